@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <library.h>
+#include <utils/debug.h>
+#include <hydra.h>
+#include <daemon.h>
+#include <sa/ike_sa.h>
+#include <sa/child_sa.h>
+
+#define SPI_IN 0xc1000000
+#define SPI_OUT 0xc2000000
+
+static void start_timing(struct timespec *start)
+{
+	clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+static double end_timing(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_nsec - start->tv_nsec) / 1000000000.0 +
+			(end.tv_sec - start->tv_sec) * 1.0;
+}
+
+/**
+ * Create an installed CHILD_SA with the given SPIs
+ */
+static child_sa_t *create_child(host_t *me, host_t *other, child_cfg_t *cfg,
+								proposal_t *proposal, u_int i)
+{
+	linked_list_t *my_ts, *other_ts;
+	child_sa_t *child_sa;
+
+	child_sa = child_sa_create(me, other, cfg, 0, FALSE);
+	child_sa->set_protocol(child_sa, PROTO_ESP);
+	child_sa->set_proposal(child_sa, proposal);
+
+	my_ts = linked_list_create();
+	my_ts->insert_last(my_ts, traffic_selector_create_from_cidr(
+											"10.1.0.0/24", 0, 0, 65535));
+	other_ts = linked_list_create();
+	other_ts->insert_last(other_ts, traffic_selector_create_from_cidr(
+											"10.2.0.0/24", 0, 0, 65535));
+	/* without kernel interface this just assigns the SPIs */
+	child_sa->install(child_sa, chunk_empty, chunk_empty, htonl(SPI_IN + i),
+					  0, TRUE, TRUE, FALSE, my_ts, other_ts);
+	child_sa->install(child_sa, chunk_empty, chunk_empty, htonl(SPI_OUT + i),
+					  0, TRUE, FALSE, FALSE, my_ts, other_ts);
+	child_sa->set_state(child_sa, CHILD_INSTALLED);
+	my_ts->destroy_offset(my_ts, offsetof(traffic_selector_t, destroy));
+	other_ts->destroy_offset(other_ts, offsetof(traffic_selector_t, destroy));
+	return child_sa;
+}
+
+/**
+ * Look up all CHILD_SAs count times by inbound and outbound SPI, and by reqid
+ */
+static void lookup(ike_sa_t *ike_sa, u_int children, u_int count)
+{
+	struct timespec timing;
+	child_sa_t *child_sa;
+	u_int i, found = 0;
+
+	start_timing(&timing);
+	for (i = 0; i < count; i++)
+	{
+		child_sa = ike_sa->get_child_sa(ike_sa, PROTO_ESP,
+									htonl(SPI_IN + i % children), TRUE);
+		if (child_sa)
+		{
+			found++;
+		}
+	}
+	printf("%u inbound SPI lookups (%u found) in %.4fs, %.0f lookups/s\n",
+		   count, found, end_timing(&timing), count / end_timing(&timing));
+
+	found = 0;
+	start_timing(&timing);
+	for (i = 0; i < count; i++)
+	{
+		child_sa = ike_sa->get_child_sa(ike_sa, PROTO_ESP,
+									htonl(SPI_OUT + i % children), FALSE);
+		if (child_sa)
+		{
+			found++;
+		}
+	}
+	printf("%u outbound SPI lookups (%u found) in %.4fs, %.0f lookups/s\n",
+		   count, found, end_timing(&timing), count / end_timing(&timing));
+
+	found = 0;
+	start_timing(&timing);
+	for (i = 0; i < count; i++)
+	{
+		child_sa = ike_sa->get_child_sa(ike_sa, PROTO_ESP,
+										htonl(SPI_OUT + i % children), TRUE);
+		if (child_sa)
+		{
+			found++;
+		}
+	}
+	printf("%u failing lookups (%u found) in %.4fs, %.0f lookups/s\n",
+		   count, found, end_timing(&timing), count / end_timing(&timing));
+}
+
+/**
+ * Look up CHILD_SAs by reqid, count times
+ */
+static void lookup_reqid(ike_sa_t *ike_sa, u_int32_t first, u_int children,
+						 u_int count)
+{
+	struct timespec timing;
+	u_int i, found = 0;
+
+	start_timing(&timing);
+	for (i = 0; i < count; i++)
+	{
+		if (ike_sa->get_child_sa_by_reqid(ike_sa, first + i % children))
+		{
+			found++;
+		}
+	}
+	printf("%u reqid lookups (%u found) in %.4fs, %.0f lookups/s\n",
+		   count, found, end_timing(&timing), count / end_timing(&timing));
+}
+
+int main(int argc, char *argv[])
+{
+	ike_sa_t *ike_sa;
+	child_cfg_t *cfg;
+	child_sa_t *child_sa;
+	proposal_t *proposal;
+	host_t *me, *other;
+	lifetime_cfg_t lifetime = {
+		.time = {
+			.life = 0,
+		},
+	};
+	struct timespec timing;
+	u_int children, count, i;
+	u_int32_t first = 0;
+
+	library_init(NULL);
+	atexit(library_deinit);
+	if (!libhydra_init("child_sa_lookup_speed"))
+	{
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	atexit(libhydra_deinit);
+	if (!libcharon_init("child_sa_lookup_speed"))
+	{
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	atexit(libcharon_deinit);
+	dbg_default_set_level(0);
+
+	children = argc > 1 ? atoi(argv[1]) : 1000;
+	count = argc > 2 ? atoi(argv[2]) : 1000000;
+	if (children == 0)
+	{
+		fprintf(stderr, "at least one CHILD_SA is required\n");
+		exit(1);
+	}
+
+	me = host_create_from_string("192.168.0.1", 500);
+	other = host_create_from_string("192.168.0.2", 500);
+	cfg = child_cfg_create("bench", &lifetime, NULL, FALSE, MODE_TUNNEL,
+						   ACTION_NONE, ACTION_NONE, ACTION_NONE, FALSE,
+						   0, 0, NULL, NULL, 0);
+	proposal = proposal_create_default(PROTO_ESP);
+	ike_sa = ike_sa_create(ike_sa_id_create(IKEV2, 1, 2, TRUE), TRUE, IKEV2);
+
+	printf("IKE_SA with %u CHILD_SAs\n", children);
+	start_timing(&timing);
+	for (i = 0; i < children; i++)
+	{
+		child_sa = create_child(me, other, cfg, proposal, i);
+		if (i == 0)
+		{
+			first = child_sa->get_reqid(child_sa);
+		}
+		ike_sa->add_child_sa(ike_sa, child_sa);
+	}
+	printf("%u CHILD_SAs added in %.4fs\n", children, end_timing(&timing));
+
+	lookup(ike_sa, children, count);
+	lookup_reqid(ike_sa, first, children, count);
+
+	start_timing(&timing);
+	for (i = 0; i < children; i++)
+	{
+		ike_sa->destroy_child_sa(ike_sa, PROTO_ESP, htonl(SPI_IN + i));
+	}
+	printf("%u CHILD_SAs destroyed in %.4fs, %d left\n", children,
+		   end_timing(&timing), ike_sa->get_child_count(ike_sa));
+
+	ike_sa->destroy(ike_sa);
+	proposal->destroy(proposal);
+	cfg->destroy(cfg);
+	me->destroy(me);
+	other->destroy(other);
+	return 0;
+}
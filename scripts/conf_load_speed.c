@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <library.h>
+#include <utils/debug.h>
+
+#include <confread.h>
+#include <cmp.h>
+
+#define TEMPLATES 10
+
+/**
+ * Globals of starter used by confread
+ */
+char *daemon_name = "charon";
+char *cmd = "charon";
+
+static void start_timing(struct timespec *start)
+{
+	clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+static double end_timing(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_nsec - start->tv_nsec) / 1000000000.0 +
+			(end.tv_sec - start->tv_sec) * 1.0;
+}
+
+/**
+ * Generate an ipsec.conf with count conns, each including a template via
+ * also=, every change'th conn getting a different peer address if not 0
+ */
+static bool generate(char *path, u_int count, u_int change)
+{
+	FILE *file;
+	u_int i, offset;
+
+	file = fopen(path, "w");
+	if (!file)
+	{
+		return FALSE;
+	}
+	fprintf(file, "config setup\n\n"
+			"conn %%default\n\tkeyexchange=ikev2\n\tleft=%%defaultroute\n\n");
+	for (i = 0; i < count; i++)
+	{
+		offset = change && i % change == 0;
+		fprintf(file, "conn peer-%u\n\talso=tmpl-%u\n\tright=172.%u.%u.%u\n"
+				"\trightid=peer-%u@strongswan.org\n\tauto=add\n\n",
+				i, i % TEMPLATES, 16 + offset, (i >> 8) & 0xff, i & 0xff, i);
+	}
+	/* templates at the end, so also= has to search past all conns */
+	for (i = 0; i < TEMPLATES; i++)
+	{
+		fprintf(file, "conn tmpl-%u\n\tleftsubnet=10.%u.0.0/16\n"
+				"\tleftcert=moon-%u.pem\n\tauto=ignore\n\n", i, i, i);
+	}
+	fclose(file);
+	return TRUE;
+}
+
+/**
+ * Load the config from path, timing it
+ */
+static starter_config_t *load(char *path)
+{
+	struct timespec timing;
+	starter_config_t *cfg;
+	starter_conn_t *conn;
+	u_int count = 0;
+
+	start_timing(&timing);
+	cfg = confread_load(path);
+	if (!cfg)
+	{
+		return NULL;
+	}
+	for (conn = cfg->conn_first; conn; conn = conn->next)
+	{
+		count++;
+	}
+	printf("loaded %u conns in %.4fs\n", count, end_timing(&timing));
+	return cfg;
+}
+
+int main(int argc, char *argv[])
+{
+	char path[] = "/tmp/conf_load_speed-XXXXXX";
+	struct timespec timing;
+	starter_config_t *old, *new;
+	starter_conn_t *conn;
+	u_int count, change, added = 0, deleted = 0;
+	int fd;
+
+	library_init(NULL);
+	atexit(library_deinit);
+	dbg_default_set_level(0);
+
+	count = argc > 1 ? atoi(argv[1]) : 50000;
+	change = argc > 2 ? atoi(argv[2]) : 100;
+
+	fd = mkstemp(path);
+	if (fd == -1)
+	{
+		return 1;
+	}
+	close(fd);
+
+	printf("%u conns including %u templates, every %u. changed on reload\n",
+		   count, TEMPLATES, change);
+	if (!generate(path, count, 0) || !(old = load(path)))
+	{
+		unlink(path);
+		return 1;
+	}
+	/* as if starter had added all conns to charon */
+	for (conn = old->conn_first; conn; conn = conn->next)
+	{
+		if (conn->state == STATE_TO_ADD)
+		{
+			conn->state = STATE_ADDED;
+		}
+	}
+	if (!generate(path, count, change) || !(new = load(path)))
+	{
+		confread_free(old);
+		unlink(path);
+		return 1;
+	}
+	unlink(path);
+
+	start_timing(&timing);
+	starter_cmp_config(old, new);
+	for (conn = old->conn_first; conn; conn = conn->next)
+	{
+		if (conn->state == STATE_ADDED)
+		{
+			deleted++;
+		}
+	}
+	for (conn = new->conn_first; conn; conn = conn->next)
+	{
+		if (conn->state == STATE_TO_ADD)
+		{
+			added++;
+		}
+	}
+	printf("compared configs in %.4fs, %u conns to delete, %u to add\n",
+		   end_timing(&timing), deleted, added);
+
+	confread_free(old);
+	confread_free(new);
+	return 0;
+}
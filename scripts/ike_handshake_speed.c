@@ -0,0 +1,624 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <library.h>
+#include <utils/debug.h>
+#include <hydra.h>
+#include <daemon.h>
+#include <collections/blocking_queue.h>
+#include <credentials/sets/mem_cred.h>
+#include <processing/jobs/callback_job.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+
+/**
+ * Plugins loaded by default, providing what a handshake with the default
+ * proposals needs
+ */
+#define DEFAULT_PLUGINS "random nonce aes sha1 sha2 hmac gmp"
+
+#define INITIATOR "10.0.0.1"
+#define RESPONDER "10.0.0.2"
+
+static void start_timing(struct timespec *start)
+{
+	clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+static double end_timing(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_nsec - start->tv_nsec) / 1000000000.0 +
+			(end.tv_sec - start->tv_sec) * 1.0;
+}
+
+/**
+ * CPU time used by all threads of the process, in seconds
+ */
+static double cpu_time()
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		   (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+#if defined(__GLIBC__) && !defined(LEAK_DETECTIVE)
+
+/**
+ * Count heap allocations of all threads by wrapping the glibc allocator
+ */
+static refcount_t allocs, frees;
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+	ref_get(&allocs);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	ref_get(&allocs);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	ref_get(&allocs);
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	if (ptr)
+	{
+		ref_get(&frees);
+	}
+	__libc_free(ptr);
+}
+
+#define HAVE_ALLOC_COUNTS
+
+#endif /* __GLIBC__ && !LEAK_DETECTIVE */
+
+/**
+ * Packets in flight between initiator and responder
+ */
+static blocking_queue_t *packets;
+
+/**
+ * Destroy packets left in flight
+ */
+static void packets_destroy()
+{
+	packets->destroy_offset(packets, offsetof(packet_t, destroy));
+}
+
+METHOD(socket_t, receive, status_t,
+	socket_t *this, packet_t **packet)
+{
+	*packet = packets->dequeue(packets);
+	return SUCCESS;
+}
+
+METHOD(socket_t, send_, status_t,
+	socket_t *this, packet_t *packet)
+{
+	/* both ends live in this process, so just loop the packet back */
+	packets->enqueue(packets, packet->clone(packet));
+	return SUCCESS;
+}
+
+METHOD(socket_t, get_port, u_int16_t,
+	socket_t *this, bool nat_t)
+{
+	return nat_t ? IKEV2_NATT_PORT : IKEV2_UDP_PORT;
+}
+
+METHOD(socket_t, supported_families, socket_family_t,
+	socket_t *this)
+{
+	return SOCKET_FAMILY_IPV4;
+}
+
+METHOD(socket_t, socket_destroy, void,
+	socket_t *this)
+{
+	free(this);
+}
+
+/**
+ * Create the loopback socket
+ */
+static socket_t *socket_create()
+{
+	socket_t *this;
+
+	INIT(this,
+		.receive = _receive,
+		.send = _send_,
+		.get_port = _get_port,
+		.supported_families = _supported_families,
+		.destroy = _socket_destroy,
+	);
+	return this;
+}
+
+/**
+ * Counter for faked SPIs
+ */
+static refcount_t spis;
+
+METHOD(kernel_ipsec_t, get_spi, status_t,
+	kernel_ipsec_t *this, host_t *src, host_t *dst,
+	u_int8_t protocol, u_int32_t reqid, u_int32_t *spi)
+{
+	*spi = htonl(ref_get(&spis));
+	return SUCCESS;
+}
+
+METHOD(kernel_ipsec_t, ipsec_destroy, void,
+	kernel_ipsec_t *this)
+{
+	free(this);
+}
+
+/**
+ * Create a kernel IPsec interface that installs nothing
+ */
+static kernel_ipsec_t *ipsec_create()
+{
+	kernel_ipsec_t *this;
+
+	INIT(this,
+		.get_spi = _get_spi,
+		.get_cpi = (void*)return_failed,
+		.add_sa = (void*)return_success,
+		.update_sa = (void*)return_success,
+		.query_sa = (void*)return_failed,
+		.del_sa = (void*)return_success,
+		.flush_sas = (void*)return_success,
+		.add_policy = (void*)return_success,
+		.query_policy = (void*)return_failed,
+		.del_policy = (void*)return_success,
+		.flush_policies = (void*)return_success,
+		.bypass_socket = (void*)return_true,
+		.enable_udp_decap = (void*)return_true,
+		.destroy = _ipsec_destroy,
+	);
+	return this;
+}
+
+METHOD(kernel_net_t, create_address_enumerator, enumerator_t*,
+	kernel_net_t *this, kernel_address_type_t which)
+{
+	return enumerator_create_empty();
+}
+
+METHOD(kernel_net_t, net_destroy, void,
+	kernel_net_t *this)
+{
+	free(this);
+}
+
+/**
+ * Create a kernel networking interface without any addresses or routes
+ */
+static kernel_net_t *net_create()
+{
+	kernel_net_t *this;
+
+	INIT(this,
+		.get_source_addr = (void*)return_null,
+		.get_nexthop = (void*)return_null,
+		.get_interface = (void*)return_false,
+		.create_address_enumerator = _create_address_enumerator,
+		.add_ip = (void*)return_success,
+		.del_ip = (void*)return_success,
+		.add_route = (void*)return_success,
+		.del_route = (void*)return_success,
+		.destroy = _net_destroy,
+	);
+	return this;
+}
+
+/**
+ * Configs of both ends
+ */
+static peer_cfg_t *initiator, *responder;
+
+METHOD(backend_t, create_peer_cfg_enumerator, enumerator_t*,
+	backend_t *this, identification_t *me, identification_t *other)
+{
+	return enumerator_create_single(responder, NULL);
+}
+
+METHOD(backend_t, create_ike_cfg_enumerator, enumerator_t*,
+	backend_t *this, host_t *me, host_t *other)
+{
+	return enumerator_create_single(responder->get_ike_cfg(responder), NULL);
+}
+
+/**
+ * Create the config of one end, with a CHILD_SA for IKE_AUTH and one for
+ * CREATE_CHILD_SA
+ */
+static peer_cfg_t *create_config(char *me, char *other, char *my_id,
+								 char *other_id)
+{
+	ike_cfg_t *ike_cfg;
+	peer_cfg_t *peer_cfg;
+	child_cfg_t *child_cfg;
+	auth_cfg_t *auth;
+	lifetime_cfg_t lifetime = {};
+	char *names[] = { "auth", "create" };
+	int i;
+
+	ike_cfg = ike_cfg_create(IKEV2, FALSE, FALSE,
+							 me, charon->socket->get_port(charon->socket, FALSE),
+							 other, IKEV2_UDP_PORT, FRAGMENTATION_NO, 0);
+	ike_cfg->add_proposal(ike_cfg, proposal_create_default(PROTO_IKE));
+	peer_cfg = peer_cfg_create(my_id, ike_cfg, CERT_NEVER_SEND, UNIQUE_NO,
+							   1, 0, 0, 0, 0, FALSE, FALSE, FALSE, 0, 0,
+							   FALSE, NULL, NULL);
+
+	auth = auth_cfg_create();
+	auth->add(auth, AUTH_RULE_AUTH_CLASS, AUTH_CLASS_PSK);
+	auth->add(auth, AUTH_RULE_IDENTITY,
+			  identification_create_from_string(my_id));
+	peer_cfg->add_auth_cfg(peer_cfg, auth, TRUE);
+	auth = auth_cfg_create();
+	auth->add(auth, AUTH_RULE_AUTH_CLASS, AUTH_CLASS_PSK);
+	auth->add(auth, AUTH_RULE_IDENTITY,
+			  identification_create_from_string(other_id));
+	peer_cfg->add_auth_cfg(peer_cfg, auth, FALSE);
+
+	for (i = 0; i < countof(names); i++)
+	{
+		child_cfg = child_cfg_create(names[i], &lifetime, NULL, FALSE,
+									 MODE_TUNNEL, ACTION_NONE, ACTION_NONE,
+									 ACTION_NONE, FALSE, 0, 0, NULL, NULL, 0);
+		child_cfg->add_proposal(child_cfg, proposal_create_default(PROTO_ESP));
+		child_cfg->add_traffic_selector(child_cfg, TRUE,
+								traffic_selector_create_dynamic(0, 0, 65535));
+		child_cfg->add_traffic_selector(child_cfg, FALSE,
+								traffic_selector_create_dynamic(0, 0, 65535));
+		peer_cfg->add_child_cfg(peer_cfg, child_cfg);
+	}
+	return peer_cfg;
+}
+
+/**
+ * Get a CHILD_SA config of the initiator by name
+ */
+static child_cfg_t *get_child_cfg(char *name)
+{
+	enumerator_t *enumerator;
+	child_cfg_t *current, *found = NULL;
+
+	enumerator = initiator->create_child_cfg_enumerator(initiator);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (streq(current->get_name(current), name))
+		{
+			found = current->get_ref(current);
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
+}
+
+/**
+ * State of the running benchmark
+ */
+static struct {
+	/** handshakes to run */
+	u_int count;
+	/** handshakes started */
+	u_int started;
+	/** handshakes completed */
+	u_int completed;
+	/** handshakes failed */
+	u_int failed;
+	/** lock for the above */
+	mutex_t *mutex;
+	/** signaled when all handshakes are done */
+	condvar_t *condvar;
+} state;
+
+static job_requeue_t initiate_ike(void *data);
+
+/**
+ * Account a finished handshake and start the next, if any.
+ */
+static void finished(bool success)
+{
+	bool next = FALSE;
+
+	state.mutex->lock(state.mutex);
+	if (success)
+	{
+		state.completed++;
+	}
+	else
+	{
+		state.failed++;
+	}
+	if (state.started < state.count)
+	{
+		state.started++;
+		next = TRUE;
+	}
+	else if (state.completed + state.failed == state.count)
+	{
+		state.condvar->signal(state.condvar);
+	}
+	state.mutex->unlock(state.mutex);
+
+	if (next)
+	{
+		lib->processor->queue_job(lib->processor, (job_t*)
+						callback_job_create(initiate_ike, NULL, NULL, NULL));
+	}
+}
+
+/**
+ * Start a new handshake with IKE_SA_INIT and IKE_AUTH
+ */
+static job_requeue_t initiate_ike(void *data)
+{
+	ike_sa_t *ike_sa;
+	ike_sa_id_t *id;
+
+	ike_sa = charon->ike_sa_manager->checkout_new(charon->ike_sa_manager,
+												  IKEV2, TRUE);
+	ike_sa->set_peer_cfg(ike_sa, initiator);
+	/* new IKE_SAs get registered when checked in, which on loopback might
+	 * be too late for the IKE_SA_INIT response */
+	id = ike_sa->get_id(ike_sa);
+	id = id->clone(id);
+	charon->ike_sa_manager->checkin(charon->ike_sa_manager, ike_sa);
+	ike_sa = charon->ike_sa_manager->checkout(charon->ike_sa_manager, id);
+	id->destroy(id);
+	if (!ike_sa)
+	{
+		finished(FALSE);
+		return JOB_REQUEUE_NONE;
+	}
+	if (ike_sa->initiate(ike_sa, get_child_cfg("auth"), 0,
+						 NULL, NULL) == SUCCESS)
+	{
+		charon->ike_sa_manager->checkin(charon->ike_sa_manager, ike_sa);
+	}
+	else
+	{
+		charon->ike_sa_manager->checkin_and_destroy(charon->ike_sa_manager,
+													ike_sa);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Continue a handshake with CREATE_CHILD_SA on an established IKE_SA
+ */
+static job_requeue_t initiate_child(ike_sa_id_t *id)
+{
+	ike_sa_t *ike_sa;
+
+	ike_sa = charon->ike_sa_manager->checkout(charon->ike_sa_manager, id);
+	if (ike_sa)
+	{
+		if (ike_sa->initiate(ike_sa, get_child_cfg("create"), 0,
+							 NULL, NULL) == SUCCESS)
+		{
+			charon->ike_sa_manager->checkin(charon->ike_sa_manager, ike_sa);
+		}
+		else
+		{
+			charon->ike_sa_manager->checkin_and_destroy(
+											charon->ike_sa_manager, ike_sa);
+		}
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+METHOD(listener_t, ike_state_change, bool,
+	listener_t *this, ike_sa_t *ike_sa, ike_sa_state_t new)
+{
+	ike_sa_id_t *id = ike_sa->get_id(ike_sa);
+
+	if (new == IKE_DESTROYING && id->is_initiator(id))
+	{	/* completed IKE_SAs are kept until the end */
+		finished(FALSE);
+	}
+	return TRUE;
+}
+
+METHOD(listener_t, child_updown, bool,
+	listener_t *this, ike_sa_t *ike_sa, child_sa_t *child_sa, bool up)
+{
+	ike_sa_id_t *id = ike_sa->get_id(ike_sa);
+
+	if (!up || !id->is_initiator(id))
+	{
+		return TRUE;
+	}
+	if (streq(child_sa->get_name(child_sa), "auth"))
+	{
+		lib->processor->queue_job(lib->processor, (job_t*)
+						callback_job_create((void*)initiate_child,
+											id->clone(id), (void*)id->destroy,
+											NULL));
+	}
+	else
+	{
+		finished(TRUE);
+	}
+	return TRUE;
+}
+
+/**
+ * Run count handshakes, at most window of them concurrently
+ */
+static void run(u_int count, u_int window, u_int threads)
+{
+	listener_t listener = {
+		.ike_state_change = _ike_state_change,
+		.child_updown = _child_updown,
+	};
+	struct timespec timing;
+	double elapsed, cpu;
+	u_int i;
+#ifdef HAVE_ALLOC_COUNTS
+	u_int allocs_start, frees_start;
+#endif
+
+	state.count = count;
+	state.started = min(window, count);
+	charon->bus->add_listener(charon->bus, &listener);
+
+	cpu = cpu_time();
+#ifdef HAVE_ALLOC_COUNTS
+	allocs_start = allocs;
+	frees_start = frees;
+#endif
+	start_timing(&timing);
+	state.mutex->lock(state.mutex);
+	for (i = 0; i < state.started; i++)
+	{
+		lib->processor->queue_job(lib->processor, (job_t*)
+						callback_job_create(initiate_ike, NULL, NULL, NULL));
+	}
+	while (state.completed + state.failed < count)
+	{
+		state.condvar->wait(state.condvar, state.mutex);
+	}
+	state.mutex->unlock(state.mutex);
+	elapsed = end_timing(&timing);
+	cpu = cpu_time() - cpu;
+
+	charon->bus->remove_listener(charon->bus, &listener);
+
+	printf("%u handshakes (IKE_SA_INIT, IKE_AUTH, CREATE_CHILD_SA), "
+		   "%u failed, %u concurrent, %u threads\n",
+		   state.completed, state.failed, window, threads);
+	printf("%.4fs, %.0f handshakes/s\n", elapsed, state.completed / elapsed);
+	printf("%.4fs CPU, %.0f handshakes/s per core\n",
+		   cpu, state.completed / cpu);
+#ifdef HAVE_ALLOC_COUNTS
+	printf("%u allocations, %u frees, %.0f allocations/handshake\n",
+		   allocs - allocs_start, frees - frees_start,
+		   (allocs - allocs_start) / (double)max(state.completed, 1));
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+	plugin_feature_t features[] = {
+		PLUGIN_CALLBACK(socket_register, socket_create),
+			PLUGIN_PROVIDE(CUSTOM, "socket"),
+		PLUGIN_CALLBACK(kernel_ipsec_register, ipsec_create),
+			PLUGIN_PROVIDE(CUSTOM, "kernel-ipsec"),
+		PLUGIN_CALLBACK(kernel_net_register, net_create),
+			PLUGIN_PROVIDE(CUSTOM, "kernel-net"),
+	};
+	backend_t backend = {
+		.create_peer_cfg_enumerator = _create_peer_cfg_enumerator,
+		.create_ike_cfg_enumerator = _create_ike_cfg_enumerator,
+		.get_peer_cfg_by_name = (void*)return_null,
+	};
+	mem_cred_t *creds;
+	u_int count, window, threads;
+	char *plugins;
+
+	count = argc > 1 ? atoi(argv[1]) : 1000;
+	window = argc > 2 ? atoi(argv[2]) : 32;
+	threads = argc > 3 ? atoi(argv[3]) : 16;
+	plugins = argc > 4 ? argv[4] : DEFAULT_PLUGINS;
+
+	library_init(NULL);
+	atexit(library_deinit);
+	packets = blocking_queue_create();
+	atexit(packets_destroy);
+	if (!libhydra_init("ike_handshake_speed"))
+	{
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	atexit(libhydra_deinit);
+	if (!libcharon_init("ike_handshake_speed"))
+	{
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	atexit(libcharon_deinit);
+	dbg_default_set_level(0);
+
+	/* the responder sees all handshakes coming from a single peer */
+	lib->settings->set_bool(lib->settings, "%s.dos_protection", FALSE,
+							charon->name);
+	lib->settings->set_int(lib->settings, "%s.retransmit_timeout", 60,
+						   charon->name);
+	lib->settings->set_str(lib->settings, "libstrongswan.plugins.random.random",
+						   "/dev/urandom");
+	/* sender, receiver and scheduler occupy a thread each */
+	lib->settings->set_int(lib->settings, "%s.threads", threads + 3,
+						   charon->name);
+
+	lib->plugins->add_static_features(lib->plugins, "ike_handshake_speed",
+									  features, countof(features), TRUE);
+	if (!charon->initialize(charon, plugins))
+	{
+		fprintf(stderr, "initializing with plugins '%s' failed\n", plugins);
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+
+	initiator = create_config(INITIATOR, RESPONDER, "initiator.bench",
+							  "responder.bench");
+	responder = create_config(RESPONDER, INITIATOR, "responder.bench",
+							  "initiator.bench");
+	charon->backends->add_backend(charon->backends, &backend);
+	creds = mem_cred_create();
+	creds->add_shared(creds, shared_key_create(SHARED_IKE,
+								chunk_clone(chunk_from_str("bench-secret"))),
+					  identification_create_from_string("initiator.bench"),
+					  identification_create_from_string("responder.bench"),
+					  NULL);
+	lib->credmgr->add_set(lib->credmgr, &creds->set);
+
+	state.mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	state.condvar = condvar_create(CONDVAR_TYPE_DEFAULT);
+	charon->start(charon);
+
+	run(count, window, threads);
+
+	lib->credmgr->remove_set(lib->credmgr, &creds->set);
+	creds->destroy(creds);
+	charon->backends->remove_backend(charon->backends, &backend);
+	initiator->destroy(initiator);
+	responder->destroy(responder);
+	state.condvar->destroy(state.condvar);
+	state.mutex->destroy(state.mutex);
+	return 0;
+}
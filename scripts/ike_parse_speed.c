@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <library.h>
+#include <utils/debug.h>
+#include <hydra.h>
+#include <daemon.h>
+#include <encoding/message.h>
+#include <encoding/parser.h>
+#include <encoding/payloads/id_payload.h>
+#include <encoding/payloads/cert_payload.h>
+#include <encoding/payloads/auth_payload.h>
+#include <encoding/payloads/sa_payload.h>
+#include <encoding/payloads/ts_payload.h>
+#include <encoding/payloads/notify_payload.h>
+
+#if defined(__GLIBC__) && !defined(LEAK_DETECTIVE)
+
+/**
+ * Count allocations by wrapping the glibc allocator
+ */
+#define COUNT_ALLOCS
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+static u_int allocs = 0;
+
+void *malloc(size_t size)
+{
+	allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if (!ptr)
+	{
+		allocs++;
+	}
+	return __libc_realloc(ptr, size);
+}
+
+#endif /* __GLIBC__ && !LEAK_DETECTIVE */
+
+static void start_timing(struct timespec *start)
+{
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, start);
+}
+
+static double end_timing(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	return (end.tv_nsec - start->tv_nsec) / 1000000000.0 +
+			(end.tv_sec - start->tv_sec) * 1.0;
+}
+
+/**
+ * Generate an unencrypted IKE_AUTH request carrying a certificate chain
+ */
+static chunk_t build_message()
+{
+	message_t *message;
+	packet_t *packet;
+	linked_list_t *list;
+	auth_payload_t *auth;
+	identification_t *id;
+	ike_sa_id_t *ike_sa_id;
+	chunk_t data = chunk_empty;
+	int i;
+
+	message = message_create(IKEV2_MAJOR_VERSION, IKEV2_MINOR_VERSION);
+	message->set_exchange_type(message, IKE_AUTH);
+	message->set_request(message, TRUE);
+	message->set_message_id(message, 1);
+	ike_sa_id = ike_sa_id_create(IKEV2_MAJOR_VERSION, 0x0102030405060708,
+								 0x1112131415161718, TRUE);
+	message->set_ike_sa_id(message, ike_sa_id);
+	ike_sa_id->destroy(ike_sa_id);
+	message->set_source(message, host_create_from_string("192.168.0.1", 4500));
+	message->set_destination(message,
+							 host_create_from_string("192.168.0.2", 4500));
+
+	id = identification_create_from_string("C=CH, O=strongSwan, CN=carol");
+	message->add_payload(message, (payload_t*)
+						 id_payload_create_from_identification(ID_INITIATOR, id));
+	id->destroy(id);
+	for (i = 0; i < 3; i++)
+	{
+		data = chunk_alloc(1200 + i * 100);
+		memset(data.ptr, i, data.len);
+		message->add_payload(message, (payload_t*)
+			cert_payload_create_custom(CERTIFICATE, ENC_X509_SIGNATURE, data));
+	}
+	auth = auth_payload_create();
+	auth->set_auth_method(auth, AUTH_RSA);
+	data = chunk_alloca(256);
+	memset(data.ptr, 0x55, data.len);
+	auth->set_data(auth, data);
+	message->add_payload(message, (payload_t*)auth);
+	message->add_notify(message, FALSE, INITIAL_CONTACT, chunk_empty);
+
+	list = linked_list_create();
+	list->insert_last(list, proposal_create_from_string(PROTO_ESP,
+												"aes128-sha256-modp2048"));
+	list->insert_last(list, proposal_create_from_string(PROTO_ESP,
+												"aes256gcm16-modp4096"));
+	message->add_payload(message, (payload_t*)
+						 sa_payload_create_from_proposals_v2(list));
+	list->destroy_offset(list, offsetof(proposal_t, destroy));
+
+	list = linked_list_create();
+	list->insert_last(list, traffic_selector_create_from_cidr(
+											"10.1.0.0/16", 0, 0, 65535));
+	list->insert_last(list, traffic_selector_create_from_cidr(
+											"10.2.0.0/16", 0, 0, 65535));
+	message->add_payload(message, (payload_t*)
+						 ts_payload_create_from_traffic_selectors(TRUE, list));
+	message->add_payload(message, (payload_t*)
+						 ts_payload_create_from_traffic_selectors(FALSE, list));
+	list->destroy_offset(list, offsetof(traffic_selector_t, destroy));
+
+	data = chunk_empty;
+	if (message->generate(message, NULL, &packet) == SUCCESS)
+	{
+		data = chunk_clone(packet->get_data(packet));
+		packet->destroy(packet);
+	}
+	message->destroy(message);
+	return data;
+}
+
+/**
+ * Load a raw IKE message from a file, skipping a non-ESP marker
+ */
+static chunk_t load_message(char *file)
+{
+	chunk_t contents, data = chunk_empty;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd != -1)
+	{
+		contents = chunk_from_fd(fd);
+		close(fd);
+		data = contents.len >= 4 && untoh32(contents.ptr) == 0 ?
+					chunk_skip(contents, 4) : contents;
+		data = chunk_clone(data);
+		chunk_free(&contents);
+	}
+	return data;
+}
+
+/**
+ * Parse the header and the payload chain of a message, as message_t does
+ */
+static bool parse_message(chunk_t data, bool zero_copy, linked_list_t *list)
+{
+	parser_t *parser;
+	payload_t *payload;
+	payload_type_t type = HEADER;
+	bool success = TRUE;
+
+	parser = parser_create(data);
+	parser->set_zero_copy(parser, zero_copy);
+	while (type != NO_PAYLOAD)
+	{
+		if (parser->parse_payload(parser, type, &payload) != SUCCESS)
+		{
+			success = FALSE;
+			break;
+		}
+		list->insert_last(list, payload);
+		if (type == ENCRYPTED)
+		{
+			break;
+		}
+		type = payload->get_next_type(payload);
+	}
+	parser->destroy(parser);
+	return success;
+}
+
+/**
+ * Destroy the parsed payloads, releasing any references to the data
+ */
+static void destroy_payloads(chunk_t data, bool zero_copy, linked_list_t *list)
+{
+	payload_t *payload;
+
+	while (list->remove_first(list, (void**)&payload) == SUCCESS)
+	{
+		if (zero_copy)
+		{
+			payload_unshare(payload, data, FALSE);
+		}
+		payload->destroy(payload);
+	}
+}
+
+#define ROUNDS 100000
+
+static void run_test(chunk_t data, bool zero_copy)
+{
+	struct timespec timing;
+	linked_list_t *list;
+	u_int start = 0;
+	int round;
+
+	list = linked_list_create();
+#ifdef COUNT_ALLOCS
+	start = allocs;
+#endif
+	if (!parse_message(data, zero_copy, list))
+	{
+		printf("parsing message failed\n");
+		destroy_payloads(data, zero_copy, list);
+		list->destroy(list);
+		return;
+	}
+	destroy_payloads(data, zero_copy, list);
+#ifdef COUNT_ALLOCS
+	printf("%s: %u allocations per message, ",
+		   zero_copy ? "zero-copy" : "copying", allocs - start);
+#else
+	printf("%s: ", zero_copy ? "zero-copy" : "copying");
+#endif
+
+	start_timing(&timing);
+	for (round = 0; round < ROUNDS; round++)
+	{
+		parse_message(data, zero_copy, list);
+		destroy_payloads(data, zero_copy, list);
+	}
+	printf("%d messages in %.4fs\n", ROUNDS, end_timing(&timing));
+	list->destroy(list);
+}
+
+int main(int argc, char *argv[])
+{
+	chunk_t data;
+	int i;
+
+	library_init(NULL);
+	atexit(library_deinit);
+	if (!libhydra_init("ike_parse_speed"))
+	{
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	atexit(libhydra_deinit);
+	if (!libcharon_init("ike_parse_speed"))
+	{
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	atexit(libcharon_deinit);
+
+	if (argc < 2)
+	{
+		data = build_message();
+		printf("generated IKE_AUTH request, %zu bytes\n", data.len);
+		run_test(data, FALSE);
+		run_test(data, TRUE);
+		chunk_free(&data);
+		return 0;
+	}
+	for (i = 1; i < argc; i++)
+	{
+		data = load_message(argv[i]);
+		if (!data.len)
+		{
+			fprintf(stderr, "loading '%s' failed\n", argv[i]);
+			continue;
+		}
+		printf("%s, %zu bytes\n", argv[i], data.len);
+		run_test(data, FALSE);
+		run_test(data, TRUE);
+		chunk_free(&data);
+	}
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <library.h>
+#include <utils/debug.h>
+#include <hydra.h>
+#include <attributes/mem_pool.h>
+
+static void start_timing(struct timespec *start)
+{
+	clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+static double end_timing(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_nsec - start->tv_nsec) / 1000000000.0 +
+			(end.tv_sec - start->tv_sec) * 1.0;
+}
+
+/**
+ * Acquire an address the way the attribute manager does
+ */
+static host_t *acquire(mem_pool_t *pool, identification_t *id,
+					   host_t *requested)
+{
+	mem_pool_op_t ops[] = { MEM_POOL_EXISTING, MEM_POOL_NEW,
+							MEM_POOL_REASSIGN };
+	host_t *addr = NULL;
+	int i;
+
+	for (i = 0; i < countof(ops) && !addr; i++)
+	{
+		addr = pool->acquire_address(pool, id, requested, ops[i]);
+	}
+	return addr;
+}
+
+/**
+ * Let count identities connect to the pool, keeping at most online leases
+ * online at the same time
+ */
+static void churn(mem_pool_t *pool, identification_t **ids, u_int count,
+				  u_int online)
+{
+	struct timespec timing;
+	host_t *requested, **addrs;
+	u_int i, failed = 0;
+
+	requested = host_create_any(AF_INET);
+	addrs = calloc(count, sizeof(host_t*));
+
+	start_timing(&timing);
+	for (i = 0; i < count; i++)
+	{
+		addrs[i] = acquire(pool, ids[i], requested);
+		if (!addrs[i])
+		{
+			failed++;
+		}
+		if (i >= online && addrs[i - online])
+		{
+			pool->release_address(pool, addrs[i - online], ids[i - online]);
+		}
+	}
+	printf("%u connects (%u failed) in %.4fs, %.0f connects/s, "
+		   "%u online, %u offline\n", count, failed, end_timing(&timing),
+		   count / end_timing(&timing), pool->get_online(pool),
+		   pool->get_offline(pool));
+
+	for (i = 0; i < count; i++)
+	{
+		if (addrs[i])
+		{
+			if (i + online >= count)
+			{
+				pool->release_address(pool, addrs[i], ids[i]);
+			}
+			addrs[i]->destroy(addrs[i]);
+		}
+	}
+	free(addrs);
+	requested->destroy(requested);
+}
+
+/**
+ * Query the lease statistics of the pool
+ */
+static void stats(mem_pool_t *pool, u_int count)
+{
+	struct timespec timing;
+	volatile u_int i, sum = 0;
+
+	start_timing(&timing);
+	for (i = 0; i < count; i++)
+	{
+		sum += pool->get_online(pool) + pool->get_offline(pool);
+	}
+	printf("%u stats queries in %.4fs, %.0f queries/s\n", count,
+		   end_timing(&timing), count / end_timing(&timing));
+}
+
+int main(int argc, char *argv[])
+{
+	identification_t **ids;
+	mem_pool_t *pool;
+	host_t *base;
+	u_int count, bits, online, i;
+
+	library_init(NULL);
+	atexit(library_deinit);
+	if (!libhydra_init("mem_pool_speed"))
+	{
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	atexit(libhydra_deinit);
+	dbg_default_set_level(0);
+
+	count = argc > 1 ? atoi(argv[1]) : 100000;
+	bits = argc > 2 ? atoi(argv[2]) : 16;
+	online = argc > 3 ? atoi(argv[3]) : 1000;
+
+	ids = calloc(count, sizeof(identification_t*));
+	for (i = 0; i < count; i++)
+	{
+		ids[i] = identification_create_from_encoding(ID_KEY_ID,
+											chunk_from_thing(i));
+	}
+	base = host_create_from_string("10.0.0.0", 0);
+	pool = mem_pool_create("bench", base, bits);
+	printf("pool of %u addresses, %u identities, %u online at a time\n",
+		   pool->get_size(pool), count, online);
+
+	printf("initial:   ");
+	churn(pool, ids, count, online);
+	printf("reconnect: ");
+	churn(pool, ids, count, online);
+	stats(pool, 10000);
+
+	pool->destroy(pool);
+	base->destroy(base);
+	for (i = 0; i < count; i++)
+	{
+		ids[i]->destroy(ids[i]);
+	}
+	free(ids);
+	return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <library.h>
+#include <utils/debug.h>
+#include <processing/processor.h>
+#include <processing/jobs/callback_job.h>
+#include <threading/thread.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+
+static void start_timing(struct timespec *start)
+{
+	clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+static double end_timing(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_nsec - start->tv_nsec) / 1000000000.0 +
+			(end.tv_sec - start->tv_sec) * 1.0;
+}
+
+static processor_t *processor;
+static mutex_t *mutex;
+static condvar_t *condvar;
+static refcount_t done;
+static u_int jobs, work;
+
+/**
+ * A job doing some dummy work
+ */
+static job_requeue_t run_job(void *data)
+{
+	volatile u_int i, sum = 0;
+
+	for (i = 0; i < work; i++)
+	{
+		sum += i;
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Count destroyed jobs, signal if all are done
+ */
+static void cleanup_job(void *data)
+{
+	if (ref_get(&done) == jobs)
+	{
+		mutex->lock(mutex);
+		condvar->signal(condvar);
+		mutex->unlock(mutex);
+	}
+}
+
+/**
+ * Queue jobs from a producer thread
+ */
+static void *produce(void *data)
+{
+	u_int i, count = (uintptr_t)data;
+
+	for (i = 0; i < count; i++)
+	{
+		processor->queue_job(processor, (job_t*)
+				callback_job_create_with_prio(run_job, NULL, cleanup_job,
+								NULL, i % JOB_PRIO_MAX));
+	}
+	return NULL;
+}
+
+static void run_test(u_int workers, u_int producers)
+{
+	struct timespec timing;
+	thread_t *threads[producers];
+	int i;
+
+	processor = processor_create();
+	processor->set_threads(processor, workers);
+	done = 0;
+
+	start_timing(&timing);
+	for (i = 0; i < producers; i++)
+	{
+		threads[i] = thread_create(produce,
+								   (void*)(uintptr_t)(jobs / producers));
+	}
+	for (i = 0; i < producers; i++)
+	{
+		threads[i]->join(threads[i]);
+	}
+	mutex->lock(mutex);
+	while (done < jobs)
+	{
+		condvar->timed_wait(condvar, mutex, 100);
+	}
+	mutex->unlock(mutex);
+	printf("%2u workers, %2u producers: %u jobs in %.4fs, %.0f jobs/s\n",
+		   workers, producers, jobs, end_timing(&timing),
+		   jobs / end_timing(&timing));
+	processor->destroy(processor);
+}
+
+int main(int argc, char *argv[])
+{
+	u_int workers[] = { 1, 2, 4, 8, 16 }, producers[] = { 1, 4 };
+	int i, j;
+
+	library_init(NULL);
+	atexit(library_deinit);
+	dbg_default_set_level(0);
+
+	jobs = argc > 1 ? atoi(argv[1]) : 200000;
+	work = argc > 2 ? atoi(argv[2]) : 100;
+	mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	condvar = condvar_create(CONDVAR_TYPE_DEFAULT);
+
+	for (i = 0; i < countof(producers); i++)
+	{
+		for (j = 0; j < countof(workers); j++)
+		{
+			jobs -= jobs % producers[i];
+			run_test(workers[j], producers[i]);
+		}
+	}
+	condvar->destroy(condvar);
+	mutex->destroy(mutex);
+	return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <library.h>
+#include <utils/debug.h>
+#include <tls.h>
+#include <credentials/sets/mem_cred.h>
+#include <credentials/certificates/x509.h>
+
+/**
+ * Plugins loaded by default, providing what the default suite needs
+ */
+#define DEFAULT_PLUGINS "random nonce aes sha1 sha2 md5 hmac gcm gmp pkcs1 x509"
+
+/**
+ * Suite negotiated by default
+ */
+#define DEFAULT_SUITE "TLS_RSA_WITH_AES_128_GCM_SHA256"
+
+/**
+ * Identity of the server, subject of its self-signed certificate
+ */
+#define SERVER_ID "C=CH, O=strongSwan, CN=tls.bench"
+
+/**
+ * Buffer size for encrypted data, as used by a stream transport
+ */
+#define CRYPTO_BUF_SIZE (TLS_MAX_FRAGMENT_LEN + 2048)
+
+/**
+ * Size of application data blocks written in bulk transfers
+ */
+#define BLOCK_SIZE (4 * TLS_MAX_FRAGMENT_LEN)
+
+/**
+ * Maximum number of flights exchanged without completing
+ */
+#define MAX_ROUNDS 16
+
+static void start_timing(struct timespec *start)
+{
+	clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+static double end_timing(struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_nsec - start->tv_nsec) / 1000000000.0 +
+			(end.tv_sec - start->tv_sec) * 1.0;
+}
+
+/**
+ * Application data source or sink for bulk transfers
+ */
+typedef struct {
+	/** implements tls_application_t */
+	tls_application_t public;
+	/** bytes left to send */
+	u_int64_t send;
+	/** bytes received so far */
+	u_int64_t received;
+	/** a block has been written, end the current batch of records */
+	bool flush;
+} bulk_app_t;
+
+METHOD(tls_application_t, app_process, status_t,
+	bulk_app_t *this, bio_reader_t *reader)
+{
+	chunk_t data;
+
+	if (!reader->read_data(reader, reader->remaining(reader), &data))
+	{
+		return FAILED;
+	}
+	this->received += data.len;
+	return NEED_MORE;
+}
+
+METHOD(tls_application_t, app_build, status_t,
+	bulk_app_t *this, bio_writer_t *writer)
+{
+	size_t len;
+
+	if (this->flush)
+	{	/* let the transport send the block before writing the next */
+		this->flush = FALSE;
+		return INVALID_STATE;
+	}
+	len = min(BLOCK_SIZE, this->send);
+	if (len)
+	{
+		memset(writer->skip(writer, len).ptr, 0x42, len);
+		this->send -= len;
+		this->flush = TRUE;
+	}
+	return INVALID_STATE;
+}
+
+/**
+ * Pass all records one end currently has to send to the other end
+ */
+static status_t transfer(tls_t *from, tls_t *to)
+{
+	char buf[CRYPTO_BUF_SIZE];
+	status_t status;
+	size_t len;
+
+	while (TRUE)
+	{
+		len = sizeof(buf);
+		status = from->build(from, buf, &len, NULL);
+		switch (status)
+		{
+			case NEED_MORE:
+			case ALREADY_DONE:
+				status = to->process(to, buf, len);
+				if (status != NEED_MORE)
+				{
+					return status;
+				}
+				continue;
+			default:
+				return status;
+		}
+	}
+}
+
+/**
+ * Exchange flights until the handshake or, with a sink, the bulk transfer
+ * completed
+ */
+static bool exchange(tls_t *client, tls_t *server, bulk_app_t *sink,
+					 u_int64_t total)
+{
+	int round;
+
+	for (round = 0; round < MAX_ROUNDS; round++)
+	{
+		if (transfer(client, server) == FAILED ||
+			transfer(server, client) == FAILED)
+		{
+			return FALSE;
+		}
+		if (sink)
+		{
+			if (sink->received == total)
+			{
+				return TRUE;
+			}
+		}
+		else if (client->is_complete(client) && server->is_complete(server))
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/**
+ * Run count handshakes, resuming sessions if caches are given
+ */
+static void run_handshakes(identification_t *id, u_int count,
+						   tls_cache_t *client_cache, tls_cache_t *server_cache)
+{
+	struct timespec timing;
+	tls_t *client, *server;
+	u_int i, failed = 0, hits, misses;
+	double elapsed;
+
+	start_timing(&timing);
+	for (i = 0; i < count; i++)
+	{
+		client = tls_create(FALSE, id, NULL, TLS_PURPOSE_GENERIC, NULL,
+							client_cache);
+		server = tls_create(TRUE, id, NULL, TLS_PURPOSE_GENERIC, NULL,
+							server_cache);
+		if (!client || !server || !exchange(client, server, NULL, 0))
+		{
+			failed++;
+		}
+		DESTROY_IF(client);
+		DESTROY_IF(server);
+	}
+	elapsed = end_timing(&timing);
+
+	printf("%u handshakes, %u failed\n", count - failed, failed);
+	if (server_cache)
+	{
+		server_cache->get_stats(server_cache, &hits, &misses);
+		printf("%u resumed, %u not resumed\n", hits, misses);
+	}
+	printf("%.4fs, %.0f handshakes/s\n", elapsed, (count - failed) / elapsed);
+}
+
+/**
+ * Transfer mbytes of application data from client to server
+ */
+static void run_bulk(identification_t *id, u_int mbytes)
+{
+	bulk_app_t source = {
+		.public = {
+			.process = _app_process,
+			.build = _app_build,
+			.destroy = (void*)nop,
+		},
+		.send = mbytes * 1024ULL * 1024ULL,
+	}, sink = {
+		.public = {
+			.process = _app_process,
+			.build = _app_build,
+			.destroy = (void*)nop,
+		},
+	};
+	struct timespec timing;
+	tls_t *client, *server;
+	double elapsed;
+	bool success;
+
+	client = tls_create(FALSE, id, NULL, TLS_PURPOSE_GENERIC,
+						&source.public, NULL);
+	server = tls_create(TRUE, id, NULL, TLS_PURPOSE_GENERIC,
+						&sink.public, NULL);
+	if (!client || !server)
+	{
+		DESTROY_IF(client);
+		DESTROY_IF(server);
+		printf("creating TLS stacks failed\n");
+		return;
+	}
+	start_timing(&timing);
+	success = exchange(client, server, &sink, mbytes * 1024ULL * 1024ULL);
+	elapsed = end_timing(&timing);
+	client->destroy(client);
+	server->destroy(server);
+
+	if (!success)
+	{
+		printf("bulk transfer failed after %llu bytes\n",
+			   (unsigned long long)sink.received);
+		return;
+	}
+	printf("%u MB application data, including handshake\n", mbytes);
+	printf("%.4fs, %.1f MB/s\n", elapsed, mbytes / elapsed);
+}
+
+/**
+ * Create a self-signed server certificate and its private key
+ */
+static mem_cred_t *create_creds(identification_t *id)
+{
+	private_key_t *key;
+	certificate_t *cert;
+	mem_cred_t *creds;
+
+	key = lib->creds->create(lib->creds, CRED_PRIVATE_KEY, KEY_RSA,
+							 BUILD_KEY_SIZE, 2048, BUILD_END);
+	if (!key)
+	{
+		return NULL;
+	}
+	cert = lib->creds->create(lib->creds, CRED_CERTIFICATE, CERT_X509,
+							  BUILD_SIGNING_KEY, key, BUILD_SUBJECT, id,
+							  BUILD_SERIAL, chunk_from_chars(0x01),
+							  BUILD_X509_FLAG, X509_CA, BUILD_END);
+	if (!cert)
+	{
+		key->destroy(key);
+		return NULL;
+	}
+	creds = mem_cred_create();
+	creds->add_cert(creds, TRUE, cert);
+	creds->add_key(creds, key);
+	return creds;
+}
+
+int main(int argc, char *argv[])
+{
+	tls_cache_t *client_cache, *server_cache;
+	identification_t *id;
+	mem_cred_t *creds;
+	u_int count, mbytes;
+	char *suite, *plugins;
+
+	count = argc > 1 ? atoi(argv[1]) : 100;
+	mbytes = argc > 2 ? atoi(argv[2]) : 64;
+	suite = argc > 3 ? argv[3] : DEFAULT_SUITE;
+	plugins = argc > 4 ? argv[4] : DEFAULT_PLUGINS;
+
+	library_init(NULL);
+	atexit(library_deinit);
+	dbg_default_set_level(0);
+
+	lib->settings->set_str(lib->settings, "libstrongswan.plugins.random.random",
+						   "/dev/urandom");
+	lib->settings->set_str(lib->settings, "libtls.suites", suite);
+	if (!lib->plugins->load(lib->plugins, plugins))
+	{
+		fprintf(stderr, "loading plugins '%s' failed\n", plugins);
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+
+	id = identification_create_from_string(SERVER_ID);
+	creds = create_creds(id);
+	if (!creds)
+	{
+		fprintf(stderr, "creating server credentials failed\n");
+		id->destroy(id);
+		exit(SS_RC_INITIALIZATION_FAILED);
+	}
+	lib->credmgr->add_set(lib->credmgr, &creds->set);
+
+	printf("%s\n", suite);
+	run_handshakes(id, count, NULL, NULL);
+
+	client_cache = tls_cache_create(count, 3600);
+	server_cache = tls_cache_create(count, 3600);
+	run_handshakes(id, count, client_cache, server_cache);
+	client_cache->destroy(client_cache);
+	server_cache->destroy(server_cache);
+
+	run_bulk(id, mbytes);
+
+	lib->credmgr->remove_set(lib->credmgr, &creds->set);
+	creds->destroy(creds);
+	id->destroy(id);
+	return 0;
+}
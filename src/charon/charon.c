@@ -26,6 +26,7 @@
 #include <sys/utsname.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <errno.h>
 
 #include <hydra.h>
 #include <daemon.h>
@@ -91,6 +92,30 @@ static void dbg_stderr(debug_t group, level_t level, char *fmt, ...)
 	}
 }
 
+/**
+ * Write the profile of the heap profiler to the configured file
+ */
+static void dump_heap_profile()
+{
+	char *path;
+	FILE *out;
+
+	path = lib->settings->get_str(lib->settings, "charon.heap_profile",
+								  IPSEC_PIDDIR "/charon.heap");
+	out = fopen(path, "w");
+	if (!out)
+	{
+		DBG1(DBG_DMN, "writing heap profile to '%s' failed: %s", path,
+			 strerror(errno));
+		return;
+	}
+	lib->heap_profiler->print(lib->heap_profiler, out,
+				lib->settings->get_bool(lib->settings,
+					"libstrongswan.heap_profiler.detailed", FALSE));
+	fclose(out);
+	DBG1(DBG_DMN, "heap profile written to '%s'", path);
+}
+
 /**
  * Run the daemon and handle unix signals
  */
@@ -98,11 +123,16 @@ static void run()
 {
 	sigset_t set;
 
-	/* handle SIGINT, SIGHUP ans SIGTERM in this handler */
+	/* handle SIGINT, SIGHUP ans SIGTERM in this handler, and SIGUSR2 if
+	 * the heap profiler is active */
 	sigemptyset(&set);
 	sigaddset(&set, SIGINT);
 	sigaddset(&set, SIGHUP);
 	sigaddset(&set, SIGTERM);
+	if (lib->heap_profiler)
+	{
+		sigaddset(&set, SIGUSR2);
+	}
 	sigprocmask(SIG_BLOCK, &set, NULL);
 
 	while (TRUE)
@@ -145,6 +175,13 @@ static void run()
 				charon->bus->alert(charon->bus, ALERT_SHUTDOWN_SIGNAL, sig);
 				return;
 			}
+			case SIGUSR2:
+			{
+				DBG1(DBG_DMN, "signal of type SIGUSR2 received. Writing heap "
+					 "profile");
+				dump_heap_profile();
+				break;
+			}
 			default:
 			{
 				DBG1(DBG_DMN, "unknown signal %d received. Ignored", sig);
@@ -424,13 +461,17 @@ int main(int argc, char *argv[])
 	}
 
 	/* add handler for SEGV and ILL,
-	 * INT, TERM and HUP are handled by sigwait() in run() */
+	 * INT, TERM, HUP and USR2 are handled by sigwait() in run() */
 	action.sa_handler = segv_handler;
 	action.sa_flags = 0;
 	sigemptyset(&action.sa_mask);
 	sigaddset(&action.sa_mask, SIGINT);
 	sigaddset(&action.sa_mask, SIGTERM);
 	sigaddset(&action.sa_mask, SIGHUP);
+	if (lib->heap_profiler)
+	{
+		sigaddset(&action.sa_mask, SIGUSR2);
+	}
 	sigaction(SIGSEGV, &action, NULL);
 	sigaction(SIGILL, &action, NULL);
 	sigaction(SIGBUS, &action, NULL);
@@ -68,6 +68,7 @@ sa/xauth/xauth_method.c sa/xauth/xauth_method.h \
 sa/xauth/xauth_manager.c sa/xauth/xauth_manager.h \
 sa/authenticator.c sa/authenticator.h \
 sa/child_sa.c sa/child_sa.h \
+sa/dh_pool.c sa/dh_pool.h \
 sa/ike_sa.c sa/ike_sa.h \
 sa/ike_sa_id.c sa/ike_sa_id.h \
 sa/keymat.h sa/keymat.c \
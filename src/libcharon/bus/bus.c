@@ -24,6 +24,31 @@
 #include <threading/rwlock.h>
 
 typedef struct private_bus_t private_bus_t;
+typedef enum hook_t hook_t;
+
+/**
+ * Listener hooks with measured dispatch times
+ */
+enum hook_t {
+	HOOK_MESSAGE,
+	HOOK_IKE_STATE_CHANGE,
+	HOOK_CHILD_STATE_CHANGE,
+	HOOK_IKE_UPDOWN,
+	HOOK_CHILD_UPDOWN,
+	HOOK_AUTHORIZE,
+	HOOK_NARROW,
+	HOOK_MAX,
+};
+
+ENUM(bus_hook_names, HOOK_MESSAGE, HOOK_NARROW,
+	"message",
+	"ike_state_change",
+	"child_state_change",
+	"ike_updown",
+	"child_updown",
+	"authorize",
+	"narrow",
+);
 
 /**
  * Private data of a bus_t object.
@@ -71,6 +96,11 @@ struct private_bus_t {
 	 * Thread local storage the threads IKE_SA
 	 */
 	thread_value_t *thread_sa;
+
+	/**
+	 * Histograms of the time to dispatch events to all listeners, per hook
+	 */
+	metric_t *dispatch[HOOK_MAX];
 };
 
 typedef struct entry_t entry_t;
@@ -432,7 +462,10 @@ METHOD(bus_t, ike_state_change, void,
 	enumerator_t *enumerator;
 	entry_t *entry;
 	bool keep;
+	metric_t *metric;
+	timeval_t start;
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
@@ -451,6 +484,8 @@ METHOD(bus_t, ike_state_change, void,
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	metric = this->dispatch[HOOK_IKE_STATE_CHANGE];
+	metric->observe_since(metric, &start);
 }
 
 METHOD(bus_t, child_state_change, void,
@@ -460,9 +495,12 @@ METHOD(bus_t, child_state_change, void,
 	ike_sa_t *ike_sa;
 	entry_t *entry;
 	bool keep;
+	metric_t *metric;
+	timeval_t start;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
@@ -482,6 +520,8 @@ METHOD(bus_t, child_state_change, void,
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	metric = this->dispatch[HOOK_CHILD_STATE_CHANGE];
+	metric->observe_since(metric, &start);
 }
 
 METHOD(bus_t, message, void,
@@ -491,9 +531,12 @@ METHOD(bus_t, message, void,
 	ike_sa_t *ike_sa;
 	entry_t *entry;
 	bool keep;
+	metric_t *metric;
+	timeval_t start;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
@@ -513,6 +556,8 @@ METHOD(bus_t, message, void,
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	metric = this->dispatch[HOOK_MESSAGE];
+	metric->observe_since(metric, &start);
 }
 
 METHOD(bus_t, ike_keys, void,
@@ -584,9 +629,12 @@ METHOD(bus_t, child_updown, void,
 	ike_sa_t *ike_sa;
 	entry_t *entry;
 	bool keep;
+	metric_t *metric;
+	timeval_t start;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
@@ -606,6 +654,8 @@ METHOD(bus_t, child_updown, void,
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	metric = this->dispatch[HOOK_CHILD_UPDOWN];
+	metric->observe_since(metric, &start);
 }
 
 METHOD(bus_t, child_rekey, void,
@@ -645,7 +695,10 @@ METHOD(bus_t, ike_updown, void,
 	enumerator_t *enumerator;
 	entry_t *entry;
 	bool keep;
+	metric_t *metric;
+	timeval_t start;
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
@@ -664,6 +717,8 @@ METHOD(bus_t, ike_updown, void,
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	metric = this->dispatch[HOOK_IKE_UPDOWN];
+	metric->observe_since(metric, &start);
 
 	/* a down event for IKE_SA implicitly downs all CHILD_SAs */
 	if (!up)
@@ -741,9 +796,12 @@ METHOD(bus_t, authorize, bool,
 	ike_sa_t *ike_sa;
 	entry_t *entry;
 	bool keep, success = TRUE;
+	metric_t *metric;
+	timeval_t start;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
@@ -767,6 +825,8 @@ METHOD(bus_t, authorize, bool,
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	metric = this->dispatch[HOOK_AUTHORIZE];
+	metric->observe_since(metric, &start);
 	if (!success)
 	{
 		alert(this, ALERT_AUTHORIZATION_FAILED);
@@ -782,9 +842,12 @@ METHOD(bus_t, narrow, void,
 	ike_sa_t *ike_sa;
 	entry_t *entry;
 	bool keep;
+	metric_t *metric;
+	timeval_t start;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
@@ -804,6 +867,8 @@ METHOD(bus_t, narrow, void,
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	metric = this->dispatch[HOOK_NARROW];
+	metric->observe_since(metric, &start);
 }
 
 METHOD(bus_t, assign_vips, void,
@@ -862,8 +927,13 @@ METHOD(bus_t, destroy, void,
 	private_bus_t *this)
 {
 	debug_t group;
+	hook_t hook;
 
 	lib->credmgr->set_hook(lib->credmgr, NULL, NULL);
+	for (hook = 0; hook < HOOK_MAX; hook++)
+	{
+		this->dispatch[hook]->destroy(this->dispatch[hook]);
+	}
 	for (group = 0; group < DBG_MAX; group++)
 	{
 		this->loggers[group]->destroy(this->loggers[group]);
@@ -884,6 +954,8 @@ bus_t *bus_create()
 {
 	private_bus_t *this;
 	debug_t group;
+	hook_t hook;
+	char labels[32];
 
 	INIT(this,
 		.public = {
@@ -912,8 +984,8 @@ bus_t *bus_create()
 			.destroy = _destroy,
 		},
 		.listeners = linked_list_create(),
-		.mutex = mutex_create(MUTEX_TYPE_RECURSIVE),
-		.log_lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.mutex = mutex_create_named(MUTEX_TYPE_RECURSIVE, "bus"),
+		.log_lock = rwlock_create_named(RWLOCK_TYPE_DEFAULT, "bus.log"),
 		.thread_sa = thread_value_create(NULL),
 	);
 
@@ -923,6 +995,13 @@ bus_t *bus_create()
 		this->max_level[group] = LEVEL_SILENT;
 		this->max_vlevel[group] = LEVEL_SILENT;
 	}
+	for (hook = 0; hook < HOOK_MAX; hook++)
+	{
+		snprintf(labels, sizeof(labels), "hook=\"%N\"", bus_hook_names, hook);
+		this->dispatch[hook] = lib->metrics->create(lib->metrics,
+								METRIC_HISTOGRAM, "bus_dispatch_seconds", labels,
+								"Time to dispatch an event to all listeners");
+	}
 
 	lib->credmgr->set_hook(lib->credmgr, (credential_hook_t)hook_creds, this);
 
@@ -443,7 +443,7 @@ backend_manager_t *backend_manager_create()
 			.destroy = _destroy,
 		},
 		.backends = linked_list_create(),
-		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.lock = rwlock_create_named(RWLOCK_TYPE_DEFAULT, "backend_manager"),
 	);
 
 	return &this->public;
@@ -68,6 +68,11 @@ struct private_daemon_t {
 	 */
 	mutex_t *mutex;
 
+	/**
+	 * Service exporting metrics, if configured
+	 */
+	stream_service_t *metrics_service;
+
 	/**
 	 * Integrity check failed?
 	 */
@@ -450,6 +455,10 @@ static void destroy(private_daemon_t *this)
 
 	/* cancel all threads and wait for their termination */
 	lib->processor->cancel(lib->processor);
+	/* DH objects must be gone before unloading plugins */
+	DESTROY_IF(this->public.dh_pool);
+
+	DESTROY_IF(this->metrics_service);
 
 #ifdef ME
 	DESTROY_IF(this->public.connect_manager);
@@ -468,6 +477,8 @@ static void destroy(private_daemon_t *this)
 	DESTROY_IF(this->public.backends);
 	DESTROY_IF(this->public.socket);
 
+	this->public.exchange_rtt->destroy(this->public.exchange_rtt);
+
 	/* rehook library logging, shutdown logging */
 	dbg = dbg_old;
 	DESTROY_IF(this->public.bus);
@@ -487,6 +498,46 @@ METHOD(daemon_t, start, void,
 }
 
 
+/**
+ * Print a snapshot of all metrics to a connecting client
+ */
+static bool print_metrics(private_daemon_t *this, stream_t *stream)
+{
+	FILE *out;
+
+	out = stream->get_file(stream);
+	if (out)
+	{
+		lib->metrics->print(lib->metrics, out);
+		fclose(out);
+	}
+	return FALSE;
+}
+
+/**
+ * Export metrics on the configured socket, if any
+ */
+static void start_metrics_service(private_daemon_t *this)
+{
+	char *uri;
+
+	uri = lib->settings->get_str(lib->settings, "%s.metrics.socket", NULL,
+								 charon->name);
+	if (!uri)
+	{
+		return;
+	}
+	this->metrics_service = lib->streams->create_service(lib->streams, uri, 10);
+	if (!this->metrics_service)
+	{
+		DBG1(DBG_DMN, "creating metrics socket '%s' failed", uri);
+		return;
+	}
+	this->metrics_service->on_accept(this->metrics_service,
+						(stream_service_cb_t)print_metrics, this,
+						JOB_PRIO_CRITICAL, 1);
+}
+
 /**
  * Initialize/deinitialize sender and receiver
  */
@@ -539,6 +590,9 @@ METHOD(daemon_t, initialize, bool,
 	{
 		return FALSE;
 	}
+	this->public.dh_pool = dh_pool_create();
+
+	start_metrics_service(this);
 
 	/* Queue start_action job */
 	lib->processor->queue_job(lib->processor, (job_t*)start_action_job_create());
@@ -569,6 +623,9 @@ private_daemon_t *daemon_create(const char *name)
 			.load_loggers = _load_loggers,
 			.set_level = _set_level,
 			.bus = bus_create(),
+			.exchange_rtt = lib->metrics->create(lib->metrics,
+							METRIC_HISTOGRAM, "ike_exchange_rtt_seconds", NULL,
+							"Time from sending an IKE request to its response"),
 			.name = strdup(name ?: "libcharon"),
 		},
 		.loggers = linked_list_create(),
@@ -158,6 +158,7 @@ typedef struct daemon_t daemon_t;
 #include <control/controller.h>
 #include <bus/bus.h>
 #include <sa/ike_sa_manager.h>
+#include <sa/dh_pool.h>
 #include <sa/trap_manager.h>
 #include <sa/shunt_manager.h>
 #include <config/backend_manager.h>
@@ -224,6 +225,11 @@ struct daemon_t {
 	 */
 	shunt_manager_t *shunts;
 
+	/**
+	 * Pool of pregenerated DH key pairs, NULL if disabled
+	 */
+	dh_pool_t *dh_pool;
+
 	/**
 	 * Manager for the different configuration backends.
 	 */
@@ -271,6 +277,11 @@ struct daemon_t {
 	mediation_manager_t *mediation_manager;
 #endif /* ME */
 
+	/**
+	 * Histogram of IKE exchange round trip times, without retransmissions
+	 */
+	metric_t *exchange_rtt;
+
 	/**
 	 * Name of the binary that uses the library (used for settings etc.)
 	 */
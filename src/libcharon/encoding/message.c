@@ -889,6 +889,16 @@ struct private_message_t {
 	 * The message rule for this message instance
 	 */
 	message_rule_t *rule;
+
+	/**
+	 * Whether parsed payloads reference the packet/decrypted data
+	 */
+	bool zero_copy;
+
+	/**
+	 * Encryption payloads holding decrypted data, encryption_payload_t
+	 */
+	linked_list_t *decrypted;
 };
 
 /**
@@ -1127,9 +1137,70 @@ METHOD(message_t, create_payload_enumerator, enumerator_t*,
 	return this->payloads->create_enumerator(this->payloads);
 }
 
+/**
+ * Detach a payload from the packet and decrypted data it might reference, if
+ * it was parsed in zero-copy mode, see payload_unshare()
+ */
+static void unshare_payload(private_message_t *this, payload_t *payload,
+							bool clone)
+{
+	enumerator_t *enumerator;
+	payload_t *encryption;
+	chunk_t *data;
+
+	if (!this->zero_copy)
+	{
+		return;
+	}
+	payload_unshare(payload, this->packet->get_data(this->packet), clone);
+	enumerator = this->decrypted->create_enumerator(this->decrypted);
+	while (enumerator->enumerate(enumerator, &encryption))
+	{
+		data = payload_get_field(encryption, ENCRYPTED_DATA, 0) ?:
+			   payload_get_field(encryption, CHUNK_DATA, 0);
+		if (data)
+		{
+			payload_unshare(payload, *data, clone);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Destroy a payload that might reference packet or decrypted data
+ */
+static void destroy_payload(private_message_t *this, payload_t *payload)
+{
+	unshare_payload(this, payload, FALSE);
+	payload->destroy(payload);
+}
+
+/**
+ * Copy all data referenced by payloads, so they don't depend on the packet
+ * or decrypted data anymore
+ */
+static void unshare_payloads(private_message_t *this)
+{
+	enumerator_t *enumerator;
+	payload_t *payload;
+
+	if (this->zero_copy)
+	{
+		enumerator = this->payloads->create_enumerator(this->payloads);
+		while (enumerator->enumerate(enumerator, &payload))
+		{
+			unshare_payload(this, payload, TRUE);
+		}
+		enumerator->destroy(enumerator);
+		this->zero_copy = FALSE;
+	}
+}
+
 METHOD(message_t, remove_payload_at, void,
 	private_message_t *this, enumerator_t *enumerator)
 {
+	/* the removed payload might outlive the message */
+	unshare_payloads(this);
 	this->payloads->remove_at(this->payloads, enumerator);
 }
 
@@ -1631,6 +1702,7 @@ METHOD(message_t, generate, status_t,
 	}
 	chunk = generator->get_chunk(generator, &lenpos);
 	htoun32(lenpos, chunk.len);
+	unshare_payloads(this);
 	this->packet->set_data(this->packet, chunk_clone(chunk));
 	if (this->is_encrypted)
 	{
@@ -1816,7 +1888,7 @@ static status_t parse_payloads(private_message_t *this)
 		{
 			DBG1(DBG_ENC, "%N payload verification failed",
 				 payload_type_names, type);
-			payload->destroy(payload);
+			destroy_payload(this, payload);
 			return VERIFY_ERROR;
 		}
 
@@ -1960,12 +2032,15 @@ static status_t decrypt_payloads(private_message_t *this, keymat_t *keymat)
 			if (enumerator->enumerate(enumerator, NULL))
 			{
 				DBG1(DBG_ENC, "encrypted payload is not last payload");
-				encryption->destroy(encryption);
+				destroy_payload(this, &encryption->payload_interface);
 				status = VERIFY_ERROR;
 				break;
 			}
+			/* the decrypted payloads reference the decrypted data, so keep
+			 * the encryption payload until we get destroyed */
+			encryption->set_zero_copy(encryption, this->zero_copy);
+			this->decrypted->insert_last(this->decrypted, encryption);
 			status = decrypt_and_extract(this, keymat, previous, encryption);
-			encryption->destroy(encryption);
 			if (status != SUCCESS)
 			{
 				break;
@@ -2066,6 +2141,10 @@ METHOD(message_t, parse_body, status_t,
 		return NOT_SUPPORTED;
 	}
 
+	/* parsed payloads reference the packet data, which we own */
+	this->zero_copy = TRUE;
+	this->parser->set_zero_copy(this->parser, TRUE);
+
 	status = parse_payloads(this);
 	if (status != SUCCESS)
 	{	/* error is already logged */
@@ -2137,8 +2216,17 @@ METHOD(message_t, parse_body, status_t,
 METHOD(message_t, destroy, void,
 	private_message_t *this)
 {
+	payload_t *payload;
+
 	DESTROY_IF(this->ike_sa_id);
-	this->payloads->destroy_offset(this->payloads, offsetof(payload_t, destroy));
+	while (this->payloads->remove_first(this->payloads,
+										(void**)&payload) == SUCCESS)
+	{
+		destroy_payload(this, payload);
+	}
+	this->payloads->destroy(this->payloads);
+	this->decrypted->destroy_offset(this->decrypted,
+									offsetof(payload_t, destroy));
 	this->packet->destroy(this->packet);
 	this->parser->destroy(this->parser);
 	free(this);
@@ -2195,6 +2283,7 @@ message_t *message_create_from_packet(packet_t *packet)
 		.first_payload = NO_PAYLOAD,
 		.packet = packet,
 		.payloads = linked_list_create(),
+		.decrypted = linked_list_create(),
 		.parser = parser_create(packet->get_data(packet)),
 	);
 
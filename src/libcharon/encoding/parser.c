@@ -83,6 +83,11 @@ struct private_parser_t {
 	 * Set of encoding rules for this parsing session.
 	 */
 	encoding_rule_t *rules;
+
+	/**
+	 * Reference input data in parsed chunks instead of copying it
+	 */
+	bool zero_copy;
 };
 
 /**
@@ -338,7 +343,7 @@ static bool parse_list(private_parser_t *this, int rule_number,
  * Parse data from current parsing position in a chunk.
  */
 static bool parse_chunk(private_parser_t *this, int rule_number,
-						chunk_t *output_pos, int length)
+						chunk_t *output_pos, int length, bool copy)
 {
 	if (this->byte_pos + length > this->input_roof)
 	{
@@ -350,14 +355,34 @@ static bool parse_chunk(private_parser_t *this, int rule_number,
 	}
 	if (output_pos)
 	{
-		*output_pos = chunk_alloc(length);
-		memcpy(output_pos->ptr, this->byte_pos, length);
+		if (this->zero_copy && !copy)
+		{
+			*output_pos = chunk_create(length ? this->byte_pos : NULL, length);
+		}
+		else
+		{
+			*output_pos = chunk_alloc(length);
+			memcpy(output_pos->ptr, this->byte_pos, length);
+		}
 		DBG3(DBG_ENC, "   %b", output_pos->ptr, length);
 	}
 	this->byte_pos += length;
 	return TRUE;
 }
 
+/**
+ * Destroy a partially parsed payload
+ */
+static void destroy_payload(private_parser_t *this, payload_t *payload)
+{
+	if (this->zero_copy)
+	{
+		payload_unshare(payload, chunk_create(this->input,
+									this->input_roof - this->input), FALSE);
+	}
+	payload->destroy(payload);
+}
+
 METHOD(parser_t, parse_payload, status_t,
 	private_parser_t *this, payload_type_t payload_type, payload_t **payload)
 {
@@ -396,7 +421,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint4(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -406,7 +431,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint8(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -415,7 +440,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint16(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -425,7 +450,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint32(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -434,7 +459,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_bytes(this, rule_number, output + rule->offset, 8))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -444,7 +469,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_bit(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -453,7 +478,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint16(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				/* parsed u_int16 should be aligned */
@@ -461,7 +486,7 @@ METHOD(parser_t, parse_payload, status_t,
 				/* all payloads must have at least 4 bytes header */
 				if (payload_length < 4)
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -470,7 +495,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint8(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				spi_size = *(u_int8_t*)(output + rule->offset);
@@ -479,9 +504,9 @@ METHOD(parser_t, parse_payload, status_t,
 			case SPI:
 			{
 				if (!parse_chunk(this, rule_number, output + rule->offset,
-								 spi_size))
+								 spi_size, FALSE))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -501,18 +526,20 @@ METHOD(parser_t, parse_payload, status_t,
 								rule->type - PAYLOAD_LIST,
 								payload_length - header_length))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
 			}
 			case CHUNK_DATA:
 			{
+				/* encrypted IKEv2 data gets decrypted in-place, copy it */
 				if (payload_length < header_length ||
 					!parse_chunk(this, rule_number, output + rule->offset,
-								 payload_length - header_length))
+								 payload_length - header_length,
+								 payload_type == ENCRYPTED))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -520,9 +547,9 @@ METHOD(parser_t, parse_payload, status_t,
 			case ENCRYPTED_DATA:
 			{
 				if (!parse_chunk(this, rule_number, output + rule->offset,
-								 this->input_roof - this->byte_pos))
+								 this->input_roof - this->byte_pos, TRUE))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -531,7 +558,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_bit(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				attribute_format = *(bool*)(output + rule->offset);
@@ -541,7 +568,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint15(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -550,7 +577,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint16(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				attribute_length = *(u_int16_t*)(output + rule->offset);
@@ -560,7 +587,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint16(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				attribute_length = *(u_int16_t*)(output + rule->offset);
@@ -570,9 +597,9 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (attribute_format == FALSE &&
 					!parse_chunk(this, rule_number, output + rule->offset,
-								 attribute_length))
+								 attribute_length, FALSE))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -581,7 +608,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				if (!parse_uint8(this, rule_number, output + rule->offset))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				ts_type = *(u_int8_t*)(output + rule->offset);
@@ -592,9 +619,9 @@ METHOD(parser_t, parse_payload, status_t,
 				int address_length = (ts_type == TS_IPV4_ADDR_RANGE) ? 4 : 16;
 
 				if (!parse_chunk(this, rule_number, output + rule->offset,
-								 address_length))
+								 address_length, FALSE))
 				{
-					pld->destroy(pld);
+					destroy_payload(this, pld);
 					return PARSE_ERROR;
 				}
 				break;
@@ -603,7 +630,7 @@ METHOD(parser_t, parse_payload, status_t,
 			{
 				DBG1(DBG_ENC, "  no rule to parse rule %d %N",
 					 rule_number, encoding_type_names, rule->type);
-				pld->destroy(pld);
+				destroy_payload(this, pld);
 				return PARSE_ERROR;
 			}
 		}
@@ -630,6 +657,12 @@ METHOD(parser_t, reset_context, void,
 	this->bit_pos = 0;
 }
 
+METHOD(parser_t, set_zero_copy, void,
+	private_parser_t *this, bool enable)
+{
+	this->zero_copy = enable;
+}
+
 METHOD(parser_t, destroy, void,
 	private_parser_t *this)
 {
@@ -648,6 +681,7 @@ parser_t *parser_create(chunk_t data)
 			.parse_payload = _parse_payload,
 			.reset_context = _reset_context,
 			.get_remaining_byte_count = _get_remaining_byte_count,
+			.set_zero_copy = _set_zero_copy,
 			.destroy = _destroy,
 		},
 		.input = data.ptr,
@@ -62,6 +62,19 @@ struct parser_t {
 	 */
 	void (*reset_context) (parser_t *this);
 
+	/**
+	 * Let parsed payloads reference the input data instead of copying it.
+	 *
+	 * Variable length fields of payloads parsed in this mode point into the
+	 * data passed to parser_create(), which therefore must outlive these
+	 * payloads. Before such a payload gets destroyed, payload_unshare() must
+	 * be called for the parsed data. Encrypted data is always copied, as it
+	 * gets decrypted in-place.
+	 *
+	 * @param enable		TRUE to reference input data, FALSE to copy it
+	 */
+	void (*set_zero_copy) (parser_t *this, bool enable);
+
 	/**
 	 * Destroys a parser_t object.
 	 */
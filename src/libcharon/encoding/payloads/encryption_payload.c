@@ -77,6 +77,11 @@ struct private_encryption_payload_t {
 	 * Type of payload, ENCRYPTED or ENCRYPTED_V1
 	 */
 	payload_type_t type;
+
+	/**
+	 * Whether parsed payloads reference the decrypted data
+	 */
+	bool zero_copy;
 };
 
 /**
@@ -446,6 +451,7 @@ static status_t parse(private_encryption_payload_t *this, chunk_t plain)
 	payload_type_t type;
 
 	parser = parser_create(plain);
+	parser->set_zero_copy(parser, this->zero_copy);
 	type = this->next_payload;
 	while (type != NO_PAYLOAD)
 	{
@@ -467,6 +473,7 @@ static status_t parse(private_encryption_payload_t *this, chunk_t plain)
 		{
 			DBG1(DBG_ENC, "%N verification failed",
 				 payload_type_names, payload->get_type(payload));
+			payload_unshare(payload, this->encrypted, FALSE);
 			payload->destroy(payload);
 			parser->destroy(parser);
 			return VERIFY_ERROR;
@@ -583,10 +590,27 @@ METHOD(encryption_payload_t, set_transform, void,
 	this->aead = aead;
 }
 
+METHOD(encryption_payload_t, set_zero_copy, void,
+	private_encryption_payload_t *this, bool enable)
+{
+	this->zero_copy = enable;
+}
+
 METHOD2(payload_t, encryption_payload_t, destroy, void,
 	private_encryption_payload_t *this)
 {
-	this->payloads->destroy_offset(this->payloads, offsetof(payload_t, destroy));
+	payload_t *payload;
+
+	while (this->payloads->remove_first(this->payloads,
+										(void**)&payload) == SUCCESS)
+	{
+		if (this->zero_copy)
+		{
+			payload_unshare(payload, this->encrypted, FALSE);
+		}
+		payload->destroy(payload);
+	}
+	this->payloads->destroy(this->payloads);
 	free(this->encrypted.ptr);
 	free(this);
 }
@@ -616,6 +640,7 @@ encryption_payload_t *encryption_payload_create(payload_type_t type)
 			.set_transform = _set_transform,
 			.encrypt = _encrypt,
 			.decrypt = _decrypt,
+			.set_zero_copy = _set_zero_copy,
 			.destroy = _destroy,
 		},
 		.next_payload = NO_PAYLOAD,
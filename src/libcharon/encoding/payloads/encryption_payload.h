@@ -94,6 +94,17 @@ struct encryption_payload_t {
 	 */
 	status_t (*decrypt) (encryption_payload_t *this, chunk_t assoc);
 
+	/**
+	 * Let payloads parsed during decryption reference the decrypted data.
+	 *
+	 * Payloads removed from an encryption payload in this mode must be
+	 * detached using payload_unshare() before the encryption payload gets
+	 * destroyed, see parser_t.set_zero_copy().
+	 *
+	 * @param enable		TRUE to reference decrypted data
+	 */
+	void (*set_zero_copy) (encryption_payload_t *this, bool enable);
+
 	/**
 	 * Destroys an encryption_payload_t object.
 	 */
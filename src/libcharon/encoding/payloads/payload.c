@@ -304,3 +304,51 @@ void* payload_get_field(payload_t *payload, encoding_type_t type, u_int skip)
 	}
 	return NULL;
 }
+
+/**
+ * Detach a payload from data, invoked for substructures in lists
+ */
+static void unshare(payload_t *payload, chunk_t *data, bool *clone)
+{
+	encoding_rule_t *rule;
+	linked_list_t *list;
+	chunk_t *chunk;
+	int i, count;
+
+	count = payload->get_encoding_rules(payload, &rule);
+	for (i = 0; i < count; i++)
+	{
+		switch ((int)rule[i].type)
+		{
+			case SPI:
+			case CHUNK_DATA:
+			case ENCRYPTED_DATA:
+			case ATTRIBUTE_VALUE:
+			case ADDRESS:
+				chunk = (chunk_t*)(((char*)payload) + rule[i].offset);
+				if (chunk->ptr >= data->ptr &&
+					chunk->ptr < data->ptr + data->len)
+				{
+					*chunk = *clone ? chunk_clone(*chunk) : chunk_empty;
+				}
+				break;
+			default:
+				if (rule[i].type < PAYLOAD_LIST)
+				{
+					break;
+				}
+				list = *(linked_list_t**)(((char*)payload) + rule[i].offset);
+				list->invoke_function(list, (linked_list_invoke_t)unshare,
+									  data, clone);
+				break;
+		}
+	}
+}
+
+/**
+ * See header.
+ */
+void payload_unshare(payload_t *payload, chunk_t data, bool clone)
+{
+	unshare(payload, &data, &clone);
+}
@@ -399,4 +399,17 @@ bool payload_is_known(payload_type_t type);
  */
 void* payload_get_field(payload_t *payload, encoding_type_t type, u_int skip);
 
+/**
+ * Detach the variable length fields of a payload from parsed data.
+ *
+ * Payloads parsed in zero-copy mode reference the parsed data. This function
+ * either copies or resets all such fields, including those of substructures,
+ * so that the payload can be passed on or destroyed independently of the data.
+ *
+ * @param payload	payload to detach from data
+ * @param data		parsed data the payload might reference
+ * @param clone		TRUE to copy referenced fields, FALSE to reset them
+ */
+void payload_unshare(payload_t *payload, chunk_t data, bool clone);
+
 #endif /** PAYLOAD_H_ @}*/
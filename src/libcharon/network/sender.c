@@ -200,7 +200,7 @@ sender_t * sender_create()
 			.destroy = _destroy,
 		},
 		.list = linked_list_create(),
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.mutex = mutex_create_named(MUTEX_TYPE_DEFAULT, "sender"),
 		.got = condvar_create(CONDVAR_TYPE_DEFAULT),
 		.sent = condvar_create(CONDVAR_TYPE_DEFAULT),
 		.send_delay = lib->settings->get_int(lib->settings,
@@ -170,7 +170,7 @@ static eap_peap_t *eap_peap_create(private_eap_peap_t * this,
 	include_length = lib->settings->get_bool(lib->settings,
 					"%s.plugins.eap-peap.include_length", FALSE, charon->name);
 	tls = tls_create(is_server, server, peer, TLS_PURPOSE_EAP_PEAP,
-					 application, NULL);
+					 application, tls_cache_get_shared(is_server));
 	this->tls_eap = tls_eap_create(EAP_PEAP, tls, frag_size, max_msg_count,
 												  include_length);
 	if (!this->tls_eap)
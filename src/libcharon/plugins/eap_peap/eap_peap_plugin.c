@@ -18,6 +18,7 @@
 #include "eap_peap.h"
 
 #include <daemon.h>
+#include <tls_cache.h>
 
 METHOD(plugin_t, get_name, char*,
 	eap_peap_plugin_t *this)
@@ -50,6 +51,7 @@ METHOD(plugin_t, get_features, int,
 METHOD(plugin_t, destroy, void,
 	eap_peap_plugin_t *this)
 {
+	tls_cache_shared_deinit();
 	free(this);
 }
 
@@ -67,6 +69,7 @@ plugin_t *eap_peap_plugin_create()
 			.destroy = _destroy,
 		},
 	);
+	tls_cache_shared_init();
 
 	return &this->plugin;
 }
@@ -17,14 +17,30 @@
 #include "eap_radius_plugin.h"
 
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <radius_message.h>
 #include <radius_client.h>
 #include <daemon.h>
 #include <collections/hashtable.h>
+#include <collections/linked_list.h>
 #include <threading/mutex.h>
 #include <processing/jobs/callback_job.h>
 
+/**
+ * Default maximum number of concurrently sent accounting requests
+ */
+#define DEFAULT_MAX_PENDING 32
+
+/**
+ * Default interval to retry backlogged Stop records, in s
+ */
+#define DEFAULT_BACKLOG_RETRY 60
+
 typedef struct private_eap_radius_accounting_t private_eap_radius_accounting_t;
 
 /**
@@ -61,8 +77,88 @@ struct private_eap_radius_accounting_t {
 	 * Disable accounting unless IKE_SA has at least one virtual IP
 	 */
 	bool acct_req_vip;
+
+	/**
+	 * Spread the first Interim-Update randomly over the interval
+	 */
+	bool interim_spread;
+
+	/**
+	 * Accounting requests waiting to get sent, as acct_request_t
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * Stop records not acknowledged by a server, as radius_message_t
+	 */
+	linked_list_t *backlog;
+
+	/**
+	 * Sent requests waiting for a response, as acct_request_t
+	 */
+	linked_list_t *inflight;
+
+	/**
+	 * Mutex to lock queue, in-flight requests and backlog
+	 */
+	mutex_t *queue_mutex;
+
+	/**
+	 * Number of requests currently waiting for a response
+	 */
+	u_int pending;
+
+	/**
+	 * Whether a job sending queued requests is active
+	 */
+	bool sending;
+
+	/**
+	 * Set once the backlog has been saved during shutdown
+	 */
+	bool closed;
+
+	/**
+	 * Maximum number of concurrently sent requests
+	 */
+	u_int max_pending;
+
+	/**
+	 * Interval to retry backlogged Stop records, in s
+	 */
+	u_int backlog_retry;
+
+	/**
+	 * File to persist backlogged Stop records to, if any
+	 */
+	char *backlog_file;
+
+	/**
+	 * Reference count, held by each pending request
+	 */
+	refcount_t ref;
 };
 
+/**
+ * A queued accounting request
+ */
+typedef struct {
+	/** reference to radius accounting */
+	private_eap_radius_accounting_t *this;
+	/** message to send, without client specific attributes */
+	radius_message_t *message;
+	/** copy of message sent over client */
+	radius_message_t *sent;
+	/** client sending the request */
+	radius_client_t *client;
+	/** IKE_SA to delete on timeout, NULL if none */
+	ike_sa_id_t *id;
+	/** is this a Stop record to keep in the backlog on failure */
+	bool stop;
+	/** is this a resent Stop record from the backlog */
+	bool retry;
+} acct_request_t;
+
 /**
  * Singleton instance of accounting
  */
@@ -179,27 +275,276 @@ static void update_usage(private_eap_radius_accounting_t *this,
 }
 
 /**
- * Send a RADIUS message, wait for response
+ * Destroy a queued accounting request
  */
-static bool send_message(private_eap_radius_accounting_t *this,
-						 radius_message_t *request)
+static void destroy_request(acct_request_t *req)
 {
-	radius_message_t *response;
-	radius_client_t *client;
+	DESTROY_IF(req->message);
+	DESTROY_IF(req->sent);
+	DESTROY_IF(req->client);
+	DESTROY_IF(req->id);
+	free(req);
+}
+
+/**
+ * Release a reference, destroy accounting if it was the last one
+ */
+static void accounting_unref(private_eap_radius_accounting_t *this)
+{
+	if (ref_put(&this->ref))
+	{
+		this->queue->destroy_function(this->queue, (void*)destroy_request);
+		this->inflight->destroy(this->inflight);
+		this->backlog->destroy_offset(this->backlog,
+									  offsetof(radius_message_t, destroy));
+		this->queue_mutex->destroy(this->queue_mutex);
+		this->mutex->destroy(this->mutex);
+		this->sessions->destroy(this->sessions);
+		free(this);
+	}
+}
+
+static job_requeue_t send_queued(private_eap_radius_accounting_t *this);
+
+/**
+ * Queue a job sending queued requests, if there are any and there is room
+ * for more pending requests. queue_mutex must be held.
+ */
+static void trigger_send(private_eap_radius_accounting_t *this)
+{
+	if (!this->sending && this->pending < this->max_pending &&
+		this->queue->get_count(this->queue))
+	{
+		this->sending = TRUE;
+		ref_get(&this->ref);
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)send_queued,
+				this, (callback_job_cleanup_t)accounting_unref, NULL,
+				JOB_PRIO_HIGH));
+	}
+}
+
+/**
+ * Queue a RADIUS message for asynchronous sending
+ */
+static void queue_message(private_eap_radius_accounting_t *this,
+						  radius_message_t *message, ike_sa_id_t *id,
+						  bool stop, bool retry)
+{
+	acct_request_t *req;
+
+	INIT(req,
+		.this = this,
+		.message = message,
+		.id = id ? id->clone(id) : NULL,
+		.stop = stop,
+		.retry = retry,
+	);
+	this->queue_mutex->lock(this->queue_mutex);
+	this->queue->insert_last(this->queue, req);
+	trigger_send(this);
+	this->queue_mutex->unlock(this->queue_mutex);
+}
+
+/**
+ * Completion callback of a sent accounting request
+ */
+static void request_done(acct_request_t *req, radius_message_t *request,
+						 radius_message_t *response)
+{
+	private_eap_radius_accounting_t *this = req->this;
 	bool ack = FALSE;
 
-	client = eap_radius_create_client();
-	if (client)
+	if (response)
+	{
+		ack = response->get_code(response) == RMC_ACCOUNTING_RESPONSE;
+		response->destroy(response);
+	}
+
+	this->queue_mutex->lock(this->queue_mutex);
+	this->pending--;
+	this->inflight->remove(this->inflight, req, NULL);
+	/* the message is gone if the backlog has been saved in the mean time */
+	if (!ack && req->stop && req->message && this->backlog_retry)
 	{
-		response = client->request(client, request);
-		if (response)
+		this->backlog->insert_last(this->backlog, req->message);
+		req->message = NULL;
+	}
+	trigger_send(this);
+	this->queue_mutex->unlock(this->queue_mutex);
+
+	/* a server not answering a resent record got handled the first time */
+	if (!ack && !req->retry)
+	{
+		eap_radius_handle_timeout(req->id);
+	}
+	destroy_request(req);
+	accounting_unref(this);
+}
+
+/**
+ * Send queued accounting requests, limiting the number of pending requests
+ */
+static job_requeue_t send_queued(private_eap_radius_accounting_t *this)
+{
+	acct_request_t *req;
+	chunk_t data;
+
+	while (TRUE)
+	{
+		this->queue_mutex->lock(this->queue_mutex);
+		if (this->pending >= this->max_pending ||
+			this->queue->remove_first(this->queue, (void**)&req) != SUCCESS)
+		{	/* triggered again by completed or newly queued requests */
+			this->sending = FALSE;
+			this->queue_mutex->unlock(this->queue_mutex);
+			return JOB_REQUEUE_NONE;
+		}
+		this->pending++;
+		this->inflight->insert_last(this->inflight, req);
+		ref_get(&this->ref);
+		this->queue_mutex->unlock(this->queue_mutex);
+
+		/* the client adds its own attributes, keep the original for retries */
+		data = req->message->get_encoding(req->message);
+		req->sent = radius_message_parse(data);
+		req->client = eap_radius_create_client();
+		if (!req->sent || !req->client ||
+			!req->client->request_async(req->client, req->sent,
+										(radius_client_cb_t)request_done, req))
+		{
+			request_done(req, req->sent, NULL);
+		}
+	}
+}
+
+/**
+ * Queue backlogged Stop records for another try
+ */
+static job_requeue_t retry_backlog(private_eap_radius_accounting_t *this)
+{
+	radius_message_t *message;
+	linked_list_t *backlog;
+
+	this->queue_mutex->lock(this->queue_mutex);
+	if (this->closed)
+	{
+		this->queue_mutex->unlock(this->queue_mutex);
+		return JOB_REQUEUE_NONE;
+	}
+	backlog = this->backlog;
+	this->backlog = linked_list_create();
+	this->queue_mutex->unlock(this->queue_mutex);
+
+	if (backlog->get_count(backlog))
+	{
+		DBG1(DBG_CFG, "retrying %d backlogged RADIUS Accounting-Stop records",
+			 backlog->get_count(backlog));
+	}
+	while (backlog->remove_first(backlog, (void**)&message) == SUCCESS)
+	{
+		queue_message(this, message, NULL, TRUE, TRUE);
+	}
+	backlog->destroy(backlog);
+	return JOB_RESCHEDULE(this->backlog_retry);
+}
+
+/**
+ * Load persisted Stop records into the backlog
+ */
+static void load_backlog(private_eap_radius_accounting_t *this)
+{
+	radius_message_t *message;
+	struct stat sb;
+	chunk_t data;
+	void *addr;
+	size_t len;
+	int fd;
+
+	fd = open(this->backlog_file, O_RDONLY);
+	if (fd == -1)
+	{
+		return;
+	}
+	if (fstat(fd, &sb) == 0 && sb.st_size > 0)
+	{
+		addr = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED)
+		{
+			/* encodings are concatenated, each contains its length */
+			data = chunk_create(addr, sb.st_size);
+			while (data.len >= 4)
+			{
+				len = untoh16(data.ptr + 2);
+				if (len > data.len)
+				{
+					break;
+				}
+				message = radius_message_parse(chunk_create(data.ptr, len));
+				if (!message)
+				{
+					break;
+				}
+				this->backlog->insert_last(this->backlog, message);
+				data = chunk_skip(data, len);
+			}
+			munmap(addr, sb.st_size);
+			DBG1(DBG_CFG, "loaded %d backlogged RADIUS Accounting-Stop records",
+				 this->backlog->get_count(this->backlog));
+		}
+	}
+	close(fd);
+	unlink(this->backlog_file);
+}
+
+/**
+ * Persist unsent Stop records, including those still waiting for a response.
+ * queue_mutex must be held.
+ */
+static void save_backlog(private_eap_radius_accounting_t *this)
+{
+	enumerator_t *enumerator;
+	radius_message_t *message;
+	acct_request_t *req;
+	chunk_t data = chunk_empty;
+
+	while (this->queue->remove_first(this->queue, (void**)&req) == SUCCESS)
+	{
+		if (req->stop)
+		{
+			this->backlog->insert_last(this->backlog, req->message);
+			req->message = NULL;
+		}
+		destroy_request(req);
+	}
+	/* in-flight records might still get acknowledged, but as we can't wait
+	 * for them, save them. A server detects duplicates by Acct-Session-Id */
+	enumerator = this->inflight->create_enumerator(this->inflight);
+	while (enumerator->enumerate(enumerator, &req))
+	{
+		if (req->stop && req->message)
+		{
+			this->backlog->insert_last(this->backlog, req->message);
+			req->message = NULL;
+		}
+	}
+	enumerator->destroy(enumerator);
+	while (this->backlog->remove_first(this->backlog,
+									   (void**)&message) == SUCCESS)
+	{
+		data = chunk_cat("mc", data, message->get_encoding(message));
+		message->destroy(message);
+	}
+	if (data.len && this->backlog_file)
+	{
+		if (chunk_write(data, this->backlog_file,
+						"RADIUS accounting backlog", 077, TRUE))
 		{
-			ack = response->get_code(response) == RMC_ACCOUNTING_RESPONSE;
-			response->destroy(response);
+			DBG1(DBG_CFG, "saved unsent RADIUS Accounting-Stop records to "
+				 "'%s'", this->backlog_file);
 		}
-		client->destroy(client);
 	}
-	return ack;
+	free(data.ptr);
 }
 
 /**
@@ -408,11 +753,7 @@ static job_requeue_t send_interim(interim_data_t *data)
 
 	if (message)
 	{
-		if (!send_message(this, message))
-		{
-			eap_radius_handle_timeout(data->id);
-		}
-		message->destroy(message);
+		queue_message(this, message, data->id, FALSE, FALSE);
 	}
 	return JOB_REQUEUE_NONE;
 }
@@ -476,6 +817,10 @@ static void send_start(private_eap_radius_accounting_t *this, ike_sa_t *ike_sa)
 
 	entry = get_or_create_entry(this, ike_sa);
 	entry->start_sent = TRUE;
+	if (this->interim_spread && entry->interim.interval)
+	{	/* avoid aligned Interim-Updates of SAs established at the same time */
+		entry->interim.last -= random() % entry->interim.interval;
+	}
 
 	message = radius_message_create(RMC_ACCOUNTING_REQUEST);
 	value = htonl(ACCT_STATUS_START);
@@ -487,11 +832,7 @@ static void send_start(private_eap_radius_accounting_t *this, ike_sa_t *ike_sa)
 	this->mutex->unlock(this->mutex);
 
 	add_ike_sa_parameters(this, message, ike_sa);
-	if (!send_message(this, message))
-	{
-		eap_radius_handle_timeout(ike_sa->get_id(ike_sa));
-	}
-	message->destroy(message);
+	queue_message(this, message, ike_sa->get_id(ike_sa), FALSE, FALSE);
 }
 
 /**
@@ -549,11 +890,7 @@ static void send_stop(private_eap_radius_accounting_t *this, ike_sa_t *ike_sa)
 		value = htonl(entry->cause);
 		message->add(message, RAT_ACCT_TERMINATE_CAUSE, chunk_from_thing(value));
 
-		if (!send_message(this, message))
-		{
-			eap_radius_handle_timeout(NULL);
-		}
-		message->destroy(message);
+		queue_message(this, message, NULL, TRUE, FALSE);
 		destroy_entry(entry);
 	}
 }
@@ -681,9 +1018,12 @@ METHOD(eap_radius_accounting_t, destroy, void,
 {
 	charon->bus->remove_listener(charon->bus, &this->public.listener);
 	singleton = NULL;
-	this->mutex->destroy(this->mutex);
-	this->sessions->destroy(this->sessions);
-	free(this);
+	this->queue_mutex->lock(this->queue_mutex);
+	save_backlog(this);
+	this->closed = TRUE;
+	this->queue_mutex->unlock(this->queue_mutex);
+	/* pending requests still refer to us */
+	accounting_unref(this);
 }
 
 /**
@@ -710,6 +1050,23 @@ eap_radius_accounting_t *eap_radius_accounting_create()
 		.sessions = hashtable_create((hashtable_hash_t)hash,
 									 (hashtable_equals_t)equals, 32),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.ref = 1,
+		.queue = linked_list_create(),
+		.inflight = linked_list_create(),
+		.backlog = linked_list_create(),
+		.queue_mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.max_pending = max(1, lib->settings->get_int(lib->settings,
+							"%s.plugins.eap-radius.accounting_max_pending",
+							DEFAULT_MAX_PENDING, charon->name)),
+		.backlog_retry = lib->settings->get_int(lib->settings,
+							"%s.plugins.eap-radius.accounting_backlog_retry",
+							DEFAULT_BACKLOG_RETRY, charon->name),
+		.backlog_file = lib->settings->get_str(lib->settings,
+							"%s.plugins.eap-radius.accounting_backlog_file",
+							NULL, charon->name),
+		.interim_spread = lib->settings->get_bool(lib->settings,
+							"%s.plugins.eap-radius.accounting_interim_spread",
+							TRUE, charon->name),
 	);
 	if (lib->settings->get_bool(lib->settings,
 			"%s.plugins.eap-radius.station_id_with_port", TRUE, charon->name))
@@ -725,6 +1082,20 @@ eap_radius_accounting_t *eap_radius_accounting_create()
 	{
 		singleton = this;
 		charon->bus->add_listener(charon->bus, &this->public.listener);
+
+		if (this->backlog_retry)
+		{
+			if (this->backlog_file)
+			{
+				load_backlog(this);
+			}
+			ref_get(&this->ref);
+			lib->scheduler->schedule_job(lib->scheduler,
+				(job_t*)callback_job_create((callback_job_cb_t)retry_backlog,
+					this, (callback_job_cleanup_t)accounting_unref,
+					(callback_job_cancel_t)return_false),
+				this->backlog_retry);
+		}
 	}
 	this->acct_req_vip = lib->settings->get_bool(lib->settings,
 							"%s.plugins.eap-radius.accounting_requires_vip",
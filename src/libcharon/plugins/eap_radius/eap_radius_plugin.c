@@ -97,7 +97,7 @@ static void load_configs(private_eap_radius_plugin_t *this)
 	enumerator_t *enumerator;
 	radius_config_t *config;
 	char *nas_identifier, *secret, *address, *section;
-	int auth_port, acct_port, sockets, preference;
+	int auth_port, acct_port, sockets, acct_sockets, preference;
 
 	address = lib->settings->get_str(lib->settings,
 					"%s.plugins.eap-radius.server", NULL, charon->name);
@@ -117,8 +117,11 @@ static void load_configs(private_eap_radius_plugin_t *this)
 					"%s.plugins.eap-radius.port", AUTH_PORT, charon->name);
 		sockets = lib->settings->get_int(lib->settings,
 					"%s.plugins.eap-radius.sockets", 1, charon->name);
+		acct_sockets = lib->settings->get_int(lib->settings,
+					"%s.plugins.eap-radius.acct_sockets", 1, charon->name);
 		config = radius_config_create(address, address, auth_port, ACCT_PORT,
-									  nas_identifier, secret, sockets, 0);
+									  nas_identifier, secret, sockets,
+									  acct_sockets, 0);
 		if (!config)
 		{
 			DBG1(DBG_CFG, "no RADUIS server defined");
@@ -163,11 +166,15 @@ static void load_configs(private_eap_radius_plugin_t *this)
 		sockets = lib->settings->get_int(lib->settings,
 				"%s.plugins.eap-radius.servers.%s.sockets", 1,
 				charon->name, section);
+		acct_sockets = lib->settings->get_int(lib->settings,
+				"%s.plugins.eap-radius.servers.%s.acct_sockets", 1,
+				charon->name, section);
 		preference = lib->settings->get_int(lib->settings,
 				"%s.plugins.eap-radius.servers.%s.preference", 0,
 				charon->name, section);
 		config = radius_config_create(section, address, auth_port, acct_port,
-								nas_identifier, secret, sockets, preference);
+								nas_identifier, secret, sockets, acct_sockets,
+								preference);
 		if (!config)
 		{
 			DBG1(DBG_CFG, "loading RADIUS server '%s' failed, skipped", section);
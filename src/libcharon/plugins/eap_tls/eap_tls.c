@@ -151,7 +151,8 @@ static eap_tls_t *eap_tls_create(identification_t *server,
 					charon->name);
 	include_length = lib->settings->get_bool(lib->settings,
 					"%s.plugins.eap-tls.include_length", TRUE, charon->name);
-	tls = tls_create(is_server, server, peer, TLS_PURPOSE_EAP_TLS, NULL, NULL);
+	tls = tls_create(is_server, server, peer, TLS_PURPOSE_EAP_TLS, NULL,
+					 tls_cache_get_shared(is_server));
 	this->tls_eap = tls_eap_create(EAP_TLS, tls, frag_size, max_msg_count,
 												 include_length);
 	if (!this->tls_eap)
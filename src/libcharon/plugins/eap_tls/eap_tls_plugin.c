@@ -18,6 +18,7 @@
 #include "eap_tls.h"
 
 #include <daemon.h>
+#include <tls_cache.h>
 
 METHOD(plugin_t, get_name, char*,
 	eap_tls_plugin_t *this)
@@ -48,6 +49,7 @@ METHOD(plugin_t, get_features, int,
 METHOD(plugin_t, destroy, void,
 	eap_tls_plugin_t *this)
 {
+	tls_cache_shared_deinit();
 	free(this);
 }
 
@@ -65,6 +67,7 @@ plugin_t *eap_tls_plugin_create()
 			.destroy = _destroy,
 		},
 	);
+	tls_cache_shared_init();
 
 	return &this->plugin;
 }
@@ -160,7 +160,7 @@ static eap_ttls_t *eap_ttls_create(identification_t *server,
 	include_length = lib->settings->get_bool(lib->settings,
 					"%s.plugins.eap-ttls.include_length", TRUE, charon->name);
 	tls = tls_create(is_server, server, peer, TLS_PURPOSE_EAP_TTLS,
-					 application, NULL);
+					 application, tls_cache_get_shared(is_server));
 	this->tls_eap = tls_eap_create(EAP_TTLS, tls, frag_size, max_msg_count,
 												  include_length);
 	if (!this->tls_eap)
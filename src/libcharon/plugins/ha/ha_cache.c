@@ -20,7 +20,13 @@
 #include <threading/mutex.h>
 #include <processing/jobs/callback_job.h>
 
+/**
+ * Default number of IKE_SAs to resync with a single cache lookup
+ */
+#define DEFAULT_RESYNC_BATCH 64
+
 typedef struct private_ha_cache_t private_ha_cache_t;
+typedef struct resync_job_t resync_job_t;
 
 /**
  * Private data of an ha_cache_t object.
@@ -56,6 +62,52 @@ struct private_ha_cache_t {
 	 * Mutex to lock cache
 	 */
 	mutex_t *mutex;
+
+	/**
+	 * Number of IKE_SAs to resync per batch
+	 */
+	u_int batch;
+
+	/**
+	 * Maximum number of resync messages to send per second, 0 for no limit
+	 */
+	u_int rate;
+};
+
+/**
+ * Data of a resync job streaming a segment
+ */
+struct resync_job_t {
+
+	/**
+	 * Cache to resync from
+	 */
+	private_ha_cache_t *this;
+
+	/**
+	 * Segment to resync
+	 */
+	u_int segment;
+
+	/**
+	 * IKE_SAs left to resync, NULL before the job started
+	 */
+	linked_list_t *sas;
+
+	/**
+	 * Copied messages of the current batch, not yet sent
+	 */
+	linked_list_t *messages;
+
+	/**
+	 * Earliest time to send the next message, if rate limited
+	 */
+	timeval_t next;
+
+	/**
+	 * Number of IKE_SAs resynced
+	 */
+	u_int count;
 };
 
 /**
@@ -82,8 +134,8 @@ typedef struct {
 	u_int segment;
 	/* ADD message */
 	ha_message_t *add;
-	/* list of updates UPDATE message */
-	linked_list_t *updates;
+	/* UPDATE message, all received updates merged */
+	ha_message_t *update;
 	/* last initiator mid */
 	ha_message_t *midi;
 	/* last responder mid */
@@ -101,7 +153,6 @@ static entry_t *entry_create(ha_message_t *add)
 
 	INIT(entry,
 		.add = add,
-		.updates = linked_list_create(),
 	);
 	return entry;
 }
@@ -111,9 +162,8 @@ static entry_t *entry_create(ha_message_t *add)
  */
 static void entry_destroy(entry_t *entry)
 {
-	entry->updates->destroy_offset(entry->updates,
-									offsetof(ha_message_t, destroy));
 	entry->add->destroy(entry->add);
+	DESTROY_IF(entry->update);
 	DESTROY_IF(entry->midi);
 	DESTROY_IF(entry->midr);
 	DESTROY_IF(entry->iv);
@@ -142,7 +192,15 @@ METHOD(ha_cache_t, cache, void,
 			{
 				entry->segment = this->kernel->get_segment(this->kernel,
 											ike_sa->get_other_host(ike_sa));
-				entry->updates->insert_last(entry->updates, message);
+				if (entry->update)
+				{
+					entry->update->merge(entry->update, message);
+					message->destroy(message);
+				}
+				else
+				{
+					entry->update = message;
+				}
 				break;
 			}
 			message->destroy(message);
@@ -197,11 +255,13 @@ METHOD(ha_cache_t, delete_, void,
 {
 	entry_t *entry;
 
+	this->mutex->lock(this->mutex);
 	entry = this->cache->remove(this->cache, ike_sa);
 	if (entry)
 	{
 		entry_destroy(entry);
 	}
+	this->mutex->unlock(this->mutex);
 }
 
 /**
@@ -291,47 +351,171 @@ static void rekey_segment(private_ha_cache_t *this, u_int segment)
 	list->destroy(list);
 }
 
-METHOD(ha_cache_t, resync, void,
-	private_ha_cache_t *this, u_int segment)
+/**
+ * Queue a copy of a cached message to a list, if any
+ */
+static void queue_copy(linked_list_t *list, ha_message_t *message)
+{
+	if (message)
+	{
+		message = ha_message_parse(message->get_encoding(message));
+		if (message)
+		{
+			list->insert_last(list, message);
+		}
+	}
+}
+
+/**
+ * Send the copied messages of a resync job, limiting the rate if configured.
+ *
+ * Returns 0 if all messages have been sent, or the number of milliseconds
+ * to wait before sending the next message.
+ */
+static u_int send_messages(private_ha_cache_t *this, resync_job_t *job)
 {
-	enumerator_t *enumerator, *updates;
-	ike_sa_t *ike_sa;
-	entry_t *entry;
 	ha_message_t *message;
+	timeval_t now, interval;
+	u_int wait;
 
-	DBG1(DBG_CFG, "resyncing HA segment %d", segment);
+	while (job->messages->remove_first(job->messages,
+									   (void**)&message) == SUCCESS)
+	{
+		if (this->rate)
+		{
+			time_monotonic(&now);
+			if (timercmp(&now, &job->next, <))
+			{
+				job->messages->insert_first(job->messages, message);
+				timersub(&job->next, &now, &now);
+				wait = now.tv_sec * 1000 + now.tv_usec / 1000;
+				return max(wait, 1);
+			}
+			if (timercmp(&job->next, &now, <))
+			{	/* don't accumulate credit while not sending */
+				job->next = now;
+			}
+			interval.tv_sec = 1 / this->rate;
+			interval.tv_usec = (1000000 / this->rate) % 1000000;
+			timeradd(&job->next, &interval, &job->next);
+		}
+		this->socket->push(this->socket, message);
+		message->destroy(message);
+	}
+	return 0;
+}
 
+/**
+ * Collect the IKE_SAs of the segment to resync
+ */
+static linked_list_t *collect_sas(private_ha_cache_t *this, u_int segment)
+{
+	enumerator_t *enumerator;
+	linked_list_t *sas;
+	ike_sa_t *ike_sa;
+	entry_t *entry;
+
+	sas = linked_list_create();
 	this->mutex->lock(this->mutex);
 	enumerator = this->cache->create_enumerator(this->cache);
 	while (enumerator->enumerate(enumerator, &ike_sa, &entry))
 	{
 		if (entry->segment == segment)
 		{
-			this->socket->push(this->socket, entry->add);
-			updates = entry->updates->create_enumerator(entry->updates);
-			while (updates->enumerate(updates, &message))
-			{
-				this->socket->push(this->socket, message);
-			}
-			updates->destroy(updates);
-			if (entry->midi)
-			{
-				this->socket->push(this->socket, entry->midi);
-			}
-			if (entry->midr)
-			{
-				this->socket->push(this->socket, entry->midr);
-			}
-			if (entry->iv)
-			{
-				this->socket->push(this->socket, entry->iv);
-			}
+			sas->insert_last(sas, ike_sa);
 		}
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+	return sas;
+}
+
+/**
+ * Stream the cached messages of a segment, in batches.
+ *
+ * If the rate limit is reached, the job gets rescheduled instead of blocking
+ * a worker thread.
+ */
+static job_requeue_t resync_segment(resync_job_t *job)
+{
+	private_ha_cache_t *this = job->this;
+	ike_sa_t *ike_sa;
+	entry_t *entry;
+	u_int batch, wait;
 
-	rekey_segment(this, segment);
+	if (!job->sas)
+	{
+		DBG1(DBG_CFG, "resyncing HA segment %d", job->segment);
+		job->sas = collect_sas(this, job->segment);
+		job->messages = linked_list_create();
+	}
+
+	while (TRUE)
+	{
+		wait = send_messages(this, job);
+		if (wait)
+		{
+			return JOB_RESCHEDULE_MS(wait);
+		}
+		if (!job->sas->get_count(job->sas))
+		{
+			break;
+		}
+		/* only hold the lock for a batch of SAs to not block live updates,
+		 * SAs might have vanished in the mean time */
+		this->mutex->lock(this->mutex);
+		for (batch = 0; batch < this->batch &&
+			 job->sas->remove_first(job->sas, (void**)&ike_sa) == SUCCESS;
+			 batch++)
+		{
+			entry = this->cache->get(this->cache, ike_sa);
+			if (entry && entry->segment == job->segment)
+			{
+				queue_copy(job->messages, entry->add);
+				queue_copy(job->messages, entry->update);
+				queue_copy(job->messages, entry->midi);
+				queue_copy(job->messages, entry->midr);
+				queue_copy(job->messages, entry->iv);
+				job->count++;
+			}
+		}
+		this->mutex->unlock(this->mutex);
+	}
+
+	DBG1(DBG_CFG, "resynced %u IKE_SAs of HA segment %d",
+		 job->count, job->segment);
+
+	rekey_segment(this, job->segment);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Destroy a resync job
+ */
+static void resync_job_destroy(resync_job_t *job)
+{
+	DESTROY_IF(job->sas);
+	if (job->messages)
+	{
+		job->messages->destroy_offset(job->messages,
+									  offsetof(ha_message_t, destroy));
+	}
+	free(job);
+}
+
+METHOD(ha_cache_t, resync, void,
+	private_ha_cache_t *this, u_int segment)
+{
+	resync_job_t *job;
+
+	INIT(job,
+		.this = this,
+		.segment = segment,
+	);
+	lib->processor->queue_job(lib->processor,
+		(job_t*)callback_job_create_with_prio((callback_job_cb_t)resync_segment,
+							job, (callback_job_cleanup_t)resync_job_destroy,
+							NULL, JOB_PRIO_HIGH));
 }
 
 /**
@@ -382,6 +566,11 @@ ha_cache_t *ha_cache_create(ha_kernel_t *kernel, ha_socket_t *socket,
 		.socket = socket,
 		.cache = hashtable_create(hash, equals, 8),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.batch = max(1, lib->settings->get_int(lib->settings,
+							"%s.plugins.ha.resync_batch", DEFAULT_RESYNC_BATCH,
+							charon->name)),
+		.rate = lib->settings->get_int(lib->settings,
+							"%s.plugins.ha.resync_rate", 0, charon->name),
 	);
 
 	if (sync)
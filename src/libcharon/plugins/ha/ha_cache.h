@@ -54,6 +54,8 @@ struct ha_cache_t {
 	/**
 	 * Resync a segment to the node using the cached messages.
 	 *
+	 * The cached messages are streamed asynchronously in a separate job.
+	 *
 	 * @param segment		segment to resync
 	 */
 	void (*resync)(ha_cache_t *this, u_int segment);
@@ -20,9 +20,15 @@
 #include <sa/ikev1/keymat_v1.h>
 #include <processing/jobs/callback_job.h>
 #include <processing/jobs/adopt_children_job.h>
+#include <collections/linked_list.h>
+#include <threading/thread.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
 
 typedef struct private_ha_dispatcher_t private_ha_dispatcher_t;
 typedef struct ha_diffie_hellman_t ha_diffie_hellman_t;
+typedef struct ha_worker_t ha_worker_t;
+typedef struct ha_queued_t ha_queued_t;
 
 /**
  * Private data of an ha_dispatcher_t object.
@@ -58,6 +64,88 @@ struct private_ha_dispatcher_t {
 	 * HA enabled pool
 	 */
 	ha_attribute_t *attr;
+
+	/**
+	 * Worker threads processing messages, ha_worker_t[]
+	 */
+	ha_worker_t *workers;
+
+	/**
+	 * Number of workers, 0 to process messages in the dispatcher thread
+	 */
+	u_int worker_count;
+
+	/**
+	 * Mutex to lock worker queues, pending counter and lag statistics
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Condvar signaled when all queued messages have been processed
+	 */
+	condvar_t *condvar;
+
+	/**
+	 * Number of messages queued to workers, but not yet processed
+	 */
+	u_int pending;
+
+	/**
+	 * Number of messages processed since the last lag query
+	 */
+	u_int64_t processed;
+
+	/**
+	 * Sum of replication lag of messages processed since the last lag query
+	 */
+	u_int64_t lag_sum;
+
+	/**
+	 * Maximum replication lag seen since the last lag query, in ms
+	 */
+	u_int lag_max;
+
+	/**
+	 * Interval to log replication lag, 0 to disable
+	 */
+	u_int lag_report;
+};
+
+/**
+ * A worker processing the messages of a subset of IKE_SAs
+ */
+struct ha_worker_t {
+
+	/**
+	 * Dispatcher we work for
+	 */
+	private_ha_dispatcher_t *dispatcher;
+
+	/**
+	 * Queue of ha_queued_t to process, locked by the dispatcher mutex
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * Whether a job is currently processing the queue
+	 */
+	bool active;
+};
+
+/**
+ * A message queued to a worker
+ */
+struct ha_queued_t {
+
+	/**
+	 * Message to process
+	 */
+	ha_message_t *message;
+
+	/**
+	 * Time the message has been received
+	 */
+	timeval_t received;
 };
 
 /**
@@ -985,14 +1073,13 @@ static void process_resync(private_ha_dispatcher_t *this,
 }
 
 /**
- * Dispatcher job function
+ * Process a single message of any type
  */
-static job_requeue_t dispatch(private_ha_dispatcher_t *this)
+static void process_message(private_ha_dispatcher_t *this,
+							ha_message_t *message)
 {
-	ha_message_t *message;
 	ha_message_type_t type;
 
-	message = this->socket->pull(this->socket);
 	type = message->get_type(message);
 	if (type != HA_STATUS)
 	{
@@ -1042,12 +1129,219 @@ static job_requeue_t dispatch(private_ha_dispatcher_t *this)
 			message->destroy(message);
 			break;
 	}
+}
+
+/**
+ * Account the replication lag of a message received at the given time
+ */
+static void update_lag(private_ha_dispatcher_t *this, timeval_t *received)
+{
+	timeval_t now;
+	u_int lag;
+
+	time_monotonic(&now);
+	timersub(&now, received, &now);
+	lag = now.tv_sec * 1000 + now.tv_usec / 1000;
+
+	this->processed++;
+	this->lag_sum += lag;
+	this->lag_max = max(this->lag_max, lag);
+}
+
+/**
+ * Get the worker responsible for the IKE_SA a message refers to.
+ *
+ * Returns NULL for messages that must be processed after all previously
+ * received messages have been applied, i.e. segment and status messages, and
+ * rekeyed IKE_SAs that refer to another IKE_SA.
+ */
+static ha_worker_t *get_worker(private_ha_dispatcher_t *this,
+							   ha_message_t *message)
+{
+	ha_message_attribute_t attribute;
+	ha_message_value_t value;
+	enumerator_t *enumerator;
+	ha_worker_t *worker = NULL;
+	u_int64_t spi;
+
+	switch (message->get_type(message))
+	{
+		case HA_IKE_ADD:
+		case HA_IKE_UPDATE:
+		case HA_IKE_MID_INITIATOR:
+		case HA_IKE_MID_RESPONDER:
+		case HA_IKE_IV:
+		case HA_IKE_DELETE:
+		case HA_CHILD_ADD:
+		case HA_CHILD_DELETE:
+			break;
+		default:
+			return NULL;
+	}
+	enumerator = message->create_attribute_enumerator(message);
+	while (enumerator->enumerate(enumerator, &attribute, &value))
+	{
+		switch (attribute)
+		{
+			case HA_IKE_ID:
+				spi = value.ike_sa_id->get_initiator_spi(value.ike_sa_id);
+				worker = &this->workers[chunk_hash(chunk_from_thing(spi)) %
+										this->worker_count];
+				continue;
+			case HA_IKE_REKEY_ID:
+				worker = NULL;
+				break;
+			default:
+				continue;
+		}
+		break;
+	}
+	enumerator->destroy(enumerator);
+	return worker;
+}
+
+/**
+ * Wait until all messages queued to workers have been processed
+ */
+static void wait_for_workers(private_ha_dispatcher_t *this)
+{
+	this->mutex->lock(this->mutex);
+	thread_cleanup_push((void*)this->mutex->unlock, this->mutex);
+	while (this->pending)
+	{
+		this->condvar->wait(this->condvar, this->mutex);
+	}
+	thread_cleanup_pop(TRUE);
+}
+
+/**
+ * Worker job function, processes the queued messages of a subset of IKE_SAs
+ */
+static job_requeue_t work(ha_worker_t *worker)
+{
+	private_ha_dispatcher_t *this = worker->dispatcher;
+	ha_queued_t *queued;
+
+	while (TRUE)
+	{
+		this->mutex->lock(this->mutex);
+		if (worker->queue->remove_first(worker->queue,
+										(void**)&queued) != SUCCESS)
+		{	/* a new job gets queued with the next message */
+			worker->active = FALSE;
+			this->mutex->unlock(this->mutex);
+			return JOB_REQUEUE_NONE;
+		}
+		this->mutex->unlock(this->mutex);
+
+		process_message(this, queued->message);
+
+		this->mutex->lock(this->mutex);
+		update_lag(this, &queued->received);
+		if (--this->pending == 0)
+		{
+			this->condvar->broadcast(this->condvar);
+		}
+		this->mutex->unlock(this->mutex);
+		free(queued);
+	}
+}
+
+/**
+ * Dispatcher job function
+ */
+static job_requeue_t dispatch(private_ha_dispatcher_t *this)
+{
+	ha_message_t *message;
+	ha_worker_t *worker = NULL;
+	ha_queued_t *queued;
+
+	INIT(queued);
+	message = this->socket->pull(this->socket, &queued->received);
+	queued->message = message;
+
+	if (this->worker_count)
+	{
+		worker = get_worker(this, message);
+		if (!worker)
+		{
+			wait_for_workers(this);
+		}
+	}
+	if (worker)
+	{
+		this->mutex->lock(this->mutex);
+		this->pending++;
+		worker->queue->insert_last(worker->queue, queued);
+		if (!worker->active)
+		{
+			worker->active = TRUE;
+			lib->processor->queue_job(lib->processor,
+				(job_t*)callback_job_create_with_prio((callback_job_cb_t)work,
+					worker, NULL, NULL, JOB_PRIO_HIGH));
+		}
+		this->mutex->unlock(this->mutex);
+	}
+	else
+	{
+		process_message(this, message);
+		this->mutex->lock(this->mutex);
+		update_lag(this, &queued->received);
+		this->mutex->unlock(this->mutex);
+		free(queued);
+	}
 	return JOB_REQUEUE_DIRECT;
 }
 
+METHOD(ha_dispatcher_t, get_lag, void,
+	private_ha_dispatcher_t *this, u_int *pending, u_int *avg, u_int *max)
+{
+	this->mutex->lock(this->mutex);
+	*pending = this->pending;
+	*avg = this->processed ? this->lag_sum / this->processed : 0;
+	*max = this->lag_max;
+	this->processed = 0;
+	this->lag_sum = 0;
+	this->lag_max = 0;
+	this->mutex->unlock(this->mutex);
+}
+
+/**
+ * Periodically log replication lag
+ */
+static job_requeue_t report_lag(private_ha_dispatcher_t *this)
+{
+	u_int pending, avg, max;
+
+	get_lag(this, &pending, &avg, &max);
+	DBG1(DBG_CFG, "HA replication lag: %u messages pending, "
+		 "average %ums, maximum %ums", pending, avg, max);
+
+	return JOB_RESCHEDULE(this->lag_report);
+}
+
+/**
+ * Destroy a queued message
+ */
+static void queued_destroy(ha_queued_t *queued)
+{
+	queued->message->destroy(queued->message);
+	free(queued);
+}
+
 METHOD(ha_dispatcher_t, destroy, void,
 	private_ha_dispatcher_t *this)
 {
+	u_int i;
+
+	for (i = 0; i < this->worker_count; i++)
+	{
+		this->workers[i].queue->destroy_function(this->workers[i].queue,
+												 (void*)queued_destroy);
+	}
+	free(this->workers);
+	this->condvar->destroy(this->condvar);
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -1059,10 +1353,12 @@ ha_dispatcher_t *ha_dispatcher_create(ha_socket_t *socket,
 									ha_kernel_t *kernel, ha_attribute_t *attr)
 {
 	private_ha_dispatcher_t *this;
-
+	int workers;
+	u_int i;
 
 	INIT(this,
 		.public = {
+			.get_lag = _get_lag,
 			.destroy = _destroy,
 		},
 		.socket = socket,
@@ -1070,11 +1366,37 @@ ha_dispatcher_t *ha_dispatcher_create(ha_socket_t *socket,
 		.cache = cache,
 		.kernel = kernel,
 		.attr = attr,
+		.lag_report = lib->settings->get_int(lib->settings,
+								"%s.plugins.ha.lag_report_interval", 0,
+								charon->name),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 	);
+
+	workers = lib->settings->get_int(lib->settings,
+							"%s.plugins.ha.dispatcher_workers", 0, charon->name);
+	if (workers < 0)
+	{
+		DBG1(DBG_CFG, "invalid number of HA dispatcher workers: %d, "
+			 "processing messages in the dispatcher", workers);
+		workers = 0;
+	}
+	this->worker_count = workers;
+	this->workers = calloc(this->worker_count, sizeof(ha_worker_t));
+	for (i = 0; i < this->worker_count; i++)
+	{
+		this->workers[i].dispatcher = this;
+		this->workers[i].queue = linked_list_create();
+	}
 	lib->processor->queue_job(lib->processor,
 		(job_t*)callback_job_create_with_prio((callback_job_cb_t)dispatch, this,
 				NULL, (callback_job_cancel_t)return_false, JOB_PRIO_CRITICAL));
+	if (this->lag_report)
+	{
+		lib->scheduler->schedule_job(lib->scheduler,
+			(job_t*)callback_job_create((callback_job_cb_t)report_lag, this,
+				NULL, (callback_job_cancel_t)return_false), this->lag_report);
+	}
 
 	return &this->public;
 }
-
@@ -31,9 +31,27 @@ typedef struct ha_dispatcher_t ha_dispatcher_t;
 
 /**
  * The dispatcher pulls messages in a thread an processes them.
+ *
+ * If dispatcher workers are configured, messages are distributed to the
+ * workers based on the IKE_SA they belong to, keeping the order of messages
+ * for a specific IKE_SA.
  */
 struct ha_dispatcher_t {
 
+	/**
+	 * Get the replication lag, the time between receiving and applying
+	 * a message.
+	 *
+	 * The lag is measured from the time the kernel received a message, and
+	 * the statistics cover the messages processed since the previous call.
+	 *
+	 * @param pending		number of messages waiting to get processed
+	 * @param avg			average replication lag since last call, in ms
+	 * @param max			maximum replication lag since last call, in ms
+	 */
+	void (*get_lag)(ha_dispatcher_t *this, u_int *pending, u_int *avg,
+					u_int *max);
+
 	/**
 	 * Destroy a ha_dispatcher_t.
 	 */
@@ -609,6 +609,73 @@ METHOD(ha_message_t, create_attribute_enumerator, enumerator_t*,
 	return &e->public;
 }
 
+/**
+ * Enumerate the raw encoding of attributes
+ */
+static bool enumerate_raw(attribute_enumerator_t *this,
+						  ha_message_attribute_t *attr, chunk_t *raw)
+{
+	ha_message_value_t value;
+	u_char *pos = this->buf.ptr;
+
+	if (!attribute_enumerate(this, attr, &value))
+	{
+		return FALSE;
+	}
+	*raw = chunk_create(pos, this->buf.ptr - pos);
+	return TRUE;
+}
+
+METHOD(ha_message_t, merge, void,
+	private_ha_message_t *this, ha_message_t *other)
+{
+	enumerator_t *enumerator;
+	ha_message_attribute_t attr;
+	bool replaced[256] = {0}, first = TRUE;
+	chunk_t raw, buf;
+
+	buf = chunk_clone(chunk_create(this->buf.ptr, 2));
+
+	enumerator = other->create_attribute_enumerator(other);
+	while (enumerate_raw((attribute_enumerator_t*)enumerator, &attr, &raw))
+	{
+		if (first)
+		{
+			buf = chunk_cat("mc", buf, raw);
+			first = FALSE;
+		}
+		replaced[attr & 0xFF] = TRUE;
+	}
+	enumerator->destroy(enumerator);
+
+	enumerator = create_attribute_enumerator(this);
+	while (enumerate_raw((attribute_enumerator_t*)enumerator, &attr, &raw))
+	{
+		if (!replaced[attr & 0xFF])
+		{
+			buf = chunk_cat("mc", buf, raw);
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	first = TRUE;
+	enumerator = other->create_attribute_enumerator(other);
+	while (enumerate_raw((attribute_enumerator_t*)enumerator, &attr, &raw))
+	{
+		if (first)
+		{	/* already added */
+			first = FALSE;
+			continue;
+		}
+		buf = chunk_cat("mc", buf, raw);
+	}
+	enumerator->destroy(enumerator);
+
+	free(this->buf.ptr);
+	this->buf = buf;
+	this->allocated = buf.len;
+}
+
 METHOD(ha_message_t, get_encoding, chunk_t,
 	private_ha_message_t *this)
 {
@@ -632,6 +699,7 @@ static private_ha_message_t *ha_message_create_generic()
 			.get_type = _get_type,
 			.add_attribute = _add_attribute,
 			.create_attribute_enumerator = _create_attribute_enumerator,
+			.merge = _merge,
 			.get_encoding = _get_encoding,
 			.destroy = _destroy,
 		},
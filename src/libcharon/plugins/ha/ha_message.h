@@ -199,6 +199,17 @@ struct ha_message_t {
 	 */
 	enumerator_t* (*create_attribute_enumerator)(ha_message_t *this);
 
+	/**
+	 * Merge the attributes of another message into this message.
+	 *
+	 * Attributes of a type contained in other replace all attributes of the
+	 * same type in this message. The first attribute of other, identifying
+	 * the subject of the message, stays the first attribute.
+	 *
+	 * @param other			message to merge into this message
+	 */
+	void (*merge)(ha_message_t *this, ha_message_t *other);
+
 	/**
 	 * Get the message in a encoded form.
 	 *
@@ -20,6 +20,7 @@
 #include <sys/socket.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include <daemon.h>
 #include <networking/host.h>
@@ -114,18 +115,58 @@ METHOD(ha_socket_t, push, void,
 	}
 }
 
+/**
+ * Get the monotonic reception time of a message received with recvmsg()
+ */
+static void get_received(struct msghdr *msg, timeval_t *received)
+{
+#ifdef SO_TIMESTAMP
+	struct cmsghdr *cmsg;
+	timeval_t now, stamp;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg))
+	{
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+			cmsg->cmsg_type == SCM_TIMESTAMP)
+		{	/* kernel stamps with wall clock time, convert to monotonic */
+			memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+			gettimeofday(&now, NULL);
+			if (timercmp(&stamp, &now, <))
+			{
+				timersub(&now, &stamp, &stamp);
+				time_monotonic(&now);
+				timersub(&now, &stamp, received);
+				return;
+			}
+			break;
+		}
+	}
+#endif /* SO_TIMESTAMP */
+	time_monotonic(received);
+}
+
 METHOD(ha_socket_t, pull, ha_message_t*,
-	private_ha_socket_t *this)
+	private_ha_socket_t *this, timeval_t *received)
 {
 	while (TRUE)
 	{
 		ha_message_t *message;
-		char buf[1024];
+		char buf[1024], ancillary[64];
+		struct iovec iov = {
+			.iov_base = buf,
+			.iov_len = sizeof(buf),
+		};
+		struct msghdr msg = {
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+			.msg_control = ancillary,
+			.msg_controllen = sizeof(ancillary),
+		};
 		bool oldstate;
 		ssize_t len;
 
 		oldstate = thread_cancelability(TRUE);
-		len = recv(this->fd, buf, sizeof(buf), 0);
+		len = recvmsg(this->fd, &msg, 0);
 		thread_cancelability(oldstate);
 		if (len <= 0)
 		{
@@ -144,6 +185,7 @@ METHOD(ha_socket_t, pull, ha_message_t*,
 		message = ha_message_parse(chunk_create(buf, len));
 		if (message)
 		{
+			get_received(&msg, received);
 			return message;
 		}
 	}
@@ -177,6 +219,18 @@ static bool open_socket(private_ha_socket_t *this)
 		this->fd = -1;
 		return FALSE;
 	}
+#ifdef SO_TIMESTAMP
+	{
+		int on = 1;
+
+		if (setsockopt(this->fd, SOL_SOCKET, SO_TIMESTAMP,
+					   &on, sizeof(on)) == -1)
+		{
+			DBG1(DBG_CFG, "enabling HA socket timestamps failed: %s",
+				 strerror(errno));
+		}
+	}
+#endif /* SO_TIMESTAMP */
 
 	return TRUE;
 }
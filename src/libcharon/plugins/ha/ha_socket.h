@@ -42,9 +42,13 @@ struct ha_socket_t {
 	/**
 	 * Pull synchronization information from a peer we are responsible.
 	 *
+	 * The reception time is taken from the kernel, if supported, and
+	 * includes the time the message has been waiting in the socket buffer.
+	 *
+	 * @param received	monotonic time the message has been received
 	 * @return			received message
 	 */
-	ha_message_t *(*pull)(ha_socket_t *this);
+	ha_message_t *(*pull)(ha_socket_t *this, timeval_t *received);
 
 	/**
 	 * Destroy a ha_socket_t.
@@ -59,9 +59,9 @@ static FILE* make_connection()
 }
 
 /**
- * Initiate load-tests
+ * Send a request, copy the output to stdout
  */
-static int initiate(unsigned int count, unsigned int delay)
+static int request(char *line)
 {
 	FILE *stream;
 	char c;
@@ -72,7 +72,7 @@ static int initiate(unsigned int count, unsigned int delay)
 		return 1;
 	}
 
-	fprintf(stream, "%u %u\n", count, delay);
+	fprintf(stream, "%s\n", line);
 
 	while (1)
 	{
@@ -92,13 +92,38 @@ static int initiate(unsigned int count, unsigned int delay)
 	return 0;
 }
 
+/**
+ * Initiate load-tests, with a delay in ms or at a rate per second
+ */
+static int initiate(unsigned int count, char *pace)
+{
+	unsigned int delay = 0, rate = 0;
+	char line[64], *pos;
+
+	if (pace)
+	{
+		pos = strchr(pace, '/');
+		if (pos && strcmp(pos, "/s") == 0)
+		{
+			rate = atoi(pace);
+		}
+		else
+		{
+			delay = atoi(pace);
+		}
+	}
+	snprintf(line, sizeof(line), "%u %u %u", count, delay, rate);
+	return request(line);
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc >= 3 && strcmp(argv[1], "initiate") == 0)
 	{
-		return initiate(atoi(argv[2]), argc > 3 ? atoi(argv[3]) : 0);
+		return initiate(atoi(argv[2]), argc > 3 ? argv[3] : NULL);
 	}
 	fprintf(stderr, "Usage:\n");
-	fprintf(stderr, "  %s initiate <count> [<delay in ms>]\n", argv[0]);
+	fprintf(stderr, "  %s initiate <count> [<delay in ms>|<rate>/s]\n",
+			argv[0]);
 	return 1;
 }
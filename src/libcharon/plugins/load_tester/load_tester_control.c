@@ -14,6 +14,7 @@
  */
 
 #include "load_tester_control.h"
+#include "load_tester_stats.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -172,17 +173,35 @@ static bool initiate_cb(init_listener_t *this, debug_t group, level_t level,
 	return TRUE;
 }
 
+/**
+ * Wait between initiations, either for a fixed delay or until the i-th
+ * initiation is due at the given rate per second
+ */
+static void pace(timeval_t *start, u_int i, u_int delay, u_int rate)
+{
+	if (rate)
+	{
+		load_tester_stats_pace(start, i, rate);
+	}
+	else if (delay)
+	{
+		usleep(delay * 1000);
+	}
+}
+
 /**
  * Accept connections, initiate load-test, write progress to stream
  */
 static bool on_accept(private_load_tester_control_t *this, stream_t *io)
 {
 	init_listener_t *listener;
+	load_tester_stats_t *stats;
 	enumerator_t *enumerator;
 	peer_cfg_t *peer_cfg;
 	child_cfg_t *child_cfg;
-	u_int i, count, failed = 0, delay = 0;
-	char buf[16] = "";
+	u_int i, count, failed = 0, delay = 0, rate = 0;
+	timeval_t start;
+	char buf[32] = "";
 	FILE *stream;
 
 	stream = io->get_file(io);
@@ -196,7 +215,7 @@ static bool on_accept(private_load_tester_control_t *this, stream_t *io)
 		fclose(stream);
 		return FALSE;
 	}
-	if (sscanf(buf, "%u %u", &count, &delay) < 1)
+	if (sscanf(buf, "%u %u %u", &count, &delay, &rate) < 1)
 	{
 		fclose(stream);
 		return FALSE;
@@ -214,10 +233,17 @@ static bool on_accept(private_load_tester_control_t *this, stream_t *io)
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 	);
 
+	stats = load_tester_stats_create();
 	charon->bus->add_listener(charon->bus, &listener->listener);
+	charon->bus->add_listener(charon->bus, &stats->listener);
 
+	time_monotonic(&start);
 	for (i = 0; i < count; i++)
 	{
+		if (i)
+		{
+			pace(&start, i, delay, rate);
+		}
 		peer_cfg = charon->backends->get_peer_cfg_by_name(charon->backends,
 														  "load-test");
 		if (!peer_cfg)
@@ -251,10 +277,6 @@ static bool on_accept(private_load_tester_control_t *this, stream_t *io)
 				fprintf(stream, "!");
 				break;
 		}
-		if (delay)
-		{
-			usleep(delay * 1000);
-		}
 		fflush(stream);
 	}
 
@@ -266,6 +288,7 @@ static bool on_accept(private_load_tester_control_t *this, stream_t *io)
 	listener->mutex->unlock(listener->mutex);
 
 	charon->bus->remove_listener(charon->bus, &listener->listener);
+	charon->bus->remove_listener(charon->bus, &stats->listener);
 
 	listener->initiated->destroy(listener->initiated);
 	listener->completed->destroy(listener->completed);
@@ -274,6 +297,8 @@ static bool on_accept(private_load_tester_control_t *this, stream_t *io)
 	free(listener);
 
 	fprintf(stream, "\n");
+	stats->print(stats, stream);
+	stats->destroy(stats);
 	fclose(stream);
 
 	return FALSE;
@@ -18,10 +18,12 @@
 #include "load_tester_creds.h"
 #include "load_tester_ipsec.h"
 #include "load_tester_listener.h"
+#include "load_tester_stats.h"
 #include "load_tester_control.h"
 #include "load_tester_diffie_hellman.h"
 
 #include <unistd.h>
+#include <errno.h>
 
 #include <hydra.h>
 #include <daemon.h>
@@ -61,6 +63,11 @@ struct private_load_tester_plugin_t {
 	 */
 	load_tester_listener_t *listener;
 
+	/**
+	 * setup latencies and throughput of initiated IKE_SAs
+	 */
+	load_tester_stats_t *stats;
+
 	/**
 	 * number of iterations per thread
 	 */
@@ -76,11 +83,26 @@ struct private_load_tester_plugin_t {
 	 */
 	int running;
 
+	/**
+	 * number of initiators started, to interleave their rate schedules
+	 */
+	int started;
+
+	/**
+	 * monotonic time the rate schedule of all initiators started
+	 */
+	timeval_t start;
+
 	/**
 	 * delay between initiations, in ms
 	 */
 	int delay;
 
+	/**
+	 * IKE_SAs to initiate per second over all threads, instead of delay
+	 */
+	int rate;
+
 	/**
 	 * Throttle initiation if half-open IKE_SA count reached
 	 */
@@ -97,14 +119,53 @@ struct private_load_tester_plugin_t {
 	condvar_t *condvar;
 };
 
+/**
+ * Initiate a single IKE_SA of the load test
+ */
+static bool initiate_one(private_load_tester_plugin_t *this)
+{
+	peer_cfg_t *peer_cfg;
+	child_cfg_t *child_cfg = NULL;
+	enumerator_t *enumerator;
+
+	peer_cfg = charon->backends->get_peer_cfg_by_name(charon->backends,
+													  "load-test");
+	if (!peer_cfg)
+	{
+		return FALSE;
+	}
+	enumerator = peer_cfg->create_child_cfg_enumerator(peer_cfg);
+	if (!enumerator->enumerate(enumerator, &child_cfg))
+	{
+		enumerator->destroy(enumerator);
+		return FALSE;
+	}
+	enumerator->destroy(enumerator);
+
+	charon->controller->initiate(charon->controller,
+				peer_cfg, child_cfg->get_ref(child_cfg),
+				NULL, NULL, 0);
+	return TRUE;
+}
+
+/**
+ * Initiate a single IKE_SA from a queued job
+ */
+static job_requeue_t initiate_job(private_load_tester_plugin_t *this)
+{
+	initiate_one(this);
+	return JOB_REQUEUE_NONE;
+}
+
 /**
  * Begin the load test
  */
 static job_requeue_t do_load_test(private_load_tester_plugin_t *this)
 {
-	int i, s = 0, ms = 0;
+	int i, index, s = 0, ms = 0;
 
 	this->mutex->lock(this->mutex);
+	index = this->started++;
 	this->running++;
 	this->mutex->unlock(this->mutex);
 	if (this->delay)
@@ -115,10 +176,6 @@ static job_requeue_t do_load_test(private_load_tester_plugin_t *this)
 
 	for (i = 0; this->iterations == 0 || i < this->iterations; i++)
 	{
-		peer_cfg_t *peer_cfg;
-		child_cfg_t *child_cfg = NULL;
-		enumerator_t *enumerator;
-
 		if (this->init_limit)
 		{
 			while ((charon->ike_sa_manager->get_count(charon->ike_sa_manager) -
@@ -136,23 +193,22 @@ static job_requeue_t do_load_test(private_load_tester_plugin_t *this)
 			}
 		}
 
-		peer_cfg = charon->backends->get_peer_cfg_by_name(charon->backends,
-														  "load-test");
-		if (!peer_cfg)
-		{
-			break;
+		if (this->rate)
+		{	/* open loop: initiations get queued at a fixed rate, no matter
+			 * how fast previous ones complete. Each thread takes every
+			 * initiators-th slot of the shared schedule, offset by its index,
+			 * so initiations get spread evenly instead of arriving in bursts */
+			load_tester_stats_pace(&this->start,
+						(u_int64_t)i * this->initiators + index, this->rate);
+			lib->processor->queue_job(lib->processor, (job_t*)
+						callback_job_create((callback_job_cb_t)initiate_job,
+											this, NULL, NULL));
+			continue;
 		}
-		enumerator = peer_cfg->create_child_cfg_enumerator(peer_cfg);
-		if (!enumerator->enumerate(enumerator, &child_cfg))
+		if (!initiate_one(this))
 		{
-			enumerator->destroy(enumerator);
 			break;
 		}
-		enumerator->destroy(enumerator);
-
-		charon->controller->initiate(charon->controller,
-					peer_cfg, child_cfg->get_ref(child_cfg),
-					NULL, NULL, 0);
 		if (s)
 		{
 			sleep(s);
@@ -169,6 +225,30 @@ static job_requeue_t do_load_test(private_load_tester_plugin_t *this)
 	return JOB_REQUEUE_NONE;
 }
 
+/**
+ * Write the setup statistics to the configured file, if any
+ */
+static void write_stats(private_load_tester_plugin_t *this)
+{
+	char *path;
+	FILE *out;
+
+	path = lib->settings->get_str(lib->settings,
+						"%s.plugins.load-tester.stats_file", NULL, charon->name);
+	if (path)
+	{
+		out = fopen(path, "w");
+		if (!out)
+		{
+			DBG1(DBG_CFG, "writing load-test statistics to '%s' failed: %s",
+				 path, strerror(errno));
+			return;
+		}
+		this->stats->print(this->stats, out);
+		fclose(out);
+	}
+}
+
 METHOD(plugin_t, get_name, char*,
 	private_load_tester_plugin_t *this)
 {
@@ -187,6 +267,7 @@ static bool register_load_tester(private_load_tester_plugin_t *this,
 
 		this->config = load_tester_config_create();
 		this->creds = load_tester_creds_create();
+		this->stats = load_tester_stats_create();
 		this->control = load_tester_control_create();
 
 		charon->backends->add_backend(charon->backends, &this->config->backend);
@@ -199,7 +280,9 @@ static bool register_load_tester(private_load_tester_plugin_t *this,
 		}
 		this->listener = load_tester_listener_create(shutdown_on, this->config);
 		charon->bus->add_listener(charon->bus, &this->listener->listener);
+		charon->bus->add_listener(charon->bus, &this->stats->listener);
 
+		time_monotonic(&this->start);
 		for (i = 0; i < this->initiators; i++)
 		{
 			lib->processor->queue_job(lib->processor, (job_t*)
@@ -219,10 +302,13 @@ static bool register_load_tester(private_load_tester_plugin_t *this,
 		charon->backends->remove_backend(charon->backends, &this->config->backend);
 		lib->credmgr->remove_set(lib->credmgr, &this->creds->credential_set);
 		charon->bus->remove_listener(charon->bus, &this->listener->listener);
+		charon->bus->remove_listener(charon->bus, &this->stats->listener);
 		this->config->destroy(this->config);
 		this->creds->destroy(this->creds);
 		this->listener->destroy(this->listener);
 		this->control->destroy(this->control);
+		write_stats(this);
+		this->stats->destroy(this->stats);
 	}
 	return TRUE;
 }
@@ -286,6 +372,8 @@ plugin_t *load_tester_plugin_create()
 						"%s.plugins.load-tester.initiators", 0, charon->name),
 		.init_limit = lib->settings->get_int(lib->settings,
 						"%s.plugins.load-tester.init_limit", 0, charon->name),
+		.rate = lib->settings->get_int(lib->settings,
+						"%s.plugins.load-tester.rate", 0, charon->name),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 	);
@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "load_tester_stats.h"
+
+#include <unistd.h>
+
+#include <daemon.h>
+#include <collections/hashtable.h>
+#include <threading/mutex.h>
+
+typedef struct private_load_tester_stats_t private_load_tester_stats_t;
+typedef struct samples_t samples_t;
+typedef struct entry_t entry_t;
+typedef enum phase_t phase_t;
+
+/**
+ * Measured phases of an IKE_SA setup
+ */
+enum phase_t {
+	/** from initiation to the IKE_SA_INIT response (IKEv2 only) */
+	PHASE_IKE_SA_INIT,
+	/** from the IKE_SA_INIT response (or initiation) to the IKE_SA */
+	PHASE_IKE_AUTH,
+	/** from the established IKE_SA to the installed CHILD_SA */
+	PHASE_CHILD_SA,
+	/** from initiation to the installed CHILD_SA */
+	PHASE_TOTAL,
+	PHASE_MAX,
+};
+
+ENUM(load_tester_phase_names, PHASE_IKE_SA_INIT, PHASE_TOTAL,
+	"IKE_SA_INIT",
+	"IKE_AUTH",
+	"CHILD_SA",
+	"total",
+);
+
+/**
+ * Latencies recorded for a phase, in us
+ */
+struct samples_t {
+
+	/**
+	 * Recorded latencies, unordered
+	 */
+	u_int32_t *usec;
+
+	/**
+	 * Number of recorded latencies
+	 */
+	u_int count;
+
+	/**
+	 * Number of allocated entries in usec
+	 */
+	u_int size;
+};
+
+/**
+ * Timestamps of an IKE_SA in setup
+ */
+struct entry_t {
+
+	/**
+	 * Start of initiation
+	 */
+	timeval_t start;
+
+	/**
+	 * IKE_SA_INIT response received, zero if none yet
+	 */
+	timeval_t init;
+
+	/**
+	 * IKE_SA established, zero if not yet
+	 */
+	timeval_t auth;
+};
+
+/**
+ * Private data of an load_tester_stats_t object.
+ */
+struct private_load_tester_stats_t {
+
+	/**
+	 * Public load_tester_stats_t interface.
+	 */
+	load_tester_stats_t public;
+
+	/**
+	 * IKE_SAs in setup, uintptr_t => entry_t
+	 */
+	hashtable_t *sas;
+
+	/**
+	 * Recorded latencies for each phase
+	 */
+	samples_t samples[PHASE_MAX];
+
+	/**
+	 * Start of the test, zero before the first initiation
+	 */
+	timeval_t first;
+
+	/**
+	 * Number of setups completed in each second since first
+	 */
+	u_int *completed;
+
+	/**
+	 * Number of seconds in completed
+	 */
+	u_int seconds;
+
+	/**
+	 * Number of started setups
+	 */
+	u_int started;
+
+	/**
+	 * Number of failed setups
+	 */
+	u_int failed;
+
+	/**
+	 * Lock for all members
+	 */
+	mutex_t *mutex;
+};
+
+/**
+ * Hashtable hash function
+ */
+static u_int hash(uintptr_t id)
+{
+	return id;
+}
+
+/**
+ * Hashtable equals function
+ */
+static bool equals(uintptr_t a, uintptr_t b)
+{
+	return a == b;
+}
+
+/**
+ * Record the latency between two timestamps for a phase
+ */
+static void add_sample(private_load_tester_stats_t *this, phase_t phase,
+					   timeval_t *from, timeval_t *to)
+{
+	samples_t *samples = &this->samples[phase];
+	timeval_t diff;
+
+	if (samples->count == samples->size)
+	{
+		samples->size = max(samples->size * 2, 1024);
+		samples->usec = realloc(samples->usec,
+								samples->size * sizeof(u_int32_t));
+	}
+	timersub(to, from, &diff);
+	samples->usec[samples->count++] = diff.tv_sec * 1000000 + diff.tv_usec;
+}
+
+/**
+ * Count a completed setup in the second it completed
+ */
+static void add_completed(private_load_tester_stats_t *this, timeval_t *now)
+{
+	timeval_t diff;
+	u_int second, seconds;
+
+	timersub(now, &this->first, &diff);
+	second = diff.tv_sec;
+	if (second >= this->seconds)
+	{
+		seconds = max(second + 1, this->seconds * 2);
+		this->completed = realloc(this->completed, seconds * sizeof(u_int));
+		memset(this->completed + this->seconds, 0,
+			   (seconds - this->seconds) * sizeof(u_int));
+		this->seconds = seconds;
+	}
+	this->completed[second]++;
+}
+
+METHOD(listener_t, ike_state_change, bool,
+	private_load_tester_stats_t *this, ike_sa_t *ike_sa, ike_sa_state_t state)
+{
+	entry_t *entry;
+	uintptr_t id;
+
+	id = ike_sa->get_unique_id(ike_sa);
+	switch (state)
+	{
+		case IKE_CONNECTING:
+			if (!ike_sa->has_condition(ike_sa, COND_ORIGINAL_INITIATOR))
+			{	/* responder in a loopback test */
+				break;
+			}
+			INIT(entry);
+			time_monotonic(&entry->start);
+			this->mutex->lock(this->mutex);
+			entry = this->sas->put(this->sas, (void*)id, entry);
+			if (!entry)
+			{
+				this->started++;
+				if (!timerisset(&this->first))
+				{
+					time_monotonic(&this->first);
+				}
+			}
+			this->mutex->unlock(this->mutex);
+			free(entry);
+			break;
+		case IKE_DESTROYING:
+			this->mutex->lock(this->mutex);
+			entry = this->sas->remove(this->sas, (void*)id);
+			if (entry)
+			{
+				this->failed++;
+			}
+			this->mutex->unlock(this->mutex);
+			free(entry);
+			break;
+		default:
+			break;
+	}
+	return TRUE;
+}
+
+METHOD(listener_t, message_hook, bool,
+	private_load_tester_stats_t *this, ike_sa_t *ike_sa, message_t *message,
+	bool incoming, bool plain)
+{
+	entry_t *entry;
+	uintptr_t id;
+
+	if (incoming && plain && !message->get_request(message) &&
+		message->get_exchange_type(message) == IKE_SA_INIT)
+	{
+		id = ike_sa->get_unique_id(ike_sa);
+		this->mutex->lock(this->mutex);
+		entry = this->sas->get(this->sas, (void*)id);
+		if (entry)
+		{	/* a retry with a COOKIE or another KE restarts this phase */
+			time_monotonic(&entry->init);
+		}
+		this->mutex->unlock(this->mutex);
+	}
+	return TRUE;
+}
+
+METHOD(listener_t, ike_updown, bool,
+	private_load_tester_stats_t *this, ike_sa_t *ike_sa, bool up)
+{
+	entry_t *entry;
+	uintptr_t id;
+
+	if (up)
+	{
+		id = ike_sa->get_unique_id(ike_sa);
+		this->mutex->lock(this->mutex);
+		entry = this->sas->get(this->sas, (void*)id);
+		if (entry)
+		{
+			time_monotonic(&entry->auth);
+		}
+		this->mutex->unlock(this->mutex);
+	}
+	return TRUE;
+}
+
+METHOD(listener_t, child_updown, bool,
+	private_load_tester_stats_t *this, ike_sa_t *ike_sa, child_sa_t *child_sa,
+	bool up)
+{
+	entry_t *entry;
+	timeval_t now;
+	uintptr_t id;
+
+	if (up)
+	{
+		id = ike_sa->get_unique_id(ike_sa);
+		time_monotonic(&now);
+		this->mutex->lock(this->mutex);
+		entry = this->sas->get(this->sas, (void*)id);
+		if (entry && timerisset(&entry->auth))
+		{
+			this->sas->remove(this->sas, (void*)id);
+			if (timerisset(&entry->init))
+			{
+				add_sample(this, PHASE_IKE_SA_INIT, &entry->start, &entry->init);
+				add_sample(this, PHASE_IKE_AUTH, &entry->init, &entry->auth);
+			}
+			else
+			{
+				add_sample(this, PHASE_IKE_AUTH, &entry->start, &entry->auth);
+			}
+			add_sample(this, PHASE_CHILD_SA, &entry->auth, &now);
+			add_sample(this, PHASE_TOTAL, &entry->start, &now);
+			add_completed(this, &now);
+			free(entry);
+		}
+		this->mutex->unlock(this->mutex);
+	}
+	return TRUE;
+}
+
+/**
+ * Compare two latencies for qsort()
+ */
+static int compare_usec(const void *a, const void *b)
+{
+	u_int32_t x = *(u_int32_t*)a, y = *(u_int32_t*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/**
+ * Get the latency in ms at the given permille of sorted samples
+ */
+static double percentile(samples_t *samples, u_int permille)
+{
+	u_int idx;
+
+	idx = ((u_int64_t)samples->count * permille + 999) / 1000;
+	return samples->usec[max(idx, 1) - 1] / 1000.0;
+}
+
+METHOD(load_tester_stats_t, print, void,
+	private_load_tester_stats_t *this, FILE *out)
+{
+	samples_t *samples;
+	phase_t phase;
+	u_int i;
+
+	this->mutex->lock(this->mutex);
+	fprintf(out, "%u initiated, %u established, %u failed, %u in progress\n",
+			this->started, this->samples[PHASE_TOTAL].count, this->failed,
+			this->sas->get_count(this->sas));
+	fprintf(out, "%-12s %8s %10s %10s %10s %10s\n",
+			"phase", "count", "p50 ms", "p99 ms", "p99.9 ms", "max ms");
+	for (phase = 0; phase < PHASE_MAX; phase++)
+	{
+		samples = &this->samples[phase];
+		if (!samples->count)
+		{
+			continue;
+		}
+		qsort(samples->usec, samples->count, sizeof(u_int32_t), compare_usec);
+		fprintf(out, "%-12N %8u %10.2f %10.2f %10.2f %10.2f\n",
+				load_tester_phase_names, phase, samples->count,
+				percentile(samples, 500), percentile(samples, 990),
+				percentile(samples, 999), percentile(samples, 1000));
+	}
+	if (this->seconds)
+	{
+		fprintf(out, "established per second:\n");
+		for (i = 0; i < this->seconds; i++)
+		{
+			if (this->completed[i] || i + 1 < this->seconds)
+			{
+				fprintf(out, "%6us %8u\n", i, this->completed[i]);
+			}
+		}
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(load_tester_stats_t, destroy, void,
+	private_load_tester_stats_t *this)
+{
+	enumerator_t *enumerator;
+	entry_t *entry;
+	phase_t phase;
+
+	enumerator = this->sas->create_enumerator(this->sas);
+	while (enumerator->enumerate(enumerator, NULL, &entry))
+	{
+		free(entry);
+	}
+	enumerator->destroy(enumerator);
+	for (phase = 0; phase < PHASE_MAX; phase++)
+	{
+		free(this->samples[phase].usec);
+	}
+	free(this->completed);
+	this->sas->destroy(this->sas);
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/**
+ * See header
+ */
+load_tester_stats_t *load_tester_stats_create()
+{
+	private_load_tester_stats_t *this;
+
+	INIT(this,
+		.public = {
+			.listener = {
+				.ike_state_change = _ike_state_change,
+				.message = _message_hook,
+				.ike_updown = _ike_updown,
+				.child_updown = _child_updown,
+			},
+			.print = _print,
+			.destroy = _destroy,
+		},
+		.sas = hashtable_create((void*)hash, (void*)equals, 1024),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+	);
+
+	return &this->public;
+}
+
+/**
+ * See header
+ */
+void load_tester_stats_pace(timeval_t *start, u_int64_t n, u_int rate)
+{
+	timeval_t due, now;
+	u_int64_t usec;
+
+	usec = n * 1000000 / rate;
+	due.tv_sec = start->tv_sec + usec / 1000000;
+	due.tv_usec = start->tv_usec + usec % 1000000;
+	if (due.tv_usec >= 1000000)
+	{
+		due.tv_sec++;
+		due.tv_usec -= 1000000;
+	}
+	time_monotonic(&now);
+	if (timercmp(&now, &due, <))
+	{
+		timersub(&due, &now, &now);
+		usleep(now.tv_sec * 1000000 + now.tv_usec);
+	}
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup load_tester_stats load_tester_stats
+ * @{ @ingroup load_tester
+ */
+
+#ifndef LOAD_TESTER_STATS_H_
+#define LOAD_TESTER_STATS_H_
+
+#include <stdio.h>
+
+#include <bus/bus.h>
+
+typedef struct load_tester_stats_t load_tester_stats_t;
+
+/**
+ * Records the setup latency of each exchange of initiated IKE_SAs.
+ *
+ * Each IKE_SA we initiate is timestamped when it starts connecting, when
+ * the IKE_SA_INIT response arrives, when the IKE_SA gets established and when
+ * its first CHILD_SA is up. Latencies of completed setups are kept per phase
+ * to report percentiles, together with the number of setups completed in each
+ * second since the test started.
+ */
+struct load_tester_stats_t {
+
+	/**
+	 * Implements listener_t interface.
+	 */
+	listener_t listener;
+
+	/**
+	 * Print percentiles of all phases and the throughput over time.
+	 *
+	 * @param out		stream to print to
+	 */
+	void (*print)(load_tester_stats_t *this, FILE *out);
+
+	/**
+	 * Destroy a load_tester_stats_t.
+	 */
+	void (*destroy)(load_tester_stats_t *this);
+};
+
+/**
+ * Create a load_tester_stats instance.
+ */
+load_tester_stats_t *load_tester_stats_create();
+
+/**
+ * Sleep until an initiation is due in a schedule with a fixed rate.
+ *
+ * The n-th initiation of the schedule is due n / rate seconds after start.
+ * Initiator threads sharing a schedule interleave by using different n.
+ *
+ * @param start		monotonic time the schedule started
+ * @param n			index of the initiation in the schedule
+ * @param rate		initiations per second
+ */
+void load_tester_stats_pace(timeval_t *start, u_int64_t n, u_int rate);
+
+#endif /** LOAD_TESTER_STATS_H_ @}*/
@@ -19,6 +19,8 @@
 #include "sql_config.h"
 
 #include <daemon.h>
+#include <collections/hashtable.h>
+#include <threading/rwlock.h>
 
 typedef struct private_sql_config_t private_sql_config_t;
 
@@ -36,8 +38,61 @@ struct private_sql_config_t {
 	 * database connection
 	 */
 	database_t *db;
+
+	/**
+	 * cache configs in memory
+	 */
+	bool cache;
+
+	/**
+	 * whether the cached configs are loaded
+	 */
+	bool loaded;
+
+	/**
+	 * cached peer configs, as peer_entry_t
+	 */
+	linked_list_t *peers;
+
+	/**
+	 * cached peer configs by name, char* => peer_entry_t
+	 */
+	hashtable_t *names;
+
+	/**
+	 * cached peer configs by remote identity, identification_t* =>
+	 * linked_list_t of peer_entry_t, for remote identities without wildcards
+	 */
+	hashtable_t *remotes;
+
+	/**
+	 * cached peer configs with wildcard remote identities, as peer_entry_t
+	 */
+	linked_list_t *wildcards;
+
+	/**
+	 * cached IKE configs, as ike_cfg_t
+	 */
+	linked_list_t *ike_cfgs;
+
+	/**
+	 * lock for cached configs
+	 */
+	rwlock_t *lock;
 };
 
+/**
+ * A cached peer config
+ */
+typedef struct {
+	/** peer config */
+	peer_cfg_t *cfg;
+	/** local identity of the config, owned by cfg */
+	identification_t *local;
+	/** remote identity of the config, owned by cfg */
+	identification_t *remote;
+} peer_entry_t;
+
 /**
  * Forward declaration
  */
@@ -417,12 +472,282 @@ static peer_cfg_t *build_peer_cfg(private_sql_config_t *this, enumerator_t *e,
 	return NULL;
 }
 
+/**
+ * Query all IKEv2 peer configs, for build_peer_cfg()
+ */
+static enumerator_t *query_peer_cfgs(private_sql_config_t *this)
+{
+	return this->db->query(this->db,
+			"SELECT c.id, name, ike_cfg, l.type, l.data, r.type, r.data, "
+			"cert_policy, uniqueid, auth_method, eap_type, eap_vendor, "
+			"keyingtries, rekeytime, reauthtime, jitter, overtime, mobike, "
+			"dpd_delay, virtual, pool, "
+			"mediation, mediated_by, COALESCE(p.type, 0), p.data "
+			"FROM peer_configs AS c "
+			"JOIN identities AS l ON local_id = l.id "
+			"JOIN identities AS r ON remote_id = r.id "
+			"LEFT JOIN identities AS p ON peer_id = p.id "
+			"WHERE ike_version = ?",
+			DB_INT, 2,
+			DB_INT, DB_TEXT, DB_INT, DB_INT, DB_BLOB, DB_INT, DB_BLOB,
+			DB_INT, DB_INT, DB_INT, DB_INT, DB_INT,
+			DB_INT, DB_INT, DB_INT, DB_INT, DB_INT, DB_INT,
+			DB_INT,	DB_TEXT, DB_TEXT,
+			DB_INT, DB_INT, DB_INT, DB_BLOB);
+}
+
+/**
+ * hashtable hash function for identities, compatible to equals(), which
+ * compares strings and RDNs of DNs case insensitive
+ */
+static u_int id_hash(identification_t *id)
+{
+	return id->hash(id, 0);
+}
+
+/**
+ * hashtable equals function for identities
+ */
+static bool id_equals(identification_t *a, identification_t *b)
+{
+	return a->equals(a, b);
+}
+
+/**
+ * Get the identity of the first local or remote auth config
+ */
+static identification_t *get_auth_identity(peer_cfg_t *cfg, bool local)
+{
+	enumerator_t *enumerator;
+	identification_t *id = NULL;
+	auth_cfg_t *auth;
+
+	enumerator = cfg->create_auth_cfg_enumerator(cfg, local);
+	if (enumerator->enumerate(enumerator, &auth))
+	{
+		id = auth->get(auth, AUTH_RULE_IDENTITY);
+	}
+	enumerator->destroy(enumerator);
+	return id;
+}
+
+/**
+ * Load all configs into the cache, write lock must be held
+ */
+static void load_cache(private_sql_config_t *this)
+{
+	enumerator_t *e;
+	peer_entry_t *entry;
+	peer_cfg_t *peer_cfg;
+	ike_cfg_t *ike_cfg;
+	linked_list_t *list;
+
+	e = query_peer_cfgs(this);
+	if (e)
+	{
+		while ((peer_cfg = build_peer_cfg(this, e, NULL, NULL)))
+		{
+			INIT(entry,
+				.cfg = peer_cfg,
+				.local = get_auth_identity(peer_cfg, TRUE),
+				.remote = get_auth_identity(peer_cfg, FALSE),
+			);
+			this->peers->insert_last(this->peers, entry);
+			if (!this->names->get(this->names, peer_cfg->get_name(peer_cfg)))
+			{
+				this->names->put(this->names, peer_cfg->get_name(peer_cfg),
+								 entry);
+			}
+			if (entry->remote->contains_wildcards(entry->remote))
+			{
+				this->wildcards->insert_last(this->wildcards, entry);
+				continue;
+			}
+			list = this->remotes->get(this->remotes, entry->remote);
+			if (!list)
+			{
+				list = linked_list_create();
+				this->remotes->put(this->remotes, entry->remote, list);
+			}
+			list->insert_last(list, entry);
+		}
+		e->destroy(e);
+	}
+	e = this->db->query(this->db,
+			"SELECT id, certreq, force_encap, local, remote "
+			"FROM ike_configs",
+			DB_INT, DB_INT, DB_INT, DB_TEXT, DB_TEXT);
+	if (e)
+	{
+		while ((ike_cfg = build_ike_cfg(this, e, NULL, NULL)))
+		{
+			this->ike_cfgs->insert_last(this->ike_cfgs, ike_cfg);
+		}
+		e->destroy(e);
+	}
+	DBG1(DBG_CFG, "loaded %d peer configs and %d IKE configs from database",
+		 this->peers->get_count(this->peers),
+		 this->ike_cfgs->get_count(this->ike_cfgs));
+	this->loaded = TRUE;
+}
+
+/**
+ * Drop all cached configs, write lock must be held
+ */
+static void flush_cache(private_sql_config_t *this)
+{
+	enumerator_t *enumerator;
+	linked_list_t *list;
+	peer_entry_t *entry;
+
+	enumerator = this->remotes->create_enumerator(this->remotes);
+	while (enumerator->enumerate(enumerator, NULL, &list))
+	{
+		this->remotes->remove_at(this->remotes, enumerator);
+		list->destroy(list);
+	}
+	enumerator->destroy(enumerator);
+	enumerator = this->names->create_enumerator(this->names);
+	while (enumerator->enumerate(enumerator, NULL, NULL))
+	{
+		this->names->remove_at(this->names, enumerator);
+	}
+	enumerator->destroy(enumerator);
+	while (this->wildcards->remove_last(this->wildcards,
+										(void**)&entry) == SUCCESS)
+	{
+		/* entries are owned by the peers list */
+	}
+	while (this->peers->remove_last(this->peers, (void**)&entry) == SUCCESS)
+	{
+		entry->cfg->destroy(entry->cfg);
+		free(entry);
+	}
+	this->ike_cfgs->destroy_offset(this->ike_cfgs,
+								   offsetof(ike_cfg_t, destroy));
+	this->ike_cfgs = linked_list_create();
+	this->loaded = FALSE;
+}
+
+/**
+ * Acquire a read lock on the cache, load configs if necessary
+ */
+static void read_lock_cache(private_sql_config_t *this)
+{
+	this->lock->read_lock(this->lock);
+	while (!this->loaded)
+	{
+		this->lock->unlock(this->lock);
+		this->lock->write_lock(this->lock);
+		if (!this->loaded)
+		{
+			load_cache(this);
+		}
+		this->lock->unlock(this->lock);
+		this->lock->read_lock(this->lock);
+	}
+}
+
+typedef struct {
+	/** lock to release */
+	rwlock_t *lock;
+	/** filtering own identity */
+	identification_t *me;
+	/** filtering remote identity */
+	identification_t *other;
+	/** candidate entries, if any */
+	linked_list_t *candidates;
+} peer_data_t;
+
+/**
+ * Filter cached peer configs by identities
+ */
+static bool peer_filter(peer_data_t *data, peer_entry_t **in,
+						peer_cfg_t **out)
+{
+	peer_entry_t *entry = *in;
+
+	if ((data->me && !data->me->matches(data->me, entry->local)) ||
+		(data->other && !data->other->matches(data->other, entry->remote)))
+	{
+		return FALSE;
+	}
+	*out = entry->cfg;
+	return TRUE;
+}
+
+/**
+ * Destroy filter data of cached peer configs, release lock
+ */
+static void peer_data_destroy(peer_data_t *data)
+{
+	data->lock->unlock(data->lock);
+	DESTROY_IF(data->candidates);
+	free(data);
+}
+
+/**
+ * Enumerate cached peer configs
+ */
+static enumerator_t *create_cached_peer_enumerator(private_sql_config_t *this,
+									identification_t *me, identification_t *other)
+{
+	enumerator_t *enumerator;
+	peer_entry_t *entry;
+	linked_list_t *list;
+	peer_data_t *data;
+
+	INIT(data,
+		.lock = this->lock,
+		.me = me,
+		.other = other,
+	);
+	read_lock_cache(this);
+	if (other && !other->contains_wildcards(other))
+	{	/* exact matches first, then those with wildcards */
+		data->candidates = linked_list_create();
+		list = this->remotes->get(this->remotes, other);
+		if (list)
+		{
+			enumerator = list->create_enumerator(list);
+			while (enumerator->enumerate(enumerator, &entry))
+			{
+				data->candidates->insert_last(data->candidates, entry);
+			}
+			enumerator->destroy(enumerator);
+		}
+		enumerator = this->wildcards->create_enumerator(this->wildcards);
+		while (enumerator->enumerate(enumerator, &entry))
+		{
+			data->candidates->insert_last(data->candidates, entry);
+		}
+		enumerator->destroy(enumerator);
+	}
+	enumerator = data->candidates ?
+					data->candidates->create_enumerator(data->candidates) :
+					this->peers->create_enumerator(this->peers);
+	return enumerator_create_filter(enumerator, (void*)peer_filter, data,
+									(void*)peer_data_destroy);
+}
+
 METHOD(backend_t, get_peer_cfg_by_name, peer_cfg_t*,
 	private_sql_config_t *this, char *name)
 {
 	enumerator_t *e;
 	peer_cfg_t *peer_cfg = NULL;
+	peer_entry_t *entry;
 
+	if (this->cache)
+	{
+		read_lock_cache(this);
+		entry = this->names->get(this->names, name);
+		if (entry)
+		{
+			peer_cfg = entry->cfg->get_ref(entry->cfg);
+		}
+		this->lock->unlock(this->lock);
+		return peer_cfg;
+	}
 	e = this->db->query(this->db,
 			"SELECT c.id, name, ike_cfg, l.type, l.data, r.type, r.data, "
 			"cert_policy, uniqueid, auth_method, eap_type, eap_vendor, "
@@ -491,7 +816,16 @@ static void ike_enumerator_destroy(ike_enumerator_t *this)
 METHOD(backend_t, create_ike_cfg_enumerator, enumerator_t*,
 	private_sql_config_t *this, host_t *me, host_t *other)
 {
-	ike_enumerator_t *e = malloc_thing(ike_enumerator_t);
+	ike_enumerator_t *e;
+
+	if (this->cache)
+	{
+		read_lock_cache(this);
+		return enumerator_create_cleaner(
+						this->ike_cfgs->create_enumerator(this->ike_cfgs),
+						(void*)this->lock->unlock, this->lock);
+	}
+	e = malloc_thing(ike_enumerator_t);
 
 	e->this = this;
 	e->me = me;
@@ -556,7 +890,13 @@ static void peer_enumerator_destroy(peer_enumerator_t *this)
 METHOD(backend_t, create_peer_cfg_enumerator, enumerator_t*,
 	private_sql_config_t *this, identification_t *me, identification_t *other)
 {
-	peer_enumerator_t *e = malloc_thing(peer_enumerator_t);
+	peer_enumerator_t *e;
+
+	if (this->cache)
+	{
+		return create_cached_peer_enumerator(this, me, other);
+	}
+	e = malloc_thing(peer_enumerator_t);
 
 	e->this = this;
 	e->me = me;
@@ -566,23 +906,7 @@ METHOD(backend_t, create_peer_cfg_enumerator, enumerator_t*,
 	e->public.destroy = (void*)peer_enumerator_destroy;
 
 	/* TODO: only get configs whose IDs match exactly or contain wildcards */
-	e->inner = this->db->query(this->db,
-			"SELECT c.id, name, ike_cfg, l.type, l.data, r.type, r.data, "
-			"cert_policy, uniqueid, auth_method, eap_type, eap_vendor, "
-			"keyingtries, rekeytime, reauthtime, jitter, overtime, mobike, "
-			"dpd_delay, virtual, pool, "
-			"mediation, mediated_by, COALESCE(p.type, 0), p.data "
-			"FROM peer_configs AS c "
-			"JOIN identities AS l ON local_id = l.id "
-			"JOIN identities AS r ON remote_id = r.id "
-			"LEFT JOIN identities AS p ON peer_id = p.id "
-			"WHERE ike_version = ?",
-			DB_INT, 2,
-			DB_INT, DB_TEXT, DB_INT, DB_INT, DB_BLOB, DB_INT, DB_BLOB,
-			DB_INT, DB_INT, DB_INT, DB_INT, DB_INT,
-			DB_INT, DB_INT, DB_INT, DB_INT, DB_INT, DB_INT,
-			DB_INT,	DB_TEXT, DB_TEXT,
-			DB_INT, DB_INT, DB_INT, DB_BLOB);
+	e->inner = query_peer_cfgs(this);
 	if (!e->inner)
 	{
 		free(e);
@@ -591,16 +915,37 @@ METHOD(backend_t, create_peer_cfg_enumerator, enumerator_t*,
 	return &e->public;
 }
 
+METHOD(sql_config_t, reload, void,
+	private_sql_config_t *this)
+{
+	if (this->cache)
+	{
+		this->lock->write_lock(this->lock);
+		flush_cache(this);
+		this->lock->unlock(this->lock);
+	}
+}
+
 METHOD(sql_config_t, destroy, void,
 	private_sql_config_t *this)
 {
+	if (this->cache)
+	{
+		flush_cache(this);
+		this->peers->destroy(this->peers);
+		this->names->destroy(this->names);
+		this->remotes->destroy(this->remotes);
+		this->wildcards->destroy(this->wildcards);
+		this->ike_cfgs->destroy(this->ike_cfgs);
+		this->lock->destroy(this->lock);
+	}
 	free(this);
 }
 
 /**
  * Described in header.
  */
-sql_config_t *sql_config_create(database_t *db)
+sql_config_t *sql_config_create(database_t *db, bool cache)
 {
 	private_sql_config_t *this;
 
@@ -611,10 +956,24 @@ sql_config_t *sql_config_create(database_t *db)
 				.create_ike_cfg_enumerator = _create_ike_cfg_enumerator,
 				.get_peer_cfg_by_name = _get_peer_cfg_by_name,
 			},
+			.reload = _reload,
 			.destroy = _destroy,
 		},
-		.db = db
+		.db = db,
+		.cache = cache,
 	);
 
+	if (cache)
+	{
+		this->peers = linked_list_create();
+		this->names = hashtable_create(hashtable_hash_str,
+									   hashtable_equals_str, 32);
+		this->remotes = hashtable_create((hashtable_hash_t)id_hash,
+										 (hashtable_equals_t)id_equals, 32);
+		this->wildcards = linked_list_create();
+		this->ike_cfgs = linked_list_create();
+		this->lock = rwlock_create_named(RWLOCK_TYPE_DEFAULT, "sql.config");
+	}
+
 	return &this->public;
 }
@@ -36,6 +36,13 @@ struct sql_config_t {
 	 */
 	backend_t backend;
 
+	/**
+	 * Drop cached configs, they get loaded again on the next lookup.
+	 *
+	 * Has no effect if configs are not cached.
+	 */
+	void (*reload)(sql_config_t *this);
+
 	/**
 	 * Destry the backend.
 	 */
@@ -45,9 +52,14 @@ struct sql_config_t {
 /**
  * Create a sql_config backend instance.
  *
+ * With caching enabled, all peer and IKE configs are loaded from the database
+ * on first use and the same objects are returned for all lookups until the
+ * backend gets reloaded.
+ *
  * @param db		underlying database
+ * @param cache		TRUE to cache configs in memory
  * @return			backend instance
  */
-sql_config_t *sql_config_create(database_t *db);
+sql_config_t *sql_config_create(database_t *db, bool cache);
 
 #endif /** SQL_CONFIG_H_ @}*/
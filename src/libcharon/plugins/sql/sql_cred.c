@@ -19,9 +19,45 @@
 #include "sql_cred.h"
 
 #include <daemon.h>
+#include <collections/hashtable.h>
+#include <threading/rwlock.h>
 
 typedef struct private_sql_cred_t private_sql_cred_t;
 
+/**
+ * Kinds of cached credentials
+ */
+typedef enum {
+	CACHE_PRIVATE,
+	CACHE_CERT,
+	CACHE_SHARED,
+	CACHE_MAX,
+} cache_kind_t;
+
+/**
+ * A cached credential
+ */
+typedef struct {
+	/** private_key_t, certificate_t or shared_key_t */
+	void *cred;
+	/** key, certificate or shared key type */
+	int type;
+	/** key type of certificates */
+	int keytype;
+	/** identities assigned to the credential, as identification_t */
+	linked_list_t *ids;
+} cred_entry_t;
+
+/**
+ * Cached credentials of one kind
+ */
+typedef struct {
+	/** all credentials, as cred_entry_t */
+	linked_list_t *all;
+	/** credentials by identity, identification_t* => linked_list_t */
+	hashtable_t *ids;
+} cred_index_t;
+
 /**
  * Private data of an sql_cred_t object
  */
@@ -36,8 +72,394 @@ struct private_sql_cred_t {
 	 * database connection
 	 */
 	database_t *db;
+
+	/**
+	 * cache parsed credentials in memory
+	 */
+	bool cache;
+
+	/**
+	 * whether the cached credentials are loaded
+	 */
+	bool loaded;
+
+	/**
+	 * cached credentials, by cache_kind_t
+	 */
+	cred_index_t index[CACHE_MAX];
+
+	/**
+	 * lock for cached credentials
+	 */
+	rwlock_t *lock;
 };
 
+/**
+ * hashtable hash function for identities, the database compares them binary
+ */
+static u_int id_hash(identification_t *id)
+{
+	return chunk_hash_inc(id->get_encoding(id), id->get_type(id));
+}
+
+/**
+ * hashtable equals function for identities
+ */
+static bool id_equals(identification_t *a, identification_t *b)
+{
+	return a->get_type(a) == b->get_type(b) &&
+		   chunk_equals(a->get_encoding(a), b->get_encoding(b));
+}
+
+/**
+ * Check if a cached credential has a specific identity assigned
+ */
+static bool has_id(cred_entry_t *entry, identification_t *id)
+{
+	enumerator_t *enumerator;
+	identification_t *current;
+	bool found = FALSE;
+
+	enumerator = entry->ids->create_enumerator(entry->ids);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (id_equals(current, id))
+		{
+			found = TRUE;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
+}
+
+/**
+ * Query all credentials of a kind, as row ID, type, key type and blob
+ */
+static enumerator_t *query_creds(private_sql_cred_t *this, cache_kind_t kind)
+{
+	switch (kind)
+	{
+		case CACHE_PRIVATE:
+			return this->db->query(this->db,
+					"SELECT id, type, 0, data FROM private_keys",
+					DB_INT, DB_INT, DB_INT, DB_BLOB);
+		case CACHE_CERT:
+			return this->db->query(this->db,
+					"SELECT id, type, keytype, data FROM certificates",
+					DB_INT, DB_INT, DB_INT, DB_BLOB);
+		case CACHE_SHARED:
+			return this->db->query(this->db,
+					"SELECT id, type, 0, data FROM shared_secrets",
+					DB_INT, DB_INT, DB_INT, DB_BLOB);
+		default:
+			return NULL;
+	}
+}
+
+/**
+ * Query the identities of all credentials of a kind, as row ID of the
+ * credential, identity type and data
+ */
+static enumerator_t *query_ids(private_sql_cred_t *this, cache_kind_t kind)
+{
+	switch (kind)
+	{
+		case CACHE_PRIVATE:
+			return this->db->query(this->db,
+					"SELECT pi.private_key, i.type, i.data "
+					"FROM private_key_identity AS pi "
+					"JOIN identities AS i ON pi.identity = i.id",
+					DB_INT, DB_INT, DB_BLOB);
+		case CACHE_CERT:
+			return this->db->query(this->db,
+					"SELECT ci.certificate, i.type, i.data "
+					"FROM certificate_identity AS ci "
+					"JOIN identities AS i ON ci.identity = i.id",
+					DB_INT, DB_INT, DB_BLOB);
+		case CACHE_SHARED:
+			return this->db->query(this->db,
+					"SELECT si.shared_secret, i.type, i.data "
+					"FROM shared_secret_identity AS si "
+					"JOIN identities AS i ON si.identity = i.id",
+					DB_INT, DB_INT, DB_BLOB);
+		default:
+			return NULL;
+	}
+}
+
+/**
+ * Parse a credential of a kind
+ */
+static void *parse_cred(cache_kind_t kind, int type, chunk_t blob)
+{
+	switch (kind)
+	{
+		case CACHE_PRIVATE:
+			return lib->creds->create(lib->creds, CRED_PRIVATE_KEY, type,
+									  BUILD_BLOB_PEM, blob, BUILD_END);
+		case CACHE_CERT:
+			return lib->creds->create(lib->creds, CRED_CERTIFICATE, type,
+									  BUILD_BLOB_PEM, blob, BUILD_END);
+		case CACHE_SHARED:
+			return shared_key_create(type, chunk_clone(blob));
+		default:
+			return NULL;
+	}
+}
+
+/**
+ * Destroy a cached credential of a kind
+ */
+static void destroy_entry(cred_entry_t *entry, cache_kind_t kind)
+{
+	switch (kind)
+	{
+		case CACHE_PRIVATE:
+			((private_key_t*)entry->cred)->destroy(entry->cred);
+			break;
+		case CACHE_CERT:
+			((certificate_t*)entry->cred)->destroy(entry->cred);
+			break;
+		case CACHE_SHARED:
+			((shared_key_t*)entry->cred)->destroy(entry->cred);
+			break;
+		default:
+			break;
+	}
+	entry->ids->destroy_offset(entry->ids, offsetof(identification_t, destroy));
+	free(entry);
+}
+
+/**
+ * Parse and index all credentials of a kind, write lock must be held
+ */
+static void load_index(private_sql_cred_t *this, cache_kind_t kind)
+{
+	cred_index_t *index = &this->index[kind];
+	cred_entry_t *entry;
+	identification_t *id;
+	linked_list_t *list;
+	hashtable_t *rows;
+	enumerator_t *e;
+	int row, type, keytype;
+	chunk_t blob;
+	void *cred;
+
+	rows = hashtable_create(hashtable_hash_ptr, hashtable_equals_ptr, 32);
+	e = query_creds(this, kind);
+	if (e)
+	{
+		while (e->enumerate(e, &row, &type, &keytype, &blob))
+		{
+			cred = parse_cred(kind, type, blob);
+			if (!cred)
+			{
+				continue;
+			}
+			INIT(entry,
+				.cred = cred,
+				.type = type,
+				.keytype = keytype,
+				.ids = linked_list_create(),
+			);
+			index->all->insert_last(index->all, entry);
+			rows->put(rows, (void*)(uintptr_t)row, entry);
+		}
+		e->destroy(e);
+	}
+	e = query_ids(this, kind);
+	if (e)
+	{
+		while (e->enumerate(e, &row, &type, &blob))
+		{
+			entry = rows->get(rows, (void*)(uintptr_t)row);
+			if (!entry)
+			{
+				continue;
+			}
+			id = identification_create_from_encoding(type, blob);
+			entry->ids->insert_last(entry->ids, id);
+			list = index->ids->get(index->ids, id);
+			if (!list)
+			{
+				list = linked_list_create();
+				index->ids->put(index->ids, id, list);
+			}
+			list->insert_last(list, entry);
+		}
+		e->destroy(e);
+	}
+	rows->destroy(rows);
+}
+
+/**
+ * Drop all cached credentials of a kind, write lock must be held
+ */
+static void flush_index(private_sql_cred_t *this, cache_kind_t kind)
+{
+	cred_index_t *index = &this->index[kind];
+	enumerator_t *enumerator;
+	cred_entry_t *entry;
+	linked_list_t *list;
+
+	enumerator = index->ids->create_enumerator(index->ids);
+	while (enumerator->enumerate(enumerator, NULL, &list))
+	{
+		index->ids->remove_at(index->ids, enumerator);
+		list->destroy(list);
+	}
+	enumerator->destroy(enumerator);
+	while (index->all->remove_last(index->all, (void**)&entry) == SUCCESS)
+	{
+		destroy_entry(entry, kind);
+	}
+}
+
+/**
+ * Acquire a read lock on the cache, load credentials if necessary
+ */
+static void read_lock_cache(private_sql_cred_t *this)
+{
+	cache_kind_t kind;
+
+	this->lock->read_lock(this->lock);
+	while (!this->loaded)
+	{
+		this->lock->unlock(this->lock);
+		this->lock->write_lock(this->lock);
+		if (!this->loaded)
+		{
+			for (kind = 0; kind < CACHE_MAX; kind++)
+			{
+				load_index(this, kind);
+			}
+			DBG1(DBG_CFG, "loaded %d private keys, %d certificates and %d "
+				 "shared secrets from database",
+				 this->index[CACHE_PRIVATE].all->get_count(
+										this->index[CACHE_PRIVATE].all),
+				 this->index[CACHE_CERT].all->get_count(
+										this->index[CACHE_CERT].all),
+				 this->index[CACHE_SHARED].all->get_count(
+										this->index[CACHE_SHARED].all));
+			this->loaded = TRUE;
+		}
+		this->lock->unlock(this->lock);
+		this->lock->read_lock(this->lock);
+	}
+}
+
+/**
+ * Filter data for cached credentials
+ */
+typedef struct {
+	/** lock to release */
+	rwlock_t *lock;
+	/** credential type to filter, 0 for any */
+	int type;
+	/** key type of certificates to filter, KEY_ANY for any */
+	int keytype;
+	/** own identity of shared secrets */
+	identification_t *me;
+	/** remote identity of shared secrets */
+	identification_t *other;
+} cred_data_t;
+
+/**
+ * Destroy filter data of cached credentials, release lock
+ */
+static void cred_data_destroy(cred_data_t *data)
+{
+	data->lock->unlock(data->lock);
+	free(data);
+}
+
+/**
+ * Create an enumerator over cached credentials of a kind with an identity
+ */
+static enumerator_t *create_cached_enumerator(private_sql_cred_t *this,
+								cache_kind_t kind, identification_t *id,
+								void *filter, cred_data_t *data)
+{
+	cred_index_t *index = &this->index[kind];
+	enumerator_t *enumerator;
+	linked_list_t *list;
+
+	data->lock = this->lock;
+	read_lock_cache(this);
+	if (id && id->get_type(id) != ID_ANY)
+	{
+		list = index->ids->get(index->ids, id);
+		enumerator = list ? list->create_enumerator(list)
+						  : enumerator_create_empty();
+	}
+	else
+	{
+		enumerator = index->all->create_enumerator(index->all);
+	}
+	return enumerator_create_filter(enumerator, filter, data,
+									(void*)cred_data_destroy);
+}
+
+/**
+ * Filter cached private keys by type
+ */
+static bool private_filter(cred_data_t *data, cred_entry_t **in,
+						   private_key_t **out)
+{
+	cred_entry_t *entry = *in;
+
+	if (data->type != KEY_ANY && data->type != entry->type)
+	{
+		return FALSE;
+	}
+	*out = entry->cred;
+	return TRUE;
+}
+
+/**
+ * Filter cached certificates by certificate and key type
+ */
+static bool cert_filter(cred_data_t *data, cred_entry_t **in,
+						certificate_t **out)
+{
+	cred_entry_t *entry = *in;
+
+	if ((data->type != CERT_ANY && data->type != entry->type) ||
+		(data->keytype != KEY_ANY && data->keytype != entry->keytype))
+	{
+		return FALSE;
+	}
+	*out = entry->cred;
+	return TRUE;
+}
+
+/**
+ * Filter cached shared secrets by type and identities
+ */
+static bool shared_filter(cred_data_t *data, cred_entry_t **in,
+						  shared_key_t **out, void **unused1, id_match_t *me,
+						  void **unused2, id_match_t *other)
+{
+	cred_entry_t *entry = *in;
+
+	if ((data->type != SHARED_ANY && data->type != entry->type) ||
+		(data->me && data->other && !has_id(entry, data->other)))
+	{
+		return FALSE;
+	}
+	*out = entry->cred;
+	if (me)
+	{
+		*me = data->me ? ID_MATCH_PERFECT : ID_MATCH_ANY;
+	}
+	if (other)
+	{
+		*other = data->other ? ID_MATCH_PERFECT : ID_MATCH_ANY;
+	}
+	return TRUE;
+}
+
 
 /**
  * enumerator over private keys
@@ -86,6 +508,16 @@ METHOD(credential_set_t, create_private_enumerator, enumerator_t*,
 {
 	private_enumerator_t *e;
 
+	if (this->cache)
+	{
+		cred_data_t *data;
+
+		INIT(data,
+			.type = type,
+		);
+		return create_cached_enumerator(this, CACHE_PRIVATE, id,
+										private_filter, data);
+	}
 	INIT(e,
 		.public = {
 			.enumerate = (void*)_private_enumerator_enumerate,
@@ -167,6 +599,17 @@ METHOD(credential_set_t, create_cert_enumerator, enumerator_t*,
 {
 	cert_enumerator_t *e;
 
+	if (this->cache)
+	{
+		cred_data_t *data;
+
+		INIT(data,
+			.type = cert,
+			.keytype = key,
+		);
+		return create_cached_enumerator(this, CACHE_CERT, id,
+										cert_filter, data);
+	}
 	INIT(e,
 		.public = {
 			.enumerate = (void*)_cert_enumerator_enumerate,
@@ -263,6 +706,18 @@ METHOD(credential_set_t, create_shared_enumerator, enumerator_t*,
 {
 	shared_enumerator_t *e;
 
+	if (this->cache)
+	{
+		cred_data_t *data;
+
+		INIT(data,
+			.type = type,
+			.me = me,
+			.other = other,
+		);
+		return create_cached_enumerator(this, CACHE_SHARED, me ?: other,
+										shared_filter, data);
+	}
 	INIT(e,
 		.public = {
 			.enumerate = (void*)_shared_enumerator_enumerate,
@@ -423,18 +878,48 @@ METHOD(credential_set_t, cache_cert, void,
 	/* TODO: implement CRL caching to database */
 }
 
+METHOD(sql_cred_t, reload, void,
+	   private_sql_cred_t *this)
+{
+	cache_kind_t kind;
+
+	if (this->cache)
+	{
+		this->lock->write_lock(this->lock);
+		for (kind = 0; kind < CACHE_MAX; kind++)
+		{
+			flush_index(this, kind);
+		}
+		this->loaded = FALSE;
+		this->lock->unlock(this->lock);
+	}
+}
+
 METHOD(sql_cred_t, destroy, void,
 	   private_sql_cred_t *this)
 {
+	cache_kind_t kind;
+
+	if (this->cache)
+	{
+		for (kind = 0; kind < CACHE_MAX; kind++)
+		{
+			flush_index(this, kind);
+			this->index[kind].all->destroy(this->index[kind].all);
+			this->index[kind].ids->destroy(this->index[kind].ids);
+		}
+		this->lock->destroy(this->lock);
+	}
 	free(this);
 }
 
 /**
  * Described in header.
  */
-sql_cred_t *sql_cred_create(database_t *db)
+sql_cred_t *sql_cred_create(database_t *db, bool cache)
 {
 	private_sql_cred_t *this;
+	cache_kind_t kind;
 
 	INIT(this,
 		.public = {
@@ -445,11 +930,25 @@ sql_cred_t *sql_cred_create(database_t *db)
 				.create_cdp_enumerator = _create_cdp_enumerator,
 				.cache_cert = _cache_cert,
 			},
+			.reload = _reload,
 			.destroy = _destroy,
 		},
 		.db = db,
+		.cache = cache,
 	);
 
+	if (cache)
+	{
+		for (kind = 0; kind < CACHE_MAX; kind++)
+		{
+			this->index[kind].all = linked_list_create();
+			this->index[kind].ids = hashtable_create(
+										(hashtable_hash_t)id_hash,
+										(hashtable_equals_t)id_equals, 32);
+		}
+		this->lock = rwlock_create_named(RWLOCK_TYPE_DEFAULT, "sql.cred");
+	}
+
 	return &this->public;
 }
 
@@ -36,6 +36,13 @@ struct sql_cred_t {
 	 */
 	credential_set_t set;
 
+	/**
+	 * Drop cached credentials, they get loaded again on the next lookup.
+	 *
+	 * Has no effect if credentials are not cached.
+	 */
+	void (*reload)(sql_cred_t *this);
+
 	/**
 	 * Destry the backend.
 	 */
@@ -45,9 +52,14 @@ struct sql_cred_t {
 /**
  * Create a sql_cred backend instance.
  *
+ * With caching enabled, private keys, certificates and shared secrets are
+ * parsed once on first use and indexed by their identities until the set gets
+ * reloaded. CDPs are always queried from the database.
+ *
  * @param db		underlying database
+ * @param cache		TRUE to cache parsed credentials in memory
  * @return			credential set
  */
-sql_cred_t *sql_cred_create(database_t *db);
+sql_cred_t *sql_cred_create(database_t *db, bool cache);
 
 #endif /** SQL_CRED_H_ @}*/
@@ -18,12 +18,15 @@
 
 #include <daemon.h>
 #include <plugins/plugin_feature.h>
+#include <processing/jobs/callback_job.h>
+#include <threading/mutex.h>
 
 #include "sql_config.h"
 #include "sql_cred.h"
 #include "sql_logger.h"
 
 typedef struct private_sql_plugin_t private_sql_plugin_t;
+typedef struct refresher_t refresher_t;
 
 /**
  * private data of sql plugin
@@ -54,6 +57,47 @@ struct private_sql_plugin_t {
 	 * bus listener/logger
 	 */
 	sql_logger_t *logger;
+
+	/**
+	 * interval in seconds to poll for configuration changes, 0 to disable
+	 */
+	u_int refresh;
+
+	/**
+	 * last seen configuration generation
+	 */
+	int generation;
+
+	/**
+	 * whether the config_generation table is available
+	 */
+	bool has_generation;
+
+	/**
+	 * state shared with the scheduled refresh job, if any
+	 */
+	refresher_t *refresher;
+};
+
+/**
+ * State shared between the plugin and the scheduled refresh job
+ */
+struct refresher_t {
+
+	/**
+	 * plugin to refresh caches of, NULL once the database got closed
+	 */
+	private_sql_plugin_t *plugin;
+
+	/**
+	 * lock held while refreshing, and while detaching the plugin
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * references held by the plugin and the job
+	 */
+	refcount_t ref;
 };
 
 METHOD(plugin_t, get_name, char*,
@@ -62,6 +106,110 @@ METHOD(plugin_t, get_name, char*,
 	return "sql";
 }
 
+/**
+ * Query the current configuration generation
+ */
+static bool query_generation(private_sql_plugin_t *this, int *generation)
+{
+	enumerator_t *e;
+	bool found = FALSE;
+
+	e = this->db->query(this->db,
+			"SELECT generation FROM config_generation", DB_INT);
+	if (e)
+	{
+		found = e->enumerate(e, generation);
+		e->destroy(e);
+	}
+	return found;
+}
+
+/**
+ * Drop cached configs and credentials
+ */
+static void reload_caches(private_sql_plugin_t *this)
+{
+	this->config->reload(this->config);
+	this->cred->reload(this->cred);
+	lib->credmgr->flush_cache(lib->credmgr, CERT_ANY);
+}
+
+/**
+ * Reload cached configs and credentials if the generation changed
+ */
+static void refresh_caches(private_sql_plugin_t *this)
+{
+	int generation;
+
+	if (query_generation(this, &generation))
+	{
+		if (!this->has_generation || generation != this->generation)
+		{
+			DBG1(DBG_CFG, "sql plugin: configuration generation changed "
+				 "to %d, reloading", generation);
+			reload_caches(this);
+		}
+		this->has_generation = TRUE;
+		this->generation = generation;
+	}
+	else
+	{
+		if (this->has_generation)
+		{
+			DBG1(DBG_CFG, "sql plugin: config_generation table not "
+				 "available, reloading every %us", this->refresh);
+		}
+		reload_caches(this);
+		this->has_generation = FALSE;
+	}
+}
+
+/**
+ * Refresh caches from a scheduled job, until the database gets closed
+ */
+static job_requeue_t refresh_job(refresher_t *refresher)
+{
+	job_requeue_t requeue = JOB_REQUEUE_NONE;
+
+	refresher->mutex->lock(refresher->mutex);
+	if (refresher->plugin)
+	{
+		refresh_caches(refresher->plugin);
+		requeue = JOB_RESCHEDULE(refresher->plugin->refresh);
+	}
+	refresher->mutex->unlock(refresher->mutex);
+	return requeue;
+}
+
+/**
+ * Release a reference to the refresh state
+ */
+static void refresher_unref(refresher_t *refresher)
+{
+	if (ref_put(&refresher->ref))
+	{
+		refresher->mutex->destroy(refresher->mutex);
+		free(refresher);
+	}
+}
+
+/**
+ * Stop refreshing caches, waits for a refresh in progress
+ */
+static void stop_refresh(private_sql_plugin_t *this)
+{
+	refresher_t *refresher = this->refresher;
+
+	if (refresher)
+	{
+		refresher->mutex->lock(refresher->mutex);
+		refresher->plugin = NULL;
+		refresher->mutex->unlock(refresher->mutex);
+		refresher_unref(refresher);
+		this->refresher = NULL;
+	}
+}
+
 /**
  * Connect to database
  */
@@ -71,6 +219,7 @@ static bool open_database(private_sql_plugin_t *this,
 	if (reg)
 	{
 		char *uri;
+		bool cache;
 
 		uri = lib->settings->get_str(lib->settings, "%s.plugins.sql.database",
 									 NULL, charon->name);
@@ -86,21 +235,48 @@ static bool open_database(private_sql_plugin_t *this,
 			DBG1(DBG_CFG, "sql plugin failed to connect to database");
 			return FALSE;
 		}
-		this->config = sql_config_create(this->db);
-		this->cred = sql_cred_create(this->db);
+		cache = lib->settings->get_bool(lib->settings, "%s.plugins.sql.cache",
+										FALSE, charon->name);
+		this->config = sql_config_create(this->db, cache);
+		this->cred = sql_cred_create(this->db, cache);
 		this->logger = sql_logger_create(this->db);
 
+		this->refresh = lib->settings->get_int(lib->settings,
+								"%s.plugins.sql.cache_refresh", 0, charon->name);
+		if (cache && this->refresh)
+		{
+			this->has_generation = query_generation(this, &this->generation);
+			if (!this->has_generation)
+			{
+				DBG1(DBG_CFG, "sql plugin: config_generation table not "
+					 "available, reloading every %us", this->refresh);
+			}
+			INIT(this->refresher,
+				.plugin = this,
+				.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+				.ref = 2,
+			);
+			lib->scheduler->schedule_job(lib->scheduler, (job_t*)
+					callback_job_create((callback_job_cb_t)refresh_job,
+										this->refresher,
+										(callback_job_cleanup_t)refresher_unref,
+										(callback_job_cancel_t)return_false),
+					this->refresh);
+		}
+
 		charon->backends->add_backend(charon->backends, &this->config->backend);
 		lib->credmgr->add_set(lib->credmgr, &this->cred->set);
 		charon->bus->add_logger(charon->bus, &this->logger->logger);
 	}
 	else
 	{
+		stop_refresh(this);
 		charon->backends->remove_backend(charon->backends,
 										 &this->config->backend);
 		lib->credmgr->remove_set(lib->credmgr, &this->cred->set);
 		charon->bus->remove_logger(charon->bus, &this->logger->logger);
 		this->config->destroy(this->config);
+		this->config = NULL;
 		this->cred->destroy(this->cred);
 		this->logger->destroy(this->logger);
 		this->db->destroy(this->db);
@@ -120,6 +296,16 @@ METHOD(plugin_t, get_features, int,
 	return countof(f);
 }
 
+METHOD(plugin_t, reload, bool,
+	private_sql_plugin_t *this)
+{
+	if (this->config)
+	{
+		reload_caches(this);
+	}
+	return TRUE;
+}
+
 METHOD(plugin_t, destroy, void,
 	private_sql_plugin_t *this)
 {
@@ -138,6 +324,7 @@ plugin_t *sql_plugin_create()
 			.plugin = {
 				.get_name = _get_name,
 				.get_features = _get_features,
+				.reload = _reload,
 				.destroy = _destroy,
 			},
 		},
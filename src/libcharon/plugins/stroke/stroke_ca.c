@@ -234,7 +234,7 @@ METHOD(credential_set_t, create_cdp_enumerator, enumerator_t*,
 			data, (void*)cdp_data_destroy);
 }
 
-METHOD(stroke_ca_t, add, void,
+METHOD(stroke_ca_t, add, bool,
 	private_stroke_ca_t *this, stroke_msg_t *msg)
 {
 	certificate_t *cert;
@@ -243,7 +243,7 @@ METHOD(stroke_ca_t, add, void,
 	if (msg->add_ca.cacert == NULL)
 	{
 		DBG1(DBG_CFG, "missing cacert parameter");
-		return;
+		return FALSE;
 	}
 	cert = this->cred->load_ca(this->cred, msg->add_ca.cacert);
 	if (cert)
@@ -273,7 +273,9 @@ METHOD(stroke_ca_t, add, void,
 		this->sections->insert_last(this->sections, ca);
 		this->lock->unlock(this->lock);
 		DBG1(DBG_CFG, "added ca '%s'", msg->add_ca.name);
+		return TRUE;
 	}
+	return FALSE;
 }
 
 METHOD(stroke_ca_t, del, void,
@@ -42,8 +42,9 @@ struct stroke_ca_t {
 	 * Add a CA to the set using a stroke_msg_t.
 	 *
 	 * @param msg		stroke message containing CA info
+	 * @return			TRUE if CA added
 	 */
-	void (*add)(stroke_ca_t *this, stroke_msg_t *msg);
+	bool (*add)(stroke_ca_t *this, stroke_msg_t *msg);
 
 	/**
 	 * Remove a CA from the set using a stroke_msg_t.
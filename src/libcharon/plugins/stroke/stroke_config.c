@@ -20,6 +20,7 @@
 #include <daemon.h>
 #include <threading/mutex.h>
 #include <utils/lexparser.h>
+#include <collections/hashtable.h>
 
 #include <netdb.h>
 
@@ -45,6 +46,36 @@ struct private_stroke_config_t {
 	 */
 	mutex_t *mutex;
 
+	/**
+	 * peer configs by merge key, char* => peer_map_entry_t
+	 */
+	hashtable_t *merge;
+
+	/**
+	 * peer configs by child config name, char* => peer_map_entry_t
+	 */
+	hashtable_t *names;
+
+	/**
+	 * peer configs added during a batch, not yet in list
+	 */
+	linked_list_t *pending;
+
+	/**
+	 * peer configs deleted during a batch, still in list, as peer_cfg_t
+	 */
+	hashtable_t *removed;
+
+	/**
+	 * whether a batch is active
+	 */
+	bool batch;
+
+	/**
+	 * held during a batch, serializes other changes with it
+	 */
+	mutex_t *batch_mutex;
+
 	/**
 	 * ca sections
 	 */
@@ -61,6 +92,105 @@ struct private_stroke_config_t {
 	stroke_attribute_t *attributes;
 };
 
+/**
+ * Entry in a map of peer configs
+ */
+typedef struct {
+	/** key of this entry */
+	char *key;
+	/** peer configs, as peer_cfg_t */
+	linked_list_t *peers;
+} peer_map_entry_t;
+
+/**
+ * Add a peer config to a map, if not already there
+ */
+static void map_add(hashtable_t *map, char *key, peer_cfg_t *peer_cfg)
+{
+	peer_map_entry_t *entry;
+
+	entry = map->get(map, key);
+	if (!entry)
+	{
+		INIT(entry,
+			.key = strdup(key),
+			.peers = linked_list_create(),
+		);
+		map->put(map, entry->key, entry);
+	}
+	if (entry->peers->find_first(entry->peers, NULL,
+								 (void**)&peer_cfg) != SUCCESS)
+	{
+		entry->peers->insert_last(entry->peers, peer_cfg);
+	}
+}
+
+/**
+ * Remove a peer config from a map
+ */
+static void map_remove(hashtable_t *map, char *key, peer_cfg_t *peer_cfg)
+{
+	peer_map_entry_t *entry;
+
+	entry = map->get(map, key);
+	if (entry)
+	{
+		entry->peers->remove(entry->peers, peer_cfg, NULL);
+		if (!entry->peers->get_count(entry->peers))
+		{
+			map->remove(map, key);
+			entry->peers->destroy(entry->peers);
+			free(entry->key);
+			free(entry);
+		}
+	}
+}
+
+/**
+ * Get the peer configs stored in a map, NULL if none
+ */
+static linked_list_t *map_get(hashtable_t *map, char *key)
+{
+	peer_map_entry_t *entry;
+
+	entry = map->get(map, key);
+	return entry ? entry->peers : NULL;
+}
+
+/**
+ * Destroy a map of peer configs
+ */
+static void map_destroy(hashtable_t *map)
+{
+	enumerator_t *enumerator;
+	peer_map_entry_t *entry;
+
+	enumerator = map->create_enumerator(map);
+	while (enumerator->enumerate(enumerator, NULL, &entry))
+	{
+		entry->peers->destroy(entry->peers);
+		free(entry->key);
+		free(entry);
+	}
+	enumerator->destroy(enumerator);
+	map->destroy(map);
+}
+
+/**
+ * Build the key of peer configs a new one might get merged with, i.e. the
+ * fields compared by ike_cfg_t.equals() that identify an IKE peer. Truncated
+ * keys just result in larger buckets.
+ */
+static void merge_key(peer_cfg_t *peer_cfg, char *buf, size_t len)
+{
+	ike_cfg_t *ike_cfg;
+
+	ike_cfg = peer_cfg->get_ike_cfg(peer_cfg);
+	snprintf(buf, len, "%d|%s|%u|%s|%u", ike_cfg->get_version(ike_cfg),
+			 ike_cfg->get_my_addr(ike_cfg), ike_cfg->get_my_port(ike_cfg),
+			 ike_cfg->get_other_addr(ike_cfg), ike_cfg->get_other_port(ike_cfg));
+}
+
 METHOD(backend_t, create_peer_cfg_enumerator, enumerator_t*,
 	private_stroke_config_t *this, identification_t *me, identification_t *other)
 {
@@ -1167,78 +1297,171 @@ static child_cfg_t *build_child_cfg(private_stroke_config_t *this,
 	return child_cfg;
 }
 
-METHOD(stroke_config_t, add, void,
+METHOD(stroke_config_t, add, bool,
 	private_stroke_config_t *this, stroke_msg_t *msg)
 {
 	ike_cfg_t *ike_cfg, *existing_ike;
 	peer_cfg_t *peer_cfg, *existing;
 	child_cfg_t *child_cfg;
 	enumerator_t *enumerator;
+	linked_list_t *peers;
 	bool use_existing = FALSE;
+	char key[512];
 
 	ike_cfg = build_ike_cfg(this, msg);
 	if (!ike_cfg)
 	{
-		return;
+		return FALSE;
 	}
 	peer_cfg = build_peer_cfg(this, msg, ike_cfg);
 	if (!peer_cfg)
 	{
 		ike_cfg->destroy(ike_cfg);
-		return;
+		return FALSE;
 	}
 
-	enumerator = create_peer_cfg_enumerator(this, NULL, NULL);
-	while (enumerator->enumerate(enumerator, &existing))
+	this->batch_mutex->lock(this->batch_mutex);
+	merge_key(peer_cfg, key, sizeof(key));
+	this->mutex->lock(this->mutex);
+	peers = map_get(this->merge, key);
+	if (peers)
 	{
-		existing_ike = existing->get_ike_cfg(existing);
-		if (existing->equals(existing, peer_cfg) &&
-			existing_ike->equals(existing_ike, peer_cfg->get_ike_cfg(peer_cfg)))
+		enumerator = peers->create_enumerator(peers);
+		while (enumerator->enumerate(enumerator, &existing))
 		{
-			use_existing = TRUE;
-			peer_cfg->destroy(peer_cfg);
-			peer_cfg = existing;
-			peer_cfg->get_ref(peer_cfg);
-			DBG1(DBG_CFG, "added child to existing configuration '%s'",
-				 peer_cfg->get_name(peer_cfg));
-			break;
+			existing_ike = existing->get_ike_cfg(existing);
+			if (existing->equals(existing, peer_cfg) &&
+				existing_ike->equals(existing_ike,
+									 peer_cfg->get_ike_cfg(peer_cfg)))
+			{
+				use_existing = TRUE;
+				peer_cfg->destroy(peer_cfg);
+				peer_cfg = existing;
+				peer_cfg->get_ref(peer_cfg);
+				DBG1(DBG_CFG, "added child to existing configuration '%s'",
+					 peer_cfg->get_name(peer_cfg));
+				break;
+			}
 		}
+		enumerator->destroy(enumerator);
 	}
-	enumerator->destroy(enumerator);
+	this->mutex->unlock(this->mutex);
 
 	child_cfg = build_child_cfg(this, msg);
 	if (!child_cfg)
 	{
 		peer_cfg->destroy(peer_cfg);
-		return;
+		this->batch_mutex->unlock(this->batch_mutex);
+		return FALSE;
 	}
 	peer_cfg->add_child_cfg(peer_cfg, child_cfg);
 
+	this->mutex->lock(this->mutex);
+	map_add(this->names, child_cfg->get_name(child_cfg), peer_cfg);
 	if (use_existing)
 	{
 		peer_cfg->destroy(peer_cfg);
 	}
 	else
 	{
-		/* add config to backend */
+		/* add config to backend, or to the pending batch */
 		DBG1(DBG_CFG, "added configuration '%s'", msg->add_conn.name);
-		this->mutex->lock(this->mutex);
+		map_add(this->merge, key, peer_cfg);
+		if (this->batch)
+		{
+			this->pending->insert_last(this->pending, peer_cfg);
+		}
+		else
+		{
+			this->list->insert_last(this->list, peer_cfg);
+		}
+	}
+	this->mutex->unlock(this->mutex);
+	this->batch_mutex->unlock(this->batch_mutex);
+	return TRUE;
+}
+
+/**
+ * Make peer configs added during a batch visible, mutex must be held
+ */
+static void commit_pending(private_stroke_config_t *this)
+{
+	peer_cfg_t *peer_cfg;
+
+	while (this->pending->remove_first(this->pending,
+									   (void**)&peer_cfg) == SUCCESS)
+	{
 		this->list->insert_last(this->list, peer_cfg);
-		this->mutex->unlock(this->mutex);
 	}
 }
 
+/**
+ * Remove peer configs deleted during a batch from the list in a single pass,
+ * mutex must be held
+ */
+static void commit_removed(private_stroke_config_t *this)
+{
+	enumerator_t *enumerator;
+	peer_cfg_t *peer_cfg;
+
+	if (!this->removed->get_count(this->removed))
+	{
+		return;
+	}
+	enumerator = this->list->create_enumerator(this->list);
+	while (enumerator->enumerate(enumerator, &peer_cfg))
+	{
+		if (this->removed->remove(this->removed, peer_cfg))
+		{
+			this->list->remove_at(this->list, enumerator);
+			peer_cfg->destroy(peer_cfg);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
+METHOD(stroke_config_t, begin_batch, void,
+	private_stroke_config_t *this)
+{
+	this->batch_mutex->lock(this->batch_mutex);
+	this->batch = TRUE;
+}
+
+METHOD(stroke_config_t, end_batch, void,
+	private_stroke_config_t *this)
+{
+	this->mutex->lock(this->mutex);
+	commit_pending(this);
+	commit_removed(this);
+	this->batch = FALSE;
+	this->mutex->unlock(this->mutex);
+	this->batch_mutex->unlock(this->batch_mutex);
+}
+
 METHOD(stroke_config_t, del, void,
 	private_stroke_config_t *this, stroke_msg_t *msg)
 {
-	enumerator_t *enumerator, *children;
+	enumerator_t *children;
+	linked_list_t *peers;
 	peer_cfg_t *peer;
 	child_cfg_t *child;
 	bool deleted = FALSE;
+	char key[512];
 
+	this->batch_mutex->lock(this->batch_mutex);
 	this->mutex->lock(this->mutex);
-	enumerator = this->list->create_enumerator(this->list);
-	while (enumerator->enumerate(enumerator, &peer))
+	commit_pending(this);
+	peers = map_get(this->names, msg->del_conn.name);
+	if (peers)
+	{	/* copy the list, as we modify the map */
+		peers = linked_list_create_from_enumerator(
+									peers->create_enumerator(peers));
+	}
+	else
+	{
+		peers = linked_list_create();
+	}
+	while (peers->remove_first(peers, (void**)&peer) == SUCCESS)
 	{
 		bool keep = FALSE;
 
@@ -1258,16 +1481,24 @@ METHOD(stroke_config_t, del, void,
 			}
 		}
 		children->destroy(children);
+		map_remove(this->names, msg->del_conn.name, peer);
 
-		/* if peer config has no children anymore, remove it */
+		/* if peer config has no children anymore, remove it from the list
+		 * when the batch ends, or right away if there is none */
 		if (!keep)
 		{
-			this->list->remove_at(this->list, enumerator);
-			peer->destroy(peer);
+			merge_key(peer, key, sizeof(key));
+			map_remove(this->merge, key, peer);
+			this->removed->put(this->removed, peer, peer);
 		}
 	}
-	enumerator->destroy(enumerator);
+	peers->destroy(peers);
+	if (!this->batch)
+	{
+		commit_removed(this);
+	}
 	this->mutex->unlock(this->mutex);
+	this->batch_mutex->unlock(this->batch_mutex);
 
 	if (deleted)
 	{
@@ -1461,7 +1692,12 @@ METHOD(stroke_config_t, destroy, void,
 	private_stroke_config_t *this)
 {
 	this->list->destroy_offset(this->list, offsetof(peer_cfg_t, destroy));
+	this->pending->destroy_offset(this->pending, offsetof(peer_cfg_t, destroy));
+	this->removed->destroy(this->removed);
+	map_destroy(this->merge);
+	map_destroy(this->names);
 	this->mutex->destroy(this->mutex);
+	this->batch_mutex->destroy(this->batch_mutex);
 	free(this);
 }
 
@@ -1482,11 +1718,18 @@ stroke_config_t *stroke_config_create(stroke_ca_t *ca, stroke_cred_t *cred,
 			},
 			.add = _add,
 			.del = _del,
+			.begin_batch = _begin_batch,
+			.end_batch = _end_batch,
 			.set_user_credentials = _set_user_credentials,
 			.destroy = _destroy,
 		},
 		.list = linked_list_create(),
 		.mutex = mutex_create(MUTEX_TYPE_RECURSIVE),
+		.merge = hashtable_create(hashtable_hash_str, hashtable_equals_str, 32),
+		.names = hashtable_create(hashtable_hash_str, hashtable_equals_str, 32),
+		.pending = linked_list_create(),
+		.removed = hashtable_create(hashtable_hash_ptr, hashtable_equals_ptr, 8),
+		.batch_mutex = mutex_create(MUTEX_TYPE_RECURSIVE),
 		.ca = ca,
 		.cred = cred,
 		.attributes = attributes,
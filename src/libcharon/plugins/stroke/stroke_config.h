@@ -44,8 +44,9 @@ struct stroke_config_t {
 	 * Add a configuration to the backend.
 	 *
 	 * @param msg		received stroke message containing config
+	 * @return			TRUE if configuration added
 	 */
-	void (*add)(stroke_config_t *this, stroke_msg_t *msg);
+	bool (*add)(stroke_config_t *this, stroke_msg_t *msg);
 
 	/**
 	 * Remove a configuration from the backend.
@@ -54,6 +55,19 @@ struct stroke_config_t {
 	 */
 	void (*del)(stroke_config_t *this, stroke_msg_t *msg);
 
+	/**
+	 * Start a batch of configuration changes.
+	 *
+	 * Configurations added during a batch get visible at once when the batch
+	 * ends. Changes by other threads wait until then.
+	 */
+	void (*begin_batch)(stroke_config_t *this);
+
+	/**
+	 * End a batch of configuration changes started with begin_batch().
+	 */
+	void (*end_batch)(stroke_config_t *this);
+
 	/**
 	 * Set the username and password for a connection in this backend.
 	 *
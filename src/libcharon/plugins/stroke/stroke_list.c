@@ -65,6 +65,11 @@ struct private_stroke_list_t {
 	 * strokes attribute provider
 	 */
 	stroke_attribute_t *attribute;
+
+	/**
+	 * summarizer registered with the IKE_SA manager
+	 */
+	ike_sa_summarizer_t summarizer;
 };
 
 /**
@@ -95,12 +100,61 @@ static void log_task_q(FILE *out, ike_sa_t *ike_sa, task_queue_t q, char *name)
 }
 
 /**
- * log an IKE_SA to out
+ * Marker in the text of a summary, replaced by the next of its fields
+ */
+#define FIELD_MARKER '\x01'
+
+/**
+ * Markers enclosing parts of the text of a summary listed by statusall only
+ */
+#define ALL_BEGIN '\x02'
+#define ALL_END '\x03'
+
+/**
+ * Fields of a summary, written when the summary gets listed
  */
-static void log_ike_sa(FILE *out, ike_sa_t *ike_sa, bool all)
+typedef enum {
+	/** time relative to the time of listing */
+	FIELD_TIME,
+	/** rekey time of a CHILD_SA, "active" if passed */
+	FIELD_REKEY,
+	/** traffic statistics of a CHILD_SA, queried from the kernel */
+	FIELD_USAGE,
+} field_type_t;
+
+/**
+ * A field of a summary
+ */
+typedef struct {
+	/** type of the field */
+	field_type_t type;
+	/** absolute monotonic time, for FIELD_TIME and FIELD_REKEY */
+	time_t time;
+} field_t;
+
+/**
+ * Write a marker for a field to out and add the field
+ */
+static void add_field(FILE *out, array_t *fields, field_type_t type,
+					  time_t time)
+{
+	field_t field = {
+		.type = type,
+		.time = time,
+	};
+
+	array_insert(fields, ARRAY_TAIL, &field);
+	fputc(FIELD_MARKER, out);
+}
+
+/**
+ * log an IKE_SA to out, with markers for the fields added to fields
+ */
+static void log_ike_sa(FILE *out, ike_sa_t *ike_sa, array_t *fields)
 {
 	ike_sa_id_t *id = ike_sa->get_id(ike_sa);
-	time_t now = time_monotonic(NULL);
+	proposal_t *ike_proposal;
+	identification_t *eap_id;
 
 	fprintf(out, "%12s[%d]: %N",
 			ike_sa->get_name(ike_sa), ike_sa->get_unique_id(ike_sa),
@@ -108,110 +162,108 @@ static void log_ike_sa(FILE *out, ike_sa_t *ike_sa, bool all)
 
 	if (ike_sa->get_state(ike_sa) == IKE_ESTABLISHED)
 	{
-		time_t established;
-
-		established = ike_sa->get_statistic(ike_sa, STAT_ESTABLISHED);
-		fprintf(out, " %V ago", &now, &established);
+		fprintf(out, " ");
+		add_field(out, fields, FIELD_TIME,
+				  ike_sa->get_statistic(ike_sa, STAT_ESTABLISHED));
+		fprintf(out, " ago");
 	}
 
 	fprintf(out, ", %H[%Y]...%H[%Y]\n",
 			ike_sa->get_my_host(ike_sa), ike_sa->get_my_id(ike_sa),
 			ike_sa->get_other_host(ike_sa), ike_sa->get_other_id(ike_sa));
 
-	if (all)
+	fputc(ALL_BEGIN, out);
+
+	eap_id = ike_sa->get_other_eap_id(ike_sa);
+
+	if (!eap_id->equals(eap_id, ike_sa->get_other_id(ike_sa)))
 	{
-		proposal_t *ike_proposal;
-		identification_t *eap_id;
+		fprintf(out, "%12s[%d]: Remote %s identity: %Y\n",
+				ike_sa->get_name(ike_sa), ike_sa->get_unique_id(ike_sa),
+				ike_sa->get_version(ike_sa) == IKEV1 ? "XAuth" : "EAP",
+				eap_id);
+	}
 
-		eap_id = ike_sa->get_other_eap_id(ike_sa);
+	ike_proposal = ike_sa->get_proposal(ike_sa);
 
-		if (!eap_id->equals(eap_id, ike_sa->get_other_id(ike_sa)))
-		{
-			fprintf(out, "%12s[%d]: Remote %s identity: %Y\n",
-					ike_sa->get_name(ike_sa), ike_sa->get_unique_id(ike_sa),
-					ike_sa->get_version(ike_sa) == IKEV1 ? "XAuth" : "EAP",
-					eap_id);
-		}
+	fprintf(out, "%12s[%d]: %N SPIs: %.16"PRIx64"_i%s %.16"PRIx64"_r%s",
+			ike_sa->get_name(ike_sa), ike_sa->get_unique_id(ike_sa),
+			ike_version_names, ike_sa->get_version(ike_sa),
+			id->get_initiator_spi(id), id->is_initiator(id) ? "*" : "",
+			id->get_responder_spi(id), id->is_initiator(id) ? "" : "*");
 
-		ike_proposal = ike_sa->get_proposal(ike_sa);
 
-		fprintf(out, "%12s[%d]: %N SPIs: %.16"PRIx64"_i%s %.16"PRIx64"_r%s",
-				ike_sa->get_name(ike_sa), ike_sa->get_unique_id(ike_sa),
-				ike_version_names, ike_sa->get_version(ike_sa),
-				id->get_initiator_spi(id), id->is_initiator(id) ? "*" : "",
-				id->get_responder_spi(id), id->is_initiator(id) ? "" : "*");
+	if (ike_sa->get_state(ike_sa) == IKE_ESTABLISHED)
+	{
+		time_t rekey, reauth;
+		peer_cfg_t *peer_cfg;
 
+		rekey = ike_sa->get_statistic(ike_sa, STAT_REKEY);
+		reauth = ike_sa->get_statistic(ike_sa, STAT_REAUTH);
+		peer_cfg = ike_sa->get_peer_cfg(ike_sa);
 
-		if (ike_sa->get_state(ike_sa) == IKE_ESTABLISHED)
+		if (rekey)
 		{
-			time_t rekey, reauth;
-			peer_cfg_t *peer_cfg;
-
-			rekey = ike_sa->get_statistic(ike_sa, STAT_REKEY);
-			reauth = ike_sa->get_statistic(ike_sa, STAT_REAUTH);
-			peer_cfg = ike_sa->get_peer_cfg(ike_sa);
+			fprintf(out, ", rekeying in ");
+			add_field(out, fields, FIELD_TIME, rekey);
+		}
+		if (reauth)
+		{
+			bool first = TRUE;
+			enumerator_t *enumerator;
+			auth_cfg_t *auth;
 
-			if (rekey)
+			fprintf(out, ", ");
+			enumerator = peer_cfg->create_auth_cfg_enumerator(peer_cfg, TRUE);
+			while (enumerator->enumerate(enumerator, &auth))
 			{
-				fprintf(out, ", rekeying in %V", &rekey, &now);
-			}
-			if (reauth)
-			{
-				bool first = TRUE;
-				enumerator_t *enumerator;
-				auth_cfg_t *auth;
-
-				fprintf(out, ", ");
-				enumerator = peer_cfg->create_auth_cfg_enumerator(peer_cfg, TRUE);
-				while (enumerator->enumerate(enumerator, &auth))
+				if (!first)
 				{
-					if (!first)
-					{
-						fprintf(out, "+");
-					}
-					first = FALSE;
-					fprintf(out, "%N", auth_class_names,
-							auth->get(auth, AUTH_RULE_AUTH_CLASS));
+					fprintf(out, "+");
 				}
-				enumerator->destroy(enumerator);
-				fprintf(out, " reauthentication in %V", &reauth, &now);
-			}
-			if (!rekey && !reauth)
-			{
-				fprintf(out, ", rekeying disabled");
+				first = FALSE;
+				fprintf(out, "%N", auth_class_names,
+						auth->get(auth, AUTH_RULE_AUTH_CLASS));
 			}
+			enumerator->destroy(enumerator);
+			fprintf(out, " reauthentication in ");
+			add_field(out, fields, FIELD_TIME, reauth);
 		}
-		fprintf(out, "\n");
-
-		if (ike_proposal)
+		if (!rekey && !reauth)
 		{
-			char buf[BUF_LEN];
-
-			snprintf(buf, BUF_LEN, "%P", ike_proposal);
-			fprintf(out, "%12s[%d]: IKE proposal: %s\n",
-					ike_sa->get_name(ike_sa), ike_sa->get_unique_id(ike_sa),
-					buf+4);
+			fprintf(out, ", rekeying disabled");
 		}
+	}
+	fprintf(out, "\n");
+
+	if (ike_proposal)
+	{
+		char buf[BUF_LEN];
 
-		log_task_q(out, ike_sa, TASK_QUEUE_QUEUED, "queued");
-		log_task_q(out, ike_sa, TASK_QUEUE_ACTIVE, "active");
-		log_task_q(out, ike_sa, TASK_QUEUE_PASSIVE, "passive");
+		snprintf(buf, BUF_LEN, "%P", ike_proposal);
+		fprintf(out, "%12s[%d]: IKE proposal: %s\n",
+				ike_sa->get_name(ike_sa), ike_sa->get_unique_id(ike_sa),
+				buf+4);
 	}
+
+	log_task_q(out, ike_sa, TASK_QUEUE_QUEUED, "queued");
+	log_task_q(out, ike_sa, TASK_QUEUE_ACTIVE, "active");
+	log_task_q(out, ike_sa, TASK_QUEUE_PASSIVE, "passive");
+
+	fputc(ALL_END, out);
 }
 
 /**
- * log an CHILD_SA to out
+ * log an CHILD_SA to out, with markers for the fields added to fields
  */
-static void log_child_sa(FILE *out, child_sa_t *child_sa, bool all)
+static void log_child_sa(FILE *out, child_sa_t *child_sa, array_t *fields)
 {
-	time_t use_in, use_out, rekey, now;
-	u_int64_t bytes_in, bytes_out, packets_in, packets_out;
+	time_t rekey;
 	proposal_t *proposal;
 	linked_list_t *my_ts, *other_ts;
 	child_cfg_t *config;
 
 	config = child_sa->get_config(child_sa);
-	now = time_monotonic(NULL);
 
 	fprintf(out, "%12s{%d}:  %N, %N%s",
 			child_sa->get_name(child_sa), child_sa->get_reqid(child_sa),
@@ -234,97 +286,71 @@ static void log_child_sa(FILE *out, child_sa_t *child_sa, bool all)
 					ntohs(child_sa->get_cpi(child_sa, FALSE)));
 		}
 
-		if (all)
-		{
-			fprintf(out, "\n%12s{%d}:  ", child_sa->get_name(child_sa),
-					child_sa->get_reqid(child_sa));
+		fputc(ALL_BEGIN, out);
+		fprintf(out, "\n%12s{%d}:  ", child_sa->get_name(child_sa),
+				child_sa->get_reqid(child_sa));
 
-			proposal = child_sa->get_proposal(child_sa);
-			if (proposal)
+		proposal = child_sa->get_proposal(child_sa);
+		if (proposal)
+		{
+			u_int16_t encr_alg = ENCR_UNDEFINED, int_alg = AUTH_UNDEFINED;
+			u_int16_t encr_size = 0, int_size = 0;
+			u_int16_t esn = NO_EXT_SEQ_NUMBERS;
+			bool first = TRUE;
+
+			proposal->get_algorithm(proposal, ENCRYPTION_ALGORITHM,
+									&encr_alg, &encr_size);
+			proposal->get_algorithm(proposal, INTEGRITY_ALGORITHM,
+									&int_alg, &int_size);
+			proposal->get_algorithm(proposal, EXTENDED_SEQUENCE_NUMBERS,
+									&esn, NULL);
+
+			if (encr_alg != ENCR_UNDEFINED)
 			{
-				u_int16_t encr_alg = ENCR_UNDEFINED, int_alg = AUTH_UNDEFINED;
-				u_int16_t encr_size = 0, int_size = 0;
-				u_int16_t esn = NO_EXT_SEQ_NUMBERS;
-				bool first = TRUE;
-
-				proposal->get_algorithm(proposal, ENCRYPTION_ALGORITHM,
-										&encr_alg, &encr_size);
-				proposal->get_algorithm(proposal, INTEGRITY_ALGORITHM,
-										&int_alg, &int_size);
-				proposal->get_algorithm(proposal, EXTENDED_SEQUENCE_NUMBERS,
-										&esn, NULL);
-
-				if (encr_alg != ENCR_UNDEFINED)
-				{
-					fprintf(out, "%N", encryption_algorithm_names, encr_alg);
-					first = FALSE;
-					if (encr_size)
-					{
-						fprintf(out, "_%u", encr_size);
-					}
-				}
-				if (int_alg != AUTH_UNDEFINED)
-				{
-					if (!first)
-					{
-						fprintf(out, "/");
-					}
-					fprintf(out, "%N", integrity_algorithm_names, int_alg);
-					if (int_size)
-					{
-						fprintf(out, "_%u", int_size);
-					}
-				}
-				if (esn == EXT_SEQ_NUMBERS)
+				fprintf(out, "%N", encryption_algorithm_names, encr_alg);
+				first = FALSE;
+				if (encr_size)
 				{
-					fprintf(out, "/ESN");
+					fprintf(out, "_%u", encr_size);
 				}
 			}
-
-			child_sa->get_usestats(child_sa, TRUE,
-								   &use_in, &bytes_in, &packets_in);
-			fprintf(out, ", %" PRIu64 " bytes_i", bytes_in);
-			if (use_in)
+			if (int_alg != AUTH_UNDEFINED)
 			{
-				fprintf(out, " (%" PRIu64 " pkt%s, %" PRIu64 "s ago)",
-						packets_in, (packets_in == 1) ? "": "s",
-						(u_int64_t)(now - use_in));
-			}
-
-			child_sa->get_usestats(child_sa, FALSE,
-								   &use_out, &bytes_out, &packets_out);
-			fprintf(out, ", %" PRIu64 " bytes_o", bytes_out);
-			if (use_out)
-			{
-				fprintf(out, " (%" PRIu64 " pkt%s, %" PRIu64 "s ago)",
-						packets_out, (packets_out == 1) ? "": "s",
-						(u_int64_t)(now - use_out));
-			}
-			fprintf(out, ", rekeying ");
-
-			rekey = child_sa->get_lifetime(child_sa, FALSE);
-			if (rekey)
-			{
-				if (now > rekey)
+				if (!first)
 				{
-					fprintf(out, "active");
+					fprintf(out, "/");
 				}
-				else
+				fprintf(out, "%N", integrity_algorithm_names, int_alg);
+				if (int_size)
 				{
-					fprintf(out, "in %V", &now, &rekey);
+					fprintf(out, "_%u", int_size);
 				}
 			}
-			else
+			if (esn == EXT_SEQ_NUMBERS)
 			{
-				fprintf(out, "disabled");
+				fprintf(out, "/ESN");
 			}
+		}
+
+		add_field(out, fields, FIELD_USAGE, 0);
+		fprintf(out, ", rekeying ");
 
+		rekey = child_sa->get_lifetime(child_sa, FALSE);
+		if (rekey)
+		{
+			add_field(out, fields, FIELD_REKEY, rekey);
+		}
+		else
+		{
+			fprintf(out, "disabled");
 		}
+		fputc(ALL_END, out);
 	}
 	else if (child_sa->get_state(child_sa) == CHILD_REKEYING)
 	{
-		rekey = child_sa->get_lifetime(child_sa, TRUE);
-		fprintf(out, ", expires in %V", &now, &rekey);
+		fprintf(out, ", expires in ");
+		add_field(out, fields, FIELD_TIME,
+				  child_sa->get_lifetime(child_sa, TRUE));
 	}
 
 	my_ts = linked_list_create_from_enumerator(
@@ -338,6 +364,333 @@ static void log_child_sa(FILE *out, child_sa_t *child_sa, bool all)
 	other_ts->destroy(other_ts);
 }
 
+/**
+ * Format an IKE_SA or CHILD_SA to an allocated string, with markers for the
+ * fields added to fields
+ */
+static char *format_text(void (*log)(FILE *out, void *sa, array_t *fields),
+						 void *sa, array_t *fields)
+{
+	size_t len;
+	bool success;
+	char *text;
+	FILE *out;
+
+	/* retry with a larger buffer if the output got truncated */
+	for (len = 1024; len <= 1024 * 1024; len *= 2)
+	{
+		text = malloc(len);
+		out = fmemopen(text, len, "w");
+		if (!out)
+		{
+			break;
+		}
+		log(out, sa, fields);
+		/* leave room for the terminating null byte */
+		success = fflush(out) == 0 && ftell(out) < len - 1;
+		fclose(out);
+		if (success)
+		{
+			return text;
+		}
+		free(text);
+		while (array_remove(fields, ARRAY_TAIL, NULL))
+		{
+			/* drop the fields of the truncated text */
+		}
+	}
+	free(text);
+	return NULL;
+}
+
+/**
+ * Summary of a CHILD_SA
+ */
+typedef struct {
+	/** name of the CHILD_SA */
+	char *name;
+	/** formatted CHILD_SA, with markers */
+	char *text;
+	/** fields of the markers in text, as field_t */
+	array_t *fields;
+	/** IPsec protocol of the CHILD_SA */
+	protocol_id_t protocol;
+	/** IPsec mode of the CHILD_SA */
+	ipsec_mode_t mode;
+	/** inbound SPI */
+	u_int32_t spi_in;
+	/** outbound SPI */
+	u_int32_t spi_out;
+	/** inbound mark */
+	mark_t mark_in;
+	/** outbound mark */
+	mark_t mark_out;
+	/** local traffic selectors, as traffic_selector_t */
+	array_t *my_ts;
+	/** remote traffic selectors, as traffic_selector_t */
+	array_t *other_ts;
+} child_summary_t;
+
+/**
+ * Summary of an IKE_SA and its CHILD_SAs, kept by the IKE_SA manager for the
+ * IKE_SA's last check-in
+ */
+typedef struct {
+	/** reference count */
+	refcount_t refs;
+	/** name of the IKE_SA */
+	char *name;
+	/** state of the IKE_SA */
+	ike_sa_state_t state;
+	/** local address of the IKE_SA */
+	host_t *me;
+	/** remote address of the IKE_SA */
+	host_t *other;
+	/** remote identity */
+	identification_t *other_id;
+	/** remote EAP/XAuth identity */
+	identification_t *other_eap_id;
+	/** formatted IKE_SA, with markers */
+	char *text;
+	/** fields of the markers in text, as field_t */
+	array_t *fields;
+	/** summaries of the CHILD_SAs, as child_summary_t */
+	array_t *children;
+} summary_t;
+
+/**
+ * Clone traffic selectors of a CHILD_SA to an array
+ */
+static array_t *clone_ts(child_sa_t *child_sa, bool local)
+{
+	enumerator_t *enumerator;
+	traffic_selector_t *ts;
+	array_t *array;
+
+	array = array_create(0, 0);
+	enumerator = child_sa->create_ts_enumerator(child_sa, local);
+	while (enumerator->enumerate(enumerator, &ts))
+	{
+		array_insert(array, ARRAY_TAIL, ts->clone(ts));
+	}
+	enumerator->destroy(enumerator);
+	return array;
+}
+
+/**
+ * Summarize a CHILD_SA
+ */
+static child_summary_t *summarize_child(child_sa_t *child_sa)
+{
+	child_summary_t *this;
+
+	INIT(this,
+		.name = strdup(child_sa->get_name(child_sa)),
+		.fields = array_create(sizeof(field_t), 0),
+		.protocol = child_sa->get_protocol(child_sa),
+		.mode = child_sa->get_mode(child_sa),
+		.spi_in = child_sa->get_spi(child_sa, TRUE),
+		.spi_out = child_sa->get_spi(child_sa, FALSE),
+		.mark_in = child_sa->get_mark(child_sa, TRUE),
+		.mark_out = child_sa->get_mark(child_sa, FALSE),
+		.my_ts = clone_ts(child_sa, TRUE),
+		.other_ts = clone_ts(child_sa, FALSE),
+	);
+	this->text = format_text((void*)log_child_sa, child_sa, this->fields);
+	return this;
+}
+
+/**
+ * Destroy a CHILD_SA summary
+ */
+static void child_summary_destroy(child_summary_t *this)
+{
+	array_destroy_offset(this->my_ts, offsetof(traffic_selector_t, destroy));
+	array_destroy_offset(this->other_ts, offsetof(traffic_selector_t, destroy));
+	array_destroy(this->fields);
+	free(this->text);
+	free(this->name);
+	free(this);
+}
+
+/**
+ * Implementation of ike_sa_summarizer_t.summarize, invoked while the IKE_SA
+ * is checked in or while the IKE_SA manager holds the lock of its segment,
+ * so we don't query the kernel here
+ */
+static void *summarize(ike_sa_summarizer_t *summarizer, ike_sa_t *ike_sa)
+{
+	enumerator_t *enumerator;
+	child_sa_t *child_sa;
+	summary_t *this;
+
+	INIT(this,
+		.refs = 1,
+		.name = strdup(ike_sa->get_name(ike_sa)),
+		.state = ike_sa->get_state(ike_sa),
+		.me = ike_sa->get_my_host(ike_sa)->clone(ike_sa->get_my_host(ike_sa)),
+		.other = ike_sa->get_other_host(ike_sa)->clone(
+											ike_sa->get_other_host(ike_sa)),
+		.other_id = ike_sa->get_other_id(ike_sa)->clone(
+											ike_sa->get_other_id(ike_sa)),
+		.other_eap_id = ike_sa->get_other_eap_id(ike_sa)->clone(
+											ike_sa->get_other_eap_id(ike_sa)),
+		.fields = array_create(sizeof(field_t), 0),
+		.children = array_create(0, 0),
+	);
+	this->text = format_text((void*)log_ike_sa, ike_sa, this->fields);
+
+	enumerator = ike_sa->create_child_sa_enumerator(ike_sa);
+	while (enumerator->enumerate(enumerator, &child_sa))
+	{
+		array_insert(this->children, ARRAY_TAIL, summarize_child(child_sa));
+	}
+	enumerator->destroy(enumerator);
+	return this;
+}
+
+/**
+ * Implementation of ike_sa_summarizer_t.get_ref
+ */
+static void *summary_get_ref(ike_sa_summarizer_t *summarizer, summary_t *this)
+{
+	ref_get(&this->refs);
+	return this;
+}
+
+/**
+ * Implementation of ike_sa_summarizer_t.release
+ */
+static void summary_release(ike_sa_summarizer_t *summarizer, summary_t *this)
+{
+	child_summary_t *child;
+
+	if (ref_put(&this->refs))
+	{
+		while (array_remove(this->children, ARRAY_TAIL, &child))
+		{
+			child_summary_destroy(child);
+		}
+		array_destroy(this->children);
+		array_destroy(this->fields);
+		this->me->destroy(this->me);
+		this->other->destroy(this->other);
+		this->other_id->destroy(this->other_id);
+		this->other_eap_id->destroy(this->other_eap_id);
+		free(this->text);
+		free(this->name);
+		free(this);
+	}
+}
+
+/**
+ * Query and log the traffic statistics of one direction of a CHILD_SA
+ */
+static void log_usage(FILE *out, host_t *me, host_t *other,
+					  child_summary_t *child, bool inbound)
+{
+	u_int64_t bytes, packets;
+	time_t use, now;
+
+	child_sa_query_usestats(me, other, child->protocol,
+					inbound ? child->spi_in : child->spi_out,
+					inbound ? child->mark_in : child->mark_out, child->mode,
+					child->my_ts, child->other_ts, inbound,
+					&use, &bytes, &packets);
+	fprintf(out, ", %" PRIu64 " bytes_%s", bytes, inbound ? "i" : "o");
+	if (use)
+	{
+		now = time_monotonic(NULL);
+		fprintf(out, " (%" PRIu64 " pkt%s, %" PRIu64 "s ago)",
+				packets, (packets == 1) ? "": "s", (u_int64_t)(now - use));
+	}
+}
+
+/**
+ * Log the text of a summary, writing its fields and, unless all is set,
+ * skipping the parts listed by statusall only. me and other are the
+ * addresses of the IKE_SA for CHILD_SA statistics, NULL to skip them.
+ */
+static void log_text(FILE *out, char *text, array_t *fields, bool all,
+					 host_t *me, host_t *other, child_summary_t *child)
+{
+	enumerator_t *enumerator;
+	field_t *field;
+	bool skip = FALSE;
+	time_t now;
+	size_t len;
+
+	if (!text)
+	{
+		return;
+	}
+	now = time_monotonic(NULL);
+	enumerator = array_create_enumerator(fields);
+	while (*text)
+	{
+		len = strcspn(text, "\x01\x02\x03");
+		if (!skip)
+		{
+			fwrite(text, 1, len, out);
+		}
+		text += len;
+		switch (*text)
+		{
+			case FIELD_MARKER:
+				if (!enumerator->enumerate(enumerator, &field) || skip)
+				{
+					break;
+				}
+				switch (field->type)
+				{
+					case FIELD_TIME:
+						fprintf(out, "%V", &now, &field->time);
+						break;
+					case FIELD_REKEY:
+						if (now > field->time)
+						{
+							fprintf(out, "active");
+						}
+						else
+						{
+							fprintf(out, "in %V", &now, &field->time);
+						}
+						break;
+					case FIELD_USAGE:
+						if (me && other && child)
+						{
+							log_usage(out, me, other, child, TRUE);
+							log_usage(out, me, other, child, FALSE);
+						}
+						break;
+				}
+				break;
+			case ALL_BEGIN:
+				skip = !all;
+				break;
+			case ALL_END:
+				skip = FALSE;
+				break;
+			default:
+				continue;
+		}
+		text++;
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Log a CHILD_SA not belonging to an IKE_SA, e.g. a trap
+ */
+static void log_child_sa_now(FILE *out, child_sa_t *child_sa, bool all)
+{
+	child_summary_t *child;
+
+	child = summarize_child(child_sa);
+	log_text(out, child->text, child->fields, all, NULL, NULL, child);
+	child_summary_destroy(child);
+}
+
 /**
  * Log a configs local or remote authentication config to out
  */
@@ -455,6 +808,73 @@ static void log_auth_cfgs(FILE *out, peer_cfg_t *peer_cfg, bool local)
 	enumerator->destroy(enumerator);
 }
 
+/**
+ * Check if a summary of an IKE_SA matches the filter of a status message
+ */
+static bool summary_matches(summary_t *summary, stroke_msg_t *msg,
+							host_t *peer_host, identification_t *peer_id)
+{
+	enumerator_t *enumerator;
+	child_summary_t *child;
+	bool found;
+
+	if (msg->status.state &&
+		!strcaseeq(msg->status.state, enum_to_name(ike_sa_state_names,
+												   summary->state)))
+	{
+		return FALSE;
+	}
+	if (peer_host || peer_id)
+	{
+		if (!(peer_host && peer_host->ip_equals(peer_host, summary->other)) &&
+			!(peer_id && (summary->other_eap_id->matches(summary->other_eap_id,
+														 peer_id) ||
+						  summary->other_id->matches(summary->other_id,
+													 peer_id))))
+		{
+			return FALSE;
+		}
+	}
+	if (!msg->status.name || streq(msg->status.name, summary->name))
+	{
+		return TRUE;
+	}
+	found = FALSE;
+	enumerator = array_create_enumerator(summary->children);
+	while (enumerator->enumerate(enumerator, &child))
+	{
+		if (streq(msg->status.name, child->name))
+		{
+			found = TRUE;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
+}
+
+/**
+ * Write a summary of an IKE_SA to the client, querying the traffic statistics
+ * of its CHILD_SAs while the IKE_SA is usable by other threads
+ */
+static void log_summary(FILE *out, summary_t *summary, char *name, bool all)
+{
+	enumerator_t *enumerator;
+	child_summary_t *child;
+
+	log_text(out, summary->text, summary->fields, all, NULL, NULL, NULL);
+	enumerator = array_create_enumerator(summary->children);
+	while (enumerator->enumerate(enumerator, &child))
+	{
+		if (name == NULL || streq(name, child->name))
+		{
+			log_text(out, child->text, child->fields, all,
+					 summary->me, summary->other, child);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
 METHOD(stroke_list_t, status, void,
 	private_stroke_list_t *this, stroke_msg_t *msg, FILE *out,
 	bool all, bool wait)
@@ -463,10 +883,13 @@ METHOD(stroke_list_t, status, void,
 	ike_cfg_t *ike_cfg;
 	child_cfg_t *child_cfg;
 	child_sa_t *child_sa;
-	ike_sa_t *ike_sa;
+	summary_t *summary;
 	linked_list_t *my_ts, *other_ts;
-	bool first, found = FALSE;
+	host_t *peer_host = NULL;
+	identification_t *peer_id = NULL;
+	bool first, more = FALSE;
 	char *name = msg->status.name;
+	int skipped = 0, shown = 0, busy = 0;
 	u_int half_open;
 
 	if (all)
@@ -639,7 +1062,7 @@ METHOD(stroke_list_t, status, void,
 			fprintf(out, "Routed Connections:\n");
 			first = FALSE;
 		}
-		log_child_sa(out, child_sa, all);
+		log_child_sa_now(out, child_sa, all);
 	}
 	enumerator->destroy(enumerator);
 
@@ -648,40 +1071,67 @@ METHOD(stroke_list_t, status, void,
 	fprintf(out, "Security Associations (%u up, %u connecting):\n",
 		charon->ike_sa_manager->get_count(charon->ike_sa_manager) - half_open,
 		half_open);
-	enumerator = charon->controller->create_ike_sa_enumerator(
-													charon->controller, wait);
-	while (enumerator->enumerate(enumerator, &ike_sa) && ferror(out) == 0)
+	if (msg->status.peer)
 	{
-		bool ike_printed = FALSE;
-		enumerator_t *children = ike_sa->create_child_sa_enumerator(ike_sa);
-
-		if (name == NULL || streq(name, ike_sa->get_name(ike_sa)))
+		peer_host = host_create_from_string(msg->status.peer, 0);
+		if (!peer_host)
 		{
-			log_ike_sa(out, ike_sa, all);
-			found = TRUE;
-			ike_printed = TRUE;
+			peer_id = identification_create_from_string(msg->status.peer);
 		}
-
-		while (children->enumerate(children, (void**)&child_sa))
+	}
+	/* the IKE_SA manager keeps summaries from the last check-in of each
+	 * IKE_SA, so IKE_SAs in use by other threads are listed too. To avoid
+	 * the overhead, summaries get created only once a status got requested */
+	charon->ike_sa_manager->set_summarizer(charon->ike_sa_manager,
+										   &this->summarizer);
+	enumerator = charon->ike_sa_manager->create_summary_enumerator(
+													charon->ike_sa_manager);
+	while (enumerator->enumerate(enumerator, &summary))
+	{
+		if (!summary)
 		{
-			if (name == NULL || streq(name, child_sa->get_name(child_sa)))
+			busy++;
+			continue;
+		}
+		if (!more && summary_matches(summary, msg, peer_host, peer_id))
+		{
+			if (skipped < msg->status.offset)
 			{
-				if (!ike_printed)
-				{
-					log_ike_sa(out, ike_sa, all);
-					found = TRUE;
-					ike_printed = TRUE;
-				}
-				log_child_sa(out, child_sa, all);
+				skipped++;
+			}
+			else if (msg->status.limit > 0 && shown == msg->status.limit)
+			{
+				more = TRUE;
+			}
+			else
+			{
+				log_summary(out, summary, name, all);
+				shown++;
 			}
 		}
-		children->destroy(children);
+		summary_release(&this->summarizer, summary);
+		if (ferror(out))
+		{
+			break;
+		}
 	}
 	enumerator->destroy(enumerator);
+	if (more)
+	{
+		fprintf(out, "  more IKE_SAs available, continue with offset=%d\n",
+				skipped + shown);
+	}
+	if (wait && busy)
+	{
+		fprintf(out, "  %d IKE_SA%s in use, not listed\n", busy,
+				busy == 1 ? "" : "s");
+	}
+	DESTROY_IF(peer_host);
+	DESTROY_IF(peer_id);
 
-	if (!found)
+	if (!shown)
 	{
-		if (name)
+		if (name || msg->status.peer || msg->status.state || skipped)
 		{
 			fprintf(out, "  no match\n");
 		}
@@ -1528,6 +1978,10 @@ METHOD(stroke_list_t, leases, void,
 METHOD(stroke_list_t, destroy, void,
 	private_stroke_list_t *this)
 {
+	if (charon->ike_sa_manager)
+	{
+		charon->ike_sa_manager->set_summarizer(charon->ike_sa_manager, NULL);
+	}
 	free(this);
 }
 
@@ -1548,6 +2002,11 @@ stroke_list_t *stroke_list_create(stroke_attribute_t *attribute)
 		.uptime = time_monotonic(NULL),
 		.swan = "strong",
 		.attribute = attribute,
+		.summarizer = {
+			.summarize = summarize,
+			.get_ref = (void*)summary_get_ref,
+			.release = (void*)summary_release,
+		},
 	);
 
 	if (lib->settings->get_bool(lib->settings,
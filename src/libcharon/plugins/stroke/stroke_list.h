@@ -47,7 +47,7 @@ struct stroke_list_t {
 	 * @param msg		stroke message
 	 * @param out		stroke console stream
 	 * @param all		TRUE for "statusall"
-	 * @param wait		TRUE to wait for IKE_SA entries, FALSE to skip if locked
+	 * @param wait		TRUE to report IKE_SAs in use, FALSE to skip silently
 	 */
 	void (*status)(stroke_list_t *this, stroke_msg_t *msg, FILE *out,
 				   bool all, bool wait);
@@ -26,6 +26,7 @@
 
 #include <hydra.h>
 #include <daemon.h>
+#include <threading/lock_profiler.h>
 
 #include "stroke_config.h"
 #include "stroke_control.h"
@@ -173,7 +174,7 @@ static void pop_end(stroke_msg_t *msg, const char* label, stroke_end_t *end)
 /**
  * Add a connection to the configuration list
  */
-static void stroke_add_conn(private_stroke_socket_t *this, stroke_msg_t *msg)
+static bool stroke_add_conn(private_stroke_socket_t *this, stroke_msg_t *msg)
 {
 	pop_string(msg, &msg->add_conn.name);
 	DBG1(DBG_CFG, "received stroke: add connection '%s'", msg->add_conn.name);
@@ -204,9 +205,13 @@ static void stroke_add_conn(private_stroke_socket_t *this, stroke_msg_t *msg)
 	DBG2(DBG_CFG, "  me_peerid=%s", msg->add_conn.ikeme.peerid);
 	DBG2(DBG_CFG, "  keyexchange=ikev%u", msg->add_conn.version);
 
-	this->config->add(this->config, msg);
+	if (!this->config->add(this->config, msg))
+	{
+		return FALSE;
+	}
 	this->attribute->add_dns(this->attribute, msg);
 	this->handler->add_attributes(this->handler, msg);
+	return TRUE;
 }
 
 /**
@@ -294,7 +299,7 @@ static void stroke_unroute(private_stroke_socket_t *this, stroke_msg_t *msg, FIL
 /**
  * Add a ca information record to the cainfo list
  */
-static void stroke_add_ca(private_stroke_socket_t *this,
+static bool stroke_add_ca(private_stroke_socket_t *this,
 						  stroke_msg_t *msg, FILE *out)
 {
 	pop_string(msg, &msg->add_ca.name);
@@ -314,7 +319,7 @@ static void stroke_add_ca(private_stroke_socket_t *this,
 	DBG2(DBG_CFG, "  ocspuri2=%s",    msg->add_ca.ocspuri2);
 	DBG2(DBG_CFG, "  certuribase=%s", msg->add_ca.certuribase);
 
-	this->ca->add(this->ca, msg);
+	return this->ca->add(this->ca, msg);
 }
 
 /**
@@ -337,6 +342,8 @@ static void stroke_status(private_stroke_socket_t *this,
 						  stroke_msg_t *msg, FILE *out, bool all, bool wait)
 {
 	pop_string(msg, &(msg->status.name));
+	pop_string(msg, &(msg->status.peer));
+	pop_string(msg, &(msg->status.state));
 
 	this->list->status(this->list, msg, out, all, wait);
 }
@@ -499,6 +506,12 @@ static void stroke_memusage(private_stroke_socket_t *this,
 	{
 		lib->leak_detective->usage(lib->leak_detective, out);
 	}
+	if (lib->heap_profiler)
+	{
+		lib->heap_profiler->print(lib->heap_profiler, out,
+					lib->settings->get_bool(lib->settings,
+						"libstrongswan.heap_profiler.detailed", FALSE));
+	}
 }
 
 /**
@@ -534,6 +547,32 @@ static void stroke_counters(private_stroke_socket_t *this,
 	}
 }
 
+/**
+ * Control the lock profiler and print its statistics
+ */
+static void stroke_locks(private_stroke_socket_t *this,
+						 stroke_msg_t *msg, FILE *out)
+{
+	switch (msg->locks.flags)
+	{
+		case LOCK_ENABLE:
+			lock_profiler_enable(TRUE);
+			fprintf(out, "lock profiler enabled\n");
+			break;
+		case LOCK_DISABLE:
+			lock_profiler_enable(FALSE);
+			fprintf(out, "lock profiler disabled\n");
+			break;
+		case LOCK_RESET:
+			lock_profiler_reset();
+			break;
+		case LOCK_LIST:
+		default:
+			lock_profiler_print(out);
+			break;
+	}
+}
+
 /**
  * set the verbosity debug output
  */
@@ -572,13 +611,12 @@ static void stroke_config(private_stroke_socket_t *this,
 }
 
 /**
- * process a stroke request
+ * Read a stroke message from a stream
  */
-static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
+static stroke_msg_t *read_msg(stream_t *stream)
 {
 	stroke_msg_t *msg;
 	u_int16_t len;
-	FILE *out;
 
 	/* read length */
 	if (!stream->read_all(stream, &len, sizeof(len)))
@@ -588,7 +626,12 @@ static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
 			DBG1(DBG_CFG, "reading length of stroke message failed: %s",
 				 strerror(errno));
 		}
-		return FALSE;
+		return NULL;
+	}
+	if (len < offsetof(stroke_msg_t, buffer))
+	{
+		DBG1(DBG_CFG, "invalid stroke message length %u", len);
+		return NULL;
 	}
 
 	/* read message */
@@ -601,18 +644,101 @@ static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
 			DBG1(DBG_CFG, "reading stroke message failed: %s", strerror(errno));
 		}
 		free(msg);
-		return FALSE;
+		return NULL;
 	}
 
 	DBG3(DBG_CFG, "stroke message %b", (void*)msg, len);
+	return msg;
+}
 
-	out = stream->get_file(stream);
-	if (!out)
+static void process_msg(private_stroke_socket_t *this, stroke_msg_t *msg,
+						stream_t *stream, FILE *out);
+
+/**
+ * Process a bulk of stroke messages following on the stream.
+ *
+ * All messages get read before processing them, so the batch does not block
+ * other configuration changes while waiting for the client, and the client
+ * does not have to read our output before it sent the complete bulk.
+ *
+ * Connections and CAs get added and deleted in a single configuration batch,
+ * which gets interrupted for other messages, such as route or initiate.
+ */
+static void stroke_bulk(private_stroke_socket_t *this, stroke_msg_t *msg,
+						stream_t *stream, FILE *out)
+{
+	linked_list_t *items;
+	stroke_msg_t *item;
+	int i, failed = 0;
+
+	DBG1(DBG_CFG, "received stroke: bulk of %d messages", msg->bulk.count);
+
+	items = linked_list_create();
+	for (i = 0; i < msg->bulk.count; i++)
 	{
-		DBG1(DBG_CFG, "creating stroke output stream failed");
-		free(msg);
-		return FALSE;
+		item = read_msg(stream);
+		if (!item)
+		{
+			fprintf(out, "reading bulk message %d of %d failed\n",
+					i + 1, msg->bulk.count);
+			failed += msg->bulk.count - i;
+			break;
+		}
+		items->insert_last(items, item);
 	}
+
+	this->config->begin_batch(this->config);
+	while (items->remove_first(items, (void**)&item) == SUCCESS)
+	{
+		switch (item->type)
+		{
+			case STR_ADD_CONN:
+				if (!stroke_add_conn(this, item))
+				{
+					fprintf(out, "adding connection '%s' failed\n",
+							item->add_conn.name);
+					failed++;
+				}
+				break;
+			case STR_ADD_CA:
+				if (!stroke_add_ca(this, item, out))
+				{
+					fprintf(out, "adding ca '%s' failed\n", item->add_ca.name);
+					failed++;
+				}
+				break;
+			case STR_DEL_CONN:
+				stroke_del_conn(this, item);
+				break;
+			case STR_DEL_CA:
+				stroke_del_ca(this, item, out);
+				break;
+			case STR_BULK:
+				DBG1(DBG_CFG, "ignoring nested bulk stroke message");
+				failed++;
+				break;
+			default:
+				/* make configs visible for route, initiate etc. */
+				this->config->end_batch(this->config);
+				process_msg(this, item, stream, out);
+				this->config->begin_batch(this->config);
+				break;
+		}
+		free(item);
+	}
+	this->config->end_batch(this->config);
+	items->destroy(items);
+
+	DBG1(DBG_CFG, "processed bulk of %d stroke messages, %d failed",
+		 msg->bulk.count, failed);
+}
+
+/**
+ * Process a single stroke message
+ */
+static void process_msg(private_stroke_socket_t *this, stroke_msg_t *msg,
+						stream_t *stream, FILE *out)
+{
 	switch (msg->type)
 	{
 		case STR_INITIATE:
@@ -643,13 +769,20 @@ static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
 			stroke_status(this, msg, out, TRUE, FALSE);
 			break;
 		case STR_ADD_CONN:
-			stroke_add_conn(this, msg);
+			if (!stroke_add_conn(this, msg))
+			{
+				fprintf(out, "adding connection '%s' failed\n",
+						msg->add_conn.name);
+			}
 			break;
 		case STR_DEL_CONN:
 			stroke_del_conn(this, msg);
 			break;
 		case STR_ADD_CA:
-			stroke_add_ca(this, msg, out);
+			if (!stroke_add_ca(this, msg, out))
+			{
+				fprintf(out, "adding ca '%s' failed\n", msg->add_ca.name);
+			}
 			break;
 		case STR_DEL_CA:
 			stroke_del_ca(this, msg, out);
@@ -684,10 +817,40 @@ static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
 		case STR_COUNTERS:
 			stroke_counters(this, msg, out);
 			break;
+		case STR_LOCKS:
+			stroke_locks(this, msg, out);
+			break;
+		case STR_BULK:
+			stroke_bulk(this, msg, stream, out);
+			break;
 		default:
 			DBG1(DBG_CFG, "received unknown stroke");
 			break;
 	}
+}
+
+/**
+ * process a stroke request
+ */
+static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
+{
+	stroke_msg_t *msg;
+	FILE *out;
+
+	msg = read_msg(stream);
+	if (!msg)
+	{
+		return FALSE;
+	}
+
+	out = stream->get_file(stream);
+	if (!out)
+	{
+		DBG1(DBG_CFG, "creating stroke output stream failed");
+		free(msg);
+		return FALSE;
+	}
+	process_msg(this, msg, stream, out);
 	free(msg);
 	fclose(out);
 	return FALSE;
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "updown_helper.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#include <daemon.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <threading/thread.h>
+
+/**
+ * Timeout for writes to the helper, in s
+ */
+#define WRITE_TIMEOUT 5
+
+/**
+ * Time to wait for the helper to terminate, in ms
+ */
+#define STOP_TIMEOUT 1000
+
+/**
+ * Interval to check whether the helper terminated, in ms
+ */
+#define STOP_INTERVAL 50
+
+typedef struct private_updown_helper_t private_updown_helper_t;
+
+/**
+ * Private data of an updown_helper_t object.
+ */
+struct private_updown_helper_t {
+
+	/**
+	 * Public updown_helper_t interface.
+	 */
+	updown_helper_t public;
+
+	/**
+	 * Path to helper executable
+	 */
+	char *path;
+
+	/**
+	 * PID of helper process, 0 if not running
+	 */
+	pid_t pid;
+
+	/**
+	 * Socket connected to stdin of helper, -1 if not running
+	 */
+	int fd;
+
+	/**
+	 * Queued events, as event_t
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * Maximum number of queued events
+	 */
+	u_int max;
+
+	/**
+	 * Mutex to lock queue
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Condvar to signal queue changes and written events
+	 */
+	condvar_t *condvar;
+
+	/**
+	 * Whether a thread is currently writing a batch of events
+	 */
+	bool writing;
+};
+
+/**
+ * An event queued by a sending thread
+ */
+typedef struct {
+	/** KEY=value lines of the event */
+	chunk_t data;
+	/** set once the batch containing the event has been handled */
+	bool done;
+	/** whether the event has been written successfully */
+	bool written;
+} event_t;
+
+/**
+ * Wait for a terminating helper, returns TRUE if it has been reaped
+ */
+static bool reap_helper(private_updown_helper_t *this)
+{
+	int i;
+
+	for (i = 0; i < STOP_TIMEOUT / STOP_INTERVAL; i++)
+	{
+		if (waitpid(this->pid, NULL, WNOHANG) != 0)
+		{
+			return TRUE;
+		}
+		usleep(STOP_INTERVAL * 1000);
+	}
+	return FALSE;
+}
+
+/**
+ * Terminate a running helper process
+ */
+static void stop_helper(private_updown_helper_t *this)
+{
+	if (this->fd != -1)
+	{
+		close(this->fd);
+		this->fd = -1;
+	}
+	if (this->pid)
+	{
+		/* the helper terminates if its stdin gets closed */
+		if (!reap_helper(this))
+		{
+			DBG1(DBG_CHD, "updown helper (PID %d) does not terminate, "
+				 "killing it", this->pid);
+			kill(this->pid, SIGTERM);
+			if (!reap_helper(this))
+			{
+				kill(this->pid, SIGKILL);
+				waitpid(this->pid, NULL, 0);
+			}
+		}
+		this->pid = 0;
+	}
+}
+
+/**
+ * Start the helper process, with a socket connected to its stdin
+ */
+static bool start_helper(private_updown_helper_t *this)
+{
+	char *argv[] = { this->path, NULL };
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+	{
+		DBG1(DBG_CHD, "creating updown helper socket failed: %s",
+			 strerror(errno));
+		return FALSE;
+	}
+	this->pid = fork();
+	switch (this->pid)
+	{
+		case -1:
+			DBG1(DBG_CHD, "forking updown helper failed: %s", strerror(errno));
+			this->pid = 0;
+			close(fds[0]);
+			close(fds[1]);
+			return FALSE;
+		case 0:
+			/* child, async-signal-safe functions only */
+			close(fds[0]);
+			if (dup2(fds[1], 0) == -1)
+			{
+				_exit(1);
+			}
+			close(fds[1]);
+			execv(this->path, argv);
+			_exit(1);
+		default:
+			close(fds[1]);
+			this->fd = fds[0];
+			{	/* don't block senders forever on a stuck helper */
+				struct timeval tv = {
+					.tv_sec = WRITE_TIMEOUT,
+				};
+
+				setsockopt(this->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+			}
+			DBG1(DBG_CHD, "started updown helper '%s' (PID %d)",
+				 this->path, this->pid);
+			return TRUE;
+	}
+}
+
+/**
+ * Write a buffer completely to the helper
+ */
+static bool write_all(private_updown_helper_t *this, chunk_t data)
+{
+	ssize_t len;
+
+	while (data.len)
+	{
+		len = send(this->fd, data.ptr, data.len, MSG_NOSIGNAL);
+		if (len < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			DBG1(DBG_CHD, "writing to updown helper failed: %s",
+				 strerror(errno));
+			return FALSE;
+		}
+		data = chunk_skip(data, len);
+	}
+	return TRUE;
+}
+
+/**
+ * Write a batch of events to the helper, restarting it once if it failed
+ */
+static bool write_batch(private_updown_helper_t *this, linked_list_t *events)
+{
+	enumerator_t *enumerator;
+	chunk_t batch = chunk_empty;
+	event_t *event;
+	bool success = TRUE;
+
+	enumerator = events->create_enumerator(events);
+	while (enumerator->enumerate(enumerator, &event))
+	{
+		batch = chunk_cat("mc", batch, event->data);
+	}
+	enumerator->destroy(enumerator);
+
+	if (this->fd == -1 && !start_helper(this))
+	{
+		success = FALSE;
+	}
+	else if (!write_all(this, batch))
+	{	/* restart the helper and retry once */
+		stop_helper(this);
+		if (!start_helper(this) || !write_all(this, batch))
+		{
+			stop_helper(this);
+			success = FALSE;
+		}
+	}
+	if (!success)
+	{
+		DBG1(DBG_CHD, "writing %d updown events to helper failed",
+			 events->get_count(events));
+	}
+	free(batch.ptr);
+	return success;
+}
+
+METHOD(updown_helper_t, send_, bool,
+	private_updown_helper_t *this, char *script, linked_list_t *envp)
+{
+	enumerator_t *enumerator;
+	linked_list_t *batch;
+	event_t event = { .done = FALSE, }, *current;
+	bool oldstate, written;
+	char *var;
+
+	event.data = chunk_cat("ccc", chunk_from_str("UPDOWN_SCRIPT="),
+						   chunk_from_str(script), chunk_from_chars('\n'));
+	enumerator = envp->create_enumerator(envp);
+	while (enumerator->enumerate(enumerator, &var))
+	{
+		event.data = chunk_cat("mcc", event.data, chunk_from_str(var),
+							   chunk_from_chars('\n'));
+	}
+	enumerator->destroy(enumerator);
+	/* terminate event with an empty line */
+	event.data = chunk_cat("mc", event.data, chunk_from_chars('\n'));
+
+	/* the event lives on our stack until written, so don't get cancelled */
+	oldstate = thread_cancelability(FALSE);
+	this->mutex->lock(this->mutex);
+	while (this->queue->get_count(this->queue) >= this->max)
+	{	/* apply backpressure if the helper can't keep up */
+		this->condvar->wait(this->condvar, this->mutex);
+	}
+	this->queue->insert_last(this->queue, &event);
+	while (!event.done)
+	{
+		if (this->writing)
+		{	/* our event gets written with the next batch */
+			this->condvar->wait(this->condvar, this->mutex);
+			continue;
+		}
+		/* write all queued events, including those of other threads */
+		this->writing = TRUE;
+		batch = this->queue;
+		this->queue = linked_list_create();
+		this->condvar->broadcast(this->condvar);
+		this->mutex->unlock(this->mutex);
+
+		written = write_batch(this, batch);
+
+		this->mutex->lock(this->mutex);
+		while (batch->remove_first(batch, (void**)&current) == SUCCESS)
+		{
+			current->written = written;
+			current->done = TRUE;
+		}
+		batch->destroy(batch);
+		this->writing = FALSE;
+		this->condvar->broadcast(this->condvar);
+	}
+	this->mutex->unlock(this->mutex);
+	thread_cancelability(oldstate);
+
+	free(event.data.ptr);
+	return event.written;
+}
+
+METHOD(updown_helper_t, destroy, void,
+	private_updown_helper_t *this)
+{
+	stop_helper(this);
+	this->queue->destroy(this->queue);
+	this->condvar->destroy(this->condvar);
+	this->mutex->destroy(this->mutex);
+	free(this->path);
+	free(this);
+}
+
+/**
+ * See header
+ */
+updown_helper_t *updown_helper_create(char *path, u_int queue)
+{
+	private_updown_helper_t *this;
+
+	INIT(this,
+		.public = {
+			.send = _send_,
+			.destroy = _destroy,
+		},
+		.path = strdup(path),
+		.fd = -1,
+		.max = max(queue, 1),
+		.queue = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+	);
+
+	if (!start_helper(this))
+	{
+		destroy(this);
+		return NULL;
+	}
+	return &this->public;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup updown_helper updown_helper
+ * @{ @ingroup updown
+ */
+
+#ifndef UPDOWN_HELPER_H_
+#define UPDOWN_HELPER_H_
+
+#include <collections/linked_list.h>
+
+typedef struct updown_helper_t updown_helper_t;
+
+/**
+ * Long-running updown helper process receiving events over a socket.
+ *
+ * Instead of invoking the updown script for each event, events get streamed
+ * to a helper process connected to its stdin. Each event consists of
+ * KEY=value lines, the first one being UPDOWN_SCRIPT containing the
+ * configured updown script. An empty line terminates the event.
+ *
+ * Events are written in batches: the sending thread that finds no write in
+ * progress writes all queued events at once, while other senders wait for
+ * the batch containing their event. If the queue is full, sending blocks
+ * until the helper catches up. A helper that went away gets restarted.
+ */
+struct updown_helper_t {
+
+	/**
+	 * Send an event to the helper, wait until it has been written.
+	 *
+	 * @param script		configured updown script
+	 * @param envp			list of KEY=value variables, as char*
+	 * @return				TRUE if written, FALSE if the helper failed and
+	 *						the event has been dropped
+	 */
+	bool (*send)(updown_helper_t *this, char *script, linked_list_t *envp);
+
+	/**
+	 * Destroy a updown_helper_t, terminates the helper process.
+	 */
+	void (*destroy)(updown_helper_t *this);
+};
+
+/**
+ * Create a updown_helper instance.
+ *
+ * @param path			path to the helper executable
+ * @param queue			maximum number of queued events
+ * @return				helper, NULL if starting the helper failed
+ */
+updown_helper_t *updown_helper_create(char *path, u_int queue);
+
+#endif /** UPDOWN_HELPER_H_ @}*/
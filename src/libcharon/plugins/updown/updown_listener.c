@@ -43,6 +43,11 @@ struct private_updown_listener_t {
 	 * DNS attribute handler
 	 */
 	updown_handler_t *handler;
+
+	/**
+	 * Helper process to stream events to, if any
+	 */
+	updown_helper_t *helper;
 };
 
 typedef struct cache_entry_t cache_entry_t;
@@ -95,19 +100,35 @@ static char* uncache_iface(private_updown_listener_t *this, u_int32_t reqid)
 	return iface;
 }
 
+/**
+ * Add a KEY=value variable to the list of variables
+ */
+static void push_env(linked_list_t *envp, char *fmt, ...)
+{
+	va_list args;
+	char *var;
+
+	va_start(args, fmt);
+	if (vasprintf(&var, fmt, args) >= 0)
+	{
+		envp->insert_last(envp, var);
+	}
+	va_end(args);
+}
+
 /**
  * Create variables for handled DNS attributes
  */
-static char *make_dns_vars(private_updown_listener_t *this, ike_sa_t *ike_sa)
+static void make_dns_vars(private_updown_listener_t *this, ike_sa_t *ike_sa,
+						  linked_list_t *envp)
 {
 	enumerator_t *enumerator;
 	host_t *host;
 	int v4 = 0, v6 = 0;
-	char total[512] = "", current[64];
 
 	if (!this->handler)
 	{
-		return strdup("");
+		return;
 	}
 
 	enumerator = this->handler->create_dns_enumerator(this->handler,
@@ -117,32 +138,27 @@ static char *make_dns_vars(private_updown_listener_t *this, ike_sa_t *ike_sa)
 		switch (host->get_family(host))
 		{
 			case AF_INET:
-				snprintf(current, sizeof(current),
-						 "PLUTO_DNS4_%d='%H' ", ++v4, host);
+				push_env(envp, "PLUTO_DNS4_%d=%H", ++v4, host);
 				break;
 			case AF_INET6:
-				snprintf(current, sizeof(current),
-						 "PLUTO_DNS6_%d='%H' ", ++v6, host);
+				push_env(envp, "PLUTO_DNS6_%d=%H", ++v6, host);
 				break;
 			default:
 				continue;
 		}
-		strncat(total, current, sizeof(total) - strlen(total) - 1);
 	}
 	enumerator->destroy(enumerator);
-
-	return strdup(total);
 }
 
 /**
  * Create variables for local virtual IPs
  */
-static char *make_vip_vars(private_updown_listener_t *this, ike_sa_t *ike_sa)
+static void make_vip_vars(private_updown_listener_t *this, ike_sa_t *ike_sa,
+						  linked_list_t *envp)
 {
 	enumerator_t *enumerator;
 	host_t *host;
 	int v4 = 0, v6 = 0;
-	char total[512] = "", current[64];
 	bool first = TRUE;
 
 	enumerator = ike_sa->create_virtual_ip_enumerator(ike_sa, TRUE);
@@ -150,28 +166,22 @@ static char *make_vip_vars(private_updown_listener_t *this, ike_sa_t *ike_sa)
 	{
 		if (first)
 		{	/* legacy variable for first VIP */
-			snprintf(current, sizeof(current),
-						 "PLUTO_MY_SOURCEIP='%H' ", host);
-			strncat(total, current, sizeof(total) - strlen(total) - 1);
+			first = FALSE;
+			push_env(envp, "PLUTO_MY_SOURCEIP=%H", host);
 		}
 		switch (host->get_family(host))
 		{
 			case AF_INET:
-				snprintf(current, sizeof(current),
-						 "PLUTO_MY_SOURCEIP4_%d='%H' ", ++v4, host);
+				push_env(envp, "PLUTO_MY_SOURCEIP4_%d=%H", ++v4, host);
 				break;
 			case AF_INET6:
-				snprintf(current, sizeof(current),
-						 "PLUTO_MY_SOURCEIP6_%d='%H' ", ++v6, host);
+				push_env(envp, "PLUTO_MY_SOURCEIP6_%d=%H", ++v6, host);
 				break;
 			default:
 				continue;
 		}
-		strncat(total, current, sizeof(total) - strlen(total) - 1);
 	}
 	enumerator->destroy(enumerator);
-
-	return strdup(total);
 }
 
 /**
@@ -195,6 +205,66 @@ static u_int16_t get_port(traffic_selector_t *me,
 	return local ? me->get_from_port(me) : other->get_from_port(other);
 }
 
+/**
+ * Invoke the updown script with the given variables using the shell
+ */
+static void invoke_script(char *script, linked_list_t *envp)
+{
+	enumerator_t *enumerator;
+	char command[1024], *var, *value;
+	int len, pos = 0;
+	FILE *shell;
+
+	/* build the command with all env variables */
+	pos = snprintf(command, sizeof(command), "2>&1 ");
+	enumerator = envp->create_enumerator(envp);
+	while (enumerator->enumerate(enumerator, &var) && pos < sizeof(command))
+	{
+		value = strchr(var, '=');
+		len = snprintf(command + pos, sizeof(command) - pos, "%.*s='%s' ",
+					   (int)(value - var), var, value + 1);
+		pos += len;
+	}
+	enumerator->destroy(enumerator);
+	if (pos < sizeof(command))
+	{
+		snprintf(command + pos, sizeof(command) - pos, "%s", script);
+	}
+
+	DBG3(DBG_CHD, "running updown script: %s", command);
+	shell = popen(command, "r");
+
+	if (shell == NULL)
+	{
+		DBG1(DBG_CHD, "could not execute updown script '%s'", script);
+		return;
+	}
+
+	while (TRUE)
+	{
+		char resp[128];
+
+		if (fgets(resp, sizeof(resp), shell) == NULL)
+		{
+			if (ferror(shell))
+			{
+				DBG1(DBG_CHD, "error reading output from updown script");
+			}
+			break;
+		}
+		else
+		{
+			char *e = resp + strlen(resp);
+			if (e > resp && e[-1] == '\n')
+			{	/* trim trailing '\n' */
+				e[-1] = '\0';
+			}
+			DBG1(DBG_CHD, "updown: %s", resp);
+		}
+	}
+	pclose(shell);
+}
+
 METHOD(listener_t, child_updown, bool,
 	private_updown_listener_t *this, ike_sa_t *ike_sa, child_sa_t *child_sa,
 	bool up)
@@ -218,91 +288,16 @@ METHOD(listener_t, child_updown, bool,
 	enumerator = child_sa->create_policy_enumerator(child_sa);
 	while (enumerator->enumerate(enumerator, &my_ts, &other_ts))
 	{
-		char command[1024];
 		host_t *my_client, *other_client;
 		u_int8_t my_client_mask, other_client_mask;
-		char *virtual_ip, *iface, *mark_in, *mark_out, *udp_enc, *dns, *xauth;
+		linked_list_t *envp;
+		char *iface;
 		mark_t mark;
 		bool is_host, is_ipv6;
-		FILE *shell;
 
 		my_ts->to_subnet(my_ts, &my_client, &my_client_mask);
 		other_ts->to_subnet(other_ts, &other_client, &other_client_mask);
 
-		virtual_ip = make_vip_vars(this, ike_sa);
-
-		/* check for the presence of an inbound mark */
-		mark = config->get_mark(config, TRUE);
-		if (mark.value)
-		{
-			if (asprintf(&mark_in, "PLUTO_MARK_IN='%u/0x%08x' ",
-						 mark.value, mark.mask ) < 0)
-			{
-				mark_in = NULL;
-			}
-		}
-		else
-		{
-			if (asprintf(&mark_in, "") < 0)
-			{
-				mark_in = NULL;
-			}
-		}
-
-		/* check for the presence of an outbound mark */
-		mark = config->get_mark(config, FALSE);
-		if (mark.value)
-		{
-			if (asprintf(&mark_out, "PLUTO_MARK_OUT='%u/0x%08x' ",
-						 mark.value, mark.mask ) < 0)
-			{
-				mark_out = NULL;
-			}
-		}
-		else
-		{
-			if (asprintf(&mark_out, "") < 0)
-			{
-				mark_out = NULL;
-			}
-		}
-
-		/* check for a NAT condition causing ESP_IN_UDP encapsulation */
-		if (ike_sa->has_condition(ike_sa, COND_NAT_ANY))
-		{
-			if (asprintf(&udp_enc, "PLUTO_UDP_ENC='%u' ",
-						 other->get_port(other)) < 0)
-			{
-				udp_enc = NULL;
-			}
-
-		}
-		else
-		{
-			if (asprintf(&udp_enc, "") < 0)
-			{
-				udp_enc = NULL;
-			}
-
-		}
-
-		if (ike_sa->has_condition(ike_sa, COND_EAP_AUTHENTICATED) ||
-			ike_sa->has_condition(ike_sa, COND_XAUTH_AUTHENTICATED))
-		{
-			if (asprintf(&xauth, "PLUTO_XAUTH_ID='%Y' ",
-						 ike_sa->get_other_eap_id(ike_sa)) < 0)
-			{
-				xauth = NULL;
-			}
-		}
-		else
-		{
-			if (asprintf(&xauth, "") < 0)
-			{
-				xauth = NULL;
-			}
-		}
-
 		if (up)
 		{
 			if (hydra->kernel_interface->get_interface(hydra->kernel_interface,
@@ -320,108 +315,74 @@ METHOD(listener_t, child_updown, bool,
 			iface = uncache_iface(this, child_sa->get_reqid(child_sa));
 		}
 
-		dns = make_dns_vars(this, ike_sa);
-
 		/* determine IPv4/IPv6 and client/host situation */
 		is_host = my_ts->is_host(my_ts, me);
 		is_ipv6 = is_host ? (me->get_family(me) == AF_INET6) :
 							(my_ts->get_type(my_ts) == TS_IPV6_ADDR_RANGE);
 
-		/* build the command with all env variables.
-		 */
-		snprintf(command, sizeof(command),
-				 "2>&1 "
-				"PLUTO_VERSION='1.1' "
-				"PLUTO_VERB='%s%s%s' "
-				"PLUTO_CONNECTION='%s' "
-				"PLUTO_INTERFACE='%s' "
-				"PLUTO_REQID='%u' "
-				"PLUTO_PROTO='%s' "
-				"PLUTO_UNIQUEID='%u' "
-				"PLUTO_ME='%H' "
-				"PLUTO_MY_ID='%Y' "
-				"PLUTO_MY_CLIENT='%H/%u' "
-				"PLUTO_MY_PORT='%u' "
-				"PLUTO_MY_PROTOCOL='%u' "
-				"PLUTO_PEER='%H' "
-				"PLUTO_PEER_ID='%Y' "
-				"PLUTO_PEER_CLIENT='%H/%u' "
-				"PLUTO_PEER_PORT='%u' "
-				"PLUTO_PEER_PROTOCOL='%u' "
-				"%s"
-				"%s"
-				"%s"
-				"%s"
-				"%s"
-				"%s"
-				"%s"
-				"%s",
+		envp = linked_list_create();
+		push_env(envp, "PLUTO_VERSION=1.1");
+		push_env(envp, "PLUTO_VERB=%s%s%s",
 				 up ? "up" : "down",
 				 is_host ? "-host" : "-client",
-				 is_ipv6 ? "-v6" : "",
-				 config->get_name(config),
-				 iface ? iface : "unknown",
-				 child_sa->get_reqid(child_sa),
-				 child_sa->get_protocol(child_sa) == PROTO_ESP ? "esp" : "ah",
-				 ike_sa->get_unique_id(ike_sa),
-				 me, ike_sa->get_my_id(ike_sa),
-				 my_client, my_client_mask,
-				 get_port(my_ts, other_ts, TRUE),
-				 my_ts->get_protocol(my_ts),
-				 other, ike_sa->get_other_id(ike_sa),
-				 other_client, other_client_mask,
-				 get_port(my_ts, other_ts, FALSE),
-				 other_ts->get_protocol(other_ts),
-				 xauth,
-				 virtual_ip,
-				 mark_in,
-				 mark_out,
-				 udp_enc,
-				 config->get_hostaccess(config) ? "PLUTO_HOST_ACCESS='1' " : "",
-				 dns,
-				 script);
+				 is_ipv6 ? "-v6" : "");
+		push_env(envp, "PLUTO_CONNECTION=%s", config->get_name(config));
+		push_env(envp, "PLUTO_INTERFACE=%s", iface ? iface : "unknown");
+		push_env(envp, "PLUTO_REQID=%u", child_sa->get_reqid(child_sa));
+		push_env(envp, "PLUTO_PROTO=%s",
+				 child_sa->get_protocol(child_sa) == PROTO_ESP ? "esp" : "ah");
+		push_env(envp, "PLUTO_UNIQUEID=%u", ike_sa->get_unique_id(ike_sa));
+		push_env(envp, "PLUTO_ME=%H", me);
+		push_env(envp, "PLUTO_MY_ID=%Y", ike_sa->get_my_id(ike_sa));
+		push_env(envp, "PLUTO_MY_CLIENT=%H/%u", my_client, my_client_mask);
+		push_env(envp, "PLUTO_MY_PORT=%u", get_port(my_ts, other_ts, TRUE));
+		push_env(envp, "PLUTO_MY_PROTOCOL=%u", my_ts->get_protocol(my_ts));
+		push_env(envp, "PLUTO_PEER=%H", other);
+		push_env(envp, "PLUTO_PEER_ID=%Y", ike_sa->get_other_id(ike_sa));
+		push_env(envp, "PLUTO_PEER_CLIENT=%H/%u",
+				 other_client, other_client_mask);
+		push_env(envp, "PLUTO_PEER_PORT=%u", get_port(my_ts, other_ts, FALSE));
+		push_env(envp, "PLUTO_PEER_PROTOCOL=%u",
+				 other_ts->get_protocol(other_ts));
+		if (ike_sa->has_condition(ike_sa, COND_EAP_AUTHENTICATED) ||
+			ike_sa->has_condition(ike_sa, COND_XAUTH_AUTHENTICATED))
+		{
+			push_env(envp, "PLUTO_XAUTH_ID=%Y",
+					 ike_sa->get_other_eap_id(ike_sa));
+		}
+		make_vip_vars(this, ike_sa, envp);
+		/* check for the presence of an inbound mark */
+		mark = config->get_mark(config, TRUE);
+		if (mark.value)
+		{
+			push_env(envp, "PLUTO_MARK_IN=%u/0x%08x", mark.value, mark.mask);
+		}
+		/* check for the presence of an outbound mark */
+		mark = config->get_mark(config, FALSE);
+		if (mark.value)
+		{
+			push_env(envp, "PLUTO_MARK_OUT=%u/0x%08x", mark.value, mark.mask);
+		}
+		/* check for a NAT condition causing ESP_IN_UDP encapsulation */
+		if (ike_sa->has_condition(ike_sa, COND_NAT_ANY))
+		{
+			push_env(envp, "PLUTO_UDP_ENC=%u", other->get_port(other));
+		}
+		if (config->get_hostaccess(config))
+		{
+			push_env(envp, "PLUTO_HOST_ACCESS=1");
+		}
+		make_dns_vars(this, ike_sa, envp);
+
 		my_client->destroy(my_client);
 		other_client->destroy(other_client);
-		free(virtual_ip);
-		free(mark_in);
-		free(mark_out);
-		free(udp_enc);
-		free(dns);
 		free(iface);
-		free(xauth);
-
-		DBG3(DBG_CHD, "running updown script: %s", command);
-		shell = popen(command, "r");
-
-		if (shell == NULL)
-		{
-			DBG1(DBG_CHD, "could not execute updown script '%s'", script);
-			return TRUE;
-		}
 
-		while (TRUE)
+		if (!this->helper || !this->helper->send(this->helper, script, envp))
 		{
-			char resp[128];
-
-			if (fgets(resp, sizeof(resp), shell) == NULL)
-			{
-				if (ferror(shell))
-				{
-					DBG1(DBG_CHD, "error reading output from updown script");
-				}
-				break;
-			}
-			else
-			{
-				char *e = resp + strlen(resp);
-				if (e > resp && e[-1] == '\n')
-				{	/* trim trailing '\n' */
-					e[-1] = '\0';
-				}
-				DBG1(DBG_CHD, "updown: %s", resp);
-			}
+			invoke_script(script, envp);
 		}
-		pclose(shell);
+		envp->destroy_function(envp, free);
 	}
 	enumerator->destroy(enumerator);
 	return TRUE;
@@ -437,7 +398,8 @@ METHOD(updown_listener_t, destroy, void,
 /**
  * See header
  */
-updown_listener_t *updown_listener_create(updown_handler_t *handler)
+updown_listener_t *updown_listener_create(updown_handler_t *handler,
+										  updown_helper_t *helper)
 {
 	private_updown_listener_t *this;
 
@@ -450,6 +412,7 @@ updown_listener_t *updown_listener_create(updown_handler_t *handler)
 		},
 		.iface_cache = linked_list_create(),
 		.handler = handler,
+		.helper = helper,
 	);
 
 	return &this->public;
@@ -24,6 +24,7 @@
 #include <bus/bus.h>
 
 #include "updown_handler.h"
+#include "updown_helper.h"
 
 typedef struct updown_listener_t updown_listener_t;
 
@@ -46,6 +47,7 @@ struct updown_listener_t {
 /**
  * Create a updown_listener instance.
  */
-updown_listener_t *updown_listener_create(updown_handler_t *handler);
+updown_listener_t *updown_listener_create(updown_handler_t *handler,
+										  updown_helper_t *helper);
 
 #endif /** UPDOWN_LISTENER_H_ @}*/
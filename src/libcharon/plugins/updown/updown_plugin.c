@@ -16,6 +16,7 @@
 #include "updown_plugin.h"
 #include "updown_listener.h"
 #include "updown_handler.h"
+#include "updown_helper.h"
 
 #include <daemon.h>
 #include <hydra.h>
@@ -41,6 +42,11 @@ struct private_updown_plugin_t {
 	 * Attribute handler, to pass DNS servers to updown
 	 */
 	updown_handler_t *handler;
+
+	/**
+	 * Optional helper process to stream updown events to
+	 */
+	updown_helper_t *helper;
 };
 
 METHOD(plugin_t, get_name, char*,
@@ -55,6 +61,8 @@ METHOD(plugin_t, get_name, char*,
 static bool plugin_cb(private_updown_plugin_t *this,
 					  plugin_feature_t *feature, bool reg, void *cb_data)
 {
+	char *helper;
+
 	if (reg)
 	{
 		if (lib->settings->get_bool(lib->settings,
@@ -64,13 +72,24 @@ static bool plugin_cb(private_updown_plugin_t *this,
 			hydra->attributes->add_handler(hydra->attributes,
 										   &this->handler->handler);
 		}
-		this->listener = updown_listener_create(this->handler);
+		helper = lib->settings->get_str(lib->settings,
+							"%s.plugins.updown.helper", NULL, charon->name);
+		if (helper)
+		{
+			this->helper = updown_helper_create(helper,
+							lib->settings->get_int(lib->settings,
+								"%s.plugins.updown.helper_queue", 256,
+								charon->name));
+		}
+		this->listener = updown_listener_create(this->handler, this->helper);
 		charon->bus->add_listener(charon->bus, &this->listener->listener);
 	}
 	else
 	{
 		charon->bus->remove_listener(charon->bus, &this->listener->listener);
 		this->listener->destroy(this->listener);
+		DESTROY_IF(this->helper);
+		this->helper = NULL;
 		if (this->handler)
 		{
 			this->handler->destroy(this->handler);
@@ -79,20 +79,12 @@ METHOD(job_t, execute, job_requeue_t,
 	}
 	if (ike_sa)
 	{
-		enumerator_t *children, *enumerator;
+		enumerator_t *enumerator;
 		child_sa_t *child_sa;
 		host_t *host;
 		linked_list_t *vips;
 
-		children = ike_sa->create_child_sa_enumerator(ike_sa);
-		while (children->enumerate(children, (void**)&child_sa))
-		{
-			if (child_sa->get_reqid(child_sa) == this->reqid)
-			{
-				break;
-			}
-		}
-		children->destroy(children);
+		child_sa = ike_sa->get_child_sa_by_reqid(ike_sa, this->reqid);
 		DBG2(DBG_JOB, "found CHILD_SA with reqid {%d}", this->reqid);
 
 		ike_sa->set_kmaddress(ike_sa, this->local, this->remote);
@@ -143,6 +143,7 @@ struct authenticator_t {
 	 *						- SUCCESS if authentication successful
 	 *						- FAILED if authentication failed
 	 *						- NEED_MORE if another exchange required
+	 *						- SUSPENDED to resume building a response later
 	 */
 	status_t (*build)(authenticator_t *this, message_t *message);
 
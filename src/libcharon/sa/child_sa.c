@@ -400,8 +400,11 @@ METHOD(enumerator_t, policy_destroy, void,
 	free(this);
 }
 
-METHOD(child_sa_t, create_policy_enumerator, enumerator_t*,
-	   private_child_sa_t *this)
+/**
+ * Create an enumerator over pairs of local and remote traffic selectors
+ */
+static enumerator_t *create_ts_pair_enumerator(array_t *my_ts,
+											   array_t *other_ts)
 {
 	policy_enumerator_t *e;
 
@@ -410,103 +413,64 @@ METHOD(child_sa_t, create_policy_enumerator, enumerator_t*,
 			.enumerate = (void*)_policy_enumerate,
 			.destroy = _policy_destroy,
 		},
-		.mine = array_create_enumerator(this->my_ts),
-		.other = array_create_enumerator(this->other_ts),
-		.array = this->other_ts,
+		.mine = array_create_enumerator(my_ts),
+		.other = array_create_enumerator(other_ts),
+		.array = other_ts,
 		.ts = NULL,
 	);
 
 	return &e->public;
 }
 
+METHOD(child_sa_t, create_policy_enumerator, enumerator_t*,
+	   private_child_sa_t *this)
+{
+	return create_ts_pair_enumerator(this->my_ts, this->other_ts);
+}
+
 /**
- * update the cached usebytes
- * returns SUCCESS if the usebytes have changed, FAILED if not or no SPIs
- * are available, and NOT_SUPPORTED if the kernel interface does not support
- * querying the usebytes.
+ * Query the number of bytes and packets processed by an SA, and its last use
  */
-static status_t update_usebytes(private_child_sa_t *this, bool inbound)
+static status_t query_usebytes(host_t *src, host_t *dst, protocol_id_t protocol,
+							   u_int32_t spi, mark_t mark, u_int64_t *bytes,
+							   u_int64_t *packets, time_t *time)
 {
-	status_t status = FAILED;
-	u_int64_t bytes, packets;
-	time_t time;
-
-	if (inbound)
-	{
-		if (this->my_spi)
-		{
-			status = hydra->kernel_interface->query_sa(hydra->kernel_interface,
-							this->other_addr, this->my_addr, this->my_spi,
-							proto_ike2ip(this->protocol), this->mark_in,
-							&bytes, &packets, &time);
-			if (status == SUCCESS)
-			{
-				if (bytes > this->my_usebytes)
-				{
-					this->my_usebytes = bytes;
-					this->my_usepackets = packets;
-					if (time)
-					{
-						this->my_usetime = time;
-					}
-					return SUCCESS;
-				}
-				return FAILED;
-			}
-		}
-	}
-	else
+	if (!spi)
 	{
-		if (this->other_spi)
-		{
-			status = hydra->kernel_interface->query_sa(hydra->kernel_interface,
-							this->my_addr, this->other_addr, this->other_spi,
-							proto_ike2ip(this->protocol), this->mark_out,
-							&bytes, &packets, &time);
-			if (status == SUCCESS)
-			{
-				if (bytes > this->other_usebytes)
-				{
-					this->other_usebytes = bytes;
-					this->other_usepackets = packets;
-					if (time)
-					{
-						this->other_usetime = time;
-					}
-					return SUCCESS;
-				}
-				return FAILED;
-			}
-		}
+		return FAILED;
 	}
-	return status;
+	return hydra->kernel_interface->query_sa(hydra->kernel_interface, src, dst,
+							spi, proto_ike2ip(protocol), mark, bytes, packets,
+							time);
 }
 
 /**
- * updates the cached usetime
+ * Query the last use of the policies between the given traffic selectors,
+ * returns 0 if unknown
  */
-static bool update_usetime(private_child_sa_t *this, bool inbound)
+static time_t query_usetime(array_t *my_ts, array_t *other_ts,
+							ipsec_mode_t mode, mark_t mark, bool inbound)
 {
 	enumerator_t *enumerator;
-	traffic_selector_t *my_ts, *other_ts;
+	traffic_selector_t *my, *other;
 	time_t last_use = 0;
 
-	enumerator = create_policy_enumerator(this);
-	while (enumerator->enumerate(enumerator, &my_ts, &other_ts))
+	enumerator = create_ts_pair_enumerator(my_ts, other_ts);
+	while (enumerator->enumerate(enumerator, &my, &other))
 	{
 		time_t in, out, fwd;
 
 		if (inbound)
 		{
 			if (hydra->kernel_interface->query_policy(hydra->kernel_interface,
-						other_ts, my_ts, POLICY_IN, this->mark_in, &in) == SUCCESS)
+						other, my, POLICY_IN, mark, &in) == SUCCESS)
 			{
 				last_use = max(last_use, in);
 			}
-			if (this->mode != MODE_TRANSPORT)
+			if (mode != MODE_TRANSPORT)
 			{
 				if (hydra->kernel_interface->query_policy(hydra->kernel_interface,
-						other_ts, my_ts, POLICY_FWD, this->mark_in, &fwd) == SUCCESS)
+						other, my, POLICY_FWD, mark, &fwd) == SUCCESS)
 				{
 					last_use = max(last_use, fwd);
 				}
@@ -515,14 +479,80 @@ static bool update_usetime(private_child_sa_t *this, bool inbound)
 		else
 		{
 			if (hydra->kernel_interface->query_policy(hydra->kernel_interface,
-						my_ts, other_ts, POLICY_OUT, this->mark_out, &out) == SUCCESS)
+						my, other, POLICY_OUT, mark, &out) == SUCCESS)
 			{
 				last_use = max(last_use, out);
 			}
 		}
 	}
 	enumerator->destroy(enumerator);
+	return last_use;
+}
+
+/**
+ * update the cached usebytes
+ * returns SUCCESS if the usebytes have changed, FAILED if not or no SPIs
+ * are available, and NOT_SUPPORTED if the kernel interface does not support
+ * querying the usebytes.
+ */
+static status_t update_usebytes(private_child_sa_t *this, bool inbound)
+{
+	status_t status;
+	u_int64_t bytes, packets;
+	time_t time;
+
+	if (inbound)
+	{
+		status = query_usebytes(this->other_addr, this->my_addr,
+								this->protocol, this->my_spi, this->mark_in,
+								&bytes, &packets, &time);
+		if (status == SUCCESS)
+		{
+			if (bytes > this->my_usebytes)
+			{
+				this->my_usebytes = bytes;
+				this->my_usepackets = packets;
+				if (time)
+				{
+					this->my_usetime = time;
+				}
+				return SUCCESS;
+			}
+			return FAILED;
+		}
+	}
+	else
+	{
+		status = query_usebytes(this->my_addr, this->other_addr,
+								this->protocol, this->other_spi, this->mark_out,
+								&bytes, &packets, &time);
+		if (status == SUCCESS)
+		{
+			if (bytes > this->other_usebytes)
+			{
+				this->other_usebytes = bytes;
+				this->other_usepackets = packets;
+				if (time)
+				{
+					this->other_usetime = time;
+				}
+				return SUCCESS;
+			}
+			return FAILED;
+		}
+	}
+	return status;
+}
+
+/**
+ * updates the cached usetime
+ */
+static bool update_usetime(private_child_sa_t *this, bool inbound)
+{
+	time_t last_use;
 
+	last_use = query_usetime(this->my_ts, this->other_ts, this->mode,
+							 inbound ? this->mark_in : this->mark_out, inbound);
 	if (last_use == 0)
 	{
 		return FALSE;
@@ -1217,3 +1247,37 @@ child_sa_t * child_sa_create(host_t *me, host_t* other,
 	}
 	return &this->public;
 }
+
+/**
+ * See header
+ */
+void child_sa_query_usestats(host_t *me, host_t *other, protocol_id_t protocol,
+							 u_int32_t spi, mark_t mark, ipsec_mode_t mode,
+							 array_t *my_ts, array_t *other_ts, bool inbound,
+							 time_t *time, u_int64_t *bytes, u_int64_t *packets)
+{
+	status_t status;
+	time_t use = 0;
+
+	if (inbound)
+	{
+		status = query_usebytes(other, me, protocol, spi, mark,
+								bytes, packets, &use);
+	}
+	else
+	{
+		status = query_usebytes(me, other, protocol, spi, mark,
+								bytes, packets, &use);
+	}
+	if (status != SUCCESS)
+	{
+		*bytes = *packets = 0;
+		use = 0;
+	}
+	/* prefer the policies' use time, as with get_usestats() */
+	*time = query_usetime(my_ts, other_ts, mode, mark, inbound);
+	if (!*time)
+	{
+		*time = use;
+	}
+}
@@ -31,6 +31,7 @@ typedef struct child_sa_t child_sa_t;
 #include <encoding/payloads/proposal_substructure.h>
 #include <config/proposal.h>
 #include <config/child_cfg.h>
+#include <collections/array.h>
 
 /**
  * States of a CHILD_SA
@@ -377,4 +378,30 @@ struct child_sa_t {
 child_sa_t * child_sa_create(host_t *me, host_t *other, child_cfg_t *config,
 							 u_int32_t reqid, bool encap);
 
+/**
+ * Query the traffic statistics of one direction of a CHILD_SA from the kernel.
+ *
+ * Unlike child_sa_t.get_usestats(), this does not access the CHILD_SA, so the
+ * statistics may be queried while its IKE_SA is in use by another thread. The
+ * time of last use is taken from the policies, or from the SA if the policies
+ * don't provide it. Nothing gets cached, so all values are queried.
+ *
+ * @param me				own address
+ * @param other				remote address
+ * @param protocol			IPsec protocol of the CHILD_SA
+ * @param spi				SPI of the SA in the given direction, 0 if none
+ * @param mark				mark of the SA and policies in the given direction
+ * @param mode				IPsec mode of the CHILD_SA
+ * @param my_ts				local traffic selectors, as traffic_selector_t
+ * @param other_ts			remote traffic selectors, as traffic_selector_t
+ * @param inbound			TRUE for inbound traffic, FALSE for outbound
+ * @param[out] time			time of last use in seconds, 0 if unknown
+ * @param[out] bytes		number of processed bytes
+ * @param[out] packets		number of processed packets
+ */
+void child_sa_query_usestats(host_t *me, host_t *other, protocol_id_t protocol,
+							 u_int32_t spi, mark_t mark, ipsec_mode_t mode,
+							 array_t *my_ts, array_t *other_ts, bool inbound,
+							 time_t *time, u_int64_t *bytes, u_int64_t *packets);
+
 #endif /** CHILD_SA_H_ @}*/
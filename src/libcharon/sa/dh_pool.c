@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "dh_pool.h"
+
+#include <daemon.h>
+#include <collections/linked_list.h>
+#include <threading/thread.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <processing/jobs/callback_job.h>
+
+/**
+ * Default number of threads generating key pairs
+ */
+#define DEFAULT_DH_THREADS 1
+
+/**
+ * Initial and maximum delay in seconds before retrying a failed group
+ */
+#define RETRY_DELAY_MIN 1
+#define RETRY_DELAY_MAX 300
+
+typedef struct private_dh_pool_t private_dh_pool_t;
+typedef struct entry_t entry_t;
+typedef struct op_entry_t op_entry_t;
+
+/**
+ * Private data of an dh_pool_t object.
+ */
+struct private_dh_pool_t {
+
+	/**
+	 * Public dh_pool_t interface.
+	 */
+	dh_pool_t public;
+
+	/**
+	 * Groups we generate key pairs for, as entry_t
+	 */
+	linked_list_t *groups;
+
+	/**
+	 * Number of key pairs to keep ready per group
+	 */
+	u_int size;
+
+	/**
+	 * Queued operations, as op_entry_t
+	 */
+	linked_list_t *ops;
+
+	/**
+	 * Whether to execute operations asynchronously
+	 */
+	bool async;
+
+	/**
+	 * Generating threads, as thread_t
+	 */
+	linked_list_t *threads;
+
+	/**
+	 * TRUE if threads should terminate
+	 */
+	bool terminate;
+
+	/**
+	 * Lock for groups, ops and terminate
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Signaled if key pairs or operations are pending, or threads should
+	 * terminate
+	 */
+	condvar_t *condvar;
+};
+
+/**
+ * Key pairs of a DH group
+ */
+struct entry_t {
+
+	/**
+	 * DH group
+	 */
+	diffie_hellman_group_t group;
+
+	/**
+	 * Pregenerated DH objects, as diffie_hellman_t
+	 */
+	linked_list_t *dhs;
+
+	/**
+	 * Number of key pairs currently being generated
+	 */
+	u_int pending;
+
+	/**
+	 * Time after which to retry generating key pairs, if the last one failed
+	 */
+	time_t retry;
+
+	/**
+	 * Current delay before retrying, doubled after each failure
+	 */
+	u_int delay;
+};
+
+/**
+ * Operation queued for an IKE_SA
+ */
+struct op_entry_t {
+
+	/**
+	 * Operation to execute
+	 */
+	dh_pool_op_t *op;
+
+	/**
+	 * IKE_SA to resume afterwards
+	 */
+	ike_sa_id_t *id;
+};
+
+/**
+ * Destroy an op_entry_t
+ */
+static void op_entry_destroy(op_entry_t *entry)
+{
+	entry->op->destroy(entry->op);
+	entry->id->destroy(entry->id);
+	free(entry);
+}
+
+/**
+ * Destroy an entry_t
+ */
+static void entry_destroy(entry_t *entry)
+{
+	entry->dhs->destroy_offset(entry->dhs,
+							   offsetof(diffie_hellman_t, destroy));
+	free(entry);
+}
+
+/**
+ * Find a group that needs key pairs, mutex must be held
+ */
+static entry_t *find_refill(private_dh_pool_t *this)
+{
+	enumerator_t *enumerator;
+	entry_t *entry, *found = NULL;
+	time_t now;
+
+	now = time_monotonic(NULL);
+	enumerator = this->groups->create_enumerator(this->groups);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->retry <= now &&
+			entry->dhs->get_count(entry->dhs) + entry->pending < this->size)
+		{
+			found = entry;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
+}
+
+/**
+ * Check out an IKE_SA and resume it after executing an operation
+ */
+static job_requeue_t resume_ike_sa(ike_sa_id_t *id)
+{
+	ike_sa_t *ike_sa;
+
+	ike_sa = charon->ike_sa_manager->checkout(charon->ike_sa_manager, id);
+	if (ike_sa)
+	{
+		if (ike_sa->resume(ike_sa) == DESTROY_ME)
+		{
+			charon->ike_sa_manager->checkin_and_destroy(
+											charon->ike_sa_manager, ike_sa);
+		}
+		else
+		{
+			charon->ike_sa_manager->checkin(charon->ike_sa_manager, ike_sa);
+		}
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Execute a queued operation and resume the IKE_SA
+ */
+static void execute_op(op_entry_t *entry)
+{
+	entry->op->execute(entry->op);
+	/* release the operation before resuming, the task picks up the result */
+	entry->op->destroy(entry->op);
+	lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)resume_ike_sa,
+					entry->id, (callback_job_cleanup_t)entry->id->destroy,
+					NULL));
+	free(entry);
+}
+
+/**
+ * Generate key pairs and execute operations until we get terminated
+ */
+static void *generate(private_dh_pool_t *this)
+{
+	diffie_hellman_group_t group;
+	diffie_hellman_t *dh;
+	op_entry_t *op;
+	entry_t *entry;
+
+	this->mutex->lock(this->mutex);
+	while (!this->terminate)
+	{
+		if (this->ops->remove_first(this->ops, (void**)&op) == SUCCESS)
+		{	/* operations delay an IKE_SA, prefer them over refilling */
+			this->mutex->unlock(this->mutex);
+			execute_op(op);
+			this->mutex->lock(this->mutex);
+			continue;
+		}
+		entry = find_refill(this);
+		if (!entry)
+		{
+			this->condvar->wait(this->condvar, this->mutex);
+			continue;
+		}
+		entry->pending++;
+		group = entry->group;
+		this->mutex->unlock(this->mutex);
+
+		dh = lib->crypto->create_dh(lib->crypto, group);
+
+		this->mutex->lock(this->mutex);
+		/* entries get removed only after all threads terminated */
+		entry->pending--;
+		if (dh)
+		{
+			entry->dhs->insert_last(entry->dhs, dh);
+			entry->delay = 0;
+		}
+		else
+		{	/* the group might be unsupported, or creating it failed only
+			 * temporarily, retry on demand after an increasing delay */
+			entry->delay = entry->delay ? min(entry->delay * 2, RETRY_DELAY_MAX)
+										: RETRY_DELAY_MIN;
+			entry->retry = time_monotonic(NULL) + entry->delay;
+			DBG1(DBG_IKE, "pregenerating %N key pair failed, retrying in %us",
+				 diffie_hellman_group_names, group, entry->delay);
+		}
+	}
+	this->mutex->unlock(this->mutex);
+	return NULL;
+}
+
+METHOD(dh_pool_t, create_dh, diffie_hellman_t*,
+	private_dh_pool_t *this, diffie_hellman_group_t group)
+{
+	enumerator_t *enumerator;
+	diffie_hellman_t *dh = NULL;
+	entry_t *entry, *found = NULL;
+
+	if (!this->size || group == MODP_NULL || group == MODP_CUSTOM)
+	{
+		return lib->crypto->create_dh(lib->crypto, group);
+	}
+	this->mutex->lock(this->mutex);
+	enumerator = this->groups->create_enumerator(this->groups);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->group == group)
+		{
+			found = entry;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (!found)
+	{
+		INIT(found,
+			.group = group,
+			.dhs = linked_list_create(),
+		);
+		this->groups->insert_last(this->groups, found);
+	}
+	found->dhs->remove_first(found->dhs, (void**)&dh);
+	this->condvar->signal(this->condvar);
+	this->mutex->unlock(this->mutex);
+
+	if (!dh)
+	{
+		DBG2(DBG_IKE, "no pregenerated %N key pair available",
+			 diffie_hellman_group_names, group);
+		dh = lib->crypto->create_dh(lib->crypto, group);
+	}
+	return dh;
+}
+
+METHOD(dh_pool_t, queue_op, bool,
+	private_dh_pool_t *this, ike_sa_id_t *id, dh_pool_op_t *op)
+{
+	op_entry_t *entry;
+
+	if (!this->async)
+	{
+		return FALSE;
+	}
+	INIT(entry,
+		.op = op->get_ref(op),
+		.id = id->clone(id),
+	);
+	this->mutex->lock(this->mutex);
+	this->ops->insert_last(this->ops, entry);
+	this->condvar->signal(this->condvar);
+	this->mutex->unlock(this->mutex);
+	return TRUE;
+}
+
+METHOD(dh_pool_t, destroy, void,
+	private_dh_pool_t *this)
+{
+	thread_t *thread;
+
+	this->mutex->lock(this->mutex);
+	this->terminate = TRUE;
+	this->condvar->broadcast(this->condvar);
+	this->mutex->unlock(this->mutex);
+
+	while (this->threads->remove_first(this->threads,
+									   (void**)&thread) == SUCCESS)
+	{
+		thread->join(thread);
+	}
+	this->threads->destroy(this->threads);
+	this->ops->destroy_function(this->ops, (void*)op_entry_destroy);
+	this->groups->destroy_function(this->groups, (void*)entry_destroy);
+	this->condvar->destroy(this->condvar);
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/**
+ * See header
+ */
+dh_pool_t *dh_pool_create()
+{
+	private_dh_pool_t *this;
+	thread_t *thread;
+	u_int i, threads;
+
+	INIT(this,
+		.public = {
+			.create_dh = _create_dh,
+			.queue_op = _queue_op,
+			.destroy = _destroy,
+		},
+		.groups = linked_list_create(),
+		.ops = linked_list_create(),
+		.threads = linked_list_create(),
+		.size = lib->settings->get_int(lib->settings, "%s.dh_pool.size", 0,
+									   charon->name),
+		.async = lib->settings->get_bool(lib->settings, "%s.dh_pool.async",
+										 FALSE, charon->name),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+	);
+
+	threads = lib->settings->get_int(lib->settings, "%s.dh_pool.threads",
+									 DEFAULT_DH_THREADS, charon->name);
+	for (i = 0; i < threads && (this->size || this->async); i++)
+	{
+		thread = thread_create((void*)generate, this);
+		if (!thread)
+		{
+			break;
+		}
+		this->threads->insert_last(this->threads, thread);
+	}
+	if (!this->threads->get_count(this->threads))
+	{
+		destroy(this);
+		return NULL;
+	}
+	if (this->size)
+	{
+		DBG1(DBG_IKE, "pregenerating %u DH key pairs per group in %u threads",
+			 this->size, this->threads->get_count(this->threads));
+	}
+	if (this->async)
+	{
+		DBG1(DBG_IKE, "computing DH secrets and signatures in %u threads",
+			 this->threads->get_count(this->threads));
+	}
+	return &this->public;
+}
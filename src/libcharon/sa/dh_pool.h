@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup dh_pool dh_pool
+ * @{ @ingroup sa
+ */
+
+#ifndef DH_POOL_H_
+#define DH_POOL_H_
+
+#include <library.h>
+#include <crypto/diffie_hellman.h>
+#include <sa/ike_sa_id.h>
+
+typedef struct dh_pool_t dh_pool_t;
+typedef struct dh_pool_op_t dh_pool_op_t;
+
+/**
+ * Expensive operation of a task, executed by the threads of a dh_pool_t.
+ */
+struct dh_pool_op_t {
+
+	/**
+	 * Execute the operation.
+	 */
+	void (*execute)(dh_pool_op_t *this);
+
+	/**
+	 * Get a reference to the operation.
+	 *
+	 * @return				this, with an increased refcount
+	 */
+	dh_pool_op_t* (*get_ref)(dh_pool_op_t *this);
+
+	/**
+	 * Release a reference, destroying the operation if it was the last.
+	 */
+	void (*destroy)(dh_pool_op_t *this);
+};
+
+/**
+ * Pool of pregenerated Diffie-Hellman key pairs.
+ *
+ * Generating the private value and computing the public value of a DH
+ * exchange is expensive and usually happens while an IKE_SA is checked out.
+ * This pool lets dedicated threads generate key pairs in advance for the
+ * groups in use, so that tasks just pick up a ready DH object. Each key pair
+ * is handed out once only.
+ *
+ * If enabled, the threads also execute expensive operations of tasks, such as
+ * computing the shared secret or creating a signature, while the IKE_SA is
+ * checked in.
+ */
+struct dh_pool_t {
+
+	/**
+	 * Get a DH object for a group, pregenerated if available.
+	 *
+	 * If no pregenerated object is available, a new one gets created in the
+	 * calling thread, and the pool starts generating key pairs for the group.
+	 *
+	 * @param group			DH group to get an object for
+	 * @return				DH object, NULL if group not supported
+	 */
+	diffie_hellman_t* (*create_dh)(dh_pool_t *this,
+								   diffie_hellman_group_t group);
+
+	/**
+	 * Execute an operation for an IKE_SA asynchronously.
+	 *
+	 * The calling task returns SUSPENDED if the operation got queued, which
+	 * checks in the IKE_SA. Once the operation has been executed, the IKE_SA
+	 * gets checked out and resumed, and the task is called again to pick up
+	 * the result.
+	 *
+	 * @param id			ID of the IKE_SA to resume
+	 * @param op			operation to execute, gets referenced
+	 * @return				TRUE if queued, FALSE if disabled
+	 */
+	bool (*queue_op)(dh_pool_t *this, ike_sa_id_t *id, dh_pool_op_t *op);
+
+	/**
+	 * Stop the generating threads and destroy a dh_pool_t.
+	 */
+	void (*destroy)(dh_pool_t *this);
+};
+
+/**
+ * Create a dh_pool instance.
+ *
+ * @return				pool, NULL if disabled in strongswan.conf
+ */
+dh_pool_t *dh_pool_create();
+
+#endif /** DH_POOL_H_ @}*/
@@ -27,6 +27,7 @@
 #include <hydra.h>
 #include <daemon.h>
 #include <collections/array.h>
+#include <collections/hashtable.h>
 #include <utils/lexparser.h>
 #include <processing/jobs/retransmit_job.h>
 #include <processing/jobs/delete_ike_sa_job.h>
@@ -176,6 +177,26 @@ struct private_ike_sa_t {
 	 */
 	array_t *child_sas;
 
+	/**
+	 * CHILD_SAs by inbound SPI, u_int32_t => child_sa_t
+	 */
+	hashtable_t *child_sas_in;
+
+	/**
+	 * CHILD_SAs by outbound SPI, u_int32_t => child_sa_t
+	 */
+	hashtable_t *child_sas_out;
+
+	/**
+	 * CHILD_SAs by reqid, u_int32_t => array_t of child_sa_t
+	 */
+	hashtable_t *child_sas_reqid;
+
+	/**
+	 * Number of CHILD_SAs replaced in the SPI indices by one with the same SPI
+	 */
+	u_int child_sas_shadowed;
+
 	/**
 	 * keymat of this IKE_SA
 	 */
@@ -1280,6 +1301,20 @@ METHOD(ike_sa_t, process_message, status_t,
 	return status;
 }
 
+METHOD(ike_sa_t, resume, status_t,
+	private_ike_sa_t *this)
+{
+	status_t status;
+
+	status = this->task_manager->resume(this->task_manager);
+	if (this->flush_auth_cfg && this->state == IKE_ESTABLISHED)
+	{
+		this->flush_auth_cfg = FALSE;
+		flush_auth_cfgs(this);
+	}
+	return status;
+}
+
 METHOD(ike_sa_t, get_id, ike_sa_id_t*,
 	private_ike_sa_t *this)
 {
@@ -1352,10 +1387,136 @@ METHOD(ike_sa_t, set_other_id, void,
 	this->other_id = other;
 }
 
+/**
+ * Add a CHILD_SA to the SPI index of one direction
+ */
+static void index_spi(private_ike_sa_t *this, hashtable_t **table,
+					  child_sa_t *child_sa, bool inbound)
+{
+	u_int32_t spi;
+
+	spi = child_sa->get_spi(child_sa, inbound);
+	if (spi)
+	{
+		if (!*table)
+		{
+			*table = hashtable_create(hashtable_hash_ptr,
+									  hashtable_equals_ptr, 4);
+		}
+		if ((*table)->put(*table, (void*)(uintptr_t)spi, child_sa))
+		{	/* the previous one is only found by a linear search */
+			this->child_sas_shadowed++;
+		}
+	}
+}
+
+/**
+ * Remove a CHILD_SA from the SPI index of one direction
+ */
+static void unindex_spi(hashtable_t *table, child_sa_t *child_sa, bool inbound)
+{
+	u_int32_t spi;
+
+	spi = child_sa->get_spi(child_sa, inbound);
+	if (spi && table && table->get(table, (void*)(uintptr_t)spi) == child_sa)
+	{
+		table->remove(table, (void*)(uintptr_t)spi);
+	}
+}
+
+/**
+ * Add a CHILD_SA to the array of CHILD_SAs and all indices
+ */
+static void add_child(private_ike_sa_t *this, child_sa_t *child_sa)
+{
+	array_t *array;
+	void *reqid;
+
+	array_insert_create(&this->child_sas, ARRAY_TAIL, child_sa);
+
+	index_spi(this, &this->child_sas_in, child_sa, TRUE);
+	index_spi(this, &this->child_sas_out, child_sa, FALSE);
+
+	if (!this->child_sas_reqid)
+	{
+		this->child_sas_reqid = hashtable_create(hashtable_hash_ptr,
+												 hashtable_equals_ptr, 4);
+	}
+	reqid = (void*)(uintptr_t)child_sa->get_reqid(child_sa);
+	array = this->child_sas_reqid->get(this->child_sas_reqid, reqid);
+	if (!array)
+	{
+		array = array_create(0, 0);
+		this->child_sas_reqid->put(this->child_sas_reqid, reqid, array);
+	}
+	array_insert(array, ARRAY_TAIL, child_sa);
+}
+
+/**
+ * Remove a CHILD_SA from all indices, but not from the array of CHILD_SAs
+ */
+static void unindex_child(private_ike_sa_t *this, child_sa_t *child_sa)
+{
+	enumerator_t *enumerator;
+	child_sa_t *current;
+	array_t *array;
+	void *reqid;
+
+	unindex_spi(this->child_sas_in, child_sa, TRUE);
+	unindex_spi(this->child_sas_out, child_sa, FALSE);
+
+	if (!this->child_sas_reqid)
+	{
+		return;
+	}
+	reqid = (void*)(uintptr_t)child_sa->get_reqid(child_sa);
+	array = this->child_sas_reqid->get(this->child_sas_reqid, reqid);
+	if (array)
+	{
+		enumerator = array_create_enumerator(array);
+		while (enumerator->enumerate(enumerator, &current))
+		{
+			if (current == child_sa)
+			{
+				array_remove_at(array, enumerator);
+				break;
+			}
+		}
+		enumerator->destroy(enumerator);
+		if (!array_count(array))
+		{
+			this->child_sas_reqid->remove(this->child_sas_reqid, reqid);
+			array_destroy(array);
+		}
+	}
+}
+
+/**
+ * Remove a CHILD_SA from the array of CHILD_SAs and all indices
+ */
+static void remove_child(private_ike_sa_t *this, child_sa_t *child_sa)
+{
+	enumerator_t *enumerator;
+	child_sa_t *current;
+
+	unindex_child(this, child_sa);
+
+	enumerator = array_create_enumerator(this->child_sas);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (current == child_sa)
+		{
+			array_remove_at(this->child_sas, enumerator);
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
 METHOD(ike_sa_t, add_child_sa, void,
 	private_ike_sa_t *this, child_sa_t *child_sa)
 {
-	array_insert_create(&this->child_sas, ARRAY_TAIL, child_sa);
+	add_child(this, child_sa);
 }
 
 METHOD(ike_sa_t, get_child_sa, child_sa_t*,
@@ -1363,6 +1524,21 @@ METHOD(ike_sa_t, get_child_sa, child_sa_t*,
 {
 	enumerator_t *enumerator;
 	child_sa_t *current, *found = NULL;
+	hashtable_t *table;
+
+	table = inbound ? this->child_sas_in : this->child_sas_out;
+	if (spi && table)
+	{
+		current = table->get(table, (void*)(uintptr_t)spi);
+		if (current && current->get_protocol(current) == protocol)
+		{
+			return current;
+		}
+		if (!current && !this->child_sas_shadowed)
+		{
+			return NULL;
+		}
+	}
 
 	enumerator = array_create_enumerator(this->child_sas);
 	while (enumerator->enumerate(enumerator, (void**)&current))
@@ -1377,22 +1553,85 @@ METHOD(ike_sa_t, get_child_sa, child_sa_t*,
 	return found;
 }
 
+METHOD(ike_sa_t, get_child_sa_by_reqid, child_sa_t*,
+	private_ike_sa_t *this, u_int32_t reqid)
+{
+	enumerator_t *enumerator;
+	child_sa_t *found = NULL;
+	array_t *array;
+
+	if (this->child_sas_reqid)
+	{
+		array = this->child_sas_reqid->get(this->child_sas_reqid,
+										   (void*)(uintptr_t)reqid);
+		if (array)
+		{
+			enumerator = array_create_enumerator(array);
+			enumerator->enumerate(enumerator, &found);
+			enumerator->destroy(enumerator);
+		}
+	}
+	return found;
+}
+
 METHOD(ike_sa_t, get_child_count, int,
 	private_ike_sa_t *this)
 {
 	return array_count(this->child_sas);
 }
 
+/**
+ * Enumerator over CHILD_SAs, remembers the current one for removal
+ */
+typedef struct {
+	/** implements enumerator_t */
+	enumerator_t public;
+	/** inner array enumerator */
+	enumerator_t *inner;
+	/** currently enumerated CHILD_SA */
+	child_sa_t *current;
+} child_enumerator_t;
+
+METHOD(enumerator_t, child_enumerate, bool,
+	child_enumerator_t *this, child_sa_t **child_sa)
+{
+	if (this->inner->enumerate(this->inner, &this->current))
+	{
+		*child_sa = this->current;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+METHOD(enumerator_t, child_enumerator_destroy, void,
+	child_enumerator_t *this)
+{
+	this->inner->destroy(this->inner);
+	free(this);
+}
+
 METHOD(ike_sa_t, create_child_sa_enumerator, enumerator_t*,
 	private_ike_sa_t *this)
 {
-	return array_create_enumerator(this->child_sas);
+	child_enumerator_t *enumerator;
+
+	INIT(enumerator,
+		.public = {
+			.enumerate = (void*)_child_enumerate,
+			.destroy = _child_enumerator_destroy,
+		},
+		.inner = array_create_enumerator(this->child_sas),
+	);
+	return &enumerator->public;
 }
 
 METHOD(ike_sa_t, remove_child_sa, void,
 	private_ike_sa_t *this, enumerator_t *enumerator)
 {
-	array_remove_at(this->child_sas, enumerator);
+	child_enumerator_t *ce = (child_enumerator_t*)enumerator;
+
+	unindex_child(this, ce->current);
+	array_remove_at(this->child_sas, ce->inner);
 }
 
 METHOD(ike_sa_t, rekey_child_sa, status_t,
@@ -1421,24 +1660,16 @@ METHOD(ike_sa_t, delete_child_sa, status_t,
 METHOD(ike_sa_t, destroy_child_sa, status_t,
 	private_ike_sa_t *this, protocol_id_t protocol, u_int32_t spi)
 {
-	enumerator_t *enumerator;
 	child_sa_t *child_sa;
-	status_t status = NOT_FOUND;
 
-	enumerator = array_create_enumerator(this->child_sas);
-	while (enumerator->enumerate(enumerator, (void**)&child_sa))
+	child_sa = get_child_sa(this, protocol, spi, TRUE);
+	if (!child_sa)
 	{
-		if (child_sa->get_protocol(child_sa) == protocol &&
-			child_sa->get_spi(child_sa, TRUE) == spi)
-		{
-			array_remove_at(this->child_sas, enumerator);
-			child_sa->destroy(child_sa);
-			status = SUCCESS;
-			break;
-		}
+		return NOT_FOUND;
 	}
-	enumerator->destroy(enumerator);
-	return status;
+	remove_child(this, child_sa);
+	child_sa->destroy(child_sa);
+	return SUCCESS;
 }
 
 METHOD(ike_sa_t, delete_, status_t,
@@ -1683,6 +1914,7 @@ METHOD(ike_sa_t, reestablish, status_t,
 				{
 					case CHILD_ROUTED:
 					{	/* move routed child directly */
+						unindex_child(this, child_sa);
 						array_remove_at(this->child_sas, enumerator);
 						new->add_child_sa(new, child_sa);
 						action = ACTION_NONE;
@@ -2096,7 +2328,8 @@ METHOD(ike_sa_t, inherit, void,
 	/* adopt all children */
 	while (array_remove(other->child_sas, ARRAY_HEAD, &child_sa))
 	{
-		array_insert_create(&this->child_sas, ARRAY_TAIL, child_sa);
+		unindex_child(other, child_sa);
+		add_child(this, child_sa);
 	}
 
 	/* move pending tasks to the new IKE_SA */
@@ -2143,6 +2376,7 @@ METHOD(ike_sa_t, destroy, void,
 	 * routes that the CHILD_SA tries to uninstall. */
 	while (array_remove(this->child_sas, ARRAY_TAIL, &child_sa))
 	{
+		unindex_child(this, child_sa);
 		child_sa->destroy(child_sa);
 	}
 	while (array_remove(this->my_vips, ARRAY_TAIL, &vip))
@@ -2174,6 +2408,9 @@ METHOD(ike_sa_t, destroy, void,
 	charon->bus->set_sa(charon->bus, NULL);
 
 	array_destroy(this->child_sas);
+	DESTROY_IF(this->child_sas_in);
+	DESTROY_IF(this->child_sas_out);
+	DESTROY_IF(this->child_sas_reqid);
 	DESTROY_IF(this->keymat);
 	array_destroy(this->attributes);
 	array_destroy(this->my_vips);
@@ -2236,6 +2473,7 @@ ike_sa_t * ike_sa_create(ike_sa_id_t *ike_sa_id, bool initiator,
 			.get_statistic = _get_statistic,
 			.set_statistic = _set_statistic,
 			.process_message = _process_message,
+			.resume = _resume,
 			.initiate = _initiate,
 			.retry_initiate = _retry_initiate,
 			.get_ike_cfg = _get_ike_cfg,
@@ -2278,6 +2516,7 @@ ike_sa_t * ike_sa_create(ike_sa_id_t *ike_sa_id, bool initiator,
 			.get_keymat = _get_keymat,
 			.add_child_sa = _add_child_sa,
 			.get_child_sa = _get_child_sa,
+			.get_child_sa_by_reqid = _get_child_sa_by_reqid,
 			.get_child_count = _get_child_count,
 			.create_child_sa_enumerator = _create_child_sa_enumerator,
 			.remove_child_sa = _remove_child_sa,
@@ -770,6 +770,15 @@ struct ike_sa_t {
 	 */
 	status_t (*process_message) (ike_sa_t *this, message_t *message);
 
+	/**
+	 * Resume processing of a message suspended by a task.
+	 *
+	 * @return
+	 *						- SUCCESS
+	 *						- DESTROY_ME if this IKE_SA MUST be deleted
+	 */
+	status_t (*resume) (ike_sa_t *this);
+
 	/**
 	 * Generate a IKE message to send it to the peer.
 	 *
@@ -842,6 +851,17 @@ struct ike_sa_t {
 	child_sa_t* (*get_child_sa) (ike_sa_t *this, protocol_id_t protocol,
 								 u_int32_t spi, bool inbound);
 
+	/**
+	 * Get a CHILD_SA identified by its reqid.
+	 *
+	 * If multiple CHILD_SAs share the reqid, e.g. while rekeying, the one
+	 * added first is returned.
+	 *
+	 * @param reqid			reqid of the CHILD_SA
+	 * @return				child_sa, or NULL if none found
+	 */
+	child_sa_t* (*get_child_sa_by_reqid) (ike_sa_t *this, u_int32_t reqid);
+
 	/**
 	 * Get the number of CHILD_SAs.
 	 *
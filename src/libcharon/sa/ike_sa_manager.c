@@ -112,6 +112,16 @@ struct entry_t {
 	 * message ID or hash of currently processing message, -1 if none
 	 */
 	u_int32_t processing;
+
+	/**
+	 * summary of the IKE_SA from its last check-in, if any
+	 */
+	void *summary;
+
+	/**
+	 * summarizer that created the summary
+	 */
+	ike_sa_summarizer_t *summarizer;
 };
 
 /**
@@ -131,6 +141,20 @@ static status_t entry_destroy(entry_t *this)
 	return SUCCESS;
 }
 
+/**
+ * Replace the summary of an entry, the lock of its segment must be held.
+ */
+static void set_entry_summary(entry_t *this, ike_sa_summarizer_t *summarizer,
+							  void *summary)
+{
+	if (this->summary)
+	{
+		this->summarizer->release(this->summarizer, this->summary);
+	}
+	this->summarizer = summarizer;
+	this->summary = summary;
+}
+
 /**
  * Creates a new entry for the ike_sa_t list.
  */
@@ -139,7 +163,8 @@ static entry_t *entry_create()
 	entry_t *this;
 
 	INIT(this,
-		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.condvar = condvar_create_named(CONDVAR_TYPE_DEFAULT,
+										"ike_sa_manager.checkout"),
 		.processing = -1,
 	);
 
@@ -151,6 +176,13 @@ static entry_t *entry_create()
  */
 static bool entry_match_by_id(entry_t *entry, ike_sa_id_t *id)
 {
+	if (id->get_ike_version(id) == IKEV2_MAJOR_VERSION &&
+		id->is_initiator(id) != entry->ike_sa_id->is_initiator(entry->ike_sa_id))
+	{
+		/* the IKEv2 header tells our role, which only differs for SAs with
+		 * the same SPIs if both ends are local, e.g. in benchmarks */
+		return FALSE;
+	}
 	if (id->equals(id, entry->ike_sa_id))
 	{
 		return TRUE;
@@ -392,6 +424,26 @@ struct private_ike_sa_manager_t {
 	 * Configured IKE_SA limit, if any
 	 */
 	u_int ikesa_limit;
+
+	/**
+	 * Gauge for the number of IKE_SAs
+	 */
+	metric_t *count_metric;
+
+	/**
+	 * Gauge for the number of half-open IKE_SAs
+	 */
+	metric_t *half_open_metric;
+
+	/**
+	 * Registered summarizer, if any
+	 */
+	ike_sa_summarizer_t *summarizer;
+
+	/**
+	 * Lock for the summarizer, held while creating or caching summaries
+	 */
+	rwlock_t *summarizer_lock;
 };
 
 /**
@@ -1388,10 +1440,9 @@ METHOD(ike_sa_manager_t, checkout_by_config, ike_sa_t*,
 METHOD(ike_sa_manager_t, checkout_by_id, ike_sa_t*,
 	private_ike_sa_manager_t *this, u_int32_t id, bool child)
 {
-	enumerator_t *enumerator, *children;
+	enumerator_t *enumerator;
 	entry_t *entry;
 	ike_sa_t *ike_sa = NULL;
-	child_sa_t *child_sa;
 	u_int segment;
 
 	DBG2(DBG_MGR, "checkout IKE_SA by ID");
@@ -1404,16 +1455,10 @@ METHOD(ike_sa_manager_t, checkout_by_id, ike_sa_t*,
 			/* look for a child with such a reqid ... */
 			if (child)
 			{
-				children = entry->ike_sa->create_child_sa_enumerator(entry->ike_sa);
-				while (children->enumerate(children, (void**)&child_sa))
+				if (entry->ike_sa->get_child_sa_by_reqid(entry->ike_sa, id))
 				{
-					if (child_sa->get_reqid(child_sa) == id)
-					{
-						ike_sa = entry->ike_sa;
-						break;
-					}
+					ike_sa = entry->ike_sa;
 				}
-				children->destroy(children);
 			}
 			else /* ... or for a IKE_SA with such a unique id */
 			{
@@ -1537,6 +1582,140 @@ METHOD(ike_sa_manager_t, create_enumerator, enumerator_t*,
 			this, reset_sa);
 }
 
+METHOD(ike_sa_manager_t, set_summarizer, void,
+	private_ike_sa_manager_t* this, ike_sa_summarizer_t *summarizer)
+{
+	ike_sa_summarizer_t *old;
+	enumerator_t *enumerator;
+	entry_t *entry;
+	u_int segment;
+
+	/* once we hold the write lock, no thread summarizes IKE_SAs with the
+	 * old summarizer anymore */
+	this->summarizer_lock->write_lock(this->summarizer_lock);
+	old = this->summarizer;
+	this->summarizer = summarizer;
+	this->summarizer_lock->unlock(this->summarizer_lock);
+
+	if (old && old != summarizer)
+	{
+		enumerator = create_table_enumerator(this);
+		while (enumerator->enumerate(enumerator, &entry, &segment))
+		{
+			if (entry->summarizer == old)
+			{
+				set_entry_summary(entry, NULL, NULL);
+			}
+		}
+		enumerator->destroy(enumerator);
+	}
+}
+
+/**
+ * Enumerator over summaries of a snapshot of IKE_SAs
+ */
+typedef struct {
+
+	/**
+	 * Implements enumerator_t
+	 */
+	enumerator_t public;
+
+	/**
+	 * Associated ike_sa_manager_t
+	 */
+	private_ike_sa_manager_t *manager;
+
+	/**
+	 * IDs of the IKE_SAs not enumerated yet, as ike_sa_id_t
+	 */
+	linked_list_t *ids;
+
+} summary_enumerator_t;
+
+METHOD(enumerator_t, summary_enumerate, bool,
+	summary_enumerator_t *this, void **out)
+{
+	private_ike_sa_manager_t *manager = this->manager;
+	ike_sa_summarizer_t *summarizer;
+	ike_sa_id_t *id;
+	entry_t *entry;
+	u_int segment;
+	bool found;
+
+	while (this->ids->remove_first(this->ids, (void**)&id) == SUCCESS)
+	{
+		manager->summarizer_lock->read_lock(manager->summarizer_lock);
+		summarizer = manager->summarizer;
+		found = get_entry_by_id(manager, id, &entry, &segment) == SUCCESS;
+		id->destroy(id);
+		if (found)
+		{
+			*out = NULL;
+			if (summarizer)
+			{
+				/* an IKE_SA not checked out can't get modified while we hold
+				 * the segment lock, so we may summarize it if it has not been
+				 * checked in since the summarizer got registered */
+				if (entry->summarizer != summarizer &&
+					!entry->checked_out && !entry->driveout_new_threads &&
+					!entry->driveout_waiting_threads)
+				{
+					set_entry_summary(entry, summarizer,
+							summarizer->summarize(summarizer, entry->ike_sa));
+				}
+				if (entry->summarizer == summarizer)
+				{
+					*out = summarizer->get_ref(summarizer, entry->summary);
+				}
+			}
+			unlock_single_segment(manager, segment);
+		}
+		manager->summarizer_lock->unlock(manager->summarizer_lock);
+		if (found)
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+METHOD(enumerator_t, summary_destroy, void,
+	summary_enumerator_t *this)
+{
+	this->ids->destroy_offset(this->ids, offsetof(ike_sa_id_t, destroy));
+	free(this);
+}
+
+METHOD(ike_sa_manager_t, create_summary_enumerator, enumerator_t*,
+	private_ike_sa_manager_t* this)
+{
+	summary_enumerator_t *enumerator;
+	enumerator_t *entries;
+	entry_t *entry;
+	u_int segment;
+
+	INIT(enumerator,
+		.public = {
+			.enumerate = (void*)_summary_enumerate,
+			.destroy = _summary_destroy,
+		},
+		.manager = this,
+		.ids = linked_list_create(),
+	);
+
+	/* segment locks are held only while copying the IDs */
+	entries = create_table_enumerator(this);
+	while (entries->enumerate(entries, &entry, &segment))
+	{
+		enumerator->ids->insert_last(enumerator->ids,
+							entry->ike_sa_id->clone(entry->ike_sa_id));
+	}
+	entries->destroy(entries);
+
+	return &enumerator->public;
+}
+
 METHOD(ike_sa_manager_t, checkin, void,
 	private_ike_sa_manager_t *this, ike_sa_t *ike_sa)
 {
@@ -1548,8 +1727,11 @@ METHOD(ike_sa_manager_t, checkin, void,
 	 */
 	entry_t *entry;
 	ike_sa_id_t *ike_sa_id;
+	ike_sa_summarizer_t *summarizer = NULL;
 	host_t *other;
 	identification_t *my_id, *other_id;
+	bool summarizing;
+	void *summary = NULL;
 	u_int segment;
 
 	ike_sa_id = ike_sa->get_id(ike_sa);
@@ -1560,6 +1742,19 @@ METHOD(ike_sa_manager_t, checkin, void,
 	DBG2(DBG_MGR, "checkin IKE_SA %s[%u]", ike_sa->get_name(ike_sa),
 			ike_sa->get_unique_id(ike_sa));
 
+	/* summarize the IKE_SA before we lock its segment, the summarizer can't
+	 * get unregistered until we cached the summary */
+	summarizing = this->summarizer != NULL;
+	if (summarizing)
+	{
+		this->summarizer_lock->read_lock(this->summarizer_lock);
+		summarizer = this->summarizer;
+		if (summarizer)
+		{
+			summary = summarizer->summarize(summarizer, ike_sa);
+		}
+	}
+
 	/* look for the entry */
 	if (get_entry_by_sa(this, ike_sa_id, ike_sa, &entry, &segment) == SUCCESS)
 	{
@@ -1628,7 +1823,15 @@ METHOD(ike_sa_manager_t, checkin, void,
 		put_connected_peers(this, entry);
 	}
 
+	if (summarizer)
+	{
+		set_entry_summary(entry, summarizer, summary);
+	}
 	unlock_single_segment(this, segment);
+	if (summarizing)
+	{
+		this->summarizer_lock->unlock(this->summarizer_lock);
+	}
 
 	charon->bus->set_sa(charon->bus, NULL);
 }
@@ -1675,6 +1878,8 @@ METHOD(ike_sa_manager_t, checkin_and_destroy, void,
 			entry->condvar->wait(entry->condvar, this->segments[segment].mutex);
 		}
 		remove_entry(this, entry);
+		/* release the summary while the summarizer can't get unregistered */
+		set_entry_summary(entry, NULL, NULL);
 		unlock_single_segment(this, segment);
 
 		if (entry->half_open)
@@ -2049,6 +2254,7 @@ METHOD(ike_sa_manager_t, flush, void,
 			remove_init_hash(this, entry->init_hash);
 		}
 		remove_entry_at((private_enumerator_t*)enumerator);
+		set_entry_summary(entry, NULL, NULL);
 		entry_destroy(entry);
 	}
 	enumerator->destroy(enumerator);
@@ -2066,6 +2272,9 @@ METHOD(ike_sa_manager_t, destroy, void,
 {
 	u_int i;
 
+	this->count_metric->destroy(this->count_metric);
+	this->half_open_metric->destroy(this->half_open_metric);
+	this->summarizer_lock->destroy(this->summarizer_lock);
 	/* these are already cleared in flush() above */
 	free(this->ike_sa_table);
 	free(this->half_open_table);
@@ -2104,6 +2313,22 @@ static u_int get_nearest_powerof2(u_int n)
 	return ++n;
 }
 
+/**
+ * Get the number of IKE_SAs, for a gauge
+ */
+static int64_t get_count_metric(private_ike_sa_manager_t *this)
+{
+	return get_count(this);
+}
+
+/**
+ * Get the total number of half-open IKE_SAs, for a gauge
+ */
+static int64_t get_half_open_metric(private_ike_sa_manager_t *this)
+{
+	return get_half_open_count(this, NULL);
+}
+
 /*
  * Described in header.
  */
@@ -2123,6 +2348,8 @@ ike_sa_manager_t *ike_sa_manager_create()
 			.check_uniqueness = _check_uniqueness,
 			.has_contact = _has_contact,
 			.create_enumerator = _create_enumerator,
+			.set_summarizer = _set_summarizer,
+			.create_summary_enumerator = _create_summary_enumerator,
 			.create_id_enumerator = _create_id_enumerator,
 			.checkin = _checkin,
 			.checkin_and_destroy = _checkin_and_destroy,
@@ -2168,7 +2395,8 @@ ike_sa_manager_t *ike_sa_manager_create()
 	this->segments = (segment_t*)calloc(this->segment_count, sizeof(segment_t));
 	for (i = 0; i < this->segment_count; i++)
 	{
-		this->segments[i].mutex = mutex_create(MUTEX_TYPE_RECURSIVE);
+		this->segments[i].mutex = mutex_create_named(MUTEX_TYPE_RECURSIVE,
+													"ike_sa_manager.segment");
 		this->segments[i].count = 0;
 	}
 
@@ -2177,7 +2405,8 @@ ike_sa_manager_t *ike_sa_manager_create()
 	this->half_open_segments = calloc(this->segment_count, sizeof(shareable_segment_t));
 	for (i = 0; i < this->segment_count; i++)
 	{
-		this->half_open_segments[i].lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
+		this->half_open_segments[i].lock = rwlock_create_named(
+						RWLOCK_TYPE_DEFAULT, "ike_sa_manager.half_open");
 		this->half_open_segments[i].count = 0;
 	}
 
@@ -2186,7 +2415,8 @@ ike_sa_manager_t *ike_sa_manager_create()
 	this->connected_peers_segments = calloc(this->segment_count, sizeof(shareable_segment_t));
 	for (i = 0; i < this->segment_count; i++)
 	{
-		this->connected_peers_segments[i].lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
+		this->connected_peers_segments[i].lock = rwlock_create_named(
+						RWLOCK_TYPE_DEFAULT, "ike_sa_manager.connected_peers");
 		this->connected_peers_segments[i].count = 0;
 	}
 
@@ -2195,11 +2425,21 @@ ike_sa_manager_t *ike_sa_manager_create()
 	this->init_hashes_segments = calloc(this->segment_count, sizeof(segment_t));
 	for (i = 0; i < this->segment_count; i++)
 	{
-		this->init_hashes_segments[i].mutex = mutex_create(MUTEX_TYPE_RECURSIVE);
+		this->init_hashes_segments[i].mutex = mutex_create_named(
+						MUTEX_TYPE_RECURSIVE, "ike_sa_manager.init_hashes");
 		this->init_hashes_segments[i].count = 0;
 	}
 
 	this->reuse_ikesa = lib->settings->get_bool(lib->settings,
 										"%s.reuse_ikesa", TRUE, charon->name);
+
+	this->count_metric = lib->metrics->create_gauge(lib->metrics,
+								"ike_sas", NULL, "Number of IKE_SAs",
+								(metric_gauge_cb_t)get_count_metric, this);
+	this->half_open_metric = lib->metrics->create_gauge(lib->metrics,
+								"ike_sas_half_open", NULL,
+								"Number of half-open IKE_SAs",
+								(metric_gauge_cb_t)get_half_open_metric, this);
+	this->summarizer_lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
 	return &this->public;
 }
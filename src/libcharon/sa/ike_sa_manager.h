@@ -30,6 +30,43 @@ typedef struct ike_sa_manager_t ike_sa_manager_t;
 #include <encoding/message.h>
 #include <config/peer_cfg.h>
 
+typedef struct ike_sa_summarizer_t ike_sa_summarizer_t;
+
+/**
+ * Summarizes IKE_SAs, see ike_sa_manager_t.set_summarizer().
+ *
+ * Summaries are opaque to the IKE_SA manager, but reference counted, as the
+ * manager keeps a summary of each IKE_SA while handing out references to it.
+ */
+struct ike_sa_summarizer_t {
+
+	/**
+	 * Summarize an IKE_SA.
+	 *
+	 * This gets invoked while the IKE_SA is checked in, or while the lock of
+	 * its segment is held, so it must not block nor call into the manager.
+	 *
+	 * @param ike_sa		IKE_SA to summarize
+	 * @return				summary of the IKE_SA, with a reference
+	 */
+	void* (*summarize)(ike_sa_summarizer_t *this, ike_sa_t *ike_sa);
+
+	/**
+	 * Get an additional reference to a summary.
+	 *
+	 * @param summary		summary to reference
+	 * @return				summary
+	 */
+	void* (*get_ref)(ike_sa_summarizer_t *this, void *summary);
+
+	/**
+	 * Release a reference to a summary.
+	 *
+	 * @param summary		summary to release
+	 */
+	void (*release)(ike_sa_summarizer_t *this, void *summary);
+};
+
 /**
  * Manages and synchronizes access to all IKE_SAs.
  *
@@ -169,6 +206,35 @@ struct ike_sa_manager_t {
 	 */
 	enumerator_t *(*create_enumerator) (ike_sa_manager_t* this, bool wait);
 
+	/**
+	 * Register the summarizer to keep a summary of each IKE_SA.
+	 *
+	 * The summary of an IKE_SA gets refreshed whenever it is checked in, so
+	 * create_summary_enumerator() can provide the summaries of IKE_SAs
+	 * checked out by other threads. Summaries of the previously registered
+	 * summarizer get released before this returns.
+	 *
+	 * @param summarizer		summarizer to register, NULL to unregister
+	 */
+	void (*set_summarizer) (ike_sa_manager_t* this,
+							ike_sa_summarizer_t *summarizer);
+
+	/**
+	 * Create an enumerator over summaries of all stored IKE_SAs.
+	 *
+	 * Unlike create_enumerator(), IKE_SAs don't get checked out and no lock is
+	 * held while the caller processes a summary. IKE_SAs checked out by other
+	 * threads are not waited for, the summary from their last check-in gets
+	 * enumerated instead. If there is none, e.g. because the IKE_SA has not
+	 * been checked in yet, NULL gets enumerated. The caller has to release
+	 * each enumerated summary via the registered summarizer. IKE_SAs added
+	 * after the creation of the enumerator are not enumerated. This requires
+	 * a registered summarizer, see set_summarizer().
+	 *
+	 * @return					enumerator over summaries (void*)
+	 */
+	enumerator_t *(*create_summary_enumerator) (ike_sa_manager_t* this);
+
 	/**
 	 * Create an enumerator over ike_sa_id_t*, matching peer identities.
 	 *
@@ -1100,6 +1100,10 @@ METHOD(keymat_t, get_version, ike_version_t,
 METHOD(keymat_t, create_dh, diffie_hellman_t*,
 	private_keymat_v1_t *this, diffie_hellman_group_t group)
 {
+	if (charon->dh_pool)
+	{
+		return charon->dh_pool->create_dh(charon->dh_pool, group);
+	}
 	return lib->crypto->create_dh(lib->crypto, group);
 }
 
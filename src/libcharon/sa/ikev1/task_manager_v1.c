@@ -1595,6 +1595,12 @@ METHOD(task_manager_t, process_message, status_t,
 	return SUCCESS;
 }
 
+METHOD(task_manager_t, resume, status_t,
+	private_task_manager_t *this)
+{	/* IKEv1 tasks do not get suspended */
+	return SUCCESS;
+}
+
 METHOD(task_manager_t, queue_task, void,
 	private_task_manager_t *this, task_t *task)
 {
@@ -2052,6 +2058,7 @@ task_manager_v1_t *task_manager_v1_create(ike_sa_t *ike_sa)
 		.public = {
 			.task_manager = {
 				.process_message = _process_message,
+				.resume = _resume,
 				.queue_task = _queue_task,
 				.queue_ike = _queue_ike,
 				.queue_ike_rekey = _queue_ike_rekey,
@@ -22,6 +22,7 @@
 #include <sa/ikev2/keymat_v2.h>
 
 typedef struct private_pubkey_authenticator_t private_pubkey_authenticator_t;
+typedef struct sign_op_t sign_op_t;
 
 /**
  * Private data of an pubkey_authenticator_t object.
@@ -52,20 +53,124 @@ struct private_pubkey_authenticator_t {
 	 * Reserved bytes of ID payload
 	 */
 	char reserved[3];
+
+	/**
+	 * pending operation creating the signature in the DH pool
+	 */
+	sign_op_t *op;
 };
 
+/**
+ * Operation creating the AUTH signature
+ */
+struct sign_op_t {
+
+	/**
+	 * Implements dh_pool_op_t
+	 */
+	dh_pool_op_t public;
+
+	/**
+	 * private key to sign with
+	 */
+	private_key_t *private;
+
+	/**
+	 * signature scheme to use
+	 */
+	signature_scheme_t scheme;
+
+	/**
+	 * AUTH method the scheme maps to
+	 */
+	auth_method_t auth_method;
+
+	/**
+	 * octets to sign
+	 */
+	chunk_t octets;
+
+	/**
+	 * created signature, if any
+	 */
+	chunk_t auth_data;
+
+	/**
+	 * reference count
+	 */
+	refcount_t ref;
+};
+
+METHOD(dh_pool_op_t, sign_op_execute, void,
+	sign_op_t *this)
+{
+	if (!this->private->sign(this->private, this->scheme, this->octets,
+							 &this->auth_data))
+	{
+		this->auth_data = chunk_empty;
+	}
+}
+
+METHOD(dh_pool_op_t, sign_op_get_ref, dh_pool_op_t*,
+	sign_op_t *this)
+{
+	ref_get(&this->ref);
+	return &this->public;
+}
+
+METHOD(dh_pool_op_t, sign_op_destroy, void,
+	sign_op_t *this)
+{
+	if (ref_put(&this->ref))
+	{
+		this->private->destroy(this->private);
+		chunk_free(&this->octets);
+		chunk_free(&this->auth_data);
+		free(this);
+	}
+}
+
+/**
+ * Add the AUTH payload with the signature of an executed operation
+ */
+static status_t add_auth_payload(private_pubkey_authenticator_t *this,
+								 message_t *message, sign_op_t *op)
+{
+	auth_payload_t *auth_payload;
+	status_t status = FAILED;
+
+	if (op->auth_data.len)
+	{
+		auth_payload = auth_payload_create();
+		auth_payload->set_auth_method(auth_payload, op->auth_method);
+		auth_payload->set_data(auth_payload, op->auth_data);
+		message->add_payload(message, (payload_t*)auth_payload);
+		status = SUCCESS;
+	}
+	DBG1(DBG_IKE, "authentication of '%Y' (myself) with %N %s",
+		 this->ike_sa->get_my_id(this->ike_sa), auth_method_names,
+		 op->auth_method, (status == SUCCESS)? "successful":"failed");
+	op->public.destroy(&op->public);
+	return status;
+}
+
 METHOD(authenticator_t, build, status_t,
 	private_pubkey_authenticator_t *this, message_t *message)
 {
-	chunk_t octets = chunk_empty, auth_data;
-	status_t status = FAILED;
 	private_key_t *private;
 	identification_t *id;
 	auth_cfg_t *auth;
-	auth_payload_t *auth_payload;
 	auth_method_t auth_method;
 	signature_scheme_t scheme;
 	keymat_v2_t *keymat;
+	sign_op_t *op;
+
+	if (this->op)
+	{	/* resumed, the DH pool created the signature */
+		op = this->op;
+		this->op = NULL;
+		return add_auth_payload(this, message, op);
+	}
 
 	id = this->ike_sa->get_my_id(this->ike_sa);
 	auth = this->ike_sa->get_auth_cfg(this->ike_sa, TRUE);
@@ -103,33 +208,44 @@ METHOD(authenticator_t, build, status_t,
 				default:
 					DBG1(DBG_IKE, "%d bit ECDSA private key size not supported",
 							private->get_keysize(private));
-					return status;
+					private->destroy(private);
+					return FAILED;
 			}
 			break;
 		default:
 			DBG1(DBG_IKE, "private key of type %N not supported",
 					key_type_names, private->get_type(private));
-			return status;
+			private->destroy(private);
+			return FAILED;
 	}
+
+	INIT(op,
+		.public = {
+			.execute = _sign_op_execute,
+			.get_ref = _sign_op_get_ref,
+			.destroy = _sign_op_destroy,
+		},
+		.private = private,
+		.scheme = scheme,
+		.auth_method = auth_method,
+		.ref = 1,
+	);
 	keymat = (keymat_v2_t*)this->ike_sa->get_keymat(this->ike_sa);
-	if (keymat->get_auth_octets(keymat, FALSE, this->ike_sa_init,
-								this->nonce, id, this->reserved, &octets) &&
-		private->sign(private, scheme, octets, &auth_data))
+	if (!keymat->get_auth_octets(keymat, FALSE, this->ike_sa_init,
+								 this->nonce, id, this->reserved, &op->octets))
 	{
-		auth_payload = auth_payload_create();
-		auth_payload->set_auth_method(auth_payload, auth_method);
-		auth_payload->set_data(auth_payload, auth_data);
-		chunk_free(&auth_data);
-		message->add_payload(message, (payload_t*)auth_payload);
-		status = SUCCESS;
+		return add_auth_payload(this, message, op);
 	}
-	DBG1(DBG_IKE, "authentication of '%Y' (myself) with %N %s", id,
-		 auth_method_names, auth_method,
-		 (status == SUCCESS)? "successful":"failed");
-	chunk_free(&octets);
-	private->destroy(private);
-
-	return status;
+	/* the task manager supports suspending while building responses only */
+	if (!message->get_request(message) && charon->dh_pool &&
+		charon->dh_pool->queue_op(charon->dh_pool,
+							this->ike_sa->get_id(this->ike_sa), &op->public))
+	{
+		this->op = op;
+		return SUSPENDED;
+	}
+	op->public.execute(&op->public);
+	return add_auth_payload(this, message, op);
 }
 
 METHOD(authenticator_t, process, status_t,
@@ -214,6 +330,10 @@ METHOD(authenticator_t, process, status_t,
 METHOD(authenticator_t, destroy, void,
 	private_pubkey_authenticator_t *this)
 {
+	if (this->op)
+	{
+		this->op->public.destroy(&this->op->public);
+	}
 	free(this);
 }
 
@@ -94,6 +94,16 @@ struct private_task_manager_t {
 		 */
 		packet_t *packet;
 
+		/**
+		 * response partially built while a task is suspended
+		 */
+		message_t *message;
+
+		/**
+		 * suspended task to resume building the response with
+		 */
+		task_t *task;
+
 	} responding;
 
 	/**
@@ -110,6 +120,11 @@ struct private_task_manager_t {
 		 */
 		u_int retransmitted;
 
+		/**
+		 * time the request was sent first
+		 */
+		timeval_t sent;
+
 		/**
 		 * packet for retransmission
 		 */
@@ -192,6 +207,9 @@ static void flush(private_task_manager_t *this)
 	flush_queue(this, TASK_QUEUE_QUEUED);
 	flush_queue(this, TASK_QUEUE_PASSIVE);
 	flush_queue(this, TASK_QUEUE_ACTIVE);
+	DESTROY_IF(this->responding.message);
+	this->responding.message = NULL;
+	this->responding.task = NULL;
 }
 
 /**
@@ -247,6 +265,10 @@ METHOD(task_manager_t, retransmit, status_t,
 		}
 		enumerator->destroy(enumerator);
 
+		if (!this->initiating.retransmitted)
+		{
+			time_monotonic(&this->initiating.sent);
+		}
 		if (mobike == NULL)
 		{
 			if (this->initiating.retransmitted <= this->retransmit_tries)
@@ -531,6 +553,11 @@ static status_t process_response(private_task_manager_t *this,
 		charon->bus->ike_updown(charon->bus, this->ike_sa, FALSE);
 		return DESTROY_ME;
 	}
+	if (this->initiating.retransmitted == 1)
+	{	/* the response is ambiguous if the request has been retransmitted */
+		charon->exchange_rtt->observe_since(charon->exchange_rtt,
+											&this->initiating.sent);
+	}
 
 	/* catch if we get resetted while processing */
 	this->reset = FALSE;
@@ -630,31 +657,31 @@ static bool handle_collisions(private_task_manager_t *this, task_t *task)
 /**
  * build a response depending on the "passive" task list
  */
-static status_t build_response(private_task_manager_t *this, message_t *request)
+/**
+ * Let the passive tasks build a response and send it, if resume is given
+ * starting with that suspended task
+ */
+static status_t build_passive(private_task_manager_t *this, message_t *message,
+							  task_t *resume)
 {
 	enumerator_t *enumerator;
 	task_t *task;
-	message_t *message;
-	host_t *me, *other;
 	bool delete = FALSE, hook = FALSE;
 	ike_sa_id_t *id = NULL;
 	u_int64_t responder_spi;
 	status_t status;
 
-	me = request->get_destination(request);
-	other = request->get_source(request);
-
-	message = message_create(IKEV2_MAJOR_VERSION, IKEV2_MINOR_VERSION);
-	message->set_exchange_type(message, request->get_exchange_type(request));
-	/* send response along the path the request came in */
-	message->set_source(message, me->clone(me));
-	message->set_destination(message, other->clone(other));
-	message->set_message_id(message, this->responding.mid);
-	message->set_request(message, FALSE);
-
 	enumerator = array_create_enumerator(this->passive_tasks);
 	while (enumerator->enumerate(enumerator, (void*)&task))
 	{
+		if (resume)
+		{	/* skip tasks that built their payloads before suspending */
+			if (task != resume)
+			{
+				continue;
+			}
+			resume = NULL;
+		}
 		switch (task->build(task, message))
 		{
 			case SUCCESS:
@@ -672,6 +699,12 @@ static status_t build_response(private_task_manager_t *this, message_t *request)
 					array_remove_at(this->passive_tasks, enumerator);
 				}
 				break;
+			case SUSPENDED:
+				/* task gets called again once resumed */
+				enumerator->destroy(enumerator);
+				this->responding.message = message;
+				this->responding.task = task;
+				return SUSPENDED;
 			case FAILED:
 			default:
 				hook = TRUE;
@@ -693,7 +726,7 @@ static status_t build_response(private_task_manager_t *this, message_t *request)
 	 * actually explicitly allows it to be non-zero.  Since we use the responder
 	 * SPI to create hashes in the IKE_SA manager we can only set the SPI to
 	 * zero temporarily, otherwise checking the SA in would fail. */
-	if (delete && request->get_exchange_type(request) == IKE_SA_INIT)
+	if (delete && message->get_exchange_type(message) == IKE_SA_INIT)
 	{
 		id = this->ike_sa->get_id(this->ike_sa);
 		responder_spi = id->get_responder_spi(id);
@@ -732,6 +765,28 @@ static status_t build_response(private_task_manager_t *this, message_t *request)
 	return SUCCESS;
 }
 
+/**
+ * Build a response to a processed request and send it
+ */
+static status_t build_response(private_task_manager_t *this, message_t *request)
+{
+	message_t *message;
+	host_t *me, *other;
+
+	me = request->get_destination(request);
+	other = request->get_source(request);
+
+	message = message_create(IKEV2_MAJOR_VERSION, IKEV2_MINOR_VERSION);
+	message->set_exchange_type(message, request->get_exchange_type(request));
+	/* send response along the path the request came in */
+	message->set_source(message, me->clone(me));
+	message->set_destination(message, other->clone(other));
+	message->set_message_id(message, this->responding.mid);
+	message->set_request(message, FALSE);
+
+	return build_passive(this, message, NULL);
+}
+
 /**
  * handle an incoming request message
  */
@@ -1131,7 +1186,12 @@ METHOD(task_manager_t, process_message, status_t,
 	mid = msg->get_message_id(msg);
 	if (msg->get_request(msg))
 	{
-		if (mid == this->responding.mid)
+		if (mid == this->responding.mid && this->responding.task)
+		{
+			DBG1(DBG_IKE, "received retransmit of request with ID %d, "
+				 "response not yet built", mid);
+		}
+		else if (mid == this->responding.mid)
 		{
 			/* reject initial messages once established */
 			if (msg->get_exchange_type(msg) == IKE_SA_INIT ||
@@ -1154,12 +1214,16 @@ METHOD(task_manager_t, process_message, status_t,
 			{	/* ignore messages altered to EXCHANGE_TYPE_UNDEFINED */
 				return SUCCESS;
 			}
-			if (process_request(this, msg) != SUCCESS)
+			status = process_request(this, msg);
+			if (status != SUCCESS && status != SUSPENDED)
 			{
 				flush(this);
 				return DESTROY_ME;
 			}
-			this->responding.mid++;
+			if (status == SUCCESS)
+			{	/* a suspended response gets completed once resumed */
+				this->responding.mid++;
+			}
 		}
 		else if ((mid == this->responding.mid - 1) && this->responding.packet)
 		{
@@ -1236,6 +1300,34 @@ METHOD(task_manager_t, process_message, status_t,
 	return SUCCESS;
 }
 
+METHOD(task_manager_t, resume, status_t,
+	private_task_manager_t *this)
+{
+	message_t *message;
+	task_t *task;
+
+	message = this->responding.message;
+	task = this->responding.task;
+	if (!task)
+	{	/* flushed while suspended */
+		return SUCCESS;
+	}
+	this->responding.message = NULL;
+	this->responding.task = NULL;
+
+	switch (build_passive(this, message, task))
+	{
+		case SUCCESS:
+			this->responding.mid++;
+			return SUCCESS;
+		case SUSPENDED:
+			return SUCCESS;
+		default:
+			flush(this);
+			return DESTROY_ME;
+	}
+}
+
 METHOD(task_manager_t, queue_task, void,
 	private_task_manager_t *this, task_t *task)
 {
@@ -1551,6 +1643,7 @@ task_manager_v2_t *task_manager_v2_create(ike_sa_t *ike_sa)
 		.public = {
 			.task_manager = {
 				.process_message = _process_message,
+				.resume = _resume,
 				.queue_task = _queue_task,
 				.queue_ike = _queue_ike,
 				.queue_ike_rekey = _queue_ike_rekey,
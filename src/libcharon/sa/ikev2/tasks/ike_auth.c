@@ -112,6 +112,11 @@ struct private_ike_auth_t {
 	 * received an INITIAL_CONTACT?
 	 */
 	bool initial_contact;
+
+	/**
+	 * building my_auth got suspended, skip preceding steps when resumed
+	 */
+	bool my_auth_suspended;
 };
 
 /**
@@ -769,7 +774,7 @@ METHOD(task_t, build_r, status_t,
 		}
 	}
 
-	if (this->other_auth)
+	if (this->other_auth && !this->my_auth_suspended)
 	{
 		switch (this->other_auth->build(this->other_auth, message))
 		{
@@ -787,6 +792,7 @@ METHOD(task_t, build_r, status_t,
 				goto peer_auth_failed;
 		}
 	}
+	this->my_auth_suspended = FALSE;
 	if (this->my_auth)
 	{
 		switch (this->my_auth->build(this->my_auth, message))
@@ -798,6 +804,9 @@ METHOD(task_t, build_r, status_t,
 				break;
 			case NEED_MORE:
 				break;
+			case SUSPENDED:
+				this->my_auth_suspended = TRUE;
+				return SUSPENDED;
 			default:
 				goto local_auth_failed;
 		}
@@ -30,6 +30,7 @@
 #define MAX_RETRIES 5
 
 typedef struct private_ike_init_t private_ike_init_t;
+typedef struct dh_op_t dh_op_t;
 
 /**
  * Private members of a ike_init_t task.
@@ -100,8 +101,103 @@ struct private_ike_init_t {
 	 * retries done so far after failure (cookie or bad dh group)
 	 */
 	u_int retry;
+
+	/**
+	 * public value of peer, not yet applied to dh
+	 */
+	chunk_t other_ke;
+
+	/**
+	 * pending operation applying other_ke in the DH pool
+	 */
+	dh_op_t *op;
 };
 
+/**
+ * Operation applying the public value of the peer, computing the secret
+ */
+struct dh_op_t {
+
+	/**
+	 * Implements dh_pool_op_t
+	 */
+	dh_pool_op_t public;
+
+	/**
+	 * DH object to apply the value to
+	 */
+	diffie_hellman_t *dh;
+
+	/**
+	 * public value of peer
+	 */
+	chunk_t value;
+
+	/**
+	 * reference count
+	 */
+	refcount_t ref;
+};
+
+METHOD(dh_pool_op_t, dh_op_execute, void,
+	dh_op_t *this)
+{
+	this->dh->set_other_public_value(this->dh, this->value);
+}
+
+METHOD(dh_pool_op_t, dh_op_get_ref, dh_pool_op_t*,
+	dh_op_t *this)
+{
+	ref_get(&this->ref);
+	return &this->public;
+}
+
+METHOD(dh_pool_op_t, dh_op_destroy, void,
+	dh_op_t *this)
+{
+	if (ref_put(&this->ref))
+	{
+		DESTROY_IF(this->dh);
+		chunk_free(&this->value);
+		free(this);
+	}
+}
+
+/**
+ * Apply the public value of the peer, asynchronously if the DH pool does so.
+ * Returns TRUE if the operation has been queued.
+ */
+static bool apply_other_ke(private_ike_init_t *this)
+{
+	dh_op_t *op;
+
+	INIT(op,
+		.public = {
+			.execute = _dh_op_execute,
+			.get_ref = _dh_op_get_ref,
+			.destroy = _dh_op_destroy,
+		},
+		.dh = this->dh,
+		.value = this->other_ke,
+		.ref = 1,
+	);
+	this->dh = NULL;
+	this->other_ke = chunk_empty;
+
+	if (charon->dh_pool &&
+		charon->dh_pool->queue_op(charon->dh_pool,
+							this->ike_sa->get_id(this->ike_sa), &op->public))
+	{
+		this->op = op;
+		return TRUE;
+	}
+	op->public.execute(&op->public);
+	this->dh = op->dh;
+	op->dh = NULL;
+	op->public.destroy(&op->public);
+	return FALSE;
+}
+
 /**
  * build the payloads for the message
  */
@@ -206,7 +302,13 @@ static void process_payloads(private_ike_init_t *this, message_t *message)
 					this->dh = this->keymat->keymat.create_dh(
 										&this->keymat->keymat, this->dh_group);
 				}
-				if (this->dh)
+				if (this->dh && !this->initiator && !this->old_sa)
+				{	/* applied when building the IKE_SA_INIT response */
+					chunk_free(&this->other_ke);
+					this->other_ke = chunk_clone(
+								ke_payload->get_key_exchange_data(ke_payload));
+				}
+				else if (this->dh)
 				{
 					this->dh->set_other_public_value(this->dh,
 								ke_payload->get_key_exchange_data(ke_payload));
@@ -377,6 +479,14 @@ static bool derive_keys(private_ike_init_t *this,
 METHOD(task_t, build_r, status_t,
 	private_ike_init_t *this, message_t *message)
 {
+	if (this->op)
+	{	/* resumed, pick up the DH object with the computed secret */
+		this->dh = this->op->dh;
+		this->op->dh = NULL;
+		this->op->public.destroy(&this->op->public);
+		this->op = NULL;
+	}
+
 	/* check if we have everything we need */
 	if (this->proposal == NULL ||
 		this->other_nonce.len == 0 || this->my_nonce.len == 0)
@@ -410,6 +520,10 @@ METHOD(task_t, build_r, status_t,
 		return FAILED;
 	}
 
+	if (this->other_ke.ptr && apply_other_ke(this))
+	{
+		return SUSPENDED;
+	}
 	if (!derive_keys(this, this->other_nonce, this->my_nonce))
 	{
 		DBG1(DBG_IKE, "key derivation failed");
@@ -565,8 +679,13 @@ METHOD(task_t, migrate, void,
 METHOD(task_t, destroy, void,
 	private_ike_init_t *this)
 {
+	if (this->op)
+	{
+		this->op->public.destroy(&this->op->public);
+	}
 	DESTROY_IF(this->dh);
 	DESTROY_IF(this->proposal);
+	chunk_free(&this->other_ke);
 	chunk_free(&this->my_nonce);
 	chunk_free(&this->other_nonce);
 	chunk_free(&this->cookie);
@@ -132,6 +132,7 @@ struct task_t {
 	 *						- DESTROY_ME if IKE_SA has been properly deleted
 	 *						- NEED_MORE if another call to build/process needed
 	 *						- ALREADY_DONE to cancel task processing
+	 *						- SUSPENDED to resume building a response later
 	 *						- SUCCESS if task completed
 	 */
 	status_t (*build) (task_t *this, message_t *message);
@@ -112,6 +112,18 @@ struct task_manager_t {
 	 */
 	status_t (*process_message) (task_manager_t *this, message_t *message);
 
+	/**
+	 * Resume processing of a message suspended by a task.
+	 *
+	 * Tasks return SUSPENDED while they wait for an asynchronous operation,
+	 * the suspended task gets called again once it completed.
+	 *
+	 * @return
+	 *						- DESTROY_ME if IKE_SA must be closed
+	 *						- SUCCESS otherwise
+	 */
+	status_t (*resume) (task_manager_t *this);
+
 	/**
 	 * Initiate an exchange with the currently queued tasks.
 	 */
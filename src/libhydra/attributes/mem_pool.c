@@ -26,6 +26,8 @@
 #define POOL_LIMIT (sizeof(u_int)*8 - 1)
 
 typedef struct private_mem_pool_t private_mem_pool_t;
+typedef struct entry_t entry_t;
+typedef struct lease_t lease_t;
 
 /**
  * private data of mem_pool_t
@@ -61,6 +63,26 @@ struct private_mem_pool_t {
 	 */
 	hashtable_t *leases;
 
+	/**
+	 * oldest offline lease, reassigned first
+	 */
+	lease_t *oldest;
+
+	/**
+	 * most recent offline lease
+	 */
+	lease_t *newest;
+
+	/**
+	 * number of online leases
+	 */
+	u_int online;
+
+	/**
+	 * number of offline leases
+	 */
+	u_int offline;
+
 	/**
 	 * lock to safely access the pool
 	 */
@@ -75,14 +97,28 @@ struct private_mem_pool_t {
 /**
  * Lease entry.
  */
-typedef struct {
+struct entry_t {
 	/* identitiy reference */
 	identification_t *id;
 	/* array of online leases, as u_int offset */
 	array_t *online;
-	/* array of offline leases, as u_int offset */
+	/* array of offline leases, as lease_t */
 	array_t *offline;
-} entry_t;
+};
+
+/**
+ * Offline lease, queued in the pool for reassignment.
+ */
+struct lease_t {
+	/* offset of the leased address */
+	u_int offset;
+	/* entry holding the lease */
+	entry_t *entry;
+	/* previous offline lease in pool, went offline before this one */
+	lease_t *prev;
+	/* next offline lease in pool, went offline after this one */
+	lease_t *next;
+};
 
 /**
  * Create a new entry
@@ -94,11 +130,91 @@ static entry_t* entry_create(identification_t *id)
 	INIT(entry,
 		.id = id->clone(id),
 		.online = array_create(sizeof(u_int), 0),
-		.offline = array_create(sizeof(u_int), 0),
+		.offline = array_create(0, 0),
 	);
 	return entry;
 }
 
+/**
+ * Destroy an entry
+ */
+static void entry_destroy(entry_t *entry)
+{
+	entry->id->destroy(entry->id);
+	array_destroy(entry->online);
+	array_destroy_function(entry->offline, (void*)free, NULL);
+	free(entry);
+}
+
+/**
+ * Get the entry of an identity, create one if it does not exist
+ */
+static entry_t* get_entry(private_mem_pool_t *this, identification_t *id)
+{
+	entry_t *entry;
+
+	entry = this->leases->get(this->leases, id);
+	if (!entry)
+	{
+		entry = entry_create(id);
+		this->leases->put(this->leases, entry->id, entry);
+	}
+	return entry;
+}
+
+/**
+ * Make a lease of an entry offline, queue it as most recent offline lease
+ */
+static void make_offline(private_mem_pool_t *this, entry_t *entry, u_int offset)
+{
+	lease_t *lease;
+
+	INIT(lease,
+		.offset = offset,
+		.entry = entry,
+		.prev = this->newest,
+	);
+	if (this->newest)
+	{
+		this->newest->next = lease;
+	}
+	else
+	{
+		this->oldest = lease;
+	}
+	this->newest = lease;
+	array_insert(entry->offline, ARRAY_TAIL, lease);
+	this->offline++;
+}
+
+/**
+ * Take an offline lease out of the queue, returns its offset
+ */
+static u_int take_offline(private_mem_pool_t *this, lease_t *lease)
+{
+	u_int offset = lease->offset;
+
+	if (lease->prev)
+	{
+		lease->prev->next = lease->next;
+	}
+	else
+	{
+		this->oldest = lease->next;
+	}
+	if (lease->next)
+	{
+		lease->next->prev = lease->prev;
+	}
+	else
+	{
+		this->newest = lease->prev;
+	}
+	this->offline--;
+	free(lease);
+	return offset;
+}
+
 /**
  * hashtable hash function for identities
  */
@@ -199,17 +315,10 @@ METHOD(mem_pool_t, get_size, u_int,
 METHOD(mem_pool_t, get_online, u_int,
 	private_mem_pool_t *this)
 {
-	enumerator_t *enumerator;
-	entry_t *entry;
-	u_int count = 0;
+	u_int count;
 
 	this->mutex->lock(this->mutex);
-	enumerator = this->leases->create_enumerator(this->leases);
-	while (enumerator->enumerate(enumerator, NULL, &entry))
-	{
-		count += array_count(entry->online);
-	}
-	enumerator->destroy(enumerator);
+	count = this->online;
 	this->mutex->unlock(this->mutex);
 
 	return count;
@@ -218,17 +327,10 @@ METHOD(mem_pool_t, get_online, u_int,
 METHOD(mem_pool_t, get_offline, u_int,
 	private_mem_pool_t *this)
 {
-	enumerator_t *enumerator;
-	entry_t *entry;
-	u_int count = 0;
+	u_int count;
 
 	this->mutex->lock(this->mutex);
-	enumerator = this->leases->create_enumerator(this->leases);
-	while (enumerator->enumerate(enumerator, NULL, &entry))
-	{
-		count += array_count(entry->offline);
-	}
-	enumerator->destroy(enumerator);
+	count = this->offline;
 	this->mutex->unlock(this->mutex);
 
 	return count;
@@ -243,7 +345,8 @@ static int get_existing(private_mem_pool_t *this, identification_t *id,
 	enumerator_t *enumerator;
 	u_int *current;
 	entry_t *entry;
-	int offset = 0;
+	lease_t *lease;
+	u_int offset = 0;
 
 	entry = this->leases->get(this->leases, id);
 	if (!entry)
@@ -252,16 +355,11 @@ static int get_existing(private_mem_pool_t *this, identification_t *id,
 	}
 
 	/* check for a valid offline lease, refresh */
-	enumerator = array_create_enumerator(entry->offline);
-	if (enumerator->enumerate(enumerator, &current))
-	{
-		offset = *current;
-		array_insert(entry->online, ARRAY_TAIL, current);
-		array_remove_at(entry->offline, enumerator);
-	}
-	enumerator->destroy(enumerator);
-	if (offset)
+	if (array_remove(entry->offline, ARRAY_HEAD, &lease))
 	{
+		offset = take_offline(this, lease);
+		array_insert(entry->online, ARRAY_TAIL, &offset);
+		this->online++;
 		DBG1(DBG_CFG, "reassigning offline lease to '%Y'", id);
 		return offset;
 	}
@@ -278,6 +376,7 @@ static int get_existing(private_mem_pool_t *this, identification_t *id,
 			offset = *current;
 			/* add an additional "online" entry */
 			array_insert(entry->online, ARRAY_TAIL, current);
+			this->online++;
 			break;
 		}
 	}
@@ -299,15 +398,11 @@ static int get_new(private_mem_pool_t *this, identification_t *id)
 
 	if (this->unused < this->size)
 	{
-		entry = this->leases->get(this->leases, id);
-		if (!entry)
-		{
-			entry = entry_create(id);
-			this->leases->put(this->leases, entry->id, entry);
-		}
+		entry = get_entry(this, id);
 		/* assigning offset, starting by 1 */
 		offset = ++this->unused;
 		array_insert(entry->online, ARRAY_TAIL, &offset);
+		this->online++;
 		DBG1(DBG_CFG, "assigning new lease to '%Y'", id);
 	}
 	return offset;
@@ -320,27 +415,38 @@ static int get_reassigned(private_mem_pool_t *this, identification_t *id)
 {
 	enumerator_t *enumerator;
 	entry_t *entry;
-	u_int current, offset = 0;
+	lease_t *lease, *current;
+	u_int offset;
 
-	enumerator = this->leases->create_enumerator(this->leases);
-	while (enumerator->enumerate(enumerator, NULL, &entry))
+	/* the lease being offline for the longest time gets reassigned */
+	lease = this->oldest;
+	if (!lease)
 	{
-		if (array_remove(entry->offline, ARRAY_HEAD, &current))
+		return 0;
+	}
+	entry = lease->entry;
+	enumerator = array_create_enumerator(entry->offline);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (current == lease)
 		{
-			offset = current;
-			DBG1(DBG_CFG, "reassigning existing offline lease by '%Y'"
-				 " to '%Y'", entry->id, id);
+			array_remove_at(entry->offline, enumerator);
 			break;
 		}
 	}
 	enumerator->destroy(enumerator);
-
-	if (offset)
-	{
-		entry = entry_create(id);
-		array_insert(entry->online, ARRAY_TAIL, &offset);
-		this->leases->put(this->leases, entry->id, entry);
+	DBG1(DBG_CFG, "reassigning existing offline lease by '%Y'"
+		 " to '%Y'", entry->id, id);
+	offset = take_offline(this, lease);
+
+	if (!array_count(entry->online) && !array_count(entry->offline))
+	{	/* previous holder has no leases left */
+		this->leases->remove(this->leases, entry->id);
+		entry_destroy(entry);
 	}
+	entry = get_entry(this, id);
+	array_insert(entry->online, ARRAY_TAIL, &offset);
+	this->online++;
 	return offset;
 }
 
@@ -427,10 +533,14 @@ METHOD(mem_pool_t, release_address, bool,
 			}
 			enumerator->destroy(enumerator);
 
+			if (found)
+			{
+				this->online--;
+			}
 			if (found && !more)
 			{
 				/* no tunnels are online anymore for this lease, make offline */
-				array_insert(entry->offline, ARRAY_TAIL, &offset);
+				make_offline(this, entry, offset);
 				DBG1(DBG_CFG, "lease %H by '%Y' went offline", address, id);
 			}
 		}
@@ -462,6 +572,7 @@ typedef struct {
 METHOD(enumerator_t, lease_enumerate, bool,
 	lease_enumerator_t *this, identification_t **id, host_t **addr, bool *online)
 {
+	lease_t *lease;
 	u_int *offset;
 
 	DESTROY_IF(this->addr);
@@ -478,10 +589,10 @@ METHOD(enumerator_t, lease_enumerate, bool,
 				*online = TRUE;
 				return TRUE;
 			}
-			if (this->offline->enumerate(this->offline, &offset))
+			if (this->offline->enumerate(this->offline, &lease))
 			{
 				*id = this->entry->id;
-				*addr = this->addr = offset2host(this->pool, *offset);
+				*addr = this->addr = offset2host(this->pool, lease->offset);
 				*online = FALSE;
 				return TRUE;
 			}
@@ -535,10 +646,7 @@ METHOD(mem_pool_t, destroy, void,
 	enumerator = this->leases->create_enumerator(this->leases);
 	while (enumerator->enumerate(enumerator, NULL, &entry))
 	{
-		entry->id->destroy(entry->id);
-		array_destroy(entry->online);
-		array_destroy(entry->offline);
-		free(entry);
+		entry_destroy(entry);
 	}
 	enumerator->destroy(enumerator);
 
@@ -17,8 +17,12 @@
 
 #include <utils/debug.h>
 #include <library.h>
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
 
 #include "sql_attribute.h"
+#include "sql_lease_cache.h"
 
 typedef struct private_sql_attribute_t private_sql_attribute_t;
 
@@ -41,12 +45,53 @@ struct private_sql_attribute_t {
 	 * whether to record lease history in lease table
 	 */
 	bool history;
+
+	/**
+	 * in-memory lease engine, NULL to query the database for each lease
+	 */
+	sql_lease_cache_t *cache;
+
+	/**
+	 * cached identity rows, identification_t => u_int, NULL if no lease cache
+	 */
+	hashtable_t *identities;
+
+	/**
+	 * cached identities in insertion order, identification_t
+	 */
+	linked_list_t *identity_order;
+
+	/**
+	 * maximum number of cached identities
+	 */
+	u_int identity_max;
+
+	/**
+	 * lock for identity cache
+	 */
+	mutex_t *mutex;
 };
 
+/**
+ * hashtable hash function for identities
+ */
+static u_int hash_identity(identification_t *id)
+{
+	return chunk_hash_inc(id->get_encoding(id), id->get_type(id));
+}
+
+/**
+ * hashtable equals function for identities
+ */
+static bool equals_identity(identification_t *a, identification_t *b)
+{
+	return a->equals(a, b);
+}
+
 /**
  * lookup/insert an identity
  */
-static u_int get_identity(private_sql_attribute_t *this, identification_t *id)
+static u_int lookup_identity(private_sql_attribute_t *this, identification_t *id)
 {
 	enumerator_t *e;
 	u_int row;
@@ -76,6 +121,57 @@ static u_int get_identity(private_sql_attribute_t *this, identification_t *id)
 	return 0;
 }
 
+/**
+ * Cache the row of an identity, evicting the oldest entry if the cache is full
+ */
+static void cache_identity(private_sql_attribute_t *this, identification_t *id,
+						   u_int row)
+{
+	identification_t *old;
+
+	this->mutex->lock(this->mutex);
+	if (!this->identities->get(this->identities, id))
+	{
+		if (this->identities->get_count(this->identities) >= this->identity_max)
+		{
+			this->identity_order->remove_first(this->identity_order,
+											   (void**)&old);
+			this->identities->remove(this->identities, old);
+			old->destroy(old);
+		}
+		id = id->clone(id);
+		this->identities->put(this->identities, id, (void*)(uintptr_t)row);
+		this->identity_order->insert_last(this->identity_order, id);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+/**
+ * get the row of an identity, identities are never deleted so with the lease
+ * cache we keep a bounded number of them in memory
+ */
+static u_int get_identity(private_sql_attribute_t *this, identification_t *id)
+{
+	u_int row;
+
+	if (!this->identities)
+	{
+		return lookup_identity(this, id);
+	}
+	this->mutex->lock(this->mutex);
+	row = (uintptr_t)this->identities->get(this->identities, id);
+	this->mutex->unlock(this->mutex);
+	if (!row)
+	{
+		row = lookup_identity(this, id);
+		if (row)
+		{
+			cache_identity(this, id, row);
+		}
+	}
+	return row;
+}
+
 /**
  * Lookup an attribute pool by name
  */
@@ -253,6 +349,11 @@ METHOD(attribute_provider_t, acquire_address, host_t*,
 	int family;
 
 	identity = get_identity(this, id);
+	if (identity && this->cache)
+	{
+		return this->cache->acquire(this->cache, pools,
+									requested->get_family(requested), identity);
+	}
 	if (identity)
 	{
 		family = requested->get_family(requested);
@@ -305,6 +406,10 @@ METHOD(attribute_provider_t, release_address, bool,
 	char *name;
 	int family;
 
+	if (this->cache)
+	{
+		return this->cache->release(this->cache, pools, address);
+	}
 	family = address->get_family(address);
 	enumerator = pools->create_enumerator(pools);
 	while (enumerator->enumerate(enumerator, &name))
@@ -435,6 +540,14 @@ METHOD(attribute_provider_t, create_attribute_enumerator, enumerator_t*,
 METHOD(sql_attribute_t, destroy, void,
 	private_sql_attribute_t *this)
 {
+	DESTROY_IF(this->cache);
+	if (this->identities)
+	{
+		this->identity_order->destroy_offset(this->identity_order,
+									offsetof(identification_t, destroy));
+		this->identities->destroy(this->identities);
+	}
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -458,6 +571,7 @@ sql_attribute_t *sql_attribute_create(database_t *db)
 		.db = db,
 		.history = lib->settings->get_bool(lib->settings,
 							"libhydra.plugins.attr-sql.lease_history", TRUE),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
 	/* close any "online" leases in the case we crashed */
@@ -471,5 +585,24 @@ sql_attribute_t *sql_attribute_create(database_t *db)
 	this->db->execute(this->db, NULL,
 					  "UPDATE addresses SET released = ? WHERE released = 0",
 					  DB_UINT, now);
+
+	if (lib->settings->get_bool(lib->settings,
+							"libhydra.plugins.attr-sql.lease_cache", FALSE))
+	{
+		this->cache = sql_lease_cache_create(db, this->history,
+							lib->settings->get_int(lib->settings,
+								"libhydra.plugins.attr-sql.write_delay", 100),
+							lib->settings->get_int(lib->settings,
+								"libhydra.plugins.attr-sql.pool_refresh", 10));
+		this->identity_max = lib->settings->get_int(lib->settings,
+							"libhydra.plugins.attr-sql.identity_cache_size", 4096);
+		if (this->identity_max)
+		{
+			this->identities = hashtable_create(
+									(hashtable_hash_t)hash_identity,
+									(hashtable_equals_t)equals_identity, 32);
+			this->identity_order = linked_list_create();
+		}
+	}
 	return &this->public;
 }
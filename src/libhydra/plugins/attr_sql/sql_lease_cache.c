@@ -0,0 +1,926 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <time.h>
+
+#include "sql_lease_cache.h"
+
+#include <utils/debug.h>
+#include <library.h>
+#include <collections/hashtable.h>
+#include <threading/mutex.h>
+#include <processing/jobs/callback_job.h>
+
+/**
+ * Minimum number of ms to wait before retrying failed writes
+ */
+#define WRITE_RETRY_DELAY 1000
+
+typedef struct private_sql_lease_cache_t private_sql_lease_cache_t;
+typedef struct lease_t lease_t;
+
+/**
+ * Private data of an sql_lease_cache_t object.
+ */
+struct private_sql_lease_cache_t {
+
+	/**
+	 * Public sql_lease_cache_t interface.
+	 */
+	sql_lease_cache_t public;
+
+	/**
+	 * Database connection
+	 */
+	database_t *db;
+
+	/**
+	 * Whether to record lease history in leases table
+	 */
+	bool history;
+
+	/**
+	 * Milliseconds to delay writes for
+	 */
+	u_int delay;
+
+	/**
+	 * Seconds after which cached pools get revalidated
+	 */
+	u_int refresh;
+
+	/**
+	 * Cached pools, name => pool_t
+	 */
+	hashtable_t *pools;
+
+	/**
+	 * Pending changes to write, as op_t
+	 */
+	linked_list_t *ops;
+
+	/**
+	 * Whether a job to write pending changes is scheduled
+	 */
+	bool scheduled;
+
+	/**
+	 * Lock for pools and pending changes
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Serializes writes to keep changes in order
+	 */
+	mutex_t *flush_mutex;
+
+	/**
+	 * Whether the cache got destroyed, changes are not written anymore
+	 */
+	bool closed;
+
+	/**
+	 * Reference count, held by the owner and scheduled jobs
+	 */
+	refcount_t ref;
+};
+
+/**
+ * A row in the addresses table
+ */
+struct lease_t {
+
+	/**
+	 * Row ID of the address
+	 */
+	u_int id;
+
+	/**
+	 * Address in network order
+	 */
+	chunk_t address;
+
+	/**
+	 * Row ID of the identity holding the lease, 0 if never assigned
+	 */
+	u_int identity;
+
+	/**
+	 * Time the lease was acquired
+	 */
+	u_int acquired;
+
+	/**
+	 * Time the lease was released, 0 if online
+	 */
+	u_int released;
+
+	/**
+	 * Whether the lease is in the free list of its pool
+	 */
+	bool free;
+
+	/**
+	 * Previous lease in free list
+	 */
+	lease_t *prev;
+
+	/**
+	 * Next lease in free list
+	 */
+	lease_t *next;
+
+	/**
+	 * Next lease of the same identity
+	 */
+	lease_t *sibling;
+};
+
+/**
+ * A cached pool
+ */
+typedef struct {
+
+	/**
+	 * Name of the pool
+	 */
+	char *name;
+
+	/**
+	 * Row ID of the pool, 0 if it does not exist
+	 */
+	u_int id;
+
+	/**
+	 * Address family of the pool
+	 */
+	int family;
+
+	/**
+	 * Lease timeout, 0 for static leases
+	 */
+	u_int timeout;
+
+	/**
+	 * Highest row ID of loaded addresses
+	 */
+	u_int max_id;
+
+	/**
+	 * Time the pool was last loaded from the database
+	 */
+	time_t loaded;
+
+	/**
+	 * All leases, chunk_t* => lease_t
+	 */
+	hashtable_t *addresses;
+
+	/**
+	 * First lease of each identity, identity => lease_t
+	 */
+	hashtable_t *identities;
+
+	/**
+	 * Free leases, ordered by release time for leases with timeout
+	 */
+	lease_t *head;
+
+	/**
+	 * Last lease in free list
+	 */
+	lease_t *tail;
+
+} pool_t;
+
+/**
+ * A pending change to a lease
+ */
+typedef struct {
+
+	/**
+	 * Row ID of the address
+	 */
+	u_int id;
+
+	/**
+	 * Identity holding the lease
+	 */
+	u_int identity;
+
+	/**
+	 * Time the lease was acquired
+	 */
+	u_int acquired;
+
+	/**
+	 * Time the lease was released, 0 if it got acquired
+	 */
+	u_int released;
+
+} op_t;
+
+/**
+ * Hashtable hash function for addresses
+ */
+static u_int hash_address(chunk_t *key)
+{
+	return chunk_hash(*key);
+}
+
+/**
+ * Hashtable equals function for addresses
+ */
+static bool equals_address(chunk_t *key, chunk_t *other)
+{
+	return chunk_equals(*key, *other);
+}
+
+/**
+ * Check if a lease may be handed out to other identities
+ */
+static inline bool is_free(pool_t *pool, lease_t *lease)
+{
+	if (pool->timeout)
+	{
+		return lease->released != 0;
+	}
+	return lease->identity == 0;
+}
+
+/**
+ * Add a lease to the free list of a pool, keeping it ordered by release time
+ */
+static void enqueue(pool_t *pool, lease_t *lease)
+{
+	lease_t *current;
+
+	lease->free = TRUE;
+	if (!pool->tail || pool->tail->released <= lease->released)
+	{	/* common case, a lease just got released */
+		lease->prev = pool->tail;
+		lease->next = NULL;
+	}
+	else if (pool->head->released >= lease->released)
+	{	/* addresses added to the pool were never released */
+		lease->prev = NULL;
+		lease->next = pool->head;
+	}
+	else
+	{
+		current = pool->tail;
+		while (current->released > lease->released)
+		{
+			current = current->prev;
+		}
+		lease->prev = current;
+		lease->next = current->next;
+	}
+	if (lease->prev)
+	{
+		lease->prev->next = lease;
+	}
+	else
+	{
+		pool->head = lease;
+	}
+	if (lease->next)
+	{
+		lease->next->prev = lease;
+	}
+	else
+	{
+		pool->tail = lease;
+	}
+}
+
+/**
+ * Remove a lease from the free list of a pool
+ */
+static void dequeue(pool_t *pool, lease_t *lease)
+{
+	if (lease->prev)
+	{
+		lease->prev->next = lease->next;
+	}
+	else
+	{
+		pool->head = lease->next;
+	}
+	if (lease->next)
+	{
+		lease->next->prev = lease->prev;
+	}
+	else
+	{
+		pool->tail = lease->prev;
+	}
+	lease->prev = lease->next = NULL;
+	lease->free = FALSE;
+}
+
+/**
+ * Add a lease to the leases of its identity
+ */
+static void add_identity(pool_t *pool, lease_t *lease)
+{
+	if (lease->identity)
+	{
+		lease->sibling = pool->identities->put(pool->identities,
+								(void*)(uintptr_t)lease->identity, lease);
+	}
+}
+
+/**
+ * Remove a lease from the leases of its identity
+ */
+static void remove_identity(pool_t *pool, lease_t *lease)
+{
+	lease_t *current, *prev = NULL;
+
+	if (!lease->identity)
+	{
+		return;
+	}
+	current = pool->identities->get(pool->identities,
+									 (void*)(uintptr_t)lease->identity);
+	while (current && current != lease)
+	{
+		prev = current;
+		current = current->sibling;
+	}
+	if (prev)
+	{
+		prev->sibling = lease->sibling;
+	}
+	else if (lease->sibling)
+	{
+		pool->identities->put(pool->identities,
+							  (void*)(uintptr_t)lease->identity, lease->sibling);
+	}
+	else
+	{
+		pool->identities->remove(pool->identities,
+								 (void*)(uintptr_t)lease->identity);
+	}
+	lease->sibling = NULL;
+}
+
+/**
+ * Destroy a cached pool and its leases
+ */
+static void pool_destroy(pool_t *pool)
+{
+	enumerator_t *enumerator;
+	lease_t *lease;
+
+	enumerator = pool->addresses->create_enumerator(pool->addresses);
+	while (enumerator->enumerate(enumerator, NULL, &lease))
+	{
+		chunk_free(&lease->address);
+		free(lease);
+	}
+	enumerator->destroy(enumerator);
+	pool->addresses->destroy(pool->addresses);
+	pool->identities->destroy(pool->identities);
+	free(pool->name);
+	free(pool);
+}
+
+/**
+ * Load addresses added to a pool since it was last loaded
+ */
+static void load_addresses(private_sql_lease_cache_t *this, pool_t *pool)
+{
+	enumerator_t *enumerator;
+	lease_t *lease;
+	chunk_t address;
+	u_int id, identity, acquired, released, count = 0;
+
+	enumerator = this->db->query(this->db,
+				"SELECT id, address, identity, acquired, released "
+				"FROM addresses WHERE pool = ? AND id > ? ORDER BY released, id",
+				DB_UINT, pool->id, DB_UINT, pool->max_id,
+				DB_UINT, DB_BLOB, DB_UINT, DB_UINT, DB_UINT);
+	if (!enumerator)
+	{
+		DBG1(DBG_CFG, "loading addresses of pool '%s' failed", pool->name);
+		return;
+	}
+	while (enumerator->enumerate(enumerator, &id, &address, &identity,
+								 &acquired, &released))
+	{
+		pool->max_id = max(pool->max_id, id);
+		if (pool->addresses->get(pool->addresses, &address))
+		{
+			continue;
+		}
+		INIT(lease,
+			.id = id,
+			.address = chunk_clone(address),
+			.identity = identity,
+			.acquired = acquired,
+			.released = released,
+		);
+		pool->addresses->put(pool->addresses, &lease->address, lease);
+		add_identity(pool, lease);
+		if (is_free(pool, lease))
+		{
+			enqueue(pool, lease);
+		}
+		count++;
+	}
+	enumerator->destroy(enumerator);
+	DBG2(DBG_CFG, "loaded %u addresses of pool '%s'", count, pool->name);
+}
+
+/**
+ * (Re-)load a pool from the database, returns the cached pool, if any
+ */
+static pool_t *load_pool(private_sql_lease_cache_t *this, char *name,
+						 pool_t *pool, time_t now)
+{
+	enumerator_t *enumerator;
+	u_int id = 0, timeout = 0;
+	int family = AF_UNSPEC;
+	chunk_t start;
+
+	enumerator = this->db->query(this->db,
+						"SELECT id, start, timeout FROM pools WHERE name = ?",
+						DB_TEXT, name, DB_UINT, DB_BLOB, DB_UINT);
+	if (!enumerator)
+	{
+		return pool;
+	}
+	if (enumerator->enumerate(enumerator, &id, &start, &timeout))
+	{
+		switch (start.len)
+		{
+			case 4:
+				family = AF_INET;
+				break;
+			case 16:
+				family = AF_INET6;
+				break;
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	if (pool && pool->id != id)
+	{	/* pool got deleted, and maybe recreated */
+		this->pools->remove(this->pools, pool->name);
+		pool_destroy(pool);
+		pool = NULL;
+	}
+	if (!pool)
+	{
+		INIT(pool,
+			.name = strdup(name),
+			.id = id,
+			.family = family,
+			.addresses = hashtable_create((hashtable_hash_t)hash_address,
+									(hashtable_equals_t)equals_address, 32),
+			.identities = hashtable_create(hashtable_hash_ptr,
+										   hashtable_equals_ptr, 32),
+		);
+		this->pools->put(this->pools, pool->name, pool);
+	}
+	pool->timeout = timeout;
+	pool->loaded = now;
+	if (pool->id)
+	{
+		load_addresses(this, pool);
+	}
+	return pool;
+}
+
+/**
+ * Get a pool by name and address family, load or revalidate it if necessary
+ */
+static pool_t *get_pool(private_sql_lease_cache_t *this, char *name,
+						int family, time_t now)
+{
+	pool_t *pool;
+
+	pool = this->pools->get(this->pools, name);
+	if (!pool || pool->loaded + this->refresh <= now)
+	{
+		pool = load_pool(this, name, pool, now);
+	}
+	if (!pool || !pool->id || pool->family != family)
+	{
+		return NULL;
+	}
+	return pool;
+}
+
+/**
+ * Queue a change to a lease, mutex must be held
+ */
+static void queue_op(private_sql_lease_cache_t *this, lease_t *lease)
+{
+	op_t *op;
+
+	INIT(op,
+		.id = lease->id,
+		.identity = lease->identity,
+		.acquired = lease->acquired,
+		.released = lease->released,
+	);
+	this->ops->insert_last(this->ops, op);
+}
+
+/**
+ * Write a single change to the database
+ */
+static bool write_op(private_sql_lease_cache_t *this, op_t *op)
+{
+	if (!op->released)
+	{
+		return this->db->execute(this->db, NULL,
+						"UPDATE addresses SET "
+						"acquired = ?, released = 0, identity = ? WHERE id = ?",
+						DB_UINT, op->acquired, DB_UINT, op->identity,
+						DB_UINT, op->id) >= 0;
+	}
+	if (this->db->execute(this->db, NULL,
+						"UPDATE addresses SET released = ? WHERE id = ?",
+						DB_UINT, op->released, DB_UINT, op->id) < 0)
+	{
+		return FALSE;
+	}
+	if (this->history)
+	{
+		return this->db->execute(this->db, NULL,
+					"INSERT INTO leases (address, identity, acquired, released) "
+					"VALUES (?, ?, ?, ?)", DB_UINT, op->id,
+					DB_UINT, op->identity, DB_UINT, op->acquired,
+					DB_UINT, op->released) == 1;
+	}
+	return TRUE;
+}
+
+/**
+ * Destroy the cache once the last reference is gone
+ */
+static void cache_unref(private_sql_lease_cache_t *this)
+{
+	enumerator_t *enumerator;
+	pool_t *pool;
+
+	if (ref_put(&this->ref))
+	{
+		enumerator = this->pools->create_enumerator(this->pools);
+		while (enumerator->enumerate(enumerator, NULL, &pool))
+		{
+			pool_destroy(pool);
+		}
+		enumerator->destroy(enumerator);
+		this->pools->destroy(this->pools);
+		this->ops->destroy_function(this->ops, free);
+		this->mutex->destroy(this->mutex);
+		this->flush_mutex->destroy(this->flush_mutex);
+		free(this);
+	}
+}
+
+static job_requeue_t flush_job(private_sql_lease_cache_t *this);
+
+/**
+ * Schedule a job to write pending changes
+ */
+static void schedule_flush(private_sql_lease_cache_t *this, u_int delay)
+{
+	ref_get(&this->ref);
+	lib->scheduler->schedule_job_ms(lib->scheduler,
+				(job_t*)callback_job_create((callback_job_cb_t)flush_job, this,
+									(callback_job_cleanup_t)cache_unref,
+									(callback_job_cancel_t)return_false),
+				delay);
+}
+
+/**
+ * Write pending changes in a single transaction, flush_mutex must be held.
+ * Changes that fail to get written are queued again, ahead of changes queued
+ * in the meantime, and get retried later.
+ */
+static void write_ops(private_sql_lease_cache_t *this)
+{
+	enumerator_t *enumerator;
+	linked_list_t *ops;
+	op_t *op;
+	bool success, schedule = FALSE;
+	int count;
+
+	this->mutex->lock(this->mutex);
+	ops = this->ops;
+	this->ops = linked_list_create();
+	this->mutex->unlock(this->mutex);
+
+	count = ops->get_count(ops);
+	if (!count)
+	{
+		ops->destroy(ops);
+		return;
+	}
+	success = this->db->transaction(this->db, FALSE);
+	if (success)
+	{
+		enumerator = ops->create_enumerator(ops);
+		while (success && enumerator->enumerate(enumerator, &op))
+		{
+			success = write_op(this, op);
+		}
+		enumerator->destroy(enumerator);
+		if (success)
+		{
+			success = this->db->commit(this->db);
+		}
+		else
+		{
+			this->db->rollback(this->db);
+		}
+	}
+	if (success)
+	{
+		DBG2(DBG_CFG, "wrote %d lease changes to database", count);
+		ops->destroy_function(ops, free);
+		return;
+	}
+	if (this->closed)
+	{
+		DBG1(DBG_CFG, "writing %d lease changes to database failed, "
+			 "changes lost", count);
+		ops->destroy_function(ops, free);
+		return;
+	}
+	DBG1(DBG_CFG, "writing %d lease changes to database failed, retrying",
+		 count);
+	this->mutex->lock(this->mutex);
+	while (this->ops->remove_first(this->ops, (void**)&op) == SUCCESS)
+	{
+		ops->insert_last(ops, op);
+	}
+	this->ops->destroy(this->ops);
+	this->ops = ops;
+	if (!this->scheduled)
+	{
+		this->scheduled = schedule = TRUE;
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (schedule)
+	{
+		schedule_flush(this, max(this->delay, WRITE_RETRY_DELAY));
+	}
+}
+
+METHOD(sql_lease_cache_t, flush, void,
+	private_sql_lease_cache_t *this)
+{
+	this->flush_mutex->lock(this->flush_mutex);
+	if (!this->closed)
+	{
+		write_ops(this);
+	}
+	this->flush_mutex->unlock(this->flush_mutex);
+}
+
+/**
+ * Write pending changes from a job
+ */
+static job_requeue_t flush_job(private_sql_lease_cache_t *this)
+{
+	this->mutex->lock(this->mutex);
+	this->scheduled = FALSE;
+	this->mutex->unlock(this->mutex);
+	flush(this);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Release the lock and write back pending changes, or schedule a job to do so
+ */
+static void unlock_and_write(private_sql_lease_cache_t *this)
+{
+	bool pending, schedule = FALSE;
+
+	pending = this->ops->get_count(this->ops) > 0;
+	if (pending && this->delay && !this->scheduled)
+	{
+		this->scheduled = schedule = TRUE;
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (pending && !this->delay)
+	{
+		flush(this);
+	}
+	else if (schedule)
+	{
+		schedule_flush(this, this->delay);
+	}
+}
+
+/**
+ * Hand out a lease to an identity
+ */
+static host_t *take_lease(private_sql_lease_cache_t *this, pool_t *pool,
+						  lease_t *lease, u_int identity, time_t now)
+{
+	if (lease->free)
+	{
+		dequeue(pool, lease);
+	}
+	if (lease->identity != identity)
+	{
+		remove_identity(pool, lease);
+		lease->identity = identity;
+		add_identity(pool, lease);
+	}
+	lease->acquired = now;
+	lease->released = 0;
+	queue_op(this, lease);
+	return host_create_from_chunk(AF_UNSPEC, lease->address, 0);
+}
+
+/**
+ * Find an offline lease of an identity
+ */
+static lease_t *get_existing(pool_t *pool, u_int identity)
+{
+	lease_t *lease;
+
+	lease = pool->identities->get(pool->identities, (void*)(uintptr_t)identity);
+	while (lease && !lease->released)
+	{
+		lease = lease->sibling;
+	}
+	return lease;
+}
+
+/**
+ * Find an unallocated address or an expired lease
+ */
+static lease_t *get_free(pool_t *pool, time_t now)
+{
+	lease_t *lease = pool->head;
+
+	if (lease && pool->timeout && lease->released + pool->timeout >= now)
+	{	/* the oldest lease did not expire yet, neither did the others */
+		return NULL;
+	}
+	return lease;
+}
+
+METHOD(sql_lease_cache_t, acquire, host_t*,
+	private_sql_lease_cache_t *this, linked_list_t *pools, int family,
+	u_int identity)
+{
+	enumerator_t *enumerator;
+	host_t *address = NULL;
+	time_t now = time(NULL);
+	lease_t *lease;
+	pool_t *pool;
+	char *name;
+
+	this->mutex->lock(this->mutex);
+	/* check for an existing lease in all pools */
+	enumerator = pools->create_enumerator(pools);
+	while (enumerator->enumerate(enumerator, &name))
+	{
+		pool = get_pool(this, name, family, now);
+		if (pool)
+		{
+			lease = get_existing(pool, identity);
+			if (lease)
+			{
+				address = take_lease(this, pool, lease, identity, now);
+				DBG1(DBG_CFG, "acquired existing lease for address %H in"
+					 " pool '%s'", address, name);
+				break;
+			}
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	if (!address)
+	{
+		/* get an unallocated address or expired lease */
+		enumerator = pools->create_enumerator(pools);
+		while (enumerator->enumerate(enumerator, &name))
+		{
+			pool = get_pool(this, name, family, now);
+			if (!pool)
+			{
+				continue;
+			}
+			lease = get_free(pool, now);
+			if (lease)
+			{
+				address = take_lease(this, pool, lease, identity, now);
+				DBG1(DBG_CFG, "acquired new lease for address %H in pool '%s'",
+					 address, name);
+				break;
+			}
+			DBG1(DBG_CFG, "no available address found in pool '%s'", name);
+		}
+		enumerator->destroy(enumerator);
+	}
+	unlock_and_write(this);
+	return address;
+}
+
+METHOD(sql_lease_cache_t, release, bool,
+	private_sql_lease_cache_t *this, linked_list_t *pools, host_t *address)
+{
+	enumerator_t *enumerator;
+	time_t now = time(NULL);
+	chunk_t chunk;
+	lease_t *lease;
+	pool_t *pool;
+	bool found = FALSE;
+	char *name;
+
+	chunk = address->get_address(address);
+	this->mutex->lock(this->mutex);
+	enumerator = pools->create_enumerator(pools);
+	while (enumerator->enumerate(enumerator, &name))
+	{
+		pool = get_pool(this, name, address->get_family(address), now);
+		if (!pool)
+		{
+			continue;
+		}
+		lease = pool->addresses->get(pool->addresses, &chunk);
+		if (lease)
+		{
+			if (!lease->released)
+			{
+				lease->released = now;
+				if (is_free(pool, lease))
+				{
+					enqueue(pool, lease);
+				}
+				queue_op(this, lease);
+			}
+			found = TRUE;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	unlock_and_write(this);
+	return found;
+}
+
+METHOD(sql_lease_cache_t, destroy, void,
+	private_sql_lease_cache_t *this)
+{
+	/* write pending changes a last time, jobs still scheduled hold a
+	 * reference but won't access the database anymore */
+	this->flush_mutex->lock(this->flush_mutex);
+	this->closed = TRUE;
+	write_ops(this);
+	this->flush_mutex->unlock(this->flush_mutex);
+	cache_unref(this);
+}
+
+/**
+ * See header
+ */
+sql_lease_cache_t *sql_lease_cache_create(database_t *db, bool history,
+										  u_int delay, u_int refresh)
+{
+	private_sql_lease_cache_t *this;
+
+	INIT(this,
+		.public = {
+			.acquire = _acquire,
+			.release = _release,
+			.flush = _flush,
+			.destroy = _destroy,
+		},
+		.db = db,
+		.history = history,
+		.delay = delay,
+		.refresh = refresh,
+		.pools = hashtable_create(hashtable_hash_str, hashtable_equals_str, 8),
+		.ops = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.flush_mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.ref = 1,
+	);
+
+	return &this->public;
+}
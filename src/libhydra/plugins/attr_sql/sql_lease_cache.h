@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup sql_lease_cache sql_lease_cache
+ * @{ @ingroup attr_sql
+ */
+
+#ifndef SQL_LEASE_CACHE_H_
+#define SQL_LEASE_CACHE_H_
+
+#include <database/database.h>
+#include <networking/host.h>
+#include <collections/linked_list.h>
+
+typedef struct sql_lease_cache_t sql_lease_cache_t;
+
+/**
+ * In-memory lease engine for SQL based address pools.
+ *
+ * Pools get loaded from the database on first use and are kept in memory
+ * afterwards, with a list of free addresses per pool and a map from
+ * identities to their leases. Leases are therefore handed out and released
+ * without querying the database. Changes are written back asynchronously,
+ * batched in a single transaction, to the unmodified tables used by the
+ * pool utility.
+ *
+ * Cached pools are revalidated against the database if they have not been
+ * loaded for a configurable interval, so addresses added to a pool and pools
+ * deleted or recreated with the pool utility are picked up within that
+ * interval. Changes that fail to get written are retried later.
+ */
+struct sql_lease_cache_t {
+
+	/**
+	 * Acquire an address for an identity from one of the given pools.
+	 *
+	 * An existing offline lease of the identity is preferred over new
+	 * leases, in any of the pools.
+	 *
+	 * @param pools			names of pools to acquire an address from
+	 * @param family		address family of the address to acquire
+	 * @param identity		row ID of the peer identity
+	 * @return				acquired address, NULL if none available
+	 */
+	host_t* (*acquire)(sql_lease_cache_t *this, linked_list_t *pools,
+					   int family, u_int identity);
+
+	/**
+	 * Release a lease previously acquired from one of the given pools.
+	 *
+	 * @param pools			names of pools the address might be from
+	 * @param address		address to release
+	 * @return				TRUE if the address was found in a pool
+	 */
+	bool (*release)(sql_lease_cache_t *this, linked_list_t *pools,
+					host_t *address);
+
+	/**
+	 * Write all pending lease changes to the database.
+	 */
+	void (*flush)(sql_lease_cache_t *this);
+
+	/**
+	 * Destroy a sql_lease_cache_t, flushing pending changes.
+	 */
+	void (*destroy)(sql_lease_cache_t *this);
+};
+
+/**
+ * Create a sql_lease_cache instance.
+ *
+ * @param db				database with pools and addresses tables
+ * @param history			TRUE to record released leases in leases table
+ * @param delay				ms to batch changes for, 0 to write synchronously
+ * @param refresh			s after which pools get revalidated, 0 to always
+ * @return					lease cache
+ */
+sql_lease_cache_t *sql_lease_cache_create(database_t *db, bool history,
+										  u_int delay, u_int refresh);
+
+#endif /** SQL_LEASE_CACHE_H_ @}*/
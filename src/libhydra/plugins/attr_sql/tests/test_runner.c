@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <unistd.h>
+#include <limits.h>
+
+#include "test_runner.h"
+
+#include <library.h>
+#include <plugins/plugin_feature.h>
+
+/**
+ * Load plugins from builddir
+ */
+static bool load_plugins()
+{
+	enumerator_t *enumerator;
+	char *name, path[PATH_MAX], dir[64];
+
+	enumerator = enumerator_create_token(PLUGINS, " ", "");
+	while (enumerator->enumerate(enumerator, &name))
+	{
+		snprintf(dir, sizeof(dir), "%s", name);
+		translate(dir, "-", "_");
+		snprintf(path, sizeof(path), "%s/%s/.libs", PLUGINDIR, dir);
+		lib->plugins->add_path(lib->plugins, path);
+	}
+	enumerator->destroy(enumerator);
+
+	return lib->plugins->load(lib->plugins, PLUGINS);
+}
+
+int main()
+{
+	SRunner *sr;
+	int nf;
+
+	/* test cases are forked and there is no cleanup, so disable leak detective.
+	 * if test_suite.h is included leak detective is enabled in test cases */
+	setenv("LEAK_DETECTIVE_DISABLE", "1", 1);
+	/* redirect all output to stderr (to redirect make's stdout to /dev/null) */
+	dup2(2, 1);
+
+	library_init(NULL);
+
+	if (!load_plugins())
+	{
+		library_deinit();
+		return EXIT_FAILURE;
+	}
+	lib->plugins->status(lib->plugins, LEVEL_CTRL);
+
+	sr = srunner_create(NULL);
+	if (lib->plugins->has_feature(lib->plugins,
+								  PLUGIN_DEPENDS(DATABASE, DB_SQLITE)))
+	{
+		srunner_add_suite(sr, sql_lease_cache_suite_create());
+	}
+
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+
+	srunner_free(sr);
+	library_deinit();
+
+	return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
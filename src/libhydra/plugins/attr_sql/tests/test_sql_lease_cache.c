@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "test_suite.h"
+
+#include <unistd.h>
+
+#include <sql_lease_cache.h>
+
+static char path[] = "/tmp/strongswan-test-lease-cache-XXXXXX";
+static database_t *db;
+static sql_lease_cache_t *cache;
+static linked_list_t *pools;
+static u_int pool_id;
+
+/**
+ * Add an address to the test pool
+ */
+static void add_address(char *str)
+{
+	host_t *host;
+
+	host = host_create_from_string(str, 0);
+	ck_assert(host != NULL);
+	ck_assert_int_eq(db->execute(db, NULL,
+					"INSERT INTO addresses (pool, address, identity, acquired, "
+					"released) VALUES (?, ?, 0, 0, 1)",
+					DB_UINT, pool_id, DB_BLOB, host->get_address(host)), 1);
+	host->destroy(host);
+}
+
+START_SETUP(setup_db)
+{
+	host_t *start, *end;
+	char uri[64];
+	int fd;
+
+	strcpy(path + strlen(path) - 6, "XXXXXX");
+	fd = mkstemp(path);
+	ck_assert(fd != -1);
+	close(fd);
+	snprintf(uri, sizeof(uri), "sqlite://%s", path);
+	db = lib->db->create(lib->db, uri);
+	ck_assert(db != NULL);
+	ck_assert(db->execute(db, NULL, "CREATE TABLE pools ("
+						"id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+						"name TEXT NOT NULL, start BLOB NOT NULL, "
+						"end BLOB NOT NULL, timeout INTEGER NOT NULL)") >= 0);
+	ck_assert(db->execute(db, NULL, "CREATE TABLE addresses ("
+						"id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+						"pool INTEGER NOT NULL, address BLOB NOT NULL, "
+						"identity INTEGER NOT NULL DEFAULT 0, "
+						"acquired INTEGER NOT NULL DEFAULT 0, "
+						"released INTEGER NOT NULL DEFAULT 1)") >= 0);
+	ck_assert(db->execute(db, NULL, "CREATE TABLE leases ("
+						"id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT, "
+						"address INTEGER NOT NULL, identity INTEGER NOT NULL, "
+						"acquired INTEGER NOT NULL, "
+						"released INTEGER NOT NULL)") >= 0);
+
+	start = host_create_from_string("10.0.1.1", 0);
+	end = host_create_from_string("10.0.1.3", 0);
+	ck_assert_int_eq(db->execute(db, (int*)&pool_id,
+					"INSERT INTO pools (name, start, end, timeout) "
+					"VALUES ('pool', ?, ?, 0)",
+					DB_BLOB, start->get_address(start),
+					DB_BLOB, end->get_address(end)), 1);
+	start->destroy(start);
+	end->destroy(end);
+	add_address("10.0.1.1");
+	add_address("10.0.1.2");
+	add_address("10.0.1.3");
+
+	pools = linked_list_create();
+	pools->insert_last(pools, "pool");
+	cache = NULL;
+}
+END_SETUP
+
+START_TEARDOWN(teardown_db)
+{
+	DESTROY_IF(cache);
+	pools->destroy(pools);
+	db->destroy(db);
+	unlink(path);
+}
+END_TEARDOWN
+
+/**
+ * Acquire an address, returns the last octet or 0 if none acquired
+ */
+static int acquire(u_int identity)
+{
+	host_t *host;
+	chunk_t addr;
+	int octet;
+
+	host = cache->acquire(cache, pools, AF_INET, identity);
+	if (!host)
+	{
+		return 0;
+	}
+	addr = host->get_address(host);
+	octet = addr.ptr[addr.len - 1];
+	host->destroy(host);
+	return octet;
+}
+
+/**
+ * Release an address with the given last octet
+ */
+static bool release(int octet)
+{
+	host_t *host;
+	char str[16];
+	bool found;
+
+	snprintf(str, sizeof(str), "10.0.1.%d", octet);
+	host = host_create_from_string(str, 0);
+	found = cache->release(cache, pools, host);
+	host->destroy(host);
+	return found;
+}
+
+/**
+ * Get the identity and the release time of an address in the database
+ */
+static void get_lease(int octet, u_int *identity, u_int *released)
+{
+	enumerator_t *enumerator;
+	host_t *host;
+	char str[16];
+
+	snprintf(str, sizeof(str), "10.0.1.%d", octet);
+	host = host_create_from_string(str, 0);
+	enumerator = db->query(db, "SELECT identity, released FROM addresses "
+						   "WHERE address = ?", DB_BLOB, host->get_address(host),
+						   DB_UINT, DB_UINT);
+	ck_assert(enumerator != NULL);
+	ck_assert(enumerator->enumerate(enumerator, identity, released));
+	enumerator->destroy(enumerator);
+	host->destroy(host);
+}
+
+/**
+ * Count the rows in the leases table
+ */
+static u_int count_leases()
+{
+	enumerator_t *enumerator;
+	u_int count = 0;
+
+	enumerator = db->query(db, "SELECT COUNT(*) FROM leases", DB_UINT);
+	ck_assert(enumerator != NULL);
+	ck_assert(enumerator->enumerate(enumerator, &count));
+	enumerator->destroy(enumerator);
+	return count;
+}
+
+START_TEST(test_acquire_release)
+{
+	u_int identity, released;
+	int octet;
+
+	cache = sql_lease_cache_create(db, TRUE, 0, 10);
+	octet = acquire(1);
+	ck_assert(octet != 0);
+	get_lease(octet, &identity, &released);
+	ck_assert_int_eq(identity, 1);
+	ck_assert_int_eq(released, 0);
+
+	ck_assert(release(octet));
+	get_lease(octet, &identity, &released);
+	ck_assert_int_eq(identity, 1);
+	ck_assert(released != 0);
+	ck_assert_int_eq(count_leases(), 1);
+
+	/* the identity gets its previous lease again */
+	ck_assert_int_eq(acquire(1), octet);
+	ck_assert(!release(42));
+}
+END_TEST
+
+START_TEST(test_exhausted)
+{
+	int a, b, c;
+
+	cache = sql_lease_cache_create(db, FALSE, 0, 10);
+	a = acquire(1);
+	b = acquire(2);
+	c = acquire(3);
+	ck_assert(a && b && c);
+	ck_assert(a != b && b != c && a != c);
+	ck_assert_int_eq(acquire(4), 0);
+	/* static leases stay reserved for their identity */
+	ck_assert(release(b));
+	ck_assert_int_eq(acquire(4), 0);
+	ck_assert_int_eq(acquire(2), b);
+}
+END_TEST
+
+START_TEST(test_pool_changes)
+{
+	/* revalidate the pool on every lease */
+	cache = sql_lease_cache_create(db, FALSE, 0, 0);
+	ck_assert(acquire(1) != 0);
+	ck_assert(acquire(2) != 0);
+	ck_assert(acquire(3) != 0);
+	ck_assert_int_eq(acquire(4), 0);
+
+	/* addresses added with the pool utility are picked up */
+	add_address("10.0.1.4");
+	ck_assert_int_eq(acquire(4), 4);
+
+	/* as are deleted pools, like with ipsec pool --del */
+	ck_assert(release(4));
+	ck_assert(db->execute(db, NULL, "DELETE FROM addresses WHERE pool = ?",
+						  DB_UINT, pool_id) >= 0);
+	ck_assert(db->execute(db, NULL, "DELETE FROM pools WHERE id = ?",
+						  DB_UINT, pool_id) >= 0);
+	ck_assert_int_eq(acquire(4), 0);
+	ck_assert_int_eq(acquire(5), 0);
+}
+END_TEST
+
+START_TEST(test_retry)
+{
+	u_int identity, released;
+	int octet;
+
+	cache = sql_lease_cache_create(db, FALSE, 0, 10);
+	ck_assert(db->execute(db, NULL, "CREATE TRIGGER fail BEFORE UPDATE ON "
+						  "addresses BEGIN SELECT RAISE(ABORT, 'fail'); END")
+			  >= 0);
+	octet = acquire(1);
+	ck_assert(octet != 0);
+	get_lease(octet, &identity, &released);
+	ck_assert_int_eq(identity, 0);
+
+	/* changes that failed to get written are kept, and written in order */
+	ck_assert(release(octet));
+	ck_assert(db->execute(db, NULL, "DROP TRIGGER fail") >= 0);
+	cache->flush(cache);
+	get_lease(octet, &identity, &released);
+	ck_assert_int_eq(identity, 1);
+	ck_assert(released != 0);
+}
+END_TEST
+
+START_TEST(test_delayed)
+{
+	u_int identity, released;
+	int octet;
+
+	cache = sql_lease_cache_create(db, FALSE, 60000, 10);
+	octet = acquire(1);
+	ck_assert(octet != 0);
+	get_lease(octet, &identity, &released);
+	ck_assert_int_eq(identity, 0);
+
+	/* pending changes get written when the cache is destroyed, the job
+	 * scheduled to write them must not access the database anymore */
+	cache->destroy(cache);
+	cache = NULL;
+	get_lease(octet, &identity, &released);
+	ck_assert_int_eq(identity, 1);
+	ck_assert_int_eq(released, 0);
+}
+END_TEST
+
+Suite *sql_lease_cache_suite_create()
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("sql lease cache");
+
+	tc = tcase_create("leases");
+	tcase_add_checked_fixture(tc, setup_db, teardown_db);
+	tcase_add_test(tc, test_acquire_release);
+	tcase_add_test(tc, test_exhausted);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("pool changes");
+	tcase_add_checked_fixture(tc, setup_db, teardown_db);
+	tcase_add_test(tc, test_pool_changes);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("writes");
+	tcase_add_checked_fixture(tc, setup_db, teardown_db);
+	tcase_add_test(tc, test_retry);
+	tcase_add_test(tc, test_delayed);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -54,6 +54,11 @@ struct private_netlink_socket_t {
 	 * netlink socket
 	 */
 	int socket;
+
+	/**
+	 * Histogram of request latencies, including waiting for the socket
+	 */
+	metric_t *latency;
 };
 
 /**
@@ -69,7 +74,9 @@ METHOD(netlink_socket_t, netlink_send, status_t,
 	struct sockaddr_nl addr;
 	chunk_t result = chunk_empty, tmp;
 	struct nlmsghdr *msg, peek;
+	timeval_t start;
 
+	time_monotonic(&start);
 	this->mutex->lock(this->mutex);
 
 	in->nlmsg_seq = ++this->seq;
@@ -177,6 +184,8 @@ METHOD(netlink_socket_t, netlink_send, status_t,
 
 	this->mutex->unlock(this->mutex);
 
+	this->latency->observe_since(this->latency, &start);
+
 	return SUCCESS;
 }
 
@@ -239,6 +248,7 @@ METHOD(netlink_socket_t, destroy, void,
 	{
 		close(this->socket);
 	}
+	this->latency->destroy(this->latency);
 	this->mutex->destroy(this->mutex);
 	free(this);
 }
@@ -260,6 +270,11 @@ netlink_socket_t *netlink_socket_create(int protocol)
 		.seq = 200,
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.protocol = protocol,
+		.latency = lib->metrics->create(lib->metrics, METRIC_HISTOGRAM,
+							"kernel_netlink_request_seconds",
+							protocol == NETLINK_XFRM ? "protocol=\"xfrm\""
+													 : "protocol=\"route\"",
+							"Time from sending a netlink request to its reply"),
 	);
 
 	memset(&addr, 0, sizeof(addr));
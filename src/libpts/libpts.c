@@ -30,6 +30,16 @@
  */
 pts_component_manager_t *pts_components;
 
+/**
+ * Cache of file measurements, NULL if not enabled
+ */
+pts_meas_cache_t *pts_meas_cache;
+
+/**
+ * Default maximum number of cached file measurements
+ */
+#define DEFAULT_HASH_CACHE_SIZE 10000
+
 /**
  * Reference count for IMC/IMV instances
  */
@@ -40,6 +50,8 @@ static refcount_t libpts_ref = 0;
  */
 bool libpts_init(void)
 {
+	char *cache;
+
 	if (libpts_ref == 0)
 	{
 		if (!imcv_pa_tnc_attributes)
@@ -67,6 +79,16 @@ bool libpts_init(void)
 									  PTS_ITA_COMP_FUNC_NAME_IMA,
 									  pts_ita_comp_ima_create);
 
+		cache = lib->settings->get_str(lib->settings,
+							"libimcv.plugins.imc-attestation.hash_cache", NULL);
+		if (cache)
+		{
+			pts_meas_cache = pts_meas_cache_create(cache,
+							lib->settings->get_int(lib->settings,
+								"libimcv.plugins.imc-attestation.hash_cache_size",
+								DEFAULT_HASH_CACHE_SIZE));
+		}
+
 		DBG1(DBG_LIB, "libpts initialized");
 	}
 	ref_get(&libpts_ref);
@@ -85,6 +107,13 @@ void libpts_deinit(void)
 		pts_components->remove_vendor(pts_components, PEN_ITA);
 		pts_components->destroy(pts_components);
 
+		if (pts_meas_cache)
+		{
+			pts_meas_cache->save(pts_meas_cache);
+			pts_meas_cache->destroy(pts_meas_cache);
+			pts_meas_cache = NULL;
+		}
+
 		if (!imcv_pa_tnc_attributes)
 		{
 			return;
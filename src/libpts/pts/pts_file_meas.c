@@ -15,7 +15,12 @@
 
 #include "pts_file_meas.h"
 
+#include "libpts.h"
+
 #include <collections/linked_list.h>
+#include <threading/thread.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
 #include <utils/debug.h>
 
 #include <sys/stat.h>
@@ -235,13 +240,25 @@ pts_file_meas_t *pts_file_meas_create(u_int16_t request_id)
 }
 
 /**
- * Hash a file with a given absolute pathname
+ * Maximum number of files queued for measurement during a directory walk
  */
-static bool hash_file(hasher_t *hasher, char *pathname, u_char *hash)
+#define MAX_QUEUED 64
+
+/**
+ * Default number of threads measuring the files of a directory
+ */
+#define DEFAULT_HASH_THREADS 4
+
+/**
+ * Hash a file with a given absolute pathname, using the measurement cache
+ */
+static bool hash_file(hasher_t *hasher, pts_meas_algorithms_t alg,
+					  char *pathname, u_char *hash)
 {
 	u_char buffer[4096];
 	size_t bytes_read;
 	bool success = TRUE;
+	struct stat st, after;
 	FILE *file;
 
 	file = fopen(pathname, "rb");
@@ -251,6 +268,17 @@ static bool hash_file(hasher_t *hasher, char *pathname, u_char *hash)
 			 strerror(errno));
 		return FALSE;
 	}
+	/* stat the opened file, so the cache key matches the hashed content */
+	if (fstat(fileno(file), &st) != 0)
+	{
+		memset(&st, 0, sizeof(st));
+	}
+	else if (pts_meas_cache && pts_meas_cache->get(pts_meas_cache, &st,
+												   alg, hash))
+	{
+		fclose(file);
+		return TRUE;
+	}
 	while (TRUE)
 	{
 		bytes_read = fread(buffer, 1, sizeof(buffer), file);
@@ -273,11 +301,250 @@ static bool hash_file(hasher_t *hasher, char *pathname, u_char *hash)
 			break;
 		}
 	}
+	/* don't cache the measurement if the file changed while hashing it */
+	if (success && st.st_ino && pts_meas_cache &&
+		fstat(fileno(file), &after) == 0 && after.st_size == st.st_size &&
+		after.st_mtime == st.st_mtime && after.st_ctime == st.st_ctime)
+	{
+		pts_meas_cache->put(pts_meas_cache, &st, alg, hash);
+	}
 	fclose(file);
-
 	return success;
 }
 
+/**
+ * State shared between a directory walk and the threads measuring its files
+ */
+typedef struct {
+
+	/**
+	 * File measurements to add results to
+	 */
+	private_pts_file_meas_t *meas;
+
+	/**
+	 * Measurement algorithm
+	 */
+	pts_meas_algorithms_t alg;
+
+	/**
+	 * Files queued for measurement, as pending_t
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * TRUE once all files of the directory have been queued
+	 */
+	bool done;
+
+	/**
+	 * Lock for queue, done and meas
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Signaled when a file gets queued or the walk is done
+	 */
+	condvar_t *queued;
+
+	/**
+	 * Signaled when a file gets dequeued
+	 */
+	condvar_t *dequeued;
+
+} walk_t;
+
+/**
+ * A file queued for measurement
+ */
+typedef struct {
+
+	/**
+	 * Absolute pathname to hash
+	 */
+	char *abs_name;
+
+	/**
+	 * Name to report the measurement for
+	 */
+	char *filename;
+
+} pending_t;
+
+/**
+ * A thread measuring queued files
+ */
+typedef struct {
+
+	/**
+	 * Directory walk to take files from
+	 */
+	walk_t *walk;
+
+	/**
+	 * Hasher exclusively used by this thread
+	 */
+	hasher_t *hasher;
+
+	/**
+	 * Measuring thread
+	 */
+	thread_t *thread;
+
+} worker_t;
+
+/**
+ * Hash a file and add its measurement
+ */
+static void measure_file(walk_t *walk, hasher_t *hasher, char *abs_name,
+						 char *filename)
+{
+	u_char hash[HASH_SIZE_SHA384];
+	chunk_t measurement;
+
+	if (hash_file(hasher, walk->alg, abs_name, hash))
+	{
+		measurement = chunk_create(hash, hasher->get_hash_size(hasher));
+		DBG2(DBG_PTS, "  %#B for '%s'", &measurement, filename);
+		walk->mutex->lock(walk->mutex);
+		add(walk->meas, filename, measurement);
+		walk->mutex->unlock(walk->mutex);
+	}
+}
+
+/**
+ * Measure queued files until the directory walk is done
+ */
+static void *measure_files(worker_t *worker)
+{
+	walk_t *walk = worker->walk;
+	pending_t *pending;
+
+	while (TRUE)
+	{
+		walk->mutex->lock(walk->mutex);
+		while (walk->queue->get_count(walk->queue) == 0 && !walk->done)
+		{
+			walk->queued->wait(walk->queued, walk->mutex);
+		}
+		if (walk->queue->remove_first(walk->queue, (void**)&pending) != SUCCESS)
+		{
+			walk->mutex->unlock(walk->mutex);
+			break;
+		}
+		walk->dequeued->signal(walk->dequeued);
+		walk->mutex->unlock(walk->mutex);
+
+		measure_file(walk, worker->hasher, pending->abs_name, pending->filename);
+		free(pending->abs_name);
+		free(pending->filename);
+		free(pending);
+	}
+	return NULL;
+}
+
+/**
+ * Measure the regular files of a directory, using a pool of threads.
+ *
+ * The directory is streamed into a bounded queue, so the number of pending
+ * files does not grow with the size of the directory.
+ */
+static bool measure_dir(private_pts_file_meas_t *this, hasher_t *hasher,
+						pts_meas_algorithms_t alg, hash_algorithm_t hash_alg,
+						char *pathname, bool use_rel_name)
+{
+	enumerator_t *enumerator;
+	worker_t *workers;
+	walk_t walk;
+	pending_t *pending;
+	char *rel_name, *abs_name, *filename;
+	struct stat st;
+	int i, count;
+
+	enumerator = enumerator_create_directory(pathname);
+	if (!enumerator)
+	{
+		DBG1(DBG_PTS, "  directory '%s' can not be opened, %s", pathname,
+			 strerror(errno));
+		return FALSE;
+	}
+	walk = (walk_t){
+		.meas = this,
+		.alg = alg,
+		.queue = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.queued = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.dequeued = condvar_create(CONDVAR_TYPE_DEFAULT),
+	};
+
+	count = lib->settings->get_int(lib->settings,
+						"libimcv.plugins.imc-attestation.hash_threads",
+						DEFAULT_HASH_THREADS);
+	workers = calloc(max(count, 1), sizeof(worker_t));
+	for (i = 0; i < count; i++)
+	{
+		workers[i].walk = &walk;
+		workers[i].hasher = lib->crypto->create_hasher(lib->crypto, hash_alg);
+		if (!workers[i].hasher)
+		{
+			break;
+		}
+		workers[i].thread = thread_create((void*)measure_files, &workers[i]);
+		if (!workers[i].thread)
+		{
+			workers[i].hasher->destroy(workers[i].hasher);
+			break;
+		}
+	}
+	/* fall back to measuring in this thread if we couldn't start any */
+	count = i;
+
+	while (enumerator->enumerate(enumerator, &rel_name, &abs_name, &st))
+	{
+		/* measure regular files only */
+		if (!S_ISREG(st.st_mode) || *rel_name == '.')
+		{
+			continue;
+		}
+		filename = use_rel_name ? rel_name : abs_name;
+		if (!count)
+		{
+			measure_file(&walk, hasher, abs_name, filename);
+			continue;
+		}
+		INIT(pending,
+			.abs_name = strdup(abs_name),
+			.filename = strdup(filename),
+		);
+		walk.mutex->lock(walk.mutex);
+		while (walk.queue->get_count(walk.queue) >= MAX_QUEUED)
+		{
+			walk.dequeued->wait(walk.dequeued, walk.mutex);
+		}
+		walk.queue->insert_last(walk.queue, pending);
+		walk.queued->signal(walk.queued);
+		walk.mutex->unlock(walk.mutex);
+	}
+	enumerator->destroy(enumerator);
+
+	walk.mutex->lock(walk.mutex);
+	walk.done = TRUE;
+	walk.queued->broadcast(walk.queued);
+	walk.mutex->unlock(walk.mutex);
+
+	for (i = 0; i < count; i++)
+	{
+		workers[i].thread->join(workers[i].thread);
+		workers[i].hasher->destroy(workers[i].hasher);
+	}
+	free(workers);
+	walk.queue->destroy(walk.queue);
+	walk.mutex->destroy(walk.mutex);
+	walk.queued->destroy(walk.queued);
+	walk.dequeued->destroy(walk.dequeued);
+	return TRUE;
+}
+
 /**
  * See header
  */
@@ -306,48 +573,25 @@ pts_file_meas_t *pts_file_meas_create_from_path(u_int16_t request_id,
 
 	if (is_dir)
 	{
-		enumerator_t *enumerator;
-		char *rel_name, *abs_name;
-		struct stat st;
-
-		enumerator = enumerator_create_directory(pathname);
-		if (!enumerator)
-		{
-			DBG1(DBG_PTS, "  directory '%s' can not be opened, %s", pathname,
-				 strerror(errno));
-			success = FALSE;
-			goto end;
-		}
-		while (enumerator->enumerate(enumerator, &rel_name, &abs_name, &st))
-		{
-			/* measure regular files only */
-			if (S_ISREG(st.st_mode) && *rel_name != '.')
-			{
-				if (!hash_file(hasher, abs_name, hash))
-				{
-					continue;
-				}
-				filename = use_rel_name ? rel_name : abs_name;
-				DBG2(DBG_PTS, "  %#B for '%s'", &measurement, filename);
-				add(this, filename, measurement);
-			}
-		}
-		enumerator->destroy(enumerator);
+		success = measure_dir(this, hasher, alg, hash_alg, pathname,
+							  use_rel_name);
 	}
 	else
 	{
-		if (!hash_file(hasher, pathname, hash))
+		success = hash_file(hasher, alg, pathname, hash);
+		if (success)
 		{
-			success = FALSE;
-			goto end;
+			filename = use_rel_name ? basename(pathname) : pathname;
+			DBG2(DBG_PTS, "  %#B for '%s'", &measurement, filename);
+			add(this, filename, measurement);
 		}
-		filename = use_rel_name ? basename(pathname) : pathname;
-		DBG2(DBG_PTS, "  %#B for '%s'", &measurement, filename);
-		add(this, filename, measurement);
 	}
-
-end:
 	hasher->destroy(hasher);
+
+	if (pts_meas_cache)
+	{
+		pts_meas_cache->save(pts_meas_cache);
+	}
 	if (success)
 	{
 		return &this->public;
@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "pts_meas_cache.h"
+
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
+#include <utils/debug.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+
+typedef struct private_pts_meas_cache_t private_pts_meas_cache_t;
+typedef struct entry_t entry_t;
+
+/**
+ * Private data of a pts_meas_cache_t object.
+ */
+struct private_pts_meas_cache_t {
+
+	/**
+	 * Public pts_meas_cache_t interface.
+	 */
+	pts_meas_cache_t public;
+
+	/**
+	 * Cached measurements, entry_t => entry_t
+	 */
+	hashtable_t *entries;
+
+	/**
+	 * Cached measurements in the order they were added, as entry_t
+	 */
+	linked_list_t *order;
+
+	/**
+	 * Maximum number of cached measurements
+	 */
+	u_int max;
+
+	/**
+	 * File to persist the cache to, NULL if none
+	 */
+	char *path;
+
+	/**
+	 * Whether entries have been added since loading or saving
+	 */
+	bool modified;
+
+	/**
+	 * Lock for entries
+	 */
+	mutex_t *mutex;
+};
+
+/**
+ * Cached measurement of a file
+ */
+struct entry_t {
+	u_int64_t dev;
+	u_int64_t ino;
+	u_int64_t size;
+	int64_t mtime;
+	int64_t ctime;
+	pts_meas_algorithms_t algo;
+	u_char hash[HASH_SIZE_SHA384];
+};
+
+/**
+ * Hashtable hash function
+ */
+static u_int hash(entry_t *key)
+{
+	u_int hash;
+
+	hash = chunk_hash(chunk_from_thing(key->ino));
+	hash = chunk_hash_inc(chunk_from_thing(key->dev), hash);
+	hash = chunk_hash_inc(chunk_from_thing(key->size), hash);
+	hash = chunk_hash_inc(chunk_from_thing(key->mtime), hash);
+	return chunk_hash_inc(chunk_from_thing(key->ctime), hash);
+}
+
+/**
+ * Hashtable equals function
+ */
+static bool equals(entry_t *a, entry_t *b)
+{
+	return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+		   a->mtime == b->mtime && a->ctime == b->ctime && a->algo == b->algo;
+}
+
+/**
+ * Initialize the key of an entry from stat() information
+ */
+static void set_key(entry_t *entry, struct stat *st, pts_meas_algorithms_t algo)
+{
+	entry->dev = st->st_dev;
+	entry->ino = st->st_ino;
+	entry->size = st->st_size;
+	entry->mtime = st->st_mtime;
+	entry->ctime = st->st_ctime;
+	entry->algo = algo;
+}
+
+METHOD(pts_meas_cache_t, get, bool,
+	private_pts_meas_cache_t *this, struct stat *st, pts_meas_algorithms_t algo,
+	u_char *hash)
+{
+	entry_t key, *entry;
+
+	set_key(&key, st, algo);
+	this->mutex->lock(this->mutex);
+	entry = this->entries->get(this->entries, &key);
+	if (entry)
+	{
+		memcpy(hash, entry->hash, pts_meas_algo_hash_size(algo));
+	}
+	this->mutex->unlock(this->mutex);
+	return entry != NULL;
+}
+
+/**
+ * Add an entry, or update the measurement of an existing one. The oldest
+ * entry gets evicted if the cache is full. Mutex must be held.
+ */
+static void add_entry(private_pts_meas_cache_t *this, entry_t *entry)
+{
+	entry_t *existing;
+
+	existing = this->entries->get(this->entries, entry);
+	if (existing)
+	{
+		memcpy(existing->hash, entry->hash, sizeof(entry->hash));
+		free(entry);
+		return;
+	}
+	if (this->order->get_count(this->order) >= this->max &&
+		this->order->remove_first(this->order, (void**)&existing) == SUCCESS)
+	{
+		this->entries->remove(this->entries, existing);
+		free(existing);
+	}
+	this->entries->put(this->entries, entry, entry);
+	this->order->insert_last(this->order, entry);
+}
+
+METHOD(pts_meas_cache_t, put, void,
+	private_pts_meas_cache_t *this, struct stat *st, pts_meas_algorithms_t algo,
+	u_char *hash)
+{
+	entry_t *entry;
+	size_t len;
+	time_t now;
+
+	len = pts_meas_algo_hash_size(algo);
+	now = time(NULL);
+	if (st->st_mtime >= now || st->st_ctime >= now ||
+		!len || len > HASH_SIZE_SHA384)
+	{
+		return;
+	}
+	INIT(entry);
+	set_key(entry, st, algo);
+	memcpy(entry->hash, hash, len);
+
+	this->mutex->lock(this->mutex);
+	add_entry(this, entry);
+	this->modified = TRUE;
+	this->mutex->unlock(this->mutex);
+}
+
+/**
+ * Load cached measurements from the cache file
+ */
+static void load(private_pts_meas_cache_t *this)
+{
+	char line[256], hex[2 * HASH_SIZE_SHA384 + 1];
+	unsigned long long dev, ino, size;
+	long long mtime, ctime;
+	u_int algo, count = 0;
+	entry_t *entry;
+	size_t len;
+	FILE *file;
+
+	file = fopen(this->path, "r");
+	if (!file)
+	{
+		if (errno != ENOENT)
+		{
+			DBG1(DBG_PTS, "opening measurement cache '%s' failed: %s",
+				 this->path, strerror(errno));
+		}
+		return;
+	}
+	while (fgets(line, sizeof(line), file))
+	{
+		if (sscanf(line, "%llu %llu %llu %lld %lld %u %96s", &dev, &ino,
+				   &size, &mtime, &ctime, &algo, hex) != 7)
+		{
+			continue;
+		}
+		len = pts_meas_algo_hash_size(algo);
+		if (!len || len > HASH_SIZE_SHA384 || strlen(hex) != 2 * len)
+		{
+			continue;
+		}
+		INIT(entry,
+			.dev = dev,
+			.ino = ino,
+			.size = size,
+			.mtime = mtime,
+			.ctime = ctime,
+			.algo = algo,
+		);
+		chunk_from_hex(chunk_create(hex, 2 * len), entry->hash);
+		add_entry(this, entry);
+		count++;
+	}
+	fclose(file);
+	DBG2(DBG_PTS, "loaded %u measurements from cache '%s'", count, this->path);
+}
+
+METHOD(pts_meas_cache_t, save, bool,
+	private_pts_meas_cache_t *this)
+{
+	char tmp[PATH_MAX], hex[2 * HASH_SIZE_SHA384 + 1];
+	enumerator_t *enumerator;
+	entry_t *entry;
+	bool success = TRUE;
+	FILE *file;
+
+	if (!this->path)
+	{
+		return TRUE;
+	}
+	this->mutex->lock(this->mutex);
+	if (!this->modified)
+	{
+		this->mutex->unlock(this->mutex);
+		return TRUE;
+	}
+	/* write to a temporary file first to never leave a truncated cache */
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", this->path) >= sizeof(tmp))
+	{
+		this->mutex->unlock(this->mutex);
+		return FALSE;
+	}
+	file = fopen(tmp, "w");
+	if (!file)
+	{
+		DBG1(DBG_PTS, "writing measurement cache '%s' failed: %s",
+			 tmp, strerror(errno));
+		this->mutex->unlock(this->mutex);
+		return FALSE;
+	}
+	/* oldest first, so the same entries get evicted after loading */
+	enumerator = this->order->create_enumerator(this->order);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		chunk_to_hex(chunk_create(entry->hash,
+						pts_meas_algo_hash_size(entry->algo)), hex, FALSE);
+		if (fprintf(file, "%llu %llu %llu %lld %lld %u %s\n",
+					(unsigned long long)entry->dev,
+					(unsigned long long)entry->ino,
+					(unsigned long long)entry->size,
+					(long long)entry->mtime, (long long)entry->ctime,
+					entry->algo, hex) < 0)
+		{
+			success = FALSE;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (fclose(file) != 0)
+	{
+		success = FALSE;
+	}
+	if (success && rename(tmp, this->path) == 0)
+	{
+		this->modified = FALSE;
+	}
+	else
+	{
+		DBG1(DBG_PTS, "writing measurement cache '%s' failed: %s",
+			 this->path, strerror(errno));
+		unlink(tmp);
+		success = FALSE;
+	}
+	this->mutex->unlock(this->mutex);
+	return success;
+}
+
+METHOD(pts_meas_cache_t, destroy, void,
+	private_pts_meas_cache_t *this)
+{
+	this->order->destroy_function(this->order, free);
+	this->entries->destroy(this->entries);
+	this->mutex->destroy(this->mutex);
+	free(this->path);
+	free(this);
+}
+
+/**
+ * See header
+ */
+pts_meas_cache_t *pts_meas_cache_create(char *path, u_int size)
+{
+	private_pts_meas_cache_t *this;
+
+	INIT(this,
+		.public = {
+			.get = _get,
+			.put = _put,
+			.save = _save,
+			.destroy = _destroy,
+		},
+		.entries = hashtable_create((hashtable_hash_t)hash,
+									(hashtable_equals_t)equals, 128),
+		.order = linked_list_create(),
+		.max = max(size, 1),
+		.path = strdupnull(path),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+	);
+
+	if (this->path)
+	{
+		load(this);
+	}
+	return &this->public;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup pts_meas_cache pts_meas_cache
+ * @{ @ingroup pts
+ */
+
+#ifndef PTS_MEAS_CACHE_H_
+#define PTS_MEAS_CACHE_H_
+
+#include "pts_meas_algo.h"
+
+#include <library.h>
+
+#include <sys/stat.h>
+
+typedef struct pts_meas_cache_t pts_meas_cache_t;
+
+/**
+ * Cache of file measurements, optionally persisted between runs.
+ *
+ * Measurements are keyed by device, inode, size, modification and status
+ * change time and measurement algorithm of a file. The status change time
+ * can't be set from user space, so a file with a restored modification time
+ * still gets measured again. Files changed within the current second are not
+ * cached, as a later change in the same second would go unnoticed.
+ *
+ * If the cache is full, the oldest measurement gets evicted.
+ */
+struct pts_meas_cache_t {
+
+	/**
+	 * Look up the cached measurement of a file.
+	 *
+	 * @param st			stat() information of the file
+	 * @param algo			measurement algorithm
+	 * @param hash			buffer receiving the cached measurement
+	 * @return				TRUE if a measurement has been found
+	 */
+	bool (*get)(pts_meas_cache_t *this, struct stat *st,
+				pts_meas_algorithms_t algo, u_char *hash);
+
+	/**
+	 * Cache the measurement of a file.
+	 *
+	 * @param st			stat() information of the file
+	 * @param algo			measurement algorithm
+	 * @param hash			measurement of the file
+	 */
+	void (*put)(pts_meas_cache_t *this, struct stat *st,
+				pts_meas_algorithms_t algo, u_char *hash);
+
+	/**
+	 * Write the cache to its file, if it has been modified.
+	 *
+	 * @return				TRUE if cache written or not modified
+	 */
+	bool (*save)(pts_meas_cache_t *this);
+
+	/**
+	 * Destroy a pts_meas_cache_t object, without saving it.
+	 */
+	void (*destroy)(pts_meas_cache_t *this);
+};
+
+/**
+ * Create a pts_meas_cache_t object.
+ *
+ * @param path			file to load the cache from and save it to, NULL
+ *						to keep measurements in memory only
+ * @param size			maximum number of cached measurements
+ * @return				cache object
+ */
+pts_meas_cache_t *pts_meas_cache_create(char *path, u_int size);
+
+#endif /** PTS_MEAS_CACHE_H_ @}*/
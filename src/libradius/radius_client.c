@@ -51,6 +51,21 @@ struct private_radius_client_t {
 	 * EAP MSK, from MPPE keys
 	 */
 	chunk_t msk;
+
+	/**
+	 * Socket used for an outstanding asynchronous request
+	 */
+	radius_socket_t *socket;
+
+	/**
+	 * Callback for an outstanding asynchronous request
+	 */
+	radius_client_cb_t cb;
+
+	/**
+	 * User data to pass to callback
+	 */
+	void *data;
 };
 
 /**
@@ -78,13 +93,12 @@ static void save_state(private_radius_client_t *this, radius_message_t *msg)
 	chunk_free(&this->state);
 }
 
-METHOD(radius_client_t, request, radius_message_t*,
-	private_radius_client_t *this, radius_message_t *req)
+/**
+ * Add client specific attributes to a request, get a socket to send it over
+ */
+static radius_socket_t *prepare_request(private_radius_client_t *this,
+										radius_message_t *req)
 {
-	radius_socket_t *socket;
-	radius_message_t *res;
-	chunk_t data;
-
 	/* add our NAS-Identifier */
 	req->add(req, RAT_NAS_IDENTIFIER,
 			 this->config->get_nas_identifier(this->config));
@@ -93,11 +107,21 @@ METHOD(radius_client_t, request, radius_message_t*,
 	{
 		req->add(req, RAT_STATE, this->state);
 	}
-	socket = this->config->get_socket(this->config);
 	DBG1(DBG_CFG, "sending RADIUS %N to server '%s'", radius_message_code_names,
 		 req->get_code(req), this->config->get_name(this->config));
+	return this->config->get_socket(this->config,
+							req->get_code(req) == RMC_ACCOUNTING_REQUEST);
+}
+
+/**
+ * Process a response received over a socket, if any
+ */
+static void process_response(private_radius_client_t *this,
+							 radius_socket_t *socket, radius_message_t *req,
+							 radius_message_t *res)
+{
+	chunk_t data;
 
-	res = socket->request(socket, req);
 	if (res)
 	{
 		DBG1(DBG_CFG, "received RADIUS %N from server '%s'",
@@ -113,10 +137,49 @@ METHOD(radius_client_t, request, radius_message_t*,
 			this->msk = socket->decrypt_msk(socket, req, res);
 		}
 		this->config->put_socket(this->config, socket, TRUE);
-		return res;
+		return;
 	}
 	this->config->put_socket(this->config, socket, FALSE);
-	return NULL;
+}
+
+METHOD(radius_client_t, request, radius_message_t*,
+	private_radius_client_t *this, radius_message_t *req)
+{
+	radius_socket_t *socket;
+	radius_message_t *res;
+
+	socket = prepare_request(this, req);
+	res = socket->request(socket, req);
+	process_response(this, socket, req, res);
+	return res;
+}
+
+/**
+ * Completion callback for asynchronous requests
+ */
+static void complete_async(private_radius_client_t *this,
+						   radius_message_t *req, radius_message_t *res)
+{
+	process_response(this, this->socket, req, res);
+	this->socket = NULL;
+	this->cb(this->data, req, res);
+}
+
+METHOD(radius_client_t, request_async, bool,
+	private_radius_client_t *this, radius_message_t *req,
+	radius_client_cb_t cb, void *data)
+{
+	this->socket = prepare_request(this, req);
+	this->cb = cb;
+	this->data = data;
+	if (!this->socket->request_async(this->socket, req,
+								(radius_socket_cb_t)complete_async, this))
+	{
+		this->config->put_socket(this->config, this->socket, FALSE);
+		this->socket = NULL;
+		return FALSE;
+	}
+	return TRUE;
 }
 
 METHOD(radius_client_t, get_msk, chunk_t,
@@ -144,6 +207,7 @@ radius_client_t *radius_client_create(radius_config_t *config)
 	INIT(this,
 		.public = {
 			.request = _request,
+			.request_async = _request_async,
 			.get_msk = _get_msk,
 			.destroy = _destroy,
 		},
@@ -26,6 +26,16 @@
 
 typedef struct radius_client_t radius_client_t;
 
+/**
+ * Callback function invoked when an asynchronous request completes.
+ *
+ * @param data			user data, as passed to request_async()
+ * @param request		request message the response belongs to
+ * @param response		response, NULL if timed out/verification failed
+ */
+typedef void (*radius_client_cb_t)(void *data, radius_message_t *request,
+								   radius_message_t *response);
+
 /**
  * RADIUS client functionality.
  *
@@ -44,6 +54,21 @@ struct radius_client_t {
 	 */
 	radius_message_t* (*request)(radius_client_t *this, radius_message_t *msg);
 
+	/**
+	 * Send a RADIUS request, invoke a callback once the response arrives.
+	 *
+	 * The client handles a single asynchronous request at a time, neither
+	 * the client nor msg must be destroyed before the callback has been
+	 * invoked. The callback receives ownership of the response.
+	 *
+	 * @param msg			RADIUS request message to send
+	 * @param cb			callback to invoke on completion
+	 * @param data			user data to pass to callback
+	 * @return				TRUE if sent, FALSE if cb won't be invoked
+	 */
+	bool (*request_async)(radius_client_t *this, radius_message_t *msg,
+						  radius_client_cb_t cb, void *data);
+
 	/**
 	 * Get the EAP MSK after successful RADIUS authentication.
 	 *
@@ -15,8 +15,6 @@
 
 #include "radius_config.h"
 
-#include <threading/mutex.h>
-#include <threading/condvar.h>
 #include <collections/linked_list.h>
 
 typedef struct private_radius_config_t private_radius_config_t;
@@ -37,19 +35,14 @@ struct private_radius_config_t {
 	linked_list_t *sockets;
 
 	/**
-	 * Total number of sockets, in list + currently in use
+	 * list of radius sockets dedicated to accounting, as radius_socket_t
 	 */
-	int socket_count;
-
-	/**
-	 * mutex to lock sockets list
-	 */
-	mutex_t *mutex;
+	linked_list_t *acct_sockets;
 
 	/**
-	 * condvar to wait for sockets
+	 * Total number of sockets
 	 */
-	condvar_t *condvar;
+	int socket_count;
 
 	/**
 	 * Server name
@@ -82,27 +75,54 @@ struct private_radius_config_t {
 	refcount_t ref;
 };
 
-METHOD(radius_config_t, get_socket, radius_socket_t*,
-	private_radius_config_t *this)
+/**
+ * Get the total number of outstanding requests on all sockets
+ */
+static u_int get_pending(private_radius_config_t *this)
 {
+	enumerator_t *enumerator;
 	radius_socket_t *skt;
+	u_int pending = 0;
 
-	this->mutex->lock(this->mutex);
-	while (this->sockets->remove_first(this->sockets, (void**)&skt) != SUCCESS)
+	enumerator = this->sockets->create_enumerator(this->sockets);
+	while (enumerator->enumerate(enumerator, &skt))
+	{
+		pending += skt->get_pending(skt);
+	}
+	enumerator->destroy(enumerator);
+	return pending;
+}
+
+METHOD(radius_config_t, get_socket, radius_socket_t*,
+	private_radius_config_t *this, bool accounting)
+{
+	enumerator_t *enumerator;
+	linked_list_t *sockets = this->sockets;
+	radius_socket_t *skt, *best = NULL;
+	u_int pending, best_pending = 0;
+
+	if (accounting && this->acct_sockets->get_count(this->acct_sockets))
+	{	/* don't let accounting bursts delay authentication */
+		sockets = this->acct_sockets;
+	}
+	/* sockets multiplex requests, use the one with the least load */
+	enumerator = sockets->create_enumerator(sockets);
+	while (enumerator->enumerate(enumerator, &skt))
 	{
-		this->condvar->wait(this->condvar, this->mutex);
+		pending = skt->get_pending(skt);
+		if (!best || pending < best_pending)
+		{
+			best = skt;
+			best_pending = pending;
+		}
 	}
-	this->mutex->unlock(this->mutex);
-	return skt;
+	enumerator->destroy(enumerator);
+	return best;
 }
 
 METHOD(radius_config_t, put_socket, void,
 	private_radius_config_t *this, radius_socket_t *skt, bool result)
 {
-	this->mutex->lock(this->mutex);
-	this->sockets->insert_last(this->sockets, skt);
-	this->mutex->unlock(this->mutex);
-	this->condvar->signal(this->condvar);
 	this->reachable = result;
 }
 
@@ -121,9 +141,10 @@ METHOD(radius_config_t, get_preference, int,
 	{	/* don't have sockets, huh? */
 		return -1;
 	}
-	/* calculate preference between 0-100 + boost */
+	/* calculate preference between 0-100 + boost, based on the number of
+	 * outstanding requests per socket */
 	pref = this->preference;
-	pref += this->sockets->get_count(this->sockets) * 100 / this->socket_count;
+	pref += this->socket_count * 100 / (this->socket_count + get_pending(this));
 	if (this->reachable)
 	{	/* reachable server get a boost: pref = 110-210 + boost */
 		return pref + 110;
@@ -166,10 +187,10 @@ METHOD(radius_config_t, destroy, void,
 {
 	if (ref_put(&this->ref))
 	{
-		this->mutex->destroy(this->mutex);
-		this->condvar->destroy(this->condvar);
 		this->sockets->destroy_offset(this->sockets,
 									  offsetof(radius_socket_t, destroy));
+		this->acct_sockets->destroy_offset(this->acct_sockets,
+									  offsetof(radius_socket_t, destroy));
 		free(this);
 	}
 }
@@ -180,7 +201,8 @@ METHOD(radius_config_t, destroy, void,
 radius_config_t *radius_config_create(char *name, char *address,
 									  u_int16_t auth_port, u_int16_t acct_port,
 									  char *nas_identifier, char *secret,
-									  int sockets, int preference)
+									  int sockets, int acct_sockets,
+									  int preference)
 {
 	private_radius_config_t *this;
 	radius_socket_t *socket;
@@ -199,8 +221,7 @@ radius_config_t *radius_config_create(char *name, char *address,
 		.nas_identifier = chunk_create(nas_identifier, strlen(nas_identifier)),
 		.socket_count = sockets,
 		.sockets = linked_list_create(),
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
-		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.acct_sockets = linked_list_create(),
 		.name = name,
 		.preference = preference,
 		.ref = 1,
@@ -217,5 +238,16 @@ radius_config_t *radius_config_create(char *name, char *address,
 		}
 		this->sockets->insert_last(this->sockets, socket);
 	}
+	while (acct_sockets-- > 0)
+	{
+		socket = radius_socket_create(address, auth_port, acct_port,
+									  chunk_create(secret, strlen(secret)));
+		if (!socket)
+		{
+			destroy(this);
+			return NULL;
+		}
+		this->acct_sockets->insert_last(this->acct_sockets, socket);
+	}
 	return &this->public;
 }
@@ -33,9 +33,14 @@ struct radius_config_t {
 	/**
 	 * Get a RADIUS socket from the pool to communicate with this config.
 	 *
-	 * @return			RADIUS socket
+	 * Sockets multiplex concurrent requests, the socket with the least
+	 * outstanding requests is returned. Accounting requests use a dedicated
+	 * pool of sockets, if configured.
+	 *
+	 * @param accounting	TRUE to get a socket for accounting requests
+	 * @return				RADIUS socket
 	 */
-	radius_socket_t* (*get_socket)(radius_config_t *this);
+	radius_socket_t* (*get_socket)(radius_config_t *this, bool accounting);
 
 	/**
 	 * Release a socket to the pool after use.
@@ -55,7 +60,7 @@ struct radius_config_t {
 	/**
 	 * Get the preference of this server.
 	 *
-	 * Based on the available sockets and the server reachability a preference
+	 * Based on the socket load and the server reachability a preference
 	 * value is calculated: better servers return a higher value.
 	 */
 	int (*get_preference)(radius_config_t *this);
@@ -90,11 +95,14 @@ struct radius_config_t {
  * @param nas_identifier	NAS-Identifier to use with this server
  * @param secret			secret to use with this server
  * @param sockets			number of sockets to create in pool
+ * @param acct_sockets		number of sockets dedicated to accounting, 0 to
+ *							send accounting requests over the pool above
  * @param preference		preference boost for this server
  */
 radius_config_t *radius_config_create(char *name, char *address,
 									  u_int16_t auth_port, u_int16_t acct_port,
 									  char *nas_identifier, char *secret,
-									  int sockets, int preference);
+									  int sockets, int acct_sockets,
+									  int preference);
 
 #endif /** RADIUS_CONFIG_H_ @}*/
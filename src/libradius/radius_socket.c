@@ -18,51 +18,98 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 
 #include <pen/pen.h>
 #include <utils/debug.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <threading/thread.h>
+#include <processing/jobs/callback_job.h>
+
+/**
+ * Number of RADIUS identifiers, maximum number of concurrent requests
+ */
+#define MAX_IDENTIFIERS 256
+
+/**
+ * Retransmission timeout of first transmit, in s
+ */
+#define RETRANSMIT_TIMEOUT 2
+
+/**
+ * Number of retransmits before giving up, timeout increases by one second
+ * with each retransmit
+ */
+#define RETRANSMIT_TRIES 3
+
+/**
+ * Interval to check if a response has been received by another thread while
+ * reading responses for a synchronous request, in ms
+ */
+#define SYNC_POLL_INTERVAL 100
 
 typedef struct private_radius_socket_t private_radius_socket_t;
+typedef struct channel_t channel_t;
+typedef struct pending_t pending_t;
+typedef struct retransmit_job_t retransmit_job_t;
 
 /**
- * Private data of an radius_socket_t object.
+ * Socket to a server port, with its own space of RADIUS identifiers
  */
-struct private_radius_socket_t {
+struct channel_t {
 
 	/**
-	 * Public radius_socket_t interface.
+	 * Server port
 	 */
-	radius_socket_t public;
+	u_int16_t port;
 
 	/**
-	 * Server port for authentication
+	 * socket file descriptor
 	 */
-	u_int16_t auth_port;
+	int fd;
 
 	/**
-	 * socket file descriptor for authentication
+	 * current RADIUS identifier
 	 */
-	int auth_fd;
+	u_int8_t identifier;
 
 	/**
-	 * Server port for accounting
+	 * Outstanding requests, indexed by RADIUS identifier
 	 */
-	u_int16_t acct_port;
+	pending_t *pending[MAX_IDENTIFIERS];
 
 	/**
-	 * socket file descriptor for accounting
+	 * Number of outstanding requests
 	 */
-	int acct_fd;
+	u_int count;
+};
+
+/**
+ * Private data of an radius_socket_t object.
+ */
+struct private_radius_socket_t {
 
 	/**
-	 * Server address
+	 * Public radius_socket_t interface.
 	 */
-	char *address;
+	radius_socket_t public;
 
 	/**
-	 * current RADIUS identifier
+	 * Channel for authentication
 	 */
-	u_int8_t identifier;
+	channel_t auth;
+
+	/**
+	 * Channel for accounting
+	 */
+	channel_t acct;
+
+	/**
+	 * Server address
+	 */
+	char *address;
 
 	/**
 	 * hasher to use for response verification
@@ -83,19 +130,311 @@ struct private_radius_socket_t {
 	 * RADIUS secret
 	 */
 	chunk_t secret;
+
+	/**
+	 * Sequence number to detect stale retransmit jobs
+	 */
+	u_int seq;
+
+	/**
+	 * Mutex to lock channels, outstanding requests and crypto primitives
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Condvar to signal completed synchronous requests
+	 */
+	condvar_t *condvar;
+
+	/**
+	 * Reference count, held by each scheduled retransmit job
+	 */
+	refcount_t ref;
 };
 
 /**
- * Check or establish RADIUS connection
+ * An outstanding request
+ */
+struct pending_t {
+
+	/**
+	 * Request message
+	 */
+	radius_message_t *request;
+
+	/**
+	 * Channel the request has been sent on
+	 */
+	channel_t *channel;
+
+	/**
+	 * Number of retransmits so far
+	 */
+	u_int retransmits;
+
+	/**
+	 * Unique sequence number of this request
+	 */
+	u_int seq;
+
+	/**
+	 * Callback to invoke on completion
+	 */
+	radius_socket_cb_t cb;
+
+	/**
+	 * User data to pass to callback
+	 */
+	void *data;
+};
+
+/**
+ * Data for a scheduled retransmit
+ */
+struct retransmit_job_t {
+
+	/**
+	 * Socket of the request
+	 */
+	private_radius_socket_t *this;
+
+	/**
+	 * Channel of the request
+	 */
+	channel_t *channel;
+
+	/**
+	 * RADIUS identifier of the request
+	 */
+	u_int8_t identifier;
+
+	/**
+	 * Sequence number of the request
+	 */
+	u_int seq;
+};
+
+/**
+ * Release a reference, destroy the socket if it was the last one
+ */
+static void socket_unref(private_radius_socket_t *this)
+{
+	if (ref_put(&this->ref))
+	{
+		DESTROY_IF(this->hasher);
+		DESTROY_IF(this->signer);
+		DESTROY_IF(this->rng);
+		this->condvar->destroy(this->condvar);
+		this->mutex->destroy(this->mutex);
+		free(this);
+	}
+}
+
+/**
+ * Cleanup function for retransmit jobs
+ */
+static void retransmit_job_destroy(retransmit_job_t *job)
+{
+	socket_unref(job->this);
+	free(job);
+}
+
+static job_requeue_t retransmit(retransmit_job_t *job);
+
+/**
+ * Schedule a retransmit job for a pending request, mutex must be held
+ */
+static void schedule_retransmit(private_radius_socket_t *this, u_int8_t id,
+								pending_t *pending)
+{
+	retransmit_job_t *job;
+
+	INIT(job,
+		.this = this,
+		.channel = pending->channel,
+		.identifier = id,
+		.seq = pending->seq,
+	);
+	ref_get(&this->ref);
+	lib->scheduler->schedule_job(lib->scheduler, (job_t*)
+		callback_job_create_with_prio((callback_job_cb_t)retransmit, job,
+				(callback_job_cleanup_t)retransmit_job_destroy, NULL,
+				JOB_PRIO_HIGH),
+		RETRANSMIT_TIMEOUT + pending->retransmits);
+}
+
+/**
+ * Send the encoding of a pending request
+ */
+static bool send_pending(pending_t *pending)
+{
+	chunk_t data;
+
+	data = pending->request->get_encoding(pending->request);
+	if (send(pending->channel->fd, data.ptr, data.len, 0) != data.len)
+	{
+		DBG1(DBG_CFG, "sending RADIUS message failed: %s", strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Remove a pending request, mutex must be held
+ */
+static void remove_pending(channel_t *channel, u_int8_t id)
+{
+	free(channel->pending[id]);
+	channel->pending[id] = NULL;
+	channel->count--;
+}
+
+/**
+ * Retransmit a pending request, or remove it if it timed out, mutex must be
+ * held. Returns TRUE if the request has been retransmitted.
+ */
+static bool retransmit_pending(channel_t *channel, u_int8_t id,
+							   radius_socket_cb_t *cb, void **data,
+							   radius_message_t **request)
+{
+	pending_t *pending = channel->pending[id];
+
+	if (pending->retransmits < RETRANSMIT_TRIES)
+	{
+		DBG1(DBG_CFG, "retransmitting RADIUS message");
+		pending->retransmits++;
+		if (send_pending(pending))
+		{
+			return TRUE;
+		}
+	}
+	else
+	{
+		DBG1(DBG_CFG, "RADIUS server is not responding");
+	}
+	*cb = pending->cb;
+	*data = pending->data;
+	*request = pending->request;
+	remove_pending(channel, id);
+	return FALSE;
+}
+
+/**
+ * Retransmit a request, or give up after the last retransmit timed out
  */
-static bool check_connection(private_radius_socket_t *this,
-							 int *fd, u_int16_t port)
+static job_requeue_t retransmit(retransmit_job_t *job)
 {
+	private_radius_socket_t *this = job->this;
+	radius_socket_cb_t cb = NULL;
+	pending_t *pending;
+	radius_message_t *request = NULL;
+	void *data = NULL;
+
+	this->mutex->lock(this->mutex);
+	pending = job->channel->pending[job->identifier];
+	if (pending && pending->seq == job->seq &&
+		retransmit_pending(job->channel, job->identifier, &cb, &data, &request))
+	{
+		schedule_retransmit(this, job->identifier, pending);
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (cb)
+	{
+		cb(data, request, NULL);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Receive and dispatch a response on a channel
+ */
+static void receive(private_radius_socket_t *this, channel_t *channel, int fd)
+{
+	radius_message_t *response;
+	radius_socket_cb_t cb = NULL;
+	pending_t *pending;
+	radius_message_t *request = NULL;
+	void *data = NULL;
+	char buf[4096];
+	u_int8_t id;
+	int res;
+
+	res = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+	if (res <= 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			DBG1(DBG_CFG, "receiving RADIUS message failed: %s",
+				 strerror(errno));
+		}
+		return;
+	}
+	response = radius_message_parse(chunk_create(buf, res));
+	if (!response)
+	{
+		DBG1(DBG_CFG, "received invalid RADIUS message, ignored");
+		return;
+	}
+	id = response->get_identifier(response);
+
+	this->mutex->lock(this->mutex);
+	pending = channel->pending[id];
+	if (pending &&
+		response->verify(response,
+						 pending->request->get_authenticator(pending->request),
+						 this->secret, this->hasher, this->signer))
+	{
+		cb = pending->cb;
+		data = pending->data;
+		request = pending->request;
+		remove_pending(channel, id);
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (cb)
+	{
+		cb(data, request, response);
+	}
+	else
+	{
+		DBG1(DBG_CFG, "received invalid RADIUS message, ignored");
+		response->destroy(response);
+	}
+}
+
+/**
+ * Receive a message on the authentication channel, invoked by the watcher
+ */
+static bool receive_auth(private_radius_socket_t *this, int fd,
+						 watcher_event_t event)
+{
+	receive(this, &this->auth, fd);
+	return TRUE;
+}
+
+/**
+ * Receive a message on the accounting channel, invoked by the watcher
+ */
+static bool receive_acct(private_radius_socket_t *this, int fd,
+						 watcher_event_t event)
+{
+	receive(this, &this->acct, fd);
+	return TRUE;
+}
+
+/**
+ * Check or establish RADIUS connection, mutex must be held
+ */
+static bool check_connection(private_radius_socket_t *this, channel_t *channel)
+{
+	int *fd = &channel->fd;
+
 	if (*fd == -1)
 	{
 		host_t *server;
 
-		server = host_create_from_dns(this->address, AF_UNSPEC, port);
+		server = host_create_from_dns(this->address, AF_UNSPEC, channel->port);
 		if (!server)
 		{
 			DBG1(DBG_CFG, "resolving RADIUS server address '%s' failed",
@@ -121,110 +460,268 @@ static bool check_connection(private_radius_socket_t *this,
 			return FALSE;
 		}
 		server->destroy(server);
+		fcntl(*fd, F_SETFL, fcntl(*fd, F_GETFL) | O_NONBLOCK);
+		lib->watcher->add(lib->watcher, *fd, WATCHER_READ,
+						  channel == &this->auth ? (watcher_cb_t)receive_auth
+												 : (watcher_cb_t)receive_acct,
+						  this);
 	}
 	return TRUE;
 }
 
-METHOD(radius_socket_t, request, radius_message_t*,
-	private_radius_socket_t *this, radius_message_t *request)
+/**
+ * Send a request and register it as pending.
+ *
+ * If schedule is set, retransmits get scheduled as jobs, otherwise the caller
+ * is responsible for retransmitting. On success, the channel, the identifier
+ * and the sequence number of the request are returned.
+ */
+static bool send_request(private_radius_socket_t *this,
+						 radius_message_t *request, radius_socket_cb_t cb,
+						 void *data, bool schedule, channel_t **out,
+						 u_int8_t *id, u_int *seq)
 {
-	chunk_t data;
-	int i, *fd;
-	u_int16_t port;
+	channel_t *channel;
+	pending_t *pending;
+	chunk_t encoding;
 	rng_t *rng = NULL;
 
 	if (request->get_code(request) == RMC_ACCOUNTING_REQUEST)
 	{
-		fd = &this->acct_fd;
-		port = this->acct_port;
+		channel = &this->acct;
 	}
 	else
 	{
-		fd = &this->auth_fd;
-		port = this->auth_port;
+		channel = &this->auth;
 		rng = this->rng;
 	}
 
-	/* set Message Identifier */
-	request->set_identifier(request, this->identifier++);
+	this->mutex->lock(this->mutex);
+	if (channel->count == MAX_IDENTIFIERS)
+	{
+		DBG1(DBG_CFG, "all RADIUS identifiers to %s in use, request failed",
+			 this->address);
+		this->mutex->unlock(this->mutex);
+		return FALSE;
+	}
+	if (!check_connection(this, channel))
+	{
+		this->mutex->unlock(this->mutex);
+		return FALSE;
+	}
+	/* use the next free Message Identifier */
+	while (channel->pending[channel->identifier])
+	{
+		channel->identifier++;
+	}
+	request->set_identifier(request, channel->identifier);
 	/* sign the request */
 	if (!request->sign(request, NULL, this->secret, this->hasher, this->signer,
 					   rng, rng != NULL))
 	{
-		return NULL;
+		this->mutex->unlock(this->mutex);
+		return FALSE;
+	}
+	encoding = request->get_encoding(request);
+	DBG3(DBG_CFG, "%B", &encoding);
+
+	INIT(pending,
+		.request = request,
+		.channel = channel,
+		.seq = this->seq++,
+		.cb = cb,
+		.data = data,
+	);
+	if (!send_pending(pending))
+	{
+		free(pending);
+		this->mutex->unlock(this->mutex);
+		return FALSE;
+	}
+	channel->pending[channel->identifier] = pending;
+	channel->count++;
+	*out = channel;
+	*id = channel->identifier++;
+	*seq = pending->seq;
+	if (schedule)
+	{
+		schedule_retransmit(this, *id, pending);
 	}
+	this->mutex->unlock(this->mutex);
+	return TRUE;
+}
+
+METHOD(radius_socket_t, request_async, bool,
+	private_radius_socket_t *this, radius_message_t *request,
+	radius_socket_cb_t cb, void *data)
+{
+	channel_t *channel;
+	u_int8_t id;
+	u_int seq;
+
+	return send_request(this, request, cb, data, TRUE, &channel, &id, &seq);
+}
+
+/**
+ * State of a synchronous request
+ */
+typedef struct {
+	/** socket the request is sent over */
+	private_radius_socket_t *this;
+	/** channel the request is sent over */
+	channel_t *channel;
+	/** RADIUS identifier of the request */
+	u_int8_t id;
+	/** sequence number of the request */
+	u_int seq;
+	/** received response, if any */
+	radius_message_t *response;
+	/** TRUE once the request completed */
+	bool done;
+} sync_request_t;
+
+/**
+ * Completion callback for synchronous requests
+ */
+static void sync_complete(sync_request_t *sync, radius_message_t *request,
+						  radius_message_t *response)
+{
+	private_radius_socket_t *this = sync->this;
+
+	this->mutex->lock(this->mutex);
+	sync->response = response;
+	sync->done = TRUE;
+	this->condvar->broadcast(this->condvar);
+	this->mutex->unlock(this->mutex);
+}
 
-	if (!check_connection(this, fd, port))
+/**
+ * Check if a synchronous request completed
+ */
+static bool sync_done(sync_request_t *sync)
+{
+	bool done;
+
+	sync->this->mutex->lock(sync->this->mutex);
+	done = sync->done;
+	sync->this->mutex->unlock(sync->this->mutex);
+	return done;
+}
+
+/**
+ * Remove a synchronous request if the waiting thread gets cancelled
+ */
+static void sync_cancel(sync_request_t *sync)
+{
+	private_radius_socket_t *this = sync->this;
+	pending_t *pending;
+
+	this->mutex->lock(this->mutex);
+	pending = sync->channel->pending[sync->id];
+	if (pending && pending->seq == sync->seq)
 	{
-		return NULL;
+		remove_pending(sync->channel, sync->id);
+		sync->done = TRUE;
+	}
+	while (!sync->done)
+	{	/* completion is in progress, the callback refers to our stack */
+		this->condvar->wait(this->condvar, this->mutex);
 	}
+	this->mutex->unlock(this->mutex);
+	DESTROY_IF(sync->response);
+}
 
-	data = request->get_encoding(request);
-	DBG3(DBG_CFG, "%B", &data);
+/**
+ * Wait for a response to a synchronous request until a deadline, reading
+ * responses in the calling thread
+ */
+static void sync_wait(sync_request_t *sync, timeval_t *deadline)
+{
+	struct pollfd pfd = {
+		.fd = sync->channel->fd,
+		.events = POLLIN,
+	};
+	timeval_t now;
+	bool oldstate;
+	int timeout, res;
 
-	/* timeout after 2, 3, 4, 5 seconds */
-	for (i = 2; i <= 5; i++)
+	while (!sync_done(sync))
 	{
-		radius_message_t *response;
-		bool retransmit = FALSE;
-		struct timeval tv;
-		char buf[4096];
-		fd_set fds;
-		int res;
-
-		if (send(*fd, data.ptr, data.len, 0) != data.len)
+		time_monotonic(&now);
+		if (!timercmp(&now, deadline, <))
 		{
-			DBG1(DBG_CFG, "sending RADIUS message failed: %s", strerror(errno));
-			return NULL;
+			return;
 		}
-		tv.tv_sec = i;
-		tv.tv_usec = 0;
-
-		while (TRUE)
+		timersub(deadline, &now, &now);
+		/* the watcher might receive our response, don't wait too long */
+		timeout = min(now.tv_sec * 1000 + now.tv_usec / 1000 + 1,
+					  SYNC_POLL_INTERVAL);
+		oldstate = thread_cancelability(TRUE);
+		res = poll(&pfd, 1, timeout);
+		thread_cancelability(oldstate);
+		if (res < 0 && errno != EINTR)
 		{
-			FD_ZERO(&fds);
-			FD_SET(*fd, &fds);
-			res = select((*fd) + 1, &fds, NULL, NULL, &tv);
-			/* TODO: updated tv to time not waited. Linux does this for us. */
-			if (res < 0)
-			{	/* failed */
-				DBG1(DBG_CFG, "waiting for RADIUS message failed: %s",
-					 strerror(errno));
-				break;
-			}
-			if (res == 0)
-			{	/* timeout */
-				DBG1(DBG_CFG, "retransmitting RADIUS message");
-				retransmit = TRUE;
-				break;
-			}
-			res = recv(*fd, buf, sizeof(buf), MSG_DONTWAIT);
-			if (res <= 0)
-			{
-				DBG1(DBG_CFG, "receiving RADIUS message failed: %s",
-					 strerror(errno));
-				break;
-			}
-			response = radius_message_parse(chunk_create(buf, res));
-			if (response)
-			{
-				if (response->verify(response,
-							request->get_authenticator(request), this->secret,
-							this->hasher, this->signer))
-				{
-					return response;
-				}
-				response->destroy(response);
-			}
-			DBG1(DBG_CFG, "received invalid RADIUS message, ignored");
+			DBG1(DBG_CFG, "waiting for RADIUS message failed: %s",
+				 strerror(errno));
+			return;
 		}
-		if (!retransmit)
+		if (res > 0)
+		{	/* dispatches responses to any pending request */
+			receive(sync->this, sync->channel, pfd.fd);
+		}
+	}
+}
+
+METHOD(radius_socket_t, request, radius_message_t*,
+	private_radius_socket_t *this, radius_message_t *request)
+{
+	sync_request_t sync = {
+		.this = this,
+	};
+	radius_socket_cb_t cb = NULL;
+	radius_message_t *req;
+	pending_t *pending;
+	timeval_t deadline;
+	void *data;
+	u_int i;
+
+	if (!send_request(this, request, (radius_socket_cb_t)sync_complete, &sync,
+					  FALSE, &sync.channel, &sync.id, &sync.seq))
+	{
+		return NULL;
+	}
+
+	/* read and retransmit in this thread, as the watcher and the scheduler
+	 * depend on worker threads that might all be busy with requests */
+	thread_cleanup_push((void*)sync_cancel, &sync);
+	for (i = 0; !sync_done(&sync); i++)
+	{
+		time_monotonic(&deadline);
+		deadline.tv_sec += RETRANSMIT_TIMEOUT + i;
+		sync_wait(&sync, &deadline);
+
+		this->mutex->lock(this->mutex);
+		pending = sync.channel->pending[sync.id];
+		if (pending && pending->seq == sync.seq &&
+			!retransmit_pending(sync.channel, sync.id, &cb, &data, &req))
 		{
-			break;
+			sync.done = TRUE;
 		}
+		this->mutex->unlock(this->mutex);
 	}
-	DBG1(DBG_CFG, "RADIUS server is not responding");
-	return NULL;
+	thread_cleanup_pop(FALSE);
+	return sync.response;
+}
+
+METHOD(radius_socket_t, get_pending, u_int,
+	private_radius_socket_t *this)
+{
+	u_int count;
+
+	this->mutex->lock(this->mutex);
+	count = this->auth.count + this->acct.count;
+	this->mutex->unlock(this->mutex);
+	return count;
 }
 
 /**
@@ -234,11 +731,14 @@ static chunk_t decrypt_mppe_key(private_radius_socket_t *this, u_int16_t salt,
 								chunk_t C, radius_message_t *request)
 {
 	chunk_t decrypted;
+	bool success;
 
 	decrypted = chunk_alloca(C.len);
-	if (!request->crypt(request, chunk_from_thing(salt), C, decrypted,
-						this->secret, this->hasher) ||
-		decrypted.ptr[0] >= decrypted.len)
+	this->mutex->lock(this->mutex);
+	success = request->crypt(request, chunk_from_thing(salt), C, decrypted,
+							 this->secret, this->hasher);
+	this->mutex->unlock(this->mutex);
+	if (!success || decrypted.ptr[0] >= decrypted.len)
 	{	/* decryption failed? */
 		return chunk_empty;
 	}
@@ -286,21 +786,44 @@ METHOD(radius_socket_t, decrypt_msk, chunk_t,
 	return chunk_empty;
 }
 
-METHOD(radius_socket_t, destroy, void,
-	private_radius_socket_t *this)
+/**
+ * Close a channel and fail its pending requests
+ */
+static void close_channel(private_radius_socket_t *this, channel_t *channel)
 {
-	DESTROY_IF(this->hasher);
-	DESTROY_IF(this->signer);
-	DESTROY_IF(this->rng);
-	if (this->auth_fd != -1)
+	radius_socket_cb_t cb;
+	radius_message_t *request;
+	void *data;
+	int i;
+
+	if (channel->fd != -1)
 	{
-		close(this->auth_fd);
-	};
-	if (this->acct_fd != -1)
+		lib->watcher->remove(lib->watcher, channel->fd);
+		close(channel->fd);
+	}
+	for (i = 0; i < MAX_IDENTIFIERS; i++)
 	{
-		close(this->acct_fd);
+		this->mutex->lock(this->mutex);
+		if (!channel->pending[i])
+		{
+			this->mutex->unlock(this->mutex);
+			continue;
+		}
+		cb = channel->pending[i]->cb;
+		data = channel->pending[i]->data;
+		request = channel->pending[i]->request;
+		remove_pending(channel, i);
+		this->mutex->unlock(this->mutex);
+		cb(data, request, NULL);
 	}
-	free(this);
+}
+
+METHOD(radius_socket_t, destroy, void,
+	private_radius_socket_t *this)
+{
+	close_channel(this, &this->auth);
+	close_channel(this, &this->acct);
+	socket_unref(this);
 }
 
 /**
@@ -314,17 +837,26 @@ radius_socket_t *radius_socket_create(char *address, u_int16_t auth_port,
 	INIT(this,
 		.public = {
 			.request = _request,
+			.request_async = _request_async,
+			.get_pending = _get_pending,
 			.decrypt_msk = _decrypt_msk,
 			.destroy = _destroy,
 		},
 		.address = address,
-		.auth_port = auth_port,
-		.auth_fd = -1,
-		.acct_port = acct_port,
-		.acct_fd = -1,
+		.auth = {
+			.port = auth_port,
+			.fd = -1,
+		},
+		.acct = {
+			.port = acct_port,
+			.fd = -1,
+		},
 		.hasher = lib->crypto->create_hasher(lib->crypto, HASH_MD5),
 		.signer = lib->crypto->create_signer(lib->crypto, AUTH_HMAC_MD5_128),
 		.rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.ref = 1,
 	);
 
 	if (!this->hasher || !this->signer || !this->rng ||
@@ -335,8 +867,9 @@ radius_socket_t *radius_socket_create(char *address, u_int16_t auth_port,
 		return NULL;
 	}
 	this->secret = secret;
-	/* we use a random identifier, helps if we restart often */
-	this->identifier = random();
+	/* we use random identifiers, helps if we restart often */
+	this->auth.identifier = random();
+	this->acct.identifier = random();
 
 	return &this->public;
 }
@@ -27,14 +27,38 @@ typedef struct radius_socket_t radius_socket_t;
 
 #include <networking/host.h>
 
+/**
+ * Callback function invoked when an asynchronous request completes.
+ *
+ * The callback gets invoked from the thread receiving the response, or
+ * from a timer job. It should return quickly, any expensive processing
+ * should get queued to the processor.
+ *
+ * @param data			user data, as passed to request_async()
+ * @param request		request message the response belongs to
+ * @param response		verified response, NULL on timeout or failure
+ */
+typedef void (*radius_socket_cb_t)(void *data, radius_message_t *request,
+								   radius_message_t *response);
+
 /**
  * RADIUS socket to a server.
+ *
+ * Requests are multiplexed using the RADIUS identifier, allowing up to 256
+ * concurrent authentication and 256 concurrent accounting requests per
+ * socket. Responses to asynchronous requests are received using the
+ * watcher, their retransmits are scheduled as timed jobs.
  */
 struct radius_socket_t {
 
 	/**
 	 * Send a RADIUS request, wait for response.
 	 *
+	 * Other threads may send requests over the same socket concurrently.
+	 * The calling thread reads responses and retransmits the request
+	 * itself, so this does not depend on the availability of other worker
+	 * threads. The call may get cancelled.
+	 *
 	 * The socket fills in RADIUS Message identifier, builds a
 	 * Request-Authenticator and calculates the Message-Authenticator
 	 * attribute.
@@ -47,6 +71,29 @@ struct radius_socket_t {
 	radius_message_t* (*request)(radius_socket_t *this,
 								 radius_message_t *request);
 
+	/**
+	 * Send a RADIUS request, invoke a callback once the response arrives.
+	 *
+	 * The request gets prepared and the response verified as in request().
+	 * The request message must not be destroyed before the callback has been
+	 * invoked, the callback receives ownership of the response.
+	 * If all RADIUS identifiers are in use, the request fails.
+	 *
+	 * @param request		request message
+	 * @param cb			callback to invoke on completion
+	 * @param data			user data to pass to callback
+	 * @return				TRUE if request sent, FALSE if cb won't be invoked
+	 */
+	bool (*request_async)(radius_socket_t *this, radius_message_t *request,
+						  radius_socket_cb_t cb, void *data);
+
+	/**
+	 * Get the number of outstanding requests.
+	 *
+	 * @return				number of requests waiting for a response
+	 */
+	u_int (*get_pending)(radius_socket_t *this);
+
 	/**
 	 * Decrypt the MSK encoded in a messages MS-MPPE-Send/Recv-Key.
 	 *
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "test_suite.h"
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <radius_socket.h>
+#include <threading/thread.h>
+
+/**
+ * Maximum number of requests the stand-in server collects
+ */
+#define MAX_REQUESTS 16
+
+/**
+ * Number of concurrent clients
+ */
+#define CLIENTS 8
+
+static chunk_t secret = chunk_from_chars('s','e','c','r','e','t');
+
+/**
+ * UDP stand-in for a RADIUS server
+ */
+typedef struct {
+	/** socket of the server */
+	int fd;
+	/** port the server is bound to */
+	u_int16_t port;
+	/** thread running the server */
+	thread_t *thread;
+	/** number of requests to drop before answering */
+	int drop;
+	/** number of requests to collect before answering in reverse order */
+	int batch;
+	/** answer the first request with a response signed with a wrong secret */
+	bool forge;
+} server_t;
+
+static server_t auth_server, acct_server;
+static radius_socket_t *skt;
+
+/**
+ * Open a server socket bound to an ephemeral port on the loopback
+ */
+static void server_open(server_t *server)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+
+	server->fd = socket(AF_INET, SOCK_DGRAM, 0);
+	ck_assert(server->fd != -1);
+	ck_assert(bind(server->fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+	ck_assert(getsockname(server->fd, (struct sockaddr*)&addr, &len) == 0);
+	server->port = ntohs(addr.sin_port);
+	server->drop = server->batch = 0;
+	server->forge = FALSE;
+}
+
+/**
+ * Send a response to a request
+ */
+static void respond(server_t *server, radius_message_t *request,
+					struct sockaddr_in *addr, chunk_t key)
+{
+	radius_message_t *response;
+	radius_message_code_t code;
+	hasher_t *hasher;
+	signer_t *signer;
+	chunk_t data;
+
+	code = RMC_ACCESS_ACCEPT;
+	if (request->get_code(request) == RMC_ACCOUNTING_REQUEST)
+	{
+		code = RMC_ACCOUNTING_RESPONSE;
+	}
+	hasher = lib->crypto->create_hasher(lib->crypto, HASH_MD5);
+	signer = lib->crypto->create_signer(lib->crypto, AUTH_HMAC_MD5_128);
+	ck_assert(hasher && signer && signer->set_key(signer, key));
+
+	response = radius_message_create(code);
+	response->set_identifier(response, request->get_identifier(request));
+	ck_assert(response->sign(response, request->get_authenticator(request),
+							 key, hasher, signer, NULL, TRUE));
+	data = response->get_encoding(response);
+	ck_assert(sendto(server->fd, data.ptr, data.len, 0,
+					 (struct sockaddr*)addr, sizeof(*addr)) == data.len);
+	response->destroy(response);
+	signer->destroy(signer);
+	hasher->destroy(hasher);
+}
+
+/**
+ * Server thread, answers requests as configured
+ */
+static void *serve(server_t *server)
+{
+	radius_message_t *requests[MAX_REQUESTS];
+	struct sockaddr_in addrs[MAX_REQUESTS];
+	socklen_t len;
+	char buf[4096];
+	int count = 0, res;
+
+	while (TRUE)
+	{
+		len = sizeof(addrs[count]);
+		thread_cancelability(TRUE);
+		res = recvfrom(server->fd, buf, sizeof(buf), 0,
+					   (struct sockaddr*)&addrs[count], &len);
+		thread_cancelability(FALSE);
+		if (res <= 0)
+		{
+			continue;
+		}
+		if (server->drop > 0)
+		{
+			server->drop--;
+			continue;
+		}
+		requests[count] = radius_message_parse(chunk_create(buf, res));
+		if (!requests[count])
+		{
+			continue;
+		}
+		if (++count < max(server->batch, 1))
+		{
+			continue;
+		}
+		while (count--)
+		{
+			if (server->forge)
+			{
+				respond(server, requests[count], &addrs[count],
+						chunk_from_str("wrong"));
+				server->forge = FALSE;
+			}
+			respond(server, requests[count], &addrs[count], secret);
+			requests[count]->destroy(requests[count]);
+		}
+		count = 0;
+	}
+	return NULL;
+}
+
+START_SETUP(setup_servers)
+{
+	server_open(&auth_server);
+	server_open(&acct_server);
+	skt = radius_socket_create("127.0.0.1", auth_server.port, acct_server.port,
+							   secret);
+	ck_assert(skt != NULL);
+}
+END_SETUP
+
+START_TEARDOWN(teardown_servers)
+{
+	server_t *servers[] = { &auth_server, &acct_server };
+	int i;
+
+	skt->destroy(skt);
+	for (i = 0; i < countof(servers); i++)
+	{
+		if (servers[i]->thread)
+		{
+			servers[i]->thread->cancel(servers[i]->thread);
+			servers[i]->thread->join(servers[i]->thread);
+			servers[i]->thread = NULL;
+		}
+		close(servers[i]->fd);
+	}
+}
+END_TEARDOWN
+
+/**
+ * Start the server threads
+ */
+static void start_servers()
+{
+	auth_server.thread = thread_create((void*)serve, &auth_server);
+	acct_server.thread = thread_create((void*)serve, &acct_server);
+	ck_assert(auth_server.thread && acct_server.thread);
+}
+
+/**
+ * Send a request and check the response
+ */
+static void check_request(radius_message_code_t code,
+						  radius_message_code_t expected)
+{
+	radius_message_t *request, *response;
+
+	request = radius_message_create(code);
+	response = skt->request(skt, request);
+	ck_assert(response != NULL);
+	ck_assert_int_eq(response->get_code(response), expected);
+	ck_assert_int_eq(response->get_identifier(response),
+					 request->get_identifier(request));
+	response->destroy(response);
+	request->destroy(request);
+}
+
+START_TEST(test_request)
+{
+	start_servers();
+	check_request(RMC_ACCESS_REQUEST, RMC_ACCESS_ACCEPT);
+	check_request(RMC_ACCOUNTING_REQUEST, RMC_ACCOUNTING_RESPONSE);
+	ck_assert_int_eq(skt->get_pending(skt), 0);
+}
+END_TEST
+
+START_TEST(test_retransmit)
+{
+	auth_server.drop = 1;
+	start_servers();
+	check_request(RMC_ACCESS_REQUEST, RMC_ACCESS_ACCEPT);
+	ck_assert_int_eq(skt->get_pending(skt), 0);
+}
+END_TEST
+
+START_TEST(test_invalid)
+{
+	auth_server.forge = TRUE;
+	start_servers();
+	check_request(RMC_ACCESS_REQUEST, RMC_ACCESS_ACCEPT);
+	ck_assert_int_eq(skt->get_pending(skt), 0);
+}
+END_TEST
+
+/**
+ * Client thread sending a request
+ */
+static void *client(radius_message_code_t *code)
+{
+	radius_message_t *request, *response;
+
+	request = radius_message_create(*code);
+	response = skt->request(skt, request);
+	if (response)
+	{
+		if (response->get_identifier(response) !=
+			request->get_identifier(request))
+		{
+			response->destroy(response);
+			response = NULL;
+		}
+	}
+	request->destroy(request);
+	return response;
+}
+
+START_TEST(test_concurrent)
+{
+	radius_message_code_t codes[] = {
+		RMC_ACCESS_REQUEST, RMC_ACCOUNTING_REQUEST
+	};
+	thread_t *threads[CLIENTS];
+	radius_message_t *response;
+	int i;
+
+	/* the server answers once all clients sent their request, in reverse
+	 * order, so all requests must be outstanding on the socket at once */
+	auth_server.batch = acct_server.batch = CLIENTS / 2;
+	start_servers();
+	for (i = 0; i < CLIENTS; i++)
+	{
+		threads[i] = thread_create((void*)client, &codes[i % 2]);
+		ck_assert(threads[i] != NULL);
+	}
+	for (i = 0; i < CLIENTS; i++)
+	{
+		response = threads[i]->join(threads[i]);
+		ck_assert(response != NULL);
+		response->destroy(response);
+	}
+	ck_assert_int_eq(skt->get_pending(skt), 0);
+}
+END_TEST
+
+Suite *radius_socket_suite_create()
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("radius socket");
+
+	tc = tcase_create("request");
+	tcase_add_checked_fixture(tc, setup_servers, teardown_servers);
+	tcase_add_test(tc, test_request);
+	tcase_add_test(tc, test_retransmit);
+	tcase_add_test(tc, test_invalid);
+	tcase_add_test(tc, test_concurrent);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
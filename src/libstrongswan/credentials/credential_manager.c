@@ -1343,7 +1343,8 @@ credential_manager_t *credential_manager_create()
 		.sets = linked_list_create(),
 		.validators = linked_list_create(),
 		.cache_queue = linked_list_create(),
-		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.lock = rwlock_create_named(RWLOCK_TYPE_DEFAULT,
+									"credential_manager"),
 		.queue_mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
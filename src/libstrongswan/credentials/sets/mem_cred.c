@@ -19,9 +19,307 @@
 
 #include <threading/rwlock.h>
 #include <collections/linked_list.h>
+#include <collections/hashtable.h>
+#include <credentials/certificates/x509.h>
 
 typedef struct private_mem_cred_t private_mem_cred_t;
 
+/**
+ * Common header of all indexed entries
+ */
+typedef struct {
+	/** entries with higher priority come first in the enumerated lists */
+	u_int prio;
+} entry_t;
+
+/**
+ * Index over entries of a list, with buckets sorted by descending priority
+ */
+typedef struct {
+	/** identification_t => bucket_t */
+	hashtable_t *ids;
+	/** key identifier as chunk_t => bucket_t */
+	hashtable_t *keyids;
+	/** entries not in any bucket, always returned by lookups, as entry_t */
+	linked_list_t *other;
+} cred_index_t;
+
+/**
+ * Bucket in an index
+ */
+typedef struct {
+	/** identity this bucket is stored under, if any */
+	identification_t *id;
+	/** key identifier this bucket is stored under, if any */
+	chunk_t keyid;
+	/** entries, as entry_t */
+	linked_list_t *entries;
+} bucket_t;
+
+/**
+ * Hash an identity in a way that is compatible with perfect matches
+ */
+static u_int id_hash(identification_t *id)
+{
+	return id->hash(id, 0);
+}
+
+/**
+ * Compare identities for a perfect match
+ */
+static bool id_equals(identification_t *a, identification_t *b)
+{
+	return a->matches(a, b) == ID_MATCH_PERFECT;
+}
+
+/**
+ * Hash a key identifier
+ */
+static u_int keyid_hash(chunk_t *keyid)
+{
+	return chunk_hash(*keyid);
+}
+
+/**
+ * Compare key identifiers
+ */
+static bool keyid_equals(chunk_t *a, chunk_t *b)
+{
+	return chunk_equals(*a, *b);
+}
+
+/**
+ * Create an empty index
+ */
+static cred_index_t *index_create()
+{
+	cred_index_t *index;
+
+	INIT(index,
+		.ids = hashtable_create((hashtable_hash_t)id_hash,
+								(hashtable_equals_t)id_equals, 32),
+		.keyids = hashtable_create((hashtable_hash_t)keyid_hash,
+								   (hashtable_equals_t)keyid_equals, 32),
+		.other = linked_list_create(),
+	);
+	return index;
+}
+
+/**
+ * Destroy the buckets in a hashtable
+ */
+static void destroy_buckets(hashtable_t *table)
+{
+	enumerator_t *enumerator;
+	bucket_t *bucket;
+	void *key;
+
+	enumerator = table->create_enumerator(table);
+	while (enumerator->enumerate(enumerator, &key, &bucket))
+	{
+		DESTROY_IF(bucket->id);
+		chunk_free(&bucket->keyid);
+		bucket->entries->destroy(bucket->entries);
+		free(bucket);
+	}
+	enumerator->destroy(enumerator);
+	table->destroy(table);
+}
+
+/**
+ * Destroy an index, but not the indexed entries
+ */
+static void index_destroy(cred_index_t *index)
+{
+	destroy_buckets(index->ids);
+	destroy_buckets(index->keyids);
+	index->other->destroy(index->other);
+	free(index);
+}
+
+/**
+ * Insert an entry to a list sorted by descending priority, unless it is
+ * already contained
+ */
+static void insert_sorted(linked_list_t *list, entry_t *entry)
+{
+	enumerator_t *enumerator;
+	entry_t *current;
+
+	/* entries usually get added in priority order, so check the ends first */
+	if (list->get_first(list, (void**)&current) != SUCCESS ||
+		current->prio < entry->prio)
+	{
+		list->insert_first(list, entry);
+		return;
+	}
+	if (list->get_last(list, (void**)&current) == SUCCESS &&
+		current->prio > entry->prio)
+	{
+		list->insert_last(list, entry);
+		return;
+	}
+	enumerator = list->create_enumerator(list);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (current == entry)
+		{
+			enumerator->destroy(enumerator);
+			return;
+		}
+		if (current->prio < entry->prio)
+		{
+			break;
+		}
+	}
+	list->insert_before(list, enumerator, entry);
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Add an entry to the index, under the given identity
+ */
+static void index_add_id(cred_index_t *index, identification_t *id,
+						 entry_t *entry)
+{
+	bucket_t *bucket;
+
+	bucket = index->ids->get(index->ids, id);
+	if (!bucket)
+	{
+		INIT(bucket,
+			.id = id->clone(id),
+			.entries = linked_list_create(),
+		);
+		index->ids->put(index->ids, bucket->id, bucket);
+	}
+	insert_sorted(bucket->entries, entry);
+}
+
+/**
+ * Add an entry to the index, under the given key identifier
+ */
+static void index_add_keyid(cred_index_t *index, chunk_t keyid,
+							entry_t *entry)
+{
+	bucket_t *bucket;
+
+	if (!keyid.len)
+	{
+		return;
+	}
+	bucket = index->keyids->get(index->keyids, &keyid);
+	if (!bucket)
+	{
+		INIT(bucket,
+			.keyid = chunk_clone(keyid),
+			.entries = linked_list_create(),
+		);
+		index->keyids->put(index->keyids, &bucket->keyid, bucket);
+	}
+	insert_sorted(bucket->entries, entry);
+}
+
+/**
+ * Add an entry to the index that gets returned by all lookups
+ */
+static void index_add_other(cred_index_t *index, entry_t *entry)
+{
+	insert_sorted(index->other, entry);
+}
+
+/**
+ * Look up the buckets for an identity, by perfect match and/or by key
+ * identifier, and add their entry lists to the given array, returns the
+ * number of lists added
+ */
+static int index_lookup(cred_index_t *index, identification_t *id,
+						bool by_id, bool by_keyid, linked_list_t **lists)
+{
+	bucket_t *bucket;
+	chunk_t keyid;
+	int count = 0;
+
+	if (by_id)
+	{
+		bucket = index->ids->get(index->ids, id);
+		if (bucket)
+		{
+			lists[count++] = bucket->entries;
+		}
+	}
+	if (by_keyid)
+	{
+		keyid = id->get_encoding(id);
+		bucket = index->keyids->get(index->keyids, &keyid);
+		if (bucket)
+		{
+			lists[count++] = bucket->entries;
+		}
+	}
+	return count;
+}
+
+/**
+ * Maximum number of lists merged for a lookup
+ */
+#define MAX_LISTS 3
+
+/**
+ * Merge the given lists, sorted by descending priority, to a single list
+ * without duplicates.
+ */
+static linked_list_t *merge_sorted(linked_list_t **lists, int count)
+{
+	enumerator_t *enumerators[MAX_LISTS];
+	entry_t *current[MAX_LISTS], *best, *last = NULL;
+	linked_list_t *merged;
+	int i;
+
+	merged = linked_list_create();
+	for (i = 0; i < count; i++)
+	{
+		enumerators[i] = lists[i]->create_enumerator(lists[i]);
+		if (!enumerators[i]->enumerate(enumerators[i], &current[i]))
+		{
+			current[i] = NULL;
+		}
+	}
+	while (TRUE)
+	{
+		best = NULL;
+		for (i = 0; i < count; i++)
+		{
+			if (current[i] && (!best || current[i]->prio > best->prio))
+			{
+				best = current[i];
+			}
+		}
+		if (!best)
+		{
+			break;
+		}
+		for (i = 0; i < count; i++)
+		{
+			if (current[i] == best &&
+				!enumerators[i]->enumerate(enumerators[i], &current[i]))
+			{
+				current[i] = NULL;
+			}
+		}
+		if (best != last)
+		{
+			merged->insert_last(merged, best);
+			last = best;
+		}
+	}
+	for (i = 0; i < count; i++)
+	{
+		enumerators[i]->destroy(enumerators[i]);
+	}
+	return merged;
+}
+
 /**
  * Private data of an mem_cred_t object.
  */
@@ -38,31 +336,235 @@ struct private_mem_cred_t {
 	rwlock_t *lock;
 
 	/**
-	 * List of trusted certificates, certificate_t
+	 * List of trusted certificates, as cert_entry_t
 	 */
 	linked_list_t *trusted;
 
 	/**
-	 * List of trusted and untrusted certificates, certificate_t
+	 * List of trusted and untrusted certificates, as cert_entry_t
 	 */
 	linked_list_t *untrusted;
 
 	/**
-	 * List of private keys, private_key_t
+	 * Index over all certificates, by subject/subjectAltNames and key IDs
+	 */
+	cred_index_t *cert_index;
+
+	/**
+	 * List of private keys, as key_entry_t
 	 */
 	linked_list_t *keys;
 
+	/**
+	 * Index over private keys, by key IDs
+	 */
+	cred_index_t *key_index;
+
 	/**
 	 * List of shared keys, as shared_entry_t
 	 */
 	linked_list_t *shared;
 
+	/**
+	 * Index over shared keys, by owners
+	 */
+	cred_index_t *shared_index;
+
+	/**
+	 * Priority assigned to the next entry inserted at the head of a list
+	 */
+	u_int prio;
+
 	/**
 	 * List of CDPs, as cdp_t
 	 */
 	linked_list_t *cdps;
 };
 
+/**
+ * Certificate entry, in the trusted/untrusted lists and the index
+ */
+typedef struct {
+	/** common header, must be first */
+	entry_t entry;
+	/** the certificate */
+	certificate_t *cert;
+	/** whether the certificate is in the trusted list */
+	bool trusted;
+} cert_entry_t;
+
+/**
+ * Destroy a certificate entry
+ */
+static void cert_entry_destroy(cert_entry_t *entry)
+{
+	entry->cert->destroy(entry->cert);
+	free(entry);
+}
+
+/**
+ * Private key entry, in the key list and the index
+ */
+typedef struct {
+	/** common header, must be first */
+	entry_t entry;
+	/** the private key */
+	private_key_t *key;
+} key_entry_t;
+
+/**
+ * Destroy a private key entry
+ */
+static void key_entry_destroy(key_entry_t *entry)
+{
+	entry->key->destroy(entry->key);
+	free(entry);
+}
+
+/**
+ * Shared key entry
+ */
+typedef struct {
+	/** common header, must be first */
+	entry_t entry;
+	/* shared key */
+	shared_key_t *shared;
+	/* list of owners, identification_t */
+	linked_list_t *owners;
+} shared_entry_t;
+
+/**
+ * Clean up a shared entry
+ */
+static void shared_entry_destroy(shared_entry_t *entry)
+{
+	entry->owners->destroy_offset(entry->owners,
+								  offsetof(identification_t, destroy));
+	entry->shared->destroy(entry->shared);
+	free(entry);
+}
+
+/**
+ * Assign priorities to the entries of a list in list order
+ */
+static void renumber(private_mem_cred_t *this, linked_list_t *list)
+{
+	enumerator_t *enumerator;
+	entry_t *entry;
+	u_int prio;
+
+	prio = this->prio + list->get_count(list);
+	enumerator = list->create_enumerator(list);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		entry->prio = prio--;
+	}
+	enumerator->destroy(enumerator);
+	this->prio += list->get_count(list);
+}
+
+/**
+ * Add a certificate entry to the index
+ */
+static void index_cert(private_mem_cred_t *this, cert_entry_t *entry)
+{
+	certificate_t *cert = entry->cert;
+	identification_t *id;
+	enumerator_t *enumerator;
+	cred_encoding_type_t type;
+	public_key_t *public;
+	hasher_t *hasher;
+	chunk_t chunk;
+	x509_t *x509;
+
+	if (cert->get_type(cert) != CERT_X509)
+	{	/* other certificate types may match identities differently */
+		index_add_other(this->cert_index, &entry->entry);
+		return;
+	}
+	x509 = (x509_t*)cert;
+	index_add_id(this->cert_index, cert->get_subject(cert), &entry->entry);
+	enumerator = x509->create_subjectAltName_enumerator(x509);
+	while (enumerator->enumerate(enumerator, &id))
+	{
+		index_add_id(this->cert_index, id, &entry->entry);
+	}
+	enumerator->destroy(enumerator);
+
+	public = cert->get_public_key(cert);
+	if (public)
+	{
+		for (type = 0; type < KEYID_MAX; type++)
+		{
+			if (public->get_fingerprint(public, type, &chunk))
+			{
+				index_add_keyid(this->cert_index, chunk, &entry->entry);
+			}
+		}
+		public->destroy(public);
+	}
+	index_add_keyid(this->cert_index, x509->get_subjectKeyIdentifier(x509),
+					&entry->entry);
+	index_add_keyid(this->cert_index, x509->get_serial(x509), &entry->entry);
+	/* X.509 certificates match key IDs against the hash of their encoding */
+	hasher = lib->crypto->create_hasher(lib->crypto, HASH_SHA1);
+	if (hasher)
+	{
+		if (cert->get_encoding(cert, CERT_ASN1_DER, &chunk))
+		{
+			chunk_t hash;
+
+			if (hasher->allocate_hash(hasher, chunk, &hash))
+			{
+				index_add_keyid(this->cert_index, hash, &entry->entry);
+				free(hash.ptr);
+			}
+			free(chunk.ptr);
+		}
+		hasher->destroy(hasher);
+	}
+}
+
+/**
+ * Add a private key entry to the index
+ */
+static void index_key(private_mem_cred_t *this, key_entry_t *entry)
+{
+	cred_encoding_type_t type;
+	chunk_t fp;
+
+	for (type = 0; type < KEYID_MAX; type++)
+	{
+		if (entry->key->get_fingerprint(entry->key, type, &fp))
+		{
+			index_add_keyid(this->key_index, fp, &entry->entry);
+		}
+	}
+}
+
+/**
+ * Add a shared key entry to the index
+ */
+static void index_shared(private_mem_cred_t *this, shared_entry_t *entry)
+{
+	enumerator_t *enumerator;
+	identification_t *id;
+
+	enumerator = entry->owners->create_enumerator(entry->owners);
+	while (enumerator->enumerate(enumerator, &id))
+	{
+		if (id->contains_wildcards(id))
+		{	/* may match anything, so always consider this entry */
+			index_add_other(this->shared_index, &entry->entry);
+		}
+		else
+		{
+			index_add_id(this->shared_index, id, &entry->entry);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
 /**
  * Data for the certificate enumerator
  */
@@ -71,6 +573,8 @@ typedef struct {
 	certificate_type_t cert;
 	key_type_t key;
 	identification_t *id;
+	bool trusted;
+	linked_list_t *candidates;
 } cert_data_t;
 
 /**
@@ -79,17 +583,23 @@ typedef struct {
 static void cert_data_destroy(cert_data_t *data)
 {
 	data->lock->unlock(data->lock);
+	DESTROY_IF(data->candidates);
 	free(data);
 }
 
 /**
  * filter function for certs enumerator
  */
-static bool certs_filter(cert_data_t *data, certificate_t **in, certificate_t **out)
+static bool certs_filter(cert_data_t *data, cert_entry_t **in,
+						 certificate_t **out)
 {
 	public_key_t *public;
-	certificate_t *cert = *in;
+	certificate_t *cert = (*in)->cert;
 
+	if (data->trusted && !(*in)->trusted)
+	{
+		return FALSE;
+	}
 	if (data->cert == CERT_ANY || data->cert == cert->get_type(cert))
 	{
 		public = cert->get_public_key(cert);
@@ -101,7 +611,7 @@ static bool certs_filter(cert_data_t *data, certificate_t **in, certificate_t **
 											data->id->get_encoding(data->id)))
 				{
 					public->destroy(public);
-					*out = *in;
+					*out = cert;
 					return TRUE;
 				}
 			}
@@ -113,7 +623,7 @@ static bool certs_filter(cert_data_t *data, certificate_t **in, certificate_t **
 		}
 		if (data->id == NULL || cert->has_subject(cert, data->id))
 		{
-			*out = *in;
+			*out = cert;
 			return TRUE;
 		}
 	}
@@ -126,15 +636,25 @@ METHOD(credential_set_t, create_cert_enumerator, enumerator_t*,
 {
 	cert_data_t *data;
 	enumerator_t *enumerator;
+	linked_list_t *lists[MAX_LISTS];
+	int count;
 
 	INIT(data,
 		.lock = this->lock,
 		.cert = cert,
 		.key = key,
 		.id = id,
+		.trusted = trusted,
 	);
 	this->lock->read_lock(this->lock);
-	if (trusted)
+	if (id && !id->contains_wildcards(id))
+	{	/* without wildcards only perfect matches or key IDs are possible */
+		count = index_lookup(this->cert_index, id, TRUE, TRUE, lists);
+		lists[count++] = this->cert_index->other;
+		data->candidates = merge_sorted(lists, count);
+		enumerator = data->candidates->create_enumerator(data->candidates);
+	}
+	else if (trusted)
 	{
 		enumerator = this->trusted->create_enumerator(this->trusted);
 	}
@@ -146,9 +666,38 @@ METHOD(credential_set_t, create_cert_enumerator, enumerator_t*,
 									(void*)cert_data_destroy);
 }
 
-static bool certificate_equals(certificate_t *item, certificate_t *cert)
+/**
+ * Find a cached certificate equal to the given one
+ */
+static cert_entry_t *find_cert(private_mem_cred_t *this, certificate_t *cert)
 {
-	return item->equals(item, cert);
+	enumerator_t *enumerator;
+	cert_entry_t *current, *found = NULL;
+	linked_list_t *list;
+	bucket_t *bucket;
+
+	list = this->cert_index->other;
+	if (cert->get_type(cert) == CERT_X509)
+	{	/* equal certificates have an equal subject */
+		bucket = this->cert_index->ids->get(this->cert_index->ids,
+											cert->get_subject(cert));
+		if (!bucket)
+		{
+			return NULL;
+		}
+		list = bucket->entries;
+	}
+	enumerator = list->create_enumerator(list);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (current->cert->equals(current->cert, cert))
+		{
+			found = current;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
 }
 
 /**
@@ -158,22 +707,30 @@ static bool certificate_equals(certificate_t *item, certificate_t *cert)
 static certificate_t *add_cert_internal(private_mem_cred_t *this, bool trusted,
 										certificate_t *cert)
 {
-	certificate_t *cached;
+	cert_entry_t *cached;
+
 	this->lock->write_lock(this->lock);
-	if (this->untrusted->find_first(this->untrusted,
-									(linked_list_match_t)certificate_equals,
-									(void**)&cached, cert) == SUCCESS)
+	cached = find_cert(this, cert);
+	if (cached)
 	{
 		cert->destroy(cert);
-		cert = cached->get_ref(cached);
+		cert = cached->cert->get_ref(cached->cert);
 	}
 	else
 	{
+		INIT(cached,
+			.entry = {
+				.prio = ++this->prio,
+			},
+			.cert = cert->get_ref(cert),
+			.trusted = trusted,
+		);
 		if (trusted)
 		{
-			this->trusted->insert_first(this->trusted, cert->get_ref(cert));
+			this->trusted->insert_first(this->trusted, cached);
 		}
-		this->untrusted->insert_first(this->untrusted, cert->get_ref(cert));
+		this->untrusted->insert_first(this->untrusted, cached);
+		index_cert(this, cached);
 	}
 	this->lock->unlock(this->lock);
 	return cert;
@@ -196,13 +753,17 @@ METHOD(mem_cred_t, add_crl, bool,
 	private_mem_cred_t *this, crl_t *crl)
 {
 	certificate_t *current, *cert = &crl->certificate;
+	cert_entry_t *entry;
 	enumerator_t *enumerator;
 	bool new = TRUE;
 
 	this->lock->write_lock(this->lock);
-	enumerator = this->untrusted->create_enumerator(this->untrusted);
-	while (enumerator->enumerate(enumerator, (void**)&current))
+	/* CRLs are not indexed, so they are all in this list */
+	enumerator = this->cert_index->other->create_enumerator(
+													this->cert_index->other);
+	while (enumerator->enumerate(enumerator, (void**)&entry))
 	{
+		current = entry->cert;
 		if (current->get_type(current) == CERT_X509_CRL)
 		{
 			bool found = FALSE;
@@ -231,7 +792,11 @@ METHOD(mem_cred_t, add_crl, bool,
 				new = crl_is_newer(crl, crl_c);
 				if (new)
 				{
-					this->untrusted->remove_at(this->untrusted, enumerator);
+					this->cert_index->other->remove_at(this->cert_index->other,
+													   enumerator);
+					this->untrusted->remove(this->untrusted, entry, NULL);
+					this->trusted->remove(this->trusted, entry, NULL);
+					cert_entry_destroy(entry);
 				}
 				else
 				{
@@ -245,7 +810,14 @@ METHOD(mem_cred_t, add_crl, bool,
 
 	if (new)
 	{
-		this->untrusted->insert_first(this->untrusted, cert);
+		INIT(entry,
+			.entry = {
+				.prio = ++this->prio,
+			},
+			.cert = cert,
+		);
+		this->untrusted->insert_first(this->untrusted, entry);
+		index_add_other(this->cert_index, &entry->entry);
 	}
 	this->lock->unlock(this->lock);
 	return new;
@@ -258,6 +830,7 @@ typedef struct {
 	rwlock_t *lock;
 	key_type_t type;
 	identification_t *id;
+	linked_list_t *candidates;
 } key_data_t;
 
 /**
@@ -266,17 +839,18 @@ typedef struct {
 static void key_data_destroy(key_data_t *data)
 {
 	data->lock->unlock(data->lock);
+	DESTROY_IF(data->candidates);
 	free(data);
 }
 
 /**
  * filter function for private key enumerator
  */
-static bool key_filter(key_data_t *data, private_key_t **in, private_key_t **out)
+static bool key_filter(key_data_t *data, key_entry_t **in, private_key_t **out)
 {
 	private_key_t *key;
 
-	key = *in;
+	key = (*in)->key;
 	if (data->type == KEY_ANY || data->type == key->get_type(key))
 	{
 		if (data->id == NULL ||
@@ -293,6 +867,9 @@ METHOD(credential_set_t, create_private_enumerator, enumerator_t*,
 	private_mem_cred_t *this, key_type_t type, identification_t *id)
 {
 	key_data_t *data;
+	enumerator_t *enumerator;
+	linked_list_t *lists[MAX_LISTS];
+	int count;
 
 	INIT(data,
 		.lock = this->lock,
@@ -300,39 +877,37 @@ METHOD(credential_set_t, create_private_enumerator, enumerator_t*,
 		.id = id,
 	);
 	this->lock->read_lock(this->lock);
-	return enumerator_create_filter(this->keys->create_enumerator(this->keys),
-							(void*)key_filter, data, (void*)key_data_destroy);
+	if (id)
+	{	/* keys without a matching fingerprint never match */
+		count = index_lookup(this->key_index, id, FALSE, TRUE, lists);
+		data->candidates = merge_sorted(lists, count);
+		enumerator = data->candidates->create_enumerator(data->candidates);
+	}
+	else
+	{
+		enumerator = this->keys->create_enumerator(this->keys);
+	}
+	return enumerator_create_filter(enumerator, (void*)key_filter, data,
+									(void*)key_data_destroy);
 }
 
 METHOD(mem_cred_t, add_key, void,
 	private_mem_cred_t *this, private_key_t *key)
 {
+	key_entry_t *entry;
+
 	this->lock->write_lock(this->lock);
-	this->keys->insert_first(this->keys, key);
+	INIT(entry,
+		.entry = {
+			.prio = ++this->prio,
+		},
+		.key = key,
+	);
+	this->keys->insert_first(this->keys, entry);
+	index_key(this, entry);
 	this->lock->unlock(this->lock);
 }
 
-/**
- * Shared key entry
- */
-typedef struct {
-	/* shared key */
-	shared_key_t *shared;
-	/* list of owners, identification_t */
-	linked_list_t *owners;
-} shared_entry_t;
-
-/**
- * Clean up a shared entry
- */
-static void shared_entry_destroy(shared_entry_t *entry)
-{
-	entry->owners->destroy_offset(entry->owners,
-								  offsetof(identification_t, destroy));
-	entry->shared->destroy(entry->shared);
-	free(entry);
-}
-
 /**
  * Data for the shared_key enumerator
  */
@@ -341,6 +916,7 @@ typedef struct {
 	identification_t *me;
 	identification_t *other;
 	shared_key_type_t type;
+	linked_list_t *candidates;
 } shared_data_t;
 
 /**
@@ -349,6 +925,7 @@ typedef struct {
 static void shared_data_destroy(shared_data_t *data)
 {
 	data->lock->unlock(data->lock);
+	DESTROY_IF(data->candidates);
 	free(data);
 }
 
@@ -419,6 +996,9 @@ METHOD(credential_set_t, create_shared_enumerator, enumerator_t*,
 	identification_t *me, identification_t *other)
 {
 	shared_data_t *data;
+	enumerator_t *enumerator;
+	linked_list_t *lists[MAX_LISTS];
+	int count = 0;
 
 	INIT(data,
 		.lock = this->lock,
@@ -427,9 +1007,28 @@ METHOD(credential_set_t, create_shared_enumerator, enumerator_t*,
 		.type = type,
 	);
 	data->lock->read_lock(data->lock);
-	return enumerator_create_filter(
-						this->shared->create_enumerator(this->shared),
-						(void*)shared_filter, data, (void*)shared_data_destroy);
+	if (me || other)
+	{	/* owners without wildcards only match perfectly */
+		if (me)
+		{
+			count += index_lookup(this->shared_index, me, TRUE, FALSE,
+								  &lists[count]);
+		}
+		if (other)
+		{
+			count += index_lookup(this->shared_index, other, TRUE, FALSE,
+								  &lists[count]);
+		}
+		lists[count++] = this->shared_index->other;
+		data->candidates = merge_sorted(lists, count);
+		enumerator = data->candidates->create_enumerator(data->candidates);
+	}
+	else
+	{
+		enumerator = this->shared->create_enumerator(this->shared);
+	}
+	return enumerator_create_filter(enumerator, (void*)shared_filter, data,
+									(void*)shared_data_destroy);
 }
 
 METHOD(mem_cred_t, add_shared_list, void,
@@ -443,7 +1042,9 @@ METHOD(mem_cred_t, add_shared_list, void,
 	);
 
 	this->lock->write_lock(this->lock);
+	entry->entry.prio = ++this->prio;
 	this->shared->insert_first(this->shared, entry);
+	index_shared(this, entry);
 	this->lock->unlock(this->lock);
 }
 
@@ -557,10 +1158,14 @@ METHOD(credential_set_t, create_cdp_enumerator, enumerator_t*,
 
 static void reset_secrets(private_mem_cred_t *this)
 {
-	this->keys->destroy_offset(this->keys, offsetof(private_key_t, destroy));
+	this->keys->destroy_function(this->keys, (void*)key_entry_destroy);
 	this->shared->destroy_function(this->shared, (void*)shared_entry_destroy);
+	index_destroy(this->key_index);
+	index_destroy(this->shared_index);
 	this->keys = linked_list_create();
 	this->shared = linked_list_create();
+	this->key_index = index_create();
+	this->shared_index = index_create();
 }
 
 METHOD(mem_cred_t, replace_secrets, void,
@@ -569,7 +1174,7 @@ METHOD(mem_cred_t, replace_secrets, void,
 	private_mem_cred_t *other = (private_mem_cred_t*)other_set;
 	enumerator_t *enumerator;
 	shared_entry_t *entry, *new_entry;
-	private_key_t *key;
+	key_entry_t *key, *new_key;
 
 	this->lock->write_lock(this->lock);
 
@@ -580,7 +1185,10 @@ METHOD(mem_cred_t, replace_secrets, void,
 		enumerator = other->keys->create_enumerator(other->keys);
 		while (enumerator->enumerate(enumerator, &key))
 		{
-			this->keys->insert_last(this->keys, key->get_ref(key));
+			INIT(new_key,
+				.key = key->key->get_ref(key->key),
+			);
+			this->keys->insert_last(this->keys, new_key);
 		}
 		enumerator->destroy(enumerator);
 		enumerator = other->shared->create_enumerator(other->shared);
@@ -606,7 +1214,26 @@ METHOD(mem_cred_t, replace_secrets, void,
 		{
 			this->shared->insert_last(this->shared, entry);
 		}
+		/* drop the index of the now empty set */
+		reset_secrets(other);
+	}
+
+	/* rebuild the indices in list order */
+	renumber(this, this->keys);
+	enumerator = this->keys->create_enumerator(this->keys);
+	while (enumerator->enumerate(enumerator, &key))
+	{
+		index_key(this, key);
+	}
+	enumerator->destroy(enumerator);
+	renumber(this, this->shared);
+	enumerator = this->shared->create_enumerator(this->shared);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		index_shared(this, entry);
 	}
+	enumerator->destroy(enumerator);
+
 	this->lock->unlock(this->lock);
 }
 
@@ -622,13 +1249,15 @@ METHOD(mem_cred_t, clear_, void,
 	private_mem_cred_t *this)
 {
 	this->lock->write_lock(this->lock);
-	this->trusted->destroy_offset(this->trusted,
-								  offsetof(certificate_t, destroy));
-	this->untrusted->destroy_offset(this->untrusted,
-									offsetof(certificate_t, destroy));
+	/* trusted certificates are in both lists, but have a single entry */
+	this->trusted->destroy(this->trusted);
+	this->untrusted->destroy_function(this->untrusted,
+									  (void*)cert_entry_destroy);
+	index_destroy(this->cert_index);
 	this->cdps->destroy_function(this->cdps, (void*)cdp_destroy);
 	this->trusted = linked_list_create();
 	this->untrusted = linked_list_create();
+	this->cert_index = index_create();
 	this->cdps = linked_list_create();
 	this->lock->unlock(this->lock);
 
@@ -641,8 +1270,11 @@ METHOD(mem_cred_t, destroy, void,
 	clear_(this);
 	this->trusted->destroy(this->trusted);
 	this->untrusted->destroy(this->untrusted);
+	index_destroy(this->cert_index);
 	this->keys->destroy(this->keys);
+	index_destroy(this->key_index);
 	this->shared->destroy(this->shared);
+	index_destroy(this->shared_index);
 	this->cdps->destroy(this->cdps);
 	this->lock->destroy(this->lock);
 	free(this);
@@ -678,8 +1310,11 @@ mem_cred_t *mem_cred_create()
 		},
 		.trusted = linked_list_create(),
 		.untrusted = linked_list_create(),
+		.cert_index = index_create(),
 		.keys = linked_list_create(),
+		.key_index = index_create(),
 		.shared = linked_list_create(),
+		.shared_index = index_create(),
 		.cdps = linked_list_create(),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 	);
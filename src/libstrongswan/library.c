@@ -20,6 +20,7 @@
 
 #include <utils/debug.h>
 #include <threading/thread.h>
+#include <threading/lock_profiler.h>
 #include <utils/identification.h>
 #include <networking/host.h>
 #include <collections/hashtable.h>
@@ -85,6 +86,7 @@ void library_deinit()
 	this->public.scheduler->destroy(this->public.scheduler);
 	this->public.processor->destroy(this->public.processor);
 	this->public.plugins->destroy(this->public.plugins);
+	this->public.metrics->destroy(this->public.metrics);
 	this->public.hosts->destroy(this->public.hosts);
 	this->public.settings->destroy(this->public.settings);
 	this->public.credmgr->destroy(this->public.credmgr);
@@ -103,11 +105,17 @@ void library_deinit()
 		this->public.integrity->destroy(this->public.integrity);
 	}
 
+	lock_profiler_deinit();
+
 	if (lib->leak_detective)
 	{
 		lib->leak_detective->report(lib->leak_detective, detailed);
 		lib->leak_detective->destroy(lib->leak_detective);
 	}
+	if (lib->heap_profiler)
+	{
+		lib->heap_profiler->destroy(lib->heap_profiler);
+	}
 
 	threads_deinit();
 	backtrace_deinit();
@@ -228,6 +236,9 @@ bool library_init(char *settings)
 #ifdef LEAK_DETECTIVE
 	lib->leak_detective = leak_detective_create();
 #endif /* LEAK_DETECTIVE */
+#ifdef HEAP_PROFILER
+	lib->heap_profiler = heap_profiler_create();
+#endif /* HEAP_PROFILER */
 
 	pfh = printf_hook_create();
 	this->public.printf_hook = pfh;
@@ -256,6 +267,14 @@ bool library_init(char *settings)
 	this->objects = hashtable_create((hashtable_hash_t)hash,
 									 (hashtable_equals_t)equals, 4);
 	this->public.settings = settings_create(settings);
+	lock_profiler_init();
+	if (lib->heap_profiler)
+	{
+		lib->heap_profiler->set_interval(lib->heap_profiler,
+				lib->settings->get_int(lib->settings,
+					"libstrongswan.heap_profiler.interval",
+					HEAP_PROFILER_INTERVAL));
+	}
 	this->public.hosts = host_resolver_create();
 	this->public.proposal = proposal_keywords_create();
 	this->public.caps = capabilities_create();
@@ -266,6 +285,7 @@ bool library_init(char *settings)
 	this->public.fetcher = fetcher_manager_create();
 	this->public.resolver = resolver_manager_create();
 	this->public.db = database_factory_create();
+	this->public.metrics = metrics_create();
 	this->public.processor = processor_create();
 	this->public.scheduler = scheduler_create();
 	this->public.watcher = watcher_create();
@@ -112,7 +112,9 @@
 #include "utils/capabilities.h"
 #include "utils/integrity_checker.h"
 #include "utils/leak_detective.h"
+#include "utils/heap_profiler.h"
 #include "utils/settings.h"
+#include "utils/metrics.h"
 #include "plugins/plugin_loader.h"
 
 typedef struct library_t library_t;
@@ -224,6 +226,11 @@ struct library_t {
 	 */
 	settings_t *settings;
 
+	/**
+	 * counters, gauges and histograms registered by components
+	 */
+	metrics_t *metrics;
+
 	/**
 	 * integrity checker to verify code integrity
 	 */
@@ -233,6 +240,11 @@ struct library_t {
 	 * Leak detective, if built and enabled
 	 */
 	leak_detective_t *leak_detective;
+
+	/**
+	 * Sampling heap profiler, if built and enabled
+	 */
+	heap_profiler_t *heap_profiler;
 };
 
 /**
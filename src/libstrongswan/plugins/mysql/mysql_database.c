@@ -25,6 +25,7 @@
 #include <threading/thread_value.h>
 #include <threading/mutex.h>
 #include <collections/linked_list.h>
+#include <collections/hashtable.h>
 
 /* Older mysql.h headers do not define it, but we need it. It is not returned
  * in in MySQL 4 by default, but by MySQL 5. To avoid this problem, we catch
@@ -33,6 +34,11 @@
 #define MYSQL_DATA_TRUNCATED 101
 #endif
 
+/**
+ * Maximum number of prepared statements cached per connection
+ */
+#define MAX_STATEMENTS 64
+
 typedef struct private_mysql_database_t private_mysql_database_t;
 
 /**
@@ -102,8 +108,35 @@ struct conn_t {
 	 * connection in use?
 	 */
 	bool in_use;
+
+	/**
+	 * cached prepared statements, char* => statement_t
+	 */
+	hashtable_t *statements;
 };
 
+/**
+ * Prepared statement in the cache of a connection
+ */
+typedef struct {
+
+	/**
+	 * SQL string the statement was prepared from
+	 */
+	char *sql;
+
+	/**
+	 * prepared MySQL statement
+	 */
+	MYSQL_STMT *stmt;
+
+	/**
+	 * TRUE while the statement is used by a query or execute
+	 */
+	bool busy;
+
+} statement_t;
+
 /**
  * database transaction
  */
@@ -186,11 +219,31 @@ void mysql_database_deinit()
 	mysql_library_end();
 }
 
+/**
+ * Destroy a cached statement
+ */
+static void statement_destroy(statement_t *this)
+{
+	mysql_stmt_close(this->stmt);
+	free(this->sql);
+	free(this);
+}
+
 /**
  * Destroy a mysql connection
  */
 static void conn_destroy(conn_t *this)
 {
+	enumerator_t *enumerator;
+	statement_t *statement;
+
+	enumerator = this->statements->create_enumerator(this->statements);
+	while (enumerator->enumerate(enumerator, NULL, &statement))
+	{
+		statement_destroy(statement);
+	}
+	enumerator->destroy(enumerator);
+	this->statements->destroy(this->statements);
 	mysql_close(this->mysql);
 	free(this);
 }
@@ -251,6 +304,8 @@ static conn_t *conn_get(private_mysql_database_t *this, transaction_t **trans)
 		INIT(found,
 			.in_use = TRUE,
 			.mysql = mysql_init(NULL),
+			.statements = hashtable_create(hashtable_hash_str,
+										   hashtable_equals_str, 8),
 		);
 		if (!mysql_real_connect(found->mysql, this->host, this->username,
 								this->password, this->database, this->port,
@@ -275,18 +330,27 @@ static conn_t *conn_get(private_mysql_database_t *this, transaction_t **trans)
 }
 
 /**
- * Create and run a MySQL stmt using a sql string and args
+ * Get a prepared statement for a SQL string, from the cache of the
+ * connection if possible. Connections are used by a single thread at a time,
+ * so no locking is required.
  */
-static MYSQL_STMT* run(MYSQL *mysql, char *sql, va_list *args)
+static MYSQL_STMT* prepare(conn_t *conn, char *sql, statement_t **cached)
 {
+	statement_t *statement;
 	MYSQL_STMT *stmt;
-	int params;
 
-	stmt = mysql_stmt_init(mysql);
+	statement = conn->statements->get(conn->statements, sql);
+	if (statement && !statement->busy)
+	{
+		statement->busy = TRUE;
+		*cached = statement;
+		return statement->stmt;
+	}
+	stmt = mysql_stmt_init(conn->mysql);
 	if (stmt == NULL)
 	{
 		DBG1(DBG_LIB, "creating MySQL statement failed: %s",
-			 mysql_error(mysql));
+			 mysql_error(conn->mysql));
 		return NULL;
 	}
 	if (mysql_stmt_prepare(stmt, sql, strlen(sql)))
@@ -296,6 +360,58 @@ static MYSQL_STMT* run(MYSQL *mysql, char *sql, va_list *args)
 		mysql_stmt_close(stmt);
 		return NULL;
 	}
+	/* statements currently in use, e.g. by a nested query, are not shared */
+	if (!statement &&
+		conn->statements->get_count(conn->statements) < MAX_STATEMENTS)
+	{
+		INIT(statement,
+			.sql = strdup(sql),
+			.stmt = stmt,
+			.busy = TRUE,
+		);
+		conn->statements->put(conn->statements, statement->sql, statement);
+		*cached = statement;
+	}
+	return stmt;
+}
+
+/**
+ * Release a statement returned by prepare(), failed statements are removed
+ * from the cache, as they might have been invalidated by the server
+ */
+static void release(conn_t *conn, MYSQL_STMT *stmt, statement_t *cached,
+					bool failed)
+{
+	if (cached)
+	{
+		if (!failed && !mysql_stmt_free_result(stmt) &&
+			!mysql_stmt_reset(stmt))
+		{
+			cached->busy = FALSE;
+			return;
+		}
+		conn->statements->remove(conn->statements, cached->sql);
+		free(cached->sql);
+		free(cached);
+	}
+	mysql_stmt_close(stmt);
+}
+
+/**
+ * Create and run a MySQL stmt using a sql string and args
+ */
+static MYSQL_STMT* run(conn_t *conn, char *sql, va_list *args,
+					   statement_t **cached)
+{
+	MYSQL_STMT *stmt;
+	int params;
+
+	*cached = NULL;
+	stmt = prepare(conn, sql, cached);
+	if (stmt == NULL)
+	{
+		return NULL;
+	}
 	params = mysql_stmt_param_count(stmt);
 	if (params > 0)
 	{
@@ -359,7 +475,7 @@ static MYSQL_STMT* run(MYSQL *mysql, char *sql, va_list *args)
 				}
 				default:
 					DBG1(DBG_LIB, "invalid data type supplied");
-					mysql_stmt_close(stmt);
+					release(conn, stmt, *cached, FALSE);
 					return NULL;
 			}
 		}
@@ -367,7 +483,7 @@ static MYSQL_STMT* run(MYSQL *mysql, char *sql, va_list *args)
 		{
 			DBG1(DBG_LIB, "binding MySQL param failed: %s",
 				 mysql_stmt_error(stmt));
-			mysql_stmt_close(stmt);
+			release(conn, stmt, *cached, TRUE);
 			return NULL;
 		}
 	}
@@ -375,7 +491,7 @@ static MYSQL_STMT* run(MYSQL *mysql, char *sql, va_list *args)
 	{
 		DBG1(DBG_LIB, "executing MySQL statement failed: %s",
 			 mysql_stmt_error(stmt));
-		mysql_stmt_close(stmt);
+		release(conn, stmt, *cached, TRUE);
 		return NULL;
 	}
 	return stmt;
@@ -388,6 +504,8 @@ typedef struct {
 	private_mysql_database_t *db;
 	/** associated MySQL statement */
 	MYSQL_STMT *stmt;
+	/** cache entry of the statement, if any */
+	statement_t *cached;
 	/** result bindings */
 	MYSQL_BIND *bind;
 	/** pooled connection handle */
@@ -426,7 +544,7 @@ static void mysql_enumerator_destroy(mysql_enumerator_t *this)
 				break;
 		}
 	}
-	mysql_stmt_close(this->stmt);
+	release(this->conn, this->stmt, this->cached, FALSE);
 	conn_release(this->db, this->conn);
 	free(this->bind);
 	free(this->val.p_void);
@@ -534,6 +652,7 @@ METHOD(database_t, query, enumerator_t*,
 	private_mysql_database_t *this, char *sql, ...)
 {
 	MYSQL_STMT *stmt;
+	statement_t *cached;
 	va_list args;
 	mysql_enumerator_t *enumerator = NULL;
 	conn_t *conn;
@@ -545,7 +664,7 @@ METHOD(database_t, query, enumerator_t*,
 	}
 
 	va_start(args, sql);
-	stmt = run(conn->mysql, sql, &args);
+	stmt = run(conn, sql, &args, &cached);
 	if (stmt)
 	{
 		int columns, i;
@@ -558,6 +677,7 @@ METHOD(database_t, query, enumerator_t*,
 			},
 			.db = this,
 			.stmt = stmt,
+			.cached = cached,
 			.conn = conn,
 		);
 		columns = mysql_stmt_field_count(stmt);
@@ -626,6 +746,7 @@ METHOD(database_t, execute, int,
 	private_mysql_database_t *this, int *rowid, char *sql, ...)
 {
 	MYSQL_STMT *stmt;
+	statement_t *cached;
 	va_list args;
 	conn_t *conn;
 	int affected = -1;
@@ -636,7 +757,7 @@ METHOD(database_t, execute, int,
 		return -1;
 	}
 	va_start(args, sql);
-	stmt = run(conn->mysql, sql, &args);
+	stmt = run(conn, sql, &args, &cached);
 	if (stmt)
 	{
 		if (rowid)
@@ -644,7 +765,7 @@ METHOD(database_t, execute, int,
 			*rowid = mysql_stmt_insert_id(stmt);
 		}
 		affected = mysql_stmt_affected_rows(stmt);
-		mysql_stmt_close(stmt);
+		release(conn, stmt, cached, FALSE);
 	}
 	va_end(args);
 	conn_release(this, conn);
@@ -22,8 +22,16 @@
 #include <utils/debug.h>
 #include <threading/mutex.h>
 #include <threading/thread_value.h>
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+
+/**
+ * Maximum number of prepared statements cached per connection
+ */
+#define MAX_STATEMENTS 64
 
 typedef struct private_sqlite_database_t private_sqlite_database_t;
+typedef struct connection_t connection_t;
 
 /**
  * private data of sqlite_database
@@ -36,21 +44,89 @@ struct private_sqlite_database_t {
 	sqlite_database_t public;
 
 	/**
-	 * sqlite database connection
+	 * database file
 	 */
-	sqlite3 *db;
+	char *file;
+
+	/**
+	 * connection used by all threads, if not using one per thread
+	 */
+	connection_t *shared;
+
+	/**
+	 * thread-specific connection, as connection_t
+	 */
+	thread_value_t *connection;
+
+	/**
+	 * all thread-specific connections, as connection_t
+	 */
+	linked_list_t *connections;
+
+	/**
+	 * mutex to lock connections
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * enable write-ahead logging on connections
+	 */
+	bool wal;
 
 	/**
 	 * thread-specific transaction, as transaction_t
 	 */
 	thread_value_t *transaction;
+};
+
+/**
+ * Database connection, along with its cached prepared statements
+ */
+struct connection_t {
+
+	/**
+	 * sqlite database connection
+	 */
+	sqlite3 *db;
 
 	/**
-	 * mutex used to lock execute(), if necessary
+	 * cached prepared statements, char* => statement_t
+	 */
+	hashtable_t *statements;
+
+	/**
+	 * mutex used to lock execute() and the cache, if necessary
 	 */
 	mutex_t *mutex;
+
+	/**
+	 * back reference to the database
+	 */
+	private_sqlite_database_t *database;
 };
 
+/**
+ * Prepared statement in the cache of a connection
+ */
+typedef struct {
+
+	/**
+	 * SQL string the statement was prepared from
+	 */
+	char *sql;
+
+	/**
+	 * prepared sqlite statement
+	 */
+	sqlite3_stmt *stmt;
+
+	/**
+	 * TRUE while the statement is used by a query or execute
+	 */
+	bool busy;
+
+} statement_t;
+
 /**
  * Database transaction
  */
@@ -69,19 +145,197 @@ typedef struct {
 } transaction_t;
 
 /**
- * Create and run a sqlite stmt using a sql string and args
+ * Busy handler implementation
  */
-static sqlite3_stmt* run(private_sqlite_database_t *this, char *sql,
-						 va_list *args)
+static int busy_handler(connection_t *this, int count)
 {
+	/* add a backoff time, quadratically increasing with every try */
+	usleep(count * count * 1000);
+	/* always retry */
+	return 1;
+}
+
+/**
+ * Destroy a cached statement
+ */
+static void statement_destroy(statement_t *this)
+{
+	sqlite3_finalize(this->stmt);
+	free(this->sql);
+	free(this);
+}
+
+/**
+ * Close a connection
+ */
+static void connection_destroy(connection_t *this)
+{
+	enumerator_t *enumerator;
+	statement_t *statement;
+
+	enumerator = this->statements->create_enumerator(this->statements);
+	while (enumerator->enumerate(enumerator, NULL, &statement))
+	{
+		statement_destroy(statement);
+	}
+	enumerator->destroy(enumerator);
+	this->statements->destroy(this->statements);
+	if (sqlite3_close(this->db) == SQLITE_BUSY)
+	{
+		DBG1(DBG_LIB, "sqlite close failed because database is busy");
+	}
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/**
+ * Open a new connection to the database
+ */
+static connection_t *connection_create(private_sqlite_database_t *this)
+{
+	connection_t *conn;
+
+	INIT(conn,
+		.statements = hashtable_create(hashtable_hash_str,
+									   hashtable_equals_str, 8),
+		.mutex = mutex_create(MUTEX_TYPE_RECURSIVE),
+		.database = this,
+	);
+	if (sqlite3_open(this->file, &conn->db) != SQLITE_OK)
+	{
+		DBG1(DBG_LIB, "opening SQLite database '%s' failed: %s",
+			 this->file, sqlite3_errmsg(conn->db));
+		connection_destroy(conn);
+		return NULL;
+	}
+	sqlite3_busy_handler(conn->db, (void*)busy_handler, conn);
+	if (this->wal &&
+		sqlite3_exec(conn->db, "PRAGMA journal_mode=WAL", NULL, NULL,
+					 NULL) != SQLITE_OK)
+	{
+		DBG1(DBG_LIB, "enabling SQLite write-ahead logging failed: %s",
+			 sqlite3_errmsg(conn->db));
+	}
+	return conn;
+}
+
+/**
+ * Close the connection of a terminating thread
+ */
+static void connection_cleanup(connection_t *conn)
+{
+	private_sqlite_database_t *this = conn->database;
+
+	this->mutex->lock(this->mutex);
+	this->connections->remove(this->connections, conn, NULL);
+	this->mutex->unlock(this->mutex);
+	connection_destroy(conn);
+}
+
+/**
+ * Get the connection to use for the calling thread
+ */
+static connection_t *connection_get(private_sqlite_database_t *this)
+{
+	connection_t *conn;
+
+	if (this->shared)
+	{
+		return this->shared;
+	}
+	conn = this->connection->get(this->connection);
+	if (!conn)
+	{
+		conn = connection_create(this);
+		if (conn)
+		{
+			this->connection->set(this->connection, conn);
+			this->mutex->lock(this->mutex);
+			this->connections->insert_last(this->connections, conn);
+			this->mutex->unlock(this->mutex);
+		}
+	}
+	return conn;
+}
+
+/**
+ * Get a prepared statement for a SQL string, from the cache if possible
+ */
+static sqlite3_stmt* prepare(connection_t *conn, char *sql,
+							 statement_t **cached)
+{
+	statement_t *statement;
 	sqlite3_stmt *stmt = NULL;
-	int params, i, res = SQLITE_OK;
 
+	conn->mutex->lock(conn->mutex);
+	statement = conn->statements->get(conn->statements, sql);
+	if (statement && !statement->busy)
+	{
+		statement->busy = TRUE;
+		conn->mutex->unlock(conn->mutex);
+		*cached = statement;
+		return statement->stmt;
+	}
 #ifdef HAVE_SQLITE3_PREPARE_V2
-	if (sqlite3_prepare_v2(this->db, sql, -1, &stmt, NULL) == SQLITE_OK)
+	if (sqlite3_prepare_v2(conn->db, sql, -1, &stmt, NULL) != SQLITE_OK)
 #else
-	if (sqlite3_prepare(this->db, sql, -1, &stmt, NULL) == SQLITE_OK)
+	if (sqlite3_prepare(conn->db, sql, -1, &stmt, NULL) != SQLITE_OK)
 #endif
+	{
+		conn->mutex->unlock(conn->mutex);
+		DBG1(DBG_LIB, "preparing sqlite statement failed: %s",
+			 sqlite3_errmsg(conn->db));
+		return NULL;
+	}
+	/* statements currently in use, e.g. by a nested query, are not shared */
+	if (!statement &&
+		conn->statements->get_count(conn->statements) < MAX_STATEMENTS)
+	{
+		INIT(statement,
+			.sql = strdup(sql),
+			.stmt = stmt,
+			.busy = TRUE,
+		);
+		conn->statements->put(conn->statements, statement->sql, statement);
+		*cached = statement;
+	}
+	conn->mutex->unlock(conn->mutex);
+	return stmt;
+}
+
+/**
+ * Release a statement returned by prepare()
+ */
+static void release(connection_t *conn, sqlite3_stmt *stmt,
+					statement_t *cached)
+{
+	if (cached)
+	{
+		/* reset now, as a pending statement keeps the database locked */
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		conn->mutex->lock(conn->mutex);
+		cached->busy = FALSE;
+		conn->mutex->unlock(conn->mutex);
+	}
+	else
+	{
+		sqlite3_finalize(stmt);
+	}
+}
+
+/**
+ * Create and run a sqlite stmt using a sql string and args
+ */
+static sqlite3_stmt* run(connection_t *conn, char *sql, va_list *args,
+						 statement_t **cached)
+{
+	sqlite3_stmt *stmt;
+	int params, i, res = SQLITE_OK;
+
+	*cached = NULL;
+	stmt = prepare(conn, sql, cached);
+	if (stmt)
 	{
 		params = sqlite3_bind_parameter_count(stmt);
 		for (i = 1; i <= params; i++)
@@ -132,16 +386,11 @@ static sqlite3_stmt* run(private_sqlite_database_t *this, char *sql,
 			}
 		}
 	}
-	else
-	{
-		DBG1(DBG_LIB, "preparing sqlite statement failed: %s",
-			 sqlite3_errmsg(this->db));
-	}
 	if (res != SQLITE_OK)
 	{
 		DBG1(DBG_LIB, "binding sqlite statement failed: %s",
-			 sqlite3_errmsg(this->db));
-		sqlite3_finalize(stmt);
+			 sqlite3_errmsg(conn->db));
+		release(conn, stmt, *cached);
 		return NULL;
 	}
 	return stmt;
@@ -152,12 +401,14 @@ typedef struct {
 	enumerator_t public;
 	/** associated sqlite statement */
 	sqlite3_stmt *stmt;
+	/** cache entry of the statement, if any */
+	statement_t *cached;
+	/** connection the statement belongs to */
+	connection_t *conn;
 	/** number of result columns */
 	int count;
 	/** column types */
 	db_type_t *columns;
-	/** back reference to parent */
-	private_sqlite_database_t *database;
 } sqlite_enumerator_t;
 
 /**
@@ -165,9 +416,9 @@ typedef struct {
  */
 static void sqlite_enumerator_destroy(sqlite_enumerator_t *this)
 {
-	sqlite3_finalize(this->stmt);
+	release(this->conn, this->stmt, this->cached);
 #if SQLITE_VERSION_NUMBER < 3005000
-	this->database->mutex->unlock(this->database->mutex);
+	this->conn->mutex->unlock(this->conn->mutex);
 #endif
 	free(this->columns);
 	free(this);
@@ -187,7 +438,7 @@ static bool sqlite_enumerator_enumerate(sqlite_enumerator_t *this, ...)
 			break;
 		default:
 			DBG1(DBG_LIB, "stepping sqlite statement failed: %s",
-				 sqlite3_errmsg(this->database->db));
+				 sqlite3_errmsg(this->conn->db));
 			/* fall */
 		case SQLITE_DONE:
 			return FALSE;
@@ -242,31 +493,45 @@ METHOD(database_t, query, enumerator_t*,
 	private_sqlite_database_t *this, char *sql, ...)
 {
 	sqlite3_stmt *stmt;
+	statement_t *cached;
+	connection_t *conn;
 	va_list args;
 	sqlite_enumerator_t *enumerator = NULL;
 	int i;
 
+	conn = connection_get(this);
+	if (!conn)
+	{
+		return NULL;
+	}
 #if SQLITE_VERSION_NUMBER < 3005000
 	/* sqlite connections prior to 3.5 may be used by a single thread only, */
-	this->mutex->lock(this->mutex);
+	conn->mutex->lock(conn->mutex);
 #endif
 
 	va_start(args, sql);
-	stmt = run(this, sql, &args);
+	stmt = run(conn, sql, &args, &cached);
 	if (stmt)
 	{
 		enumerator = malloc_thing(sqlite_enumerator_t);
 		enumerator->public.enumerate = (void*)sqlite_enumerator_enumerate;
 		enumerator->public.destroy = (void*)sqlite_enumerator_destroy;
 		enumerator->stmt = stmt;
+		enumerator->cached = cached;
+		enumerator->conn = conn;
 		enumerator->count = sqlite3_column_count(stmt);
 		enumerator->columns = malloc(sizeof(db_type_t) * enumerator->count);
-		enumerator->database = this;
 		for (i = 0; i < enumerator->count; i++)
 		{
 			enumerator->columns[i] = va_arg(args, db_type_t);
 		}
 	}
+#if SQLITE_VERSION_NUMBER < 3005000
+	else
+	{
+		conn->mutex->unlock(conn->mutex);
+	}
+#endif
 	va_end(args);
 	return (enumerator_t*)enumerator;
 }
@@ -275,13 +540,20 @@ METHOD(database_t, execute, int,
 	private_sqlite_database_t *this, int *rowid, char *sql, ...)
 {
 	sqlite3_stmt *stmt;
+	statement_t *cached;
+	connection_t *conn;
 	int affected = -1;
 	va_list args;
 
+	conn = connection_get(this);
+	if (!conn)
+	{
+		return -1;
+	}
 	/* we need a lock to get our rowid/changes correctly */
-	this->mutex->lock(this->mutex);
+	conn->mutex->lock(conn->mutex);
 	va_start(args, sql);
-	stmt = run(this, sql, &args);
+	stmt = run(conn, sql, &args, &cached);
 	va_end(args);
 	if (stmt)
 	{
@@ -289,18 +561,18 @@ METHOD(database_t, execute, int,
 		{
 			if (rowid)
 			{
-				*rowid = sqlite3_last_insert_rowid(this->db);
+				*rowid = sqlite3_last_insert_rowid(conn->db);
 			}
-			affected = sqlite3_changes(this->db);
+			affected = sqlite3_changes(conn->db);
 		}
 		else
 		{
 			DBG1(DBG_LIB, "sqlite execute failed: %s",
-				 sqlite3_errmsg(this->db));
+				 sqlite3_errmsg(conn->db));
 		}
-		sqlite3_finalize(stmt);
+		release(conn, stmt, cached);
 	}
-	this->mutex->unlock(this->mutex);
+	conn->mutex->unlock(conn->mutex);
 	return affected;
 }
 
@@ -345,6 +617,8 @@ static bool finalize_transaction(private_sqlite_database_t *this,
 		DBG1(DBG_LIB, "no database transaction found");
 		return FALSE;
 	}
+	/* set flag, can't be unset */
+	trans->rollback |= rollback;
 
 	if (ref_put(&trans->refs))
 	{
@@ -358,10 +632,6 @@ static bool finalize_transaction(private_sqlite_database_t *this,
 		free(trans);
 		return success;
 	}
-	else
-	{	/* set flag, can't be unset */
-		trans->rollback |= rollback;
-	}
 	return TRUE;
 }
 
@@ -383,26 +653,20 @@ METHOD(database_t, get_driver, db_driver_t,
 	return DB_SQLITE;
 }
 
-/**
- * Busy handler implementation
- */
-static int busy_handler(private_sqlite_database_t *this, int count)
-{
-	/* add a backoff time, quadratically increasing with every try */
-	usleep(count * count * 1000);
-	/* always retry */
-	return 1;
-}
-
 METHOD(database_t, destroy, void,
 	private_sqlite_database_t *this)
 {
-	if (sqlite3_close(this->db) == SQLITE_BUSY)
+	/* closes the connection of the calling thread */
+	this->connection->destroy(this->connection);
+	this->connections->destroy_function(this->connections,
+										(void*)connection_destroy);
+	if (this->shared)
 	{
-		DBG1(DBG_LIB, "sqlite close failed because database is busy");
+		connection_destroy(this->shared);
 	}
 	this->transaction->destroy(this->transaction);
 	this->mutex->destroy(this->mutex);
+	free(this->file);
 	free(this);
 }
 
@@ -411,8 +675,9 @@ METHOD(database_t, destroy, void,
  */
 sqlite_database_t *sqlite_database_create(char *uri)
 {
-	char *file;
 	private_sqlite_database_t *this;
+	connection_t *conn;
+	char *file;
 
 	/**
 	 * parse sqlite:///path/to/file.db uri
@@ -435,19 +700,32 @@ sqlite_database_t *sqlite_database_create(char *uri)
 				.destroy = _destroy,
 			},
 		},
-		.mutex = mutex_create(MUTEX_TYPE_RECURSIVE),
+		.file = strdup(file),
+		.connection = thread_value_create((void*)connection_cleanup),
+		.connections = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.wal = lib->settings->get_bool(lib->settings,
+							"libstrongswan.plugins.sqlite.wal", FALSE),
 		.transaction = thread_value_create(NULL),
 	);
 
-	if (sqlite3_open(file, &this->db) != SQLITE_OK)
+	/* also checks if the database can be opened */
+	conn = connection_create(this);
+	if (!conn)
 	{
-		DBG1(DBG_LIB, "opening SQLite database '%s' failed: %s",
-			 file, sqlite3_errmsg(this->db));
 		destroy(this);
 		return NULL;
 	}
-
-	sqlite3_busy_handler(this->db, (void*)busy_handler, this);
-
+	if (streq(file, ":memory:") || !strlen(file) ||
+		!lib->settings->get_bool(lib->settings,
+				"libstrongswan.plugins.sqlite.connection_per_thread", TRUE))
+	{	/* temporary databases are private to a connection */
+		this->shared = conn;
+	}
+	else
+	{
+		this->connection->set(this->connection, conn);
+		this->connections->insert_last(this->connections, conn);
+	}
 	return &this->public;
 }
@@ -1,6 +1,6 @@
 /*
  * Copyright (C) 2005-2011 Martin Willi
- * Copyright (C) 2011 revosec AG
+ * Copyright (C) 2011-2013 revosec AG
  * Copyright (C) 2008-2013 Tobias Brunner
  * Copyright (C) 2005 Jan Hutter
  * Hochschule fuer Technik Rapperswil
@@ -26,13 +26,39 @@
 #include <threading/thread.h>
 #include <threading/condvar.h>
 #include <threading/mutex.h>
+#include <threading/rwlock.h>
 #include <threading/thread_value.h>
 #include <collections/linked_list.h>
 
 typedef struct private_processor_t private_processor_t;
+typedef struct worker_thread_t worker_thread_t;
+typedef struct queue_entry_t queue_entry_t;
+
+/**
+ * Entry of a lock-free job stack
+ */
+struct queue_entry_t {
+
+	/**
+	 * Queued job
+	 */
+	job_t *job;
+
+	/**
+	 * Next entry, towards older entries
+	 */
+	queue_entry_t *next;
+};
 
 /**
  * Private data of processor_t class.
+ *
+ * Jobs queued by external threads get pushed to lock-free stacks, one for
+ * each priority. Worker threads take all jobs from such a stack at once,
+ * execute the oldest one and move the others to their own local queues.
+ * Idle workers steal jobs from the queues of other workers. Thread management
+ * and waiting for jobs is locked through mutex, but queueing and executing
+ * jobs does not require it as long as workers are busy.
  */
 struct private_processor_t {
 
@@ -54,7 +80,12 @@ struct private_processor_t {
 	/**
 	 * Number of threads currently working, for each priority
 	 */
-	u_int working_threads[JOB_PRIO_MAX];
+	refcount_t working_threads[JOB_PRIO_MAX];
+
+	/**
+	 * Number of queued jobs, for each priority
+	 */
+	refcount_t queued_jobs[JOB_PRIO_MAX];
 
 	/**
 	 * All threads managed in the pool (including threads that have been
@@ -63,9 +94,29 @@ struct private_processor_t {
 	linked_list_t *threads;
 
 	/**
-	 * A list of queued jobs for each priority
+	 * Running worker threads jobs can be stolen from
 	 */
-	linked_list_t *jobs[JOB_PRIO_MAX];
+	worker_thread_t **workers;
+
+	/**
+	 * Number of entries in workers
+	 */
+	u_int worker_count;
+
+	/**
+	 * Lock for workers array
+	 */
+	rwlock_t *workers_lock;
+
+	/**
+	 * Lock-free stack of queued jobs for each priority, newest first
+	 */
+	queue_entry_t *jobs[JOB_PRIO_MAX];
+
+	/**
+	 * Lock-free stack of jobs to execute immediately, for each priority
+	 */
+	queue_entry_t *urgent[JOB_PRIO_MAX];
 
 	/**
 	 * Threads reserved for each priority
@@ -73,7 +124,22 @@ struct private_processor_t {
 	int prio_threads[JOB_PRIO_MAX];
 
 	/**
-	 * access to job lists is locked through this mutex
+	 * Serializes job selection if threads are reserved for any priority
+	 */
+	mutex_t *reserve_lock;
+
+	/**
+	 * Incremented whenever jobs get queued, to detect missed wakeups
+	 */
+	refcount_t jobs_added;
+
+	/**
+	 * Number of worker threads waiting for job_added
+	 */
+	refcount_t waiting;
+
+	/**
+	 * access to thread counters is locked through this mutex
 	 */
 	mutex_t *mutex;
 
@@ -86,12 +152,22 @@ struct private_processor_t {
 	 * Condvar to wait for terminated threads
 	 */
 	condvar_t *thread_terminated;
+
+	/**
+	 * Gauges for queued jobs, for each priority
+	 */
+	metric_t *queued_metric[JOB_PRIO_MAX];
+
+	/**
+	 * Histogram of job execution times
+	 */
+	metric_t *duration_metric;
 };
 
 /**
  * Worker thread
  */
-typedef struct {
+struct worker_thread_t {
 
 	/**
 	 * Reference to the processor
@@ -113,10 +189,193 @@ typedef struct {
 	 */
 	job_priority_t priority;
 
-} worker_thread_t;
+	/**
+	 * Local job queues, for each priority
+	 */
+	linked_list_t *jobs[JOB_PRIO_MAX];
+
+	/**
+	 * Lock for job and jobs
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Offset of the next worker to steal jobs from
+	 */
+	u_int victim;
+};
 
 static void process_jobs(worker_thread_t *worker);
 
+/**
+ * Push a job to a lock-free stack
+ */
+static void push_job(queue_entry_t **stack, job_t *job)
+{
+	queue_entry_t *entry;
+
+	INIT(entry,
+		.job = job,
+	);
+	do
+	{
+		entry->next = *stack;
+	}
+	while (!cas_ptr((void**)stack, entry->next, entry));
+}
+
+/**
+ * Take all jobs from a lock-free stack, newest first
+ */
+static queue_entry_t *pop_jobs(queue_entry_t **stack)
+{
+	queue_entry_t *entries;
+
+	do
+	{
+		entries = *stack;
+	}
+	while (entries && !cas_ptr((void**)stack, entries, NULL));
+	return entries;
+}
+
+/**
+ * Reverse a list of stack entries
+ */
+static queue_entry_t *reverse_jobs(queue_entry_t *entries)
+{
+	queue_entry_t *reversed = NULL, *next;
+
+	while (entries)
+	{
+		next = entries->next;
+		entries->next = reversed;
+		reversed = entries;
+		entries = next;
+	}
+	return reversed;
+}
+
+/**
+ * Wake up a waiting worker thread after jobs have been queued
+ */
+static void notify(private_processor_t *this)
+{
+	ref_get(&this->jobs_added);
+	if (this->waiting)
+	{
+		this->mutex->lock(this->mutex);
+		this->job_added->signal(this->job_added);
+		this->mutex->unlock(this->mutex);
+	}
+}
+
+/**
+ * Queue a job to be picked up by any worker thread
+ */
+static void enqueue(private_processor_t *this, job_t *job, job_priority_t prio)
+{
+	job->status = JOB_STATUS_QUEUED;
+	ref_get(&this->queued_jobs[prio]);
+	push_job(&this->jobs[prio], job);
+	notify(this);
+}
+
+/**
+ * Create a worker thread, this->mutex is expected to be locked
+ */
+static worker_thread_t *create_worker(private_processor_t *this)
+{
+	worker_thread_t *worker;
+	int i;
+
+	INIT(worker,
+		.processor = this,
+		.mutex = mutex_create_named(MUTEX_TYPE_DEFAULT, "processor.worker"),
+	);
+	for (i = 0; i < JOB_PRIO_MAX; i++)
+	{
+		worker->jobs[i] = linked_list_create();
+	}
+	this->workers_lock->write_lock(this->workers_lock);
+	this->workers = realloc(this->workers,
+					sizeof(worker_thread_t*) * (this->worker_count + 1));
+	this->workers[this->worker_count++] = worker;
+	this->workers_lock->unlock(this->workers_lock);
+
+	worker->thread = thread_create((thread_main_t)process_jobs, worker);
+	if (!worker->thread)
+	{
+		this->workers_lock->write_lock(this->workers_lock);
+		this->worker_count--;
+		this->workers_lock->unlock(this->workers_lock);
+		for (i = 0; i < JOB_PRIO_MAX; i++)
+		{
+			worker->jobs[i]->destroy(worker->jobs[i]);
+		}
+		worker->mutex->destroy(worker->mutex);
+		free(worker);
+		return NULL;
+	}
+	this->threads->insert_last(this->threads, worker);
+	return worker;
+}
+
+/**
+ * Stop stealing from a terminating worker and requeue its local jobs
+ */
+static void retire_worker(worker_thread_t *worker)
+{
+	private_processor_t *this = worker->processor;
+	bool requeued = FALSE;
+	job_t *job;
+	int i;
+
+	this->workers_lock->write_lock(this->workers_lock);
+	for (i = 0; i < this->worker_count; i++)
+	{
+		if (this->workers[i] == worker)
+		{
+			this->workers[i] = this->workers[--this->worker_count];
+			break;
+		}
+	}
+	this->workers_lock->unlock(this->workers_lock);
+
+	worker->mutex->lock(worker->mutex);
+	for (i = 0; i < JOB_PRIO_MAX; i++)
+	{
+		while (worker->jobs[i]->remove_first(worker->jobs[i],
+											 (void**)&job) == SUCCESS)
+		{
+			push_job(&this->jobs[i], job);
+			requeued = TRUE;
+		}
+	}
+	worker->mutex->unlock(worker->mutex);
+	if (requeued)
+	{
+		notify(this);
+	}
+}
+
+/**
+ * Destroy a terminated worker thread
+ */
+static void destroy_worker(worker_thread_t *worker)
+{
+	int i;
+
+	worker->thread->join(worker->thread);
+	for (i = 0; i < JOB_PRIO_MAX; i++)
+	{
+		worker->jobs[i]->destroy_offset(worker->jobs[i],
+										offsetof(job_t, destroy));
+	}
+	worker->mutex->destroy(worker->mutex);
+	free(worker);
+}
+
 /**
  * restart a terminated thread
  */
@@ -127,9 +386,9 @@ static void restart(worker_thread_t *worker)
 
 	DBG2(DBG_JOB, "terminated worker thread %.2u", thread_current_id());
 
-	this->mutex->lock(this->mutex);
+	worker->mutex->lock(worker->mutex);
 	/* cleanup worker thread  */
-	this->working_threads[worker->priority]--;
+	ref_put(&this->working_threads[worker->priority]);
 	worker->job->status = JOB_STATUS_CANCELED;
 	job = worker->job;
 	/* unset the job before releasing the mutex, otherwise cancel() might
@@ -137,27 +396,17 @@ static void restart(worker_thread_t *worker)
 	worker->job = NULL;
 	/* release mutex to avoid deadlocks if the same lock is required
 	 * during queue_job() and in the destructor called here */
-	this->mutex->unlock(this->mutex);
+	worker->mutex->unlock(worker->mutex);
 	job->destroy(job);
+	retire_worker(worker);
 	this->mutex->lock(this->mutex);
 
 	/* respawn thread if required */
-	if (this->desired_threads >= this->total_threads)
+	if (this->desired_threads >= this->total_threads &&
+		create_worker(this))
 	{
-		worker_thread_t *new_worker;
-
-		INIT(new_worker,
-			.processor = this,
-		);
-		new_worker->thread = thread_create((thread_main_t)process_jobs,
-										   new_worker);
-		if (new_worker->thread)
-		{
-			this->threads->insert_last(this->threads, new_worker);
-			this->mutex->unlock(this->mutex);
-			return;
-		}
-		free(new_worker);
+		this->mutex->unlock(this->mutex);
+		return;
 	}
 	this->total_threads--;
 	this->thread_terminated->signal(this->thread_terminated);
@@ -169,24 +418,119 @@ static void restart(worker_thread_t *worker)
  */
 static u_int get_idle_threads_nolock(private_processor_t *this)
 {
-	u_int count, i;
+	int count, i;
 
 	count = this->total_threads;
 	for (i = 0; i < JOB_PRIO_MAX; i++)
 	{
 		count -= this->working_threads[i];
 	}
-	return count;
+	return max(count, 0);
+}
+
+/**
+ * Take a job of the given priority from the local queue of another worker
+ */
+static job_t *steal_job(private_processor_t *this, worker_thread_t *worker,
+						job_priority_t prio)
+{
+	worker_thread_t *victim;
+	job_t *job = NULL;
+	bool more = FALSE;
+	int i;
+
+	this->workers_lock->read_lock(this->workers_lock);
+	for (i = 0; i < this->worker_count && !job; i++)
+	{
+		victim = this->workers[worker->victim++ % this->worker_count];
+		if (victim == worker)
+		{
+			continue;
+		}
+		victim->mutex->lock(victim->mutex);
+		if (victim->jobs[prio]->remove_last(victim->jobs[prio],
+											(void**)&job) != SUCCESS)
+		{
+			job = NULL;
+		}
+		more = victim->jobs[prio]->get_count(victim->jobs[prio]) > 0;
+		victim->mutex->unlock(victim->mutex);
+	}
+	this->workers_lock->unlock(this->workers_lock);
+	if (job && more)
+	{	/* wake another idle worker to steal the remaining jobs */
+		notify(this);
+	}
+	return job;
+}
+
+/**
+ * Take a job of the given priority, moving any additional jobs taken from
+ * a shared stack to the local queue of the worker.
+ */
+static job_t *take_job(private_processor_t *this, worker_thread_t *worker,
+					   job_priority_t prio)
+{
+	queue_entry_t *entries, *entry;
+	job_t *job = NULL;
+
+	if (!this->queued_jobs[prio])
+	{
+		return NULL;
+	}
+	/* jobs to execute immediately, newest first */
+	entries = pop_jobs(&this->urgent[prio]);
+	if (!entries)
+	{
+		worker->mutex->lock(worker->mutex);
+		if (worker->jobs[prio]->remove_first(worker->jobs[prio],
+											 (void**)&job) != SUCCESS)
+		{
+			job = NULL;
+		}
+		worker->mutex->unlock(worker->mutex);
+		if (job)
+		{
+			return job;
+		}
+		/* regularly queued jobs, oldest first */
+		entries = reverse_jobs(pop_jobs(&this->jobs[prio]));
+	}
+	if (entries)
+	{
+		job = entries->job;
+		entry = entries;
+		entries = entries->next;
+		free(entry);
+		if (entries)
+		{
+			worker->mutex->lock(worker->mutex);
+			while (entries)
+			{
+				worker->jobs[prio]->insert_last(worker->jobs[prio],
+												entries->job);
+				entry = entries;
+				entries = entries->next;
+				free(entry);
+			}
+			worker->mutex->unlock(worker->mutex);
+			/* let idle workers steal the remaining jobs */
+			notify(this);
+		}
+		return job;
+	}
+	return steal_job(this, worker, prio);
 }
 
 /**
  * Get a job from any job queue, starting with the highest priority.
  *
- * this->mutex is expected to be locked.
+ * this->reserve_lock is expected to be locked, if threads are reserved.
  */
-static bool get_job(private_processor_t *this, worker_thread_t *worker)
+static bool get_job_nolock(private_processor_t *this, worker_thread_t *worker)
 {
 	int i, reserved = 0, idle;
+	job_t *job;
 
 	idle = get_idle_threads_nolock(this);
 
@@ -204,10 +548,16 @@ static bool get_job(private_processor_t *this, worker_thread_t *worker)
 		{
 			reserved += this->prio_threads[i] - this->working_threads[i];
 		}
-		if (this->jobs[i]->remove_first(this->jobs[i],
-										(void**)&worker->job) == SUCCESS)
+		job = take_job(this, worker, i);
+		if (job)
 		{
+			ref_put(&this->queued_jobs[i]);
+			ref_get(&this->working_threads[i]);
+			worker->mutex->lock(worker->mutex);
+			worker->job = job;
+			worker->job->status = JOB_STATUS_EXECUTING;
 			worker->priority = i;
+			worker->mutex->unlock(worker->mutex);
 			return TRUE;
 		}
 	}
@@ -215,24 +565,42 @@ static bool get_job(private_processor_t *this, worker_thread_t *worker)
 }
 
 /**
- * Process a single job (provided in worker->job, worker->priority is also
- * expected to be set)
+ * Get a job and account the worker as working for its priority.
  *
- * this->mutex is expected to be locked.
+ * If threads are reserved for some priorities, job selection is serialized
+ * to keep the number of reserved threads exact.
+ */
+static bool get_job(private_processor_t *this, worker_thread_t *worker)
+{
+	bool found;
+
+	if (!this->reserve_lock)
+	{
+		return get_job_nolock(this, worker);
+	}
+	this->reserve_lock->lock(this->reserve_lock);
+	found = get_job_nolock(this, worker);
+	this->reserve_lock->unlock(this->reserve_lock);
+	return found;
+}
+
+/**
+ * Process a single job (provided in worker->job, worker->priority is also
+ * expected to be set and the worker accounted in working_threads)
  */
 static void process_job(private_processor_t *this, worker_thread_t *worker)
 {
-	job_t *to_destroy = NULL;
+	job_t *to_destroy = NULL, *job;
 	job_requeue_t requeue;
+	timeval_t start;
 
-	this->working_threads[worker->priority]++;
-	worker->job->status = JOB_STATUS_EXECUTING;
-	this->mutex->unlock(this->mutex);
 	/* canceled threads are restarted to get a constant pool */
 	thread_cleanup_push((thread_cleanup_t)restart, worker);
 	while (TRUE)
 	{
+		time_monotonic(&start);
 		requeue = worker->job->execute(worker->job);
+		this->duration_metric->observe_since(this->duration_metric, &start);
 		if (requeue.type != JOB_REQUEUE_TYPE_DIRECT)
 		{
 			break;
@@ -244,90 +612,119 @@ static void process_job(private_processor_t *this, worker_thread_t *worker)
 		}
 	}
 	thread_cleanup_pop(FALSE);
-	this->mutex->lock(this->mutex);
-	this->working_threads[worker->priority]--;
-	if (worker->job->status == JOB_STATUS_CANCELED)
+	worker->mutex->lock(worker->mutex);
+	ref_put(&this->working_threads[worker->priority]);
+	job = worker->job;
+	/* unset the current job to avoid interference with cancel() when
+	 * destroying or requeueing the job below */
+	worker->job = NULL;
+	if (job->status == JOB_STATUS_CANCELED)
 	{	/* job was canceled via a custom cancel() method or did not
 		 * use JOB_REQUEUE_TYPE_DIRECT */
-		to_destroy = worker->job;
+		to_destroy = job;
+		requeue.type = JOB_REQUEUE_TYPE_NONE;
 	}
-	else
+	worker->mutex->unlock(worker->mutex);
+
+	switch (requeue.type)
 	{
-		switch (requeue.type)
-		{
-			case JOB_REQUEUE_TYPE_NONE:
-				worker->job->status = JOB_STATUS_DONE;
-				to_destroy = worker->job;
-				break;
-			case JOB_REQUEUE_TYPE_FAIR:
-				worker->job->status = JOB_STATUS_QUEUED;
-				this->jobs[worker->priority]->insert_last(
-									this->jobs[worker->priority], worker->job);
-				this->job_added->signal(this->job_added);
-				break;
-			case JOB_REQUEUE_TYPE_SCHEDULE:
-				/* scheduler_t does not hold its lock when queuing jobs
-				 * so this should be safe without unlocking our mutex */
-				switch (requeue.schedule)
-				{
-					case JOB_SCHEDULE:
-						lib->scheduler->schedule_job(lib->scheduler,
-												worker->job, requeue.time.rel);
-						break;
-					case JOB_SCHEDULE_MS:
-						lib->scheduler->schedule_job_ms(lib->scheduler,
-												worker->job, requeue.time.rel);
-						break;
-					case JOB_SCHEDULE_TV:
-						lib->scheduler->schedule_job_tv(lib->scheduler,
-												worker->job, requeue.time.abs);
-						break;
-				}
-				break;
-			default:
-				break;
-		}
+		case JOB_REQUEUE_TYPE_NONE:
+			if (!to_destroy)
+			{
+				job->status = JOB_STATUS_DONE;
+				to_destroy = job;
+			}
+			break;
+		case JOB_REQUEUE_TYPE_FAIR:
+			enqueue(this, job, worker->priority);
+			break;
+		case JOB_REQUEUE_TYPE_SCHEDULE:
+			switch (requeue.schedule)
+			{
+				case JOB_SCHEDULE:
+					lib->scheduler->schedule_job(lib->scheduler, job,
+												 requeue.time.rel);
+					break;
+				case JOB_SCHEDULE_MS:
+					lib->scheduler->schedule_job_ms(lib->scheduler, job,
+													requeue.time.rel);
+					break;
+				case JOB_SCHEDULE_TV:
+					lib->scheduler->schedule_job_tv(lib->scheduler, job,
+													requeue.time.abs);
+					break;
+			}
+			break;
+		default:
+			break;
 	}
-	/* unset the current job to avoid interference with cancel() when
-	 * destroying the job below */
-	worker->job = NULL;
-
 	if (to_destroy)
-	{	/* release mutex to avoid deadlocks if the same lock is required
-		 * during queue_job() and in the destructor called here */
-		this->mutex->unlock(this->mutex);
+	{
 		to_destroy->destroy(to_destroy);
-		this->mutex->lock(this->mutex);
 	}
 }
 
+/**
+ * Check if the calling worker thread should terminate, this->mutex is
+ * expected to be locked
+ */
+static bool terminate_worker(private_processor_t *this)
+{
+	if (this->desired_threads < this->total_threads)
+	{
+		this->total_threads--;
+		this->thread_terminated->signal(this->thread_terminated);
+		return TRUE;
+	}
+	return FALSE;
+}
+
 /**
  * Process queued jobs, called by the worker threads
  */
 static void process_jobs(worker_thread_t *worker)
 {
 	private_processor_t *this = worker->processor;
+	refcount_t added;
 
 	/* worker threads are not cancelable by default */
 	thread_cancelability(FALSE);
 
 	DBG2(DBG_JOB, "started worker thread %.2u", thread_current_id());
 
-	this->mutex->lock(this->mutex);
-	while (this->desired_threads >= this->total_threads)
+	while (TRUE)
 	{
+		added = this->jobs_added;
+		if (this->desired_threads < this->total_threads)
+		{
+			this->mutex->lock(this->mutex);
+			if (terminate_worker(this))
+			{
+				this->mutex->unlock(this->mutex);
+				break;
+			}
+			this->mutex->unlock(this->mutex);
+		}
 		if (get_job(this, worker))
 		{
 			process_job(this, worker);
+			continue;
 		}
-		else
+		this->mutex->lock(this->mutex);
+		if (terminate_worker(this))
 		{
+			this->mutex->unlock(this->mutex);
+			break;
+		}
+		ref_get(&this->waiting);
+		if (added == this->jobs_added)
+		{	/* no jobs queued since we checked, wait for new ones */
 			this->job_added->wait(this->job_added, this->mutex);
 		}
+		ref_put(&this->waiting);
+		this->mutex->unlock(this->mutex);
 	}
-	this->total_threads--;
-	this->thread_terminated->signal(this->thread_terminated);
-	this->mutex->unlock(this->mutex);
+	retire_worker(worker);
 }
 
 METHOD(processor_t, get_total_threads, u_int,
@@ -367,59 +764,36 @@ static job_priority_t sane_prio(job_priority_t prio)
 METHOD(processor_t, get_working_threads, u_int,
 	private_processor_t *this, job_priority_t prio)
 {
-	u_int count;
-
-	this->mutex->lock(this->mutex);
-	count = this->working_threads[sane_prio(prio)];
-	this->mutex->unlock(this->mutex);
-	return count;
+	return this->working_threads[sane_prio(prio)];
 }
 
 METHOD(processor_t, get_job_load, u_int,
 	private_processor_t *this, job_priority_t prio)
 {
-	u_int load;
-
-	prio = sane_prio(prio);
-	this->mutex->lock(this->mutex);
-	load = this->jobs[prio]->get_count(this->jobs[prio]);
-	this->mutex->unlock(this->mutex);
-	return load;
+	return this->queued_jobs[sane_prio(prio)];
 }
 
 METHOD(processor_t, queue_job, void,
 	private_processor_t *this, job_t *job)
 {
-	job_priority_t prio;
-
-	prio = sane_prio(job->get_priority(job));
-	job->status = JOB_STATUS_QUEUED;
-
-	this->mutex->lock(this->mutex);
-	this->jobs[prio]->insert_last(this->jobs[prio], job);
-	this->job_added->signal(this->job_added);
-	this->mutex->unlock(this->mutex);
+	enqueue(this, job, sane_prio(job->get_priority(job)));
 }
 
 METHOD(processor_t, execute_job, void,
 	private_processor_t *this, job_t *job)
 {
 	job_priority_t prio;
-	bool queued = FALSE;
 
-	this->mutex->lock(this->mutex);
 	if (this->desired_threads && get_idle_threads_nolock(this))
 	{
 		prio = sane_prio(job->get_priority(job));
 		job->status = JOB_STATUS_QUEUED;
-		/* insert job in front to execute it immediately */
-		this->jobs[prio]->insert_first(this->jobs[prio], job);
-		queued = TRUE;
+		ref_get(&this->queued_jobs[prio]);
+		/* push job to the urgent stack to execute it immediately */
+		push_job(&this->urgent[prio], job);
+		notify(this);
 	}
-	this->job_added->signal(this->job_added);
-	this->mutex->unlock(this->mutex);
-
-	if (!queued)
+	else
 	{
 		job->execute(job);
 		job->destroy(job);
@@ -432,26 +806,16 @@ METHOD(processor_t, set_threads, void,
 	this->mutex->lock(this->mutex);
 	if (count > this->total_threads)
 	{	/* increase thread count */
-		worker_thread_t *worker;
 		int i;
 
 		this->desired_threads = count;
 		DBG1(DBG_JOB, "spawning %d worker threads", count - this->total_threads);
 		for (i = this->total_threads; i < count; i++)
 		{
-			INIT(worker,
-				.processor = this,
-			);
-			worker->thread = thread_create((thread_main_t)process_jobs, worker);
-			if (worker->thread)
+			if (create_worker(this))
 			{
-				this->threads->insert_last(this->threads, worker);
 				this->total_threads++;
 			}
-			else
-			{
-				free(worker);
-			}
 		}
 	}
 	else if (count < this->total_threads)
@@ -474,6 +838,7 @@ METHOD(processor_t, cancel, void,
 	enumerator = this->threads->create_enumerator(this->threads);
 	while (enumerator->enumerate(enumerator, (void**)&worker))
 	{
+		worker->mutex->lock(worker->mutex);
 		if (worker->job && worker->job->cancel)
 		{
 			worker->job->status = JOB_STATUS_CANCELED;
@@ -483,6 +848,7 @@ METHOD(processor_t, cancel, void,
 				worker->thread->cancel(worker->thread);
 			}
 		}
+		worker->mutex->unlock(worker->mutex);
 	}
 	enumerator->destroy(enumerator);
 	while (this->total_threads > 0)
@@ -493,35 +859,68 @@ METHOD(processor_t, cancel, void,
 	while (this->threads->remove_first(this->threads,
 									  (void**)&worker) == SUCCESS)
 	{
-		worker->thread->join(worker->thread);
-		free(worker);
+		destroy_worker(worker);
 	}
 	this->mutex->unlock(this->mutex);
 }
 
+/**
+ * Destroy all jobs in a lock-free stack
+ */
+static void destroy_jobs(queue_entry_t *entries)
+{
+	queue_entry_t *entry;
+
+	while (entries)
+	{
+		entry = entries;
+		entries = entries->next;
+		entry->job->destroy(entry->job);
+		free(entry);
+	}
+}
+
 METHOD(processor_t, destroy, void,
 	private_processor_t *this)
 {
 	int i;
 
 	cancel(this);
+	for (i = 0; i < JOB_PRIO_MAX; i++)
+	{
+		this->queued_metric[i]->destroy(this->queued_metric[i]);
+	}
+	this->duration_metric->destroy(this->duration_metric);
 	this->thread_terminated->destroy(this->thread_terminated);
 	this->job_added->destroy(this->job_added);
 	this->mutex->destroy(this->mutex);
+	this->workers_lock->destroy(this->workers_lock);
+	DESTROY_IF(this->reserve_lock);
 	for (i = 0; i < JOB_PRIO_MAX; i++)
 	{
-		this->jobs[i]->destroy_offset(this->jobs[i], offsetof(job_t, destroy));
+		destroy_jobs(pop_jobs(&this->urgent[i]));
+		destroy_jobs(pop_jobs(&this->jobs[i]));
 	}
 	this->threads->destroy(this->threads);
+	free(this->workers);
 	free(this);
 }
 
+/**
+ * Get the number of queued jobs counted in a refcount, for a gauge
+ */
+static int64_t get_queued(refcount_t *queued)
+{
+	return *queued;
+}
+
 /*
  * Described in header.
  */
 processor_t *processor_create()
 {
 	private_processor_t *this;
+	char labels[32];
 	int i;
 
 	INIT(this,
@@ -537,16 +936,32 @@ processor_t *processor_create()
 			.destroy = _destroy,
 		},
 		.threads = linked_list_create(),
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.workers_lock = rwlock_create_named(RWLOCK_TYPE_DEFAULT,
+											"processor.workers"),
+		.mutex = mutex_create_named(MUTEX_TYPE_DEFAULT, "processor"),
 		.job_added = condvar_create(CONDVAR_TYPE_DEFAULT),
 		.thread_terminated = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.duration_metric = lib->metrics->create(lib->metrics,
+								METRIC_HISTOGRAM, "processor_job_duration_seconds",
+								NULL, "Time spent executing jobs"),
 	);
 	for (i = 0; i < JOB_PRIO_MAX; i++)
 	{
-		this->jobs[i] = linked_list_create();
+		snprintf(labels, sizeof(labels), "priority=\"%N\"",
+				 job_priority_names, i);
+		this->queued_metric[i] = lib->metrics->create_gauge(lib->metrics,
+								"processor_queued_jobs", labels,
+								"Number of jobs queued for execution",
+								(metric_gauge_cb_t)get_queued,
+								&this->queued_jobs[i]);
 		this->prio_threads[i] = lib->settings->get_int(lib->settings,
 						"libstrongswan.processor.priority_threads.%N", 0,
 						job_priority_names, i);
+		if (this->prio_threads[i] > 0 && !this->reserve_lock)
+		{
+			this->reserve_lock = mutex_create_named(MUTEX_TYPE_DEFAULT,
+													"processor.reserve");
+		}
 	}
 
 	return &this->public;
@@ -91,6 +91,11 @@ struct private_scheduler_t {
 	 * Condvar to wait for next job.
 	 */
 	condvar_t *condvar;
+
+	/**
+	 * Histogram of delays between scheduled and actual event times
+	 */
+	metric_t *lag;
 };
 
 /**
@@ -193,6 +198,7 @@ static job_requeue_t schedule(private_scheduler_t * this)
 		{
 			remove_event(this);
 			this->mutex->unlock(this->mutex);
+			this->lag->observe_since(this->lag, &event->time);
 			DBG2(DBG_JOB, "got event, queuing job for execution");
 			lib->processor->queue_job(lib->processor, event->job);
 			free(event);
@@ -304,6 +310,7 @@ METHOD(scheduler_t, destroy, void,
 	private_scheduler_t *this)
 {
 	event_t *event;
+	this->lag->destroy(this->lag);
 	this->condvar->destroy(this->condvar);
 	this->mutex->destroy(this->mutex);
 	while ((event = remove_event(this)) != NULL)
@@ -331,8 +338,11 @@ scheduler_t * scheduler_create()
 			.destroy = _destroy,
 		},
 		.heap_size = HEAP_SIZE_DEFAULT,
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.mutex = mutex_create_named(MUTEX_TYPE_DEFAULT, "scheduler"),
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.lag = lib->metrics->create(lib->metrics, METRIC_HISTOGRAM,
+								"scheduler_lag_seconds", NULL,
+								"Delay of scheduled jobs past their due time"),
 	);
 
 	this->heap = (event_t**)calloc(this->heap_size + 1, sizeof(event_t*));
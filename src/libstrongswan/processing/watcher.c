@@ -447,7 +447,7 @@ watcher_t *watcher_create()
 			.destroy = _destroy,
 		},
 		.fds = linked_list_create(),
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.mutex = mutex_create_named(MUTEX_TYPE_DEFAULT, "watcher"),
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 		.jobs = linked_list_create(),
 		.notify = {-1, -1},
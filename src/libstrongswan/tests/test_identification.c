@@ -783,6 +783,87 @@ START_TEST(test_contains_wildcards)
 }
 END_TEST
 
+/*******************************************************************************
+ * hash
+ */
+
+/**
+ * Check that two identities are equal and hash to the same value
+ */
+static void assert_hash_equal(identification_t *a, identification_t *b)
+{
+	ck_assert(a->equals(a, b));
+	ck_assert(b->equals(b, a));
+	ck_assert_int_eq(a->hash(a, 0), b->hash(b, 0));
+	ck_assert_int_eq(a->hash(a, 42), b->hash(b, 42));
+}
+
+START_TEST(test_hash)
+{
+	identification_t *a, *b;
+
+	a = identification_create_from_string("moon@strongswan.org");
+	b = identification_create_from_string("Moon@StrongSwan.ORG");
+	assert_hash_equal(a, b);
+	ck_assert(a->hash(a, 0) != a->hash(a, 1));
+	b->destroy(b);
+	b = identification_create_from_string("sun@strongswan.org");
+	ck_assert(a->hash(a, 0) != b->hash(b, 0));
+	b->destroy(b);
+	b = identification_create_from_string("@moon@strongswan.org");
+	ck_assert(a->hash(a, 0) != b->hash(b, 0));
+	a->destroy(a);
+	b->destroy(b);
+
+	a = identification_create_from_string("ipsec.strongswan.org");
+	b = identification_create_from_string("IPSEC.strongSwan.org");
+	assert_hash_equal(a, b);
+	a->destroy(a);
+	b->destroy(b);
+
+	a = identification_create_from_string("%any");
+	b = identification_create_from_encoding(ID_ANY, chunk_from_chars(0x01));
+	assert_hash_equal(a, b);
+	a->destroy(a);
+	b->destroy(b);
+
+	a = identification_create_from_string("192.168.0.1");
+	b = identification_create_from_string("192.168.0.2");
+	ck_assert(a->hash(a, 0) != b->hash(b, 0));
+	b->destroy(b);
+	b = identification_create_from_string("192.168.0.1");
+	assert_hash_equal(a, b);
+	a->destroy(a);
+	b->destroy(b);
+}
+END_TEST
+
+START_TEST(test_hash_dn)
+{
+	identification_t *a, *b;
+
+	a = identification_create_from_string("C=CH, E=moon@strongswan.org, CN=moon");
+	b = identification_create_from_string("C=ch, E=Moon@StrongSwan.ORG, CN=moon");
+	assert_hash_equal(a, b);
+	b->destroy(b);
+	b = identification_create_from_string("C=CH, E=moon@strongswan.org, CN=sun");
+	ck_assert(a->hash(a, 0) != b->hash(b, 0));
+	a->destroy(a);
+	b->destroy(b);
+
+	/* CN=moon as PrintableString and as UTF8String */
+	a = identification_create_from_encoding(ID_DER_ASN1_DN, chunk_from_chars(
+						0x30, 0x0f, 0x31, 0x0d, 0x30, 0x0b, 0x06, 0x03, 0x55, 0x04,
+						0x03, 0x13, 0x04, 0x6d, 0x6f, 0x6f, 0x6e));
+	b = identification_create_from_encoding(ID_DER_ASN1_DN, chunk_from_chars(
+						0x30, 0x0f, 0x31, 0x0d, 0x30, 0x0b, 0x06, 0x03, 0x55, 0x04,
+						0x03, 0x0c, 0x04, 0x6d, 0x6f, 0x6f, 0x6e));
+	assert_hash_equal(a, b);
+	a->destroy(a);
+	b->destroy(b);
+}
+END_TEST
+
 /*******************************************************************************
  * clone
  */
@@ -849,6 +930,11 @@ Suite *identification_suite_create()
 	tcase_add_test(tc, test_contains_wildcards);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("hash");
+	tcase_add_test(tc, test_hash);
+	tcase_add_test(tc, test_hash_dn);
+	suite_add_tcase(s, tc);
+
 	tc = tcase_create("clone");
 	tcase_add_test(tc, test_clone);
 	suite_add_tcase(s, tc);
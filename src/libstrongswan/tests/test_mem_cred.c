@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "test_suite.h"
+
+#include <credentials/sets/mem_cred.h>
+
+static mem_cred_t *creds;
+
+START_SETUP(setup_creds)
+{
+	creds = mem_cred_create();
+}
+END_SETUP
+
+START_TEARDOWN(teardown_creds)
+{
+	creds->destroy(creds);
+}
+END_TEARDOWN
+
+/**
+ * Add a shared key with the given value and owners
+ */
+static void add_shared(char *key, char *owner1, char *owner2)
+{
+	shared_key_t *shared;
+
+	shared = shared_key_create(SHARED_EAP, chunk_clone(chunk_from_str(key)));
+	creds->add_shared(creds, shared,
+					  identification_create_from_string(owner1),
+					  owner2 ? identification_create_from_string(owner2) : NULL,
+					  NULL);
+}
+
+/**
+ * Enumerate shared keys and compare them against the expected values,
+ * concatenated in enumeration order
+ */
+static void assert_shared(char *me, char *other, char *expected)
+{
+	identification_t *id_me = NULL, *id_other = NULL;
+	enumerator_t *enumerator;
+	shared_key_t *shared;
+	char buf[128] = "";
+
+	if (me)
+	{
+		id_me = identification_create_from_string(me);
+	}
+	if (other)
+	{
+		id_other = identification_create_from_string(other);
+	}
+	enumerator = creds->set.create_shared_enumerator(&creds->set, SHARED_ANY,
+													 id_me, id_other);
+	while (enumerator->enumerate(enumerator, &shared, NULL, NULL))
+	{
+		strncat(buf, shared->get_key(shared).ptr,
+				min(shared->get_key(shared).len, sizeof(buf) - strlen(buf) - 1));
+	}
+	enumerator->destroy(enumerator);
+	DESTROY_IF(id_me);
+	DESTROY_IF(id_other);
+	ck_assert_str_eq(buf, expected);
+}
+
+START_TEST(test_shared_exact)
+{
+	add_shared("a", "alice@strongswan.org", NULL);
+	add_shared("b", "bob@strongswan.org", NULL);
+	add_shared("c", "carol@strongswan.org", "moon.strongswan.org");
+
+	assert_shared("alice@strongswan.org", NULL, "a");
+	assert_shared("BOB@strongswan.org", NULL, "b");
+	assert_shared("moon.strongswan.org", NULL, "c");
+	assert_shared("moon.strongswan.org", "alice@strongswan.org", "ca");
+	assert_shared("dave@strongswan.org", NULL, "");
+	assert_shared(NULL, NULL, "cba");
+}
+END_TEST
+
+START_TEST(test_shared_dn)
+{
+	add_shared("a", "C=CH, O=strongSwan, CN=alice", NULL);
+	add_shared("b", "C=CH, O=strongSwan, CN=bob", NULL);
+
+	assert_shared("C=CH, O=strongSwan, CN=alice", NULL, "a");
+	assert_shared("c=ch, o=strongSwan, cn=bob", NULL, "b");
+	assert_shared("C=CH, O=strongSwan, CN=carol", NULL, "");
+}
+END_TEST
+
+START_TEST(test_shared_wildcards)
+{
+	add_shared("a", "alice@strongswan.org", NULL);
+	add_shared("b", "*@strongswan.org", NULL);
+	add_shared("c", "%any", NULL);
+	add_shared("d", "C=CH, O=strongSwan, CN=*", NULL);
+	add_shared("e", "alice@strongswan.org", NULL);
+
+	assert_shared("alice@strongswan.org", NULL, "ecba");
+	assert_shared("bob@strongswan.org", NULL, "cb");
+	assert_shared("C=CH, O=strongSwan, CN=bob", NULL, "dc");
+	assert_shared("%any", NULL, "c");
+}
+END_TEST
+
+START_TEST(test_shared_replace)
+{
+	mem_cred_t *other;
+
+	add_shared("a", "alice@strongswan.org", NULL);
+
+	other = mem_cred_create();
+	other->add_shared(other, shared_key_create(SHARED_EAP,
+								chunk_clone(chunk_from_str("b"))),
+					  identification_create_from_string("alice@strongswan.org"),
+					  NULL);
+	other->add_shared(other, shared_key_create(SHARED_EAP,
+								chunk_clone(chunk_from_str("c"))),
+					  identification_create_from_string("%any"), NULL);
+	creds->replace_secrets(creds, other, _i);
+	other->destroy(other);
+
+	assert_shared("alice@strongswan.org", NULL, "cb");
+	add_shared("d", "alice@strongswan.org", NULL);
+	assert_shared("alice@strongswan.org", NULL, "dcb");
+	assert_shared("bob@strongswan.org", NULL, "c");
+}
+END_TEST
+
+Suite *mem_cred_suite_create()
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("mem_cred");
+
+	tc = tcase_create("shared");
+	tcase_add_checked_fixture(tc, setup_creds, teardown_creds);
+	tcase_add_test(tc, test_shared_exact);
+	tcase_add_test(tc, test_shared_dn);
+	tcase_add_test(tc, test_shared_wildcards);
+	tcase_add_loop_test(tc, test_shared_replace, 0, 2);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
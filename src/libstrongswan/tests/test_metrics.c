@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <pthread.h>
+
+#include "test_suite.h"
+
+#include <utils/metrics.h>
+
+#define THREADS 10
+
+static metrics_t *metrics;
+
+START_SETUP(setup_metrics)
+{
+	metrics = metrics_create();
+}
+END_SETUP
+
+START_TEARDOWN(teardown_metrics)
+{
+	metrics->destroy(metrics);
+}
+END_TEARDOWN
+
+/**
+ * Print all metrics to the given buffer
+ */
+static void print_metrics(char *buf, size_t len)
+{
+	FILE *out;
+
+	memset(buf, 0, len);
+	out = fmemopen(buf, len, "w");
+	metrics->print(metrics, out);
+	fclose(out);
+}
+
+/*******************************************************************************
+ * counters
+ */
+
+static void *count_run(metric_t *metric)
+{
+	int i;
+
+	for (i = 0; i < 1000; i++)
+	{
+		metric->add(metric, 1);
+	}
+	return NULL;
+}
+
+START_TEST(test_counter)
+{
+	pthread_t threads[THREADS];
+	metric_t *metric;
+	char buf[512];
+	int i;
+
+	metric = metrics->create(metrics, METRIC_COUNTER, "test_total", NULL,
+							 "Test counter");
+	for (i = 0; i < THREADS; i++)
+	{
+		pthread_create(&threads[i], NULL, (void*)count_run, metric);
+	}
+	for (i = 0; i < THREADS; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	metric->add(metric, 5);
+
+	print_metrics(buf, sizeof(buf));
+	ck_assert_str_eq(buf, "# HELP strongswan_test_total Test counter\n"
+						  "# TYPE strongswan_test_total counter\n"
+						  "strongswan_test_total 10005\n");
+	metric->destroy(metric);
+
+	print_metrics(buf, sizeof(buf));
+	ck_assert_str_eq(buf, "");
+}
+END_TEST
+
+/*******************************************************************************
+ * gauges
+ */
+
+static int64_t get_value(int64_t *value)
+{
+	return *value;
+}
+
+START_TEST(test_gauge)
+{
+	metric_t *a, *b, *c;
+	int64_t value = 42;
+	char buf[512];
+
+	a = metrics->create(metrics, METRIC_GAUGE, "test_gauge", "id=\"a\"",
+						"Test gauge");
+	c = metrics->create(metrics, METRIC_GAUGE, "test_other", NULL,
+						"Other gauge");
+	b = metrics->create_gauge(metrics, "test_gauge", "id=\"b\"", "Test gauge",
+							  (metric_gauge_cb_t)get_value, &value);
+	a->add(a, 3);
+	a->add(a, -5);
+	c->add(c, 1);
+
+	print_metrics(buf, sizeof(buf));
+	ck_assert_str_eq(buf, "# HELP strongswan_test_gauge Test gauge\n"
+						  "# TYPE strongswan_test_gauge gauge\n"
+						  "strongswan_test_gauge{id=\"a\"} -2\n"
+						  "strongswan_test_gauge{id=\"b\"} 42\n"
+						  "# HELP strongswan_test_other Other gauge\n"
+						  "# TYPE strongswan_test_other gauge\n"
+						  "strongswan_test_other 1\n");
+	a->destroy(a);
+	b->destroy(b);
+	c->destroy(c);
+}
+END_TEST
+
+/*******************************************************************************
+ * histograms
+ */
+
+START_TEST(test_histogram)
+{
+	metric_t *metric;
+	timeval_t start;
+	char buf[4096];
+
+	metric = metrics->create(metrics, METRIC_HISTOGRAM, "test_seconds",
+							 "op=\"x\"", "Test histogram");
+	metric->observe(metric, 5);
+	metric->observe(metric, 10);
+	metric->observe(metric, 300000);
+	metric->observe(metric, 20000000);
+	time_monotonic(&start);
+	start.tv_sec--;
+	metric->observe_since(metric, &start);
+
+	print_metrics(buf, sizeof(buf));
+	ck_assert(strstr(buf, "# TYPE strongswan_test_seconds histogram\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_bucket"
+						  "{op=\"x\",le=\"1e-05\"} 2\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_bucket"
+						  "{op=\"x\",le=\"0.25\"} 2\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_bucket"
+						  "{op=\"x\",le=\"0.5\"} 3\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_bucket"
+						  "{op=\"x\",le=\"2.5\"} 4\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_bucket"
+						  "{op=\"x\",le=\"10\"} 4\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_bucket"
+						  "{op=\"x\",le=\"+Inf\"} 5\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_count{op=\"x\"} 5\n"));
+	ck_assert(strstr(buf, "strongswan_test_seconds_sum{op=\"x\"} 21.3"));
+	metric->destroy(metric);
+}
+END_TEST
+
+Suite *metrics_suite_create()
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("metrics");
+
+	tc = tcase_create("counter");
+	tcase_add_checked_fixture(tc, setup_metrics, teardown_metrics);
+	tcase_add_test(tc, test_counter);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("gauge");
+	tcase_add_checked_fixture(tc, setup_metrics, teardown_metrics);
+	tcase_add_test(tc, test_gauge);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("histogram");
+	tcase_add_checked_fixture(tc, setup_metrics, teardown_metrics);
+	tcase_add_test(tc, test_histogram);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "test_suite.h"
+
+#include <unistd.h>
+
+#include <processing/processor.h>
+#include <processing/jobs/callback_job.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+
+static processor_t *processor;
+static mutex_t *mutex;
+static condvar_t *condvar;
+static int executed, destroyed, blocked;
+static bool release;
+
+START_SETUP(setup_processor)
+{
+	executed = destroyed = blocked = 0;
+	release = FALSE;
+	mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	condvar = condvar_create(CONDVAR_TYPE_DEFAULT);
+	processor = processor_create();
+}
+END_SETUP
+
+START_TEARDOWN(teardown_processor)
+{
+	processor->destroy(processor);
+	condvar->destroy(condvar);
+	mutex->destroy(mutex);
+}
+END_TEARDOWN
+
+/**
+ * Count executed jobs
+ */
+static job_requeue_t count(int *requeue)
+{
+	mutex->lock(mutex);
+	executed++;
+	condvar->broadcast(condvar);
+	mutex->unlock(mutex);
+	if (requeue && --(*requeue) > 0)
+	{
+		return JOB_REQUEUE_FAIR;
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Block until released
+ */
+static job_requeue_t block(void *data)
+{
+	mutex->lock(mutex);
+	executed++;
+	blocked++;
+	condvar->broadcast(condvar);
+	while (!release)
+	{
+		condvar->wait(condvar, mutex);
+	}
+	blocked--;
+	mutex->unlock(mutex);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Count destroyed jobs
+ */
+static void cleanup(void *data)
+{
+	mutex->lock(mutex);
+	destroyed++;
+	condvar->broadcast(condvar);
+	mutex->unlock(mutex);
+}
+
+/**
+ * Queue a job with the given priority
+ */
+static void queue(callback_job_cb_t cb, void *data, job_priority_t prio)
+{
+	processor->queue_job(processor, (job_t*)
+			callback_job_create_with_prio(cb, data, (void*)cleanup, NULL, prio));
+}
+
+/**
+ * Wait until the given number of jobs got destroyed
+ */
+static void wait_destroyed(int count)
+{
+	mutex->lock(mutex);
+	while (destroyed < count)
+	{
+		condvar->wait(condvar, mutex);
+	}
+	mutex->unlock(mutex);
+}
+
+/**
+ * Wait until the given number of jobs are blocking
+ */
+static void wait_blocked(int count)
+{
+	mutex->lock(mutex);
+	while (blocked < count)
+	{
+		condvar->wait(condvar, mutex);
+	}
+	mutex->unlock(mutex);
+}
+
+/**
+ * Release blocking jobs
+ */
+static void release_blocked()
+{
+	mutex->lock(mutex);
+	release = TRUE;
+	condvar->broadcast(condvar);
+	mutex->unlock(mutex);
+}
+
+static int thread_counts[] = { 1, 2, 8 };
+
+START_TEST(test_queue)
+{
+	int i;
+
+	processor->set_threads(processor, thread_counts[_i]);
+	for (i = 0; i < 1000; i++)
+	{
+		queue((void*)count, NULL, i % JOB_PRIO_MAX);
+	}
+	wait_destroyed(1000);
+	ck_assert_int_eq(executed, 1000);
+	for (i = 0; i < JOB_PRIO_MAX; i++)
+	{
+		ck_assert_int_eq(processor->get_job_load(processor, i), 0);
+	}
+}
+END_TEST
+
+START_TEST(test_requeue)
+{
+	int requeue[4] = { 10, 20, 30, 40 }, i;
+
+	processor->set_threads(processor, thread_counts[_i]);
+	for (i = 0; i < countof(requeue); i++)
+	{
+		queue((void*)count, &requeue[i], JOB_PRIO_MEDIUM);
+	}
+	wait_destroyed(countof(requeue));
+	ck_assert_int_eq(executed, 100);
+}
+END_TEST
+
+START_TEST(test_execute)
+{
+	processor->set_threads(processor, thread_counts[_i]);
+	processor->execute_job(processor, (job_t*)
+			callback_job_create((void*)count, NULL, (void*)cleanup, NULL));
+	wait_destroyed(1);
+	ck_assert_int_eq(executed, 1);
+
+	processor->set_threads(processor, 0);
+	processor->cancel(processor);
+	processor->execute_job(processor, (job_t*)
+			callback_job_create((void*)count, NULL, (void*)cleanup, NULL));
+	ck_assert_int_eq(executed, 2);
+	ck_assert_int_eq(destroyed, 2);
+}
+END_TEST
+
+START_TEST(test_destroy_queued)
+{
+	int i;
+
+	for (i = 0; i < 10; i++)
+	{
+		queue((void*)count, NULL, i % JOB_PRIO_MAX);
+	}
+	ck_assert_int_eq(processor->get_job_load(processor, JOB_PRIO_CRITICAL), 3);
+	processor->destroy(processor);
+	ck_assert_int_eq(executed, 0);
+	ck_assert_int_eq(destroyed, 10);
+	processor = processor_create();
+}
+END_TEST
+
+START_TEST(test_blocking)
+{
+	int i, threads = thread_counts[_i];
+
+	processor->set_threads(processor, threads);
+	for (i = 0; i < threads * 3; i++)
+	{
+		queue(block, NULL, JOB_PRIO_MEDIUM);
+	}
+	wait_blocked(threads);
+	ck_assert_int_eq(processor->get_working_threads(processor,
+												JOB_PRIO_MEDIUM), threads);
+	ck_assert_int_eq(processor->get_idle_threads(processor), 0);
+	release_blocked();
+	wait_destroyed(threads * 3);
+	ck_assert_int_eq(executed, threads * 3);
+}
+END_TEST
+
+START_TEST(test_reserved)
+{
+	processor->destroy(processor);
+	lib->settings->set_int(lib->settings,
+			"libstrongswan.processor.priority_threads.critical", 1);
+	processor = processor_create();
+	lib->settings->set_int(lib->settings,
+			"libstrongswan.processor.priority_threads.critical", 0);
+
+	processor->set_threads(processor, 2);
+	queue(block, NULL, JOB_PRIO_LOW);
+	queue(block, NULL, JOB_PRIO_LOW);
+	wait_blocked(1);
+	/* give the second thread a chance to pick up the second job */
+	usleep(50000);
+	ck_assert_int_eq(processor->get_working_threads(processor,
+												JOB_PRIO_LOW), 1);
+	ck_assert_int_eq(processor->get_job_load(processor, JOB_PRIO_LOW), 1);
+
+	queue((void*)count, NULL, JOB_PRIO_CRITICAL);
+	wait_destroyed(1);
+	ck_assert_int_eq(executed, 2);
+
+	release_blocked();
+	wait_destroyed(3);
+	ck_assert_int_eq(executed, 3);
+}
+END_TEST
+
+Suite *processor_suite_create()
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("processor");
+
+	tc = tcase_create("queue");
+	tcase_add_checked_fixture(tc, setup_processor, teardown_processor);
+	tcase_add_loop_test(tc, test_queue, 0, countof(thread_counts));
+	tcase_add_loop_test(tc, test_requeue, 0, countof(thread_counts));
+	tcase_add_loop_test(tc, test_execute, 0, countof(thread_counts));
+	tcase_add_test(tc, test_destroy_queued);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("threads");
+	tcase_add_checked_fixture(tc, setup_processor, teardown_processor);
+	tcase_add_loop_test(tc, test_blocking, 0, countof(thread_counts));
+	tcase_add_test(tc, test_reserved);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -85,6 +85,9 @@ int main()
 	srunner_add_suite(sr, host_suite_create());
 	srunner_add_suite(sr, vectors_suite_create());
 	srunner_add_suite(sr, printf_suite_create());
+	srunner_add_suite(sr, mem_cred_suite_create());
+	srunner_add_suite(sr, processor_suite_create());
+	srunner_add_suite(sr, metrics_suite_create());
 	if (lib->plugins->has_feature(lib->plugins,
 								  PLUGIN_DEPENDS(PRIVKEY_GEN, KEY_RSA)))
 	{
@@ -95,6 +98,11 @@ int main()
 	{
 		srunner_add_suite(sr, ecdsa_suite_create());
 	}
+	if (lib->plugins->has_feature(lib->plugins,
+								  PLUGIN_DEPENDS(DATABASE, DB_SQLITE)))
+	{
+		srunner_add_suite(sr, sqlite_suite_create());
+	}
 
 	srunner_run_all(sr, CK_NORMAL);
 	nf = srunner_ntests_failed(sr);
@@ -35,5 +35,9 @@ Suite *ecdsa_suite_create();
 Suite *rsa_suite_create();
 Suite *host_suite_create();
 Suite *printf_suite_create();
+Suite *mem_cred_suite_create();
+Suite *processor_suite_create();
+Suite *sqlite_suite_create();
+Suite *metrics_suite_create();
 
 #endif /** TEST_RUNNER_H_ */
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "test_suite.h"
+
+#include <unistd.h>
+
+#include <database/database.h>
+#include <threading/thread.h>
+
+static char path[] = "/tmp/strongswan-test-sqlite-XXXXXX";
+static database_t *db;
+
+START_SETUP(setup_db)
+{
+	char uri[64];
+	int fd;
+
+	strcpy(path + strlen(path) - 6, "XXXXXX");
+	fd = mkstemp(path);
+	ck_assert(fd != -1);
+	close(fd);
+	snprintf(uri, sizeof(uri), "sqlite://%s", path);
+	db = lib->db->create(lib->db, uri);
+	ck_assert(db != NULL);
+	ck_assert(db->execute(db, NULL, "CREATE TABLE t (id INTEGER PRIMARY KEY, "
+						  "val INTEGER, name TEXT)") >= 0);
+}
+END_SETUP
+
+START_TEARDOWN(teardown_db)
+{
+	db->destroy(db);
+	unlink(path);
+}
+END_TEARDOWN
+
+/**
+ * Insert a row, return its rowid
+ */
+static int insert(int val, char *name)
+{
+	int rowid = 0;
+
+	ck_assert_int_eq(db->execute(db, &rowid,
+					"INSERT INTO t (val, name) VALUES (?, ?)",
+					DB_INT, val, DB_TEXT, name), 1);
+	return rowid;
+}
+
+/**
+ * Sum up the values of rows with the given name
+ */
+static int sum(char *name)
+{
+	enumerator_t *enumerator;
+	int val, total = 0;
+
+	enumerator = db->query(db, "SELECT val FROM t WHERE name = ?",
+						   DB_TEXT, name, DB_INT);
+	ck_assert(enumerator != NULL);
+	while (enumerator->enumerate(enumerator, &val))
+	{
+		total += val;
+	}
+	enumerator->destroy(enumerator);
+	return total;
+}
+
+START_TEST(test_statements)
+{
+	int i;
+
+	for (i = 1; i <= 10; i++)
+	{
+		ck_assert_int_eq(insert(i, i % 2 ? "odd" : "even"), i);
+	}
+	ck_assert_int_eq(sum("odd"), 25);
+	ck_assert_int_eq(sum("even"), 30);
+	ck_assert_int_eq(sum("none"), 0);
+	ck_assert_int_eq(db->execute(db, NULL, "UPDATE t SET val = ? WHERE name = ?",
+								 DB_INT, 0, DB_TEXT, "odd"), 5);
+	ck_assert_int_eq(sum("odd"), 0);
+	ck_assert_int_eq(sum("even"), 30);
+}
+END_TEST
+
+START_TEST(test_nested)
+{
+	enumerator_t *outer, *inner;
+	int a, b, count = 0;
+
+	insert(1, "x");
+	insert(2, "x");
+
+	outer = db->query(db, "SELECT val FROM t WHERE name = ?",
+					  DB_TEXT, "x", DB_INT);
+	ck_assert(outer != NULL);
+	while (outer->enumerate(outer, &a))
+	{
+		inner = db->query(db, "SELECT val FROM t WHERE name = ?",
+						  DB_TEXT, "x", DB_INT);
+		ck_assert(inner != NULL);
+		while (inner->enumerate(inner, &b))
+		{
+			count += a * b;
+		}
+		inner->destroy(inner);
+	}
+	outer->destroy(outer);
+	ck_assert_int_eq(count, 9);
+}
+END_TEST
+
+START_TEST(test_transaction)
+{
+	insert(1, "x");
+	ck_assert(db->transaction(db, FALSE));
+	insert(2, "x");
+	ck_assert_int_eq(sum("x"), 3);
+	ck_assert(db->rollback(db));
+	ck_assert_int_eq(sum("x"), 1);
+	ck_assert(db->transaction(db, FALSE));
+	insert(3, "x");
+	ck_assert(db->commit(db));
+	ck_assert_int_eq(sum("x"), 4);
+}
+END_TEST
+
+#define THREADS 4
+#define ROWS 25
+
+/**
+ * Insert rows and read them back from a separate thread
+ */
+static void *insert_rows(void *data)
+{
+	char *name = data;
+	int i;
+
+	for (i = 1; i <= ROWS; i++)
+	{
+		insert(i, name);
+	}
+	return (void*)(uintptr_t)sum(name);
+}
+
+START_TEST(test_threads)
+{
+	thread_t *threads[THREADS];
+	char *names[] = { "a", "b", "c", "d" };
+	int i;
+
+	for (i = 0; i < THREADS; i++)
+	{
+		threads[i] = thread_create(insert_rows, names[i]);
+		ck_assert(threads[i] != NULL);
+	}
+	for (i = 0; i < THREADS; i++)
+	{
+		ck_assert_int_eq((uintptr_t)threads[i]->join(threads[i]),
+						 ROWS * (ROWS + 1) / 2);
+	}
+	for (i = 0; i < THREADS; i++)
+	{
+		ck_assert_int_eq(sum(names[i]), ROWS * (ROWS + 1) / 2);
+	}
+}
+END_TEST
+
+Suite *sqlite_suite_create()
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("sqlite");
+
+	tc = tcase_create("statements");
+	tcase_add_checked_fixture(tc, setup_db, teardown_db);
+	tcase_add_test(tc, test_statements);
+	tcase_add_test(tc, test_nested);
+	tcase_add_test(tc, test_transaction);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("threads");
+	tcase_add_checked_fixture(tc, setup_db, teardown_db);
+	tcase_add_test(tc, test_threads);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
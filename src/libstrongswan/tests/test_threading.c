@@ -20,6 +20,9 @@
 #include "test_suite.h"
 
 #include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <threading/rwlock.h>
+#include <threading/lock_profiler.h>
 
 /*******************************************************************************
  * recursive mutex test
@@ -95,6 +98,73 @@ START_TEST(test_mutex)
 }
 END_TEST
 
+/*******************************************************************************
+ * lock profiler test
+ */
+
+/**
+ * Print lock profiler statistics to the given buffer
+ */
+static void print_profile(char *buf, size_t len)
+{
+	FILE *out;
+
+	memset(buf, 0, len);
+	out = fmemopen(buf, len, "w");
+	lock_profiler_print(out);
+	fclose(out);
+}
+
+START_TEST(test_lock_profiler)
+{
+	pthread_t threads[THREADS];
+	rwlock_t *rwlock;
+	condvar_t *condvar;
+	char buf[1024];
+	int i;
+
+	lock_profiler_enable(TRUE);
+	mutex = mutex_create_named(MUTEX_TYPE_RECURSIVE, "test.mutex");
+	rwlock = rwlock_create_named(RWLOCK_TYPE_DEFAULT, "test.rwlock");
+	condvar = condvar_create_named(CONDVAR_TYPE_DEFAULT, "test.condvar");
+
+	pthread_barrier_init(&mutex_barrier, NULL, THREADS);
+	for (i = 0; i < THREADS; i++)
+	{
+		pthread_create(&threads[i], NULL, mutex_run, NULL);
+	}
+	for (i = 0; i < THREADS; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	pthread_barrier_destroy(&mutex_barrier);
+
+	mutex->lock(mutex);
+	ck_assert(condvar->timed_wait(condvar, mutex, 1));
+	mutex->unlock(mutex);
+	rwlock->read_lock(rwlock);
+	rwlock->unlock(rwlock);
+	rwlock->write_lock(rwlock);
+	rwlock->unlock(rwlock);
+	lock_profiler_enable(FALSE);
+	rwlock->read_lock(rwlock);
+	rwlock->unlock(rwlock);
+
+	print_profile(buf, sizeof(buf));
+	ck_assert(strstr(buf, "test.mutex: 2001 locked") != NULL);
+	ck_assert(strstr(buf, "test.rwlock: 2 locked, 0 contended, held") != NULL);
+	ck_assert(strstr(buf, "test.condvar: 1 locked, 1 contended") != NULL);
+
+	lock_profiler_reset();
+	print_profile(buf, sizeof(buf));
+	ck_assert(strstr(buf, "test.") == NULL);
+
+	condvar->destroy(condvar);
+	rwlock->destroy(rwlock);
+	mutex->destroy(mutex);
+}
+END_TEST
+
 Suite *threading_suite_create()
 {
 	Suite *s;
@@ -106,5 +176,9 @@ Suite *threading_suite_create()
 	tcase_add_test(tc, test_mutex);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("lock profiler");
+	tcase_add_test(tc, test_lock_profiler);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
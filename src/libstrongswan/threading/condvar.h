@@ -92,5 +92,14 @@ struct condvar_t {
  */
 condvar_t *condvar_create(condvar_type_t type);
 
+/**
+ * Create a named condvar instance, profiled by the lock profiler.
+ *
+ * @param type		type of condvar to create
+ * @param name		name shared by all condvars of this kind, NULL for none
+ * @return			condvar instance
+ */
+condvar_t *condvar_create_named(condvar_type_t type, const char *name);
+
 #endif /** THREADING_CONDVAR_H_ @} */
 
@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include <pthread.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "lock_profiler.h"
+
+#include <library.h>
+#include <collections/hashtable.h>
+
+/**
+ * Profile shared by all locks of the same name
+ */
+struct lock_profile_t {
+
+	/**
+	 * Name of the locks
+	 */
+	char *name;
+
+	/**
+	 * References held by locks and the registry
+	 */
+	refcount_t refs;
+
+	/**
+	 * Number of acquisitions
+	 */
+	u_int64_t locked;
+
+	/**
+	 * Number of acquisitions that had to block
+	 */
+	u_int64_t contended;
+
+	/**
+	 * Total time spent waiting for the lock, in ns
+	 */
+	u_int64_t wait_total;
+
+	/**
+	 * Longest single wait, in ns
+	 */
+	u_int64_t wait_max;
+
+	/**
+	 * Histogram of wait times
+	 */
+	u_int64_t waits[LOCK_PROFILE_BUCKETS];
+
+	/**
+	 * Number of recorded exclusive hold times
+	 */
+	u_int64_t held;
+
+	/**
+	 * Total time the lock was held exclusively, in ns
+	 */
+	u_int64_t hold_total;
+
+	/**
+	 * Longest time the lock was held exclusively, in ns
+	 */
+	u_int64_t hold_max;
+};
+
+/**
+ * See header
+ */
+#ifdef LOCK_PROFILER
+bool lock_profiler_enabled = TRUE;
+#else
+bool lock_profiler_enabled = FALSE;
+#endif
+
+/**
+ * Registered profiles, name => lock_profile_t
+ */
+static hashtable_t *profiles = NULL;
+
+/**
+ * Lock for the registry, a plain pthread mutex as mutex_t depends on us
+ */
+static pthread_mutex_t profiles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef HAVE_GCC_ATOMIC_OPERATIONS
+
+/**
+ * Atomically add a value to a counter
+ */
+static inline void stat_add(u_int64_t *stat, u_int64_t value)
+{
+	__sync_add_and_fetch(stat, value);
+}
+
+/**
+ * Atomically raise a maximum value
+ */
+static inline void stat_max(u_int64_t *stat, u_int64_t value)
+{
+	u_int64_t current;
+
+	do
+	{
+		current = *stat;
+		if (current >= value)
+		{
+			return;
+		}
+	}
+	while (!__sync_bool_compare_and_swap(stat, current, value));
+}
+
+#else /* !HAVE_GCC_ATOMIC_OPERATIONS */
+
+/**
+ * Lock protecting statistics updates
+ */
+static pthread_mutex_t stat_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Add a value to a counter
+ */
+static inline void stat_add(u_int64_t *stat, u_int64_t value)
+{
+	pthread_mutex_lock(&stat_lock);
+	*stat += value;
+	pthread_mutex_unlock(&stat_lock);
+}
+
+/**
+ * Raise a maximum value
+ */
+static inline void stat_max(u_int64_t *stat, u_int64_t value)
+{
+	pthread_mutex_lock(&stat_lock);
+	*stat = max(*stat, value);
+	pthread_mutex_unlock(&stat_lock);
+}
+
+#endif /* HAVE_GCC_ATOMIC_OPERATIONS */
+
+/*
+ * Described in header
+ */
+lock_profile_t *lock_profile_get(const char *name)
+{
+	lock_profile_t *profile;
+
+	if (!name)
+	{
+		return NULL;
+	}
+	pthread_mutex_lock(&profiles_lock);
+	if (!profiles)
+	{
+		profiles = hashtable_create(hashtable_hash_str, hashtable_equals_str, 8);
+	}
+	profile = profiles->get(profiles, (void*)name);
+	if (!profile)
+	{
+		INIT(profile,
+			.name = strdup(name),
+			.refs = 1,
+		);
+		profiles->put(profiles, profile->name, profile);
+	}
+	ref_get(&profile->refs);
+	pthread_mutex_unlock(&profiles_lock);
+	return profile;
+}
+
+/*
+ * Described in header
+ */
+void lock_profile_put(lock_profile_t *profile)
+{
+	if (profile && ref_put(&profile->refs))
+	{
+		free(profile->name);
+		free(profile);
+	}
+}
+
+/*
+ * Described in header
+ */
+u_int64_t lock_profile_time()
+{
+	timeval_t tv;
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+	{
+		return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+#endif /* HAVE_CLOCK_GETTIME */
+	time_monotonic(&tv);
+	return tv.tv_sec * 1000000000ULL + tv.tv_usec * 1000ULL;
+}
+
+/**
+ * Get the histogram bucket for a wait time
+ */
+static inline int get_bucket(u_int64_t ns)
+{
+	u_int64_t us = ns / 1000;
+	int bucket = 0;
+
+	while (us && bucket < LOCK_PROFILE_BUCKETS - 1)
+	{
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/**
+ * Record a wait time
+ */
+static void record_wait(lock_profile_t *profile, u_int64_t start,
+						u_int64_t now)
+{
+	u_int64_t wait = now > start ? now - start : 0;
+
+	stat_add(&profile->contended, 1);
+	stat_add(&profile->wait_total, wait);
+	stat_add(&profile->waits[get_bucket(wait)], 1);
+	stat_max(&profile->wait_max, wait);
+}
+
+/*
+ * Described in header
+ */
+u_int64_t lock_profile_locked(lock_profile_t *profile, u_int64_t start)
+{
+	u_int64_t now;
+
+	now = lock_profile_time();
+	stat_add(&profile->locked, 1);
+	if (start)
+	{
+		record_wait(profile, start, now);
+	}
+	return now;
+}
+
+/*
+ * Described in header
+ */
+void lock_profile_unlocked(lock_profile_t *profile, u_int64_t locked)
+{
+	u_int64_t now, hold;
+
+	now = lock_profile_time();
+	hold = now > locked ? now - locked : 0;
+	stat_add(&profile->held, 1);
+	stat_add(&profile->hold_total, hold);
+	stat_max(&profile->hold_max, hold);
+}
+
+/*
+ * Described in header
+ */
+void lock_profile_waited(lock_profile_t *profile, u_int64_t start)
+{
+	stat_add(&profile->locked, 1);
+	record_wait(profile, start, lock_profile_time());
+}
+
+/*
+ * Described in header
+ */
+void lock_profiler_enable(bool enable)
+{
+	lock_profiler_enabled = enable;
+}
+
+/*
+ * Described in header
+ */
+void lock_profiler_reset()
+{
+	enumerator_t *enumerator;
+	lock_profile_t *profile;
+
+	pthread_mutex_lock(&profiles_lock);
+	if (profiles)
+	{
+		enumerator = profiles->create_enumerator(profiles);
+		while (enumerator->enumerate(enumerator, NULL, &profile))
+		{
+			/* concurrent updates might get lost, which is acceptable */
+			memset(&profile->locked, 0,
+				   sizeof(*profile) - offsetof(lock_profile_t, locked));
+		}
+		enumerator->destroy(enumerator);
+	}
+	pthread_mutex_unlock(&profiles_lock);
+}
+
+/**
+ * Sort profiles by total wait time, descending
+ */
+static int profile_cmp(const void *a, const void *b)
+{
+	lock_profile_t *pa = *(lock_profile_t**)a, *pb = *(lock_profile_t**)b;
+
+	if (pa->wait_total == pb->wait_total)
+	{
+		return strcmp(pa->name, pb->name);
+	}
+	return pa->wait_total < pb->wait_total ? 1 : -1;
+}
+
+/**
+ * Print the statistics of a single profile
+ */
+static void print_profile(FILE *out, lock_profile_t *profile)
+{
+	u_int64_t waits[LOCK_PROFILE_BUCKETS], locked, contended, held;
+	int i;
+
+	locked = profile->locked;
+	contended = profile->contended;
+	held = profile->held;
+	memcpy(waits, profile->waits, sizeof(waits));
+
+	fprintf(out, "  %s: %" PRIu64 " locked, %" PRIu64 " contended",
+			profile->name, locked, contended);
+	if (contended)
+	{
+		fprintf(out, ", waited %" PRIu64 "us (avg %" PRIu64 "us, "
+				"max %" PRIu64 "us)", profile->wait_total / 1000,
+				profile->wait_total / contended / 1000,
+				profile->wait_max / 1000);
+	}
+	if (held)
+	{
+		fprintf(out, ", held %" PRIu64 "us (avg %" PRIu64 "us, "
+				"max %" PRIu64 "us)", profile->hold_total / 1000,
+				profile->hold_total / held / 1000, profile->hold_max / 1000);
+	}
+	fprintf(out, "\n");
+	if (contended)
+	{
+		fprintf(out, "    waits:");
+		for (i = 0; i < LOCK_PROFILE_BUCKETS; i++)
+		{
+			if (!waits[i])
+			{
+				continue;
+			}
+			if (i < LOCK_PROFILE_BUCKETS - 1)
+			{
+				fprintf(out, " <%uus: %" PRIu64, 1 << i, waits[i]);
+			}
+			else
+			{
+				fprintf(out, " >=%uus: %" PRIu64, 1 << (i - 1), waits[i]);
+			}
+		}
+		fprintf(out, "\n");
+	}
+}
+
+/*
+ * Described in header
+ */
+void lock_profiler_print(FILE *out)
+{
+	enumerator_t *enumerator;
+	lock_profile_t *profile, **sorted = NULL;
+	int count = 0, i;
+
+	pthread_mutex_lock(&profiles_lock);
+	if (profiles)
+	{
+		sorted = calloc(profiles->get_count(profiles), sizeof(*sorted));
+		enumerator = profiles->create_enumerator(profiles);
+		while (enumerator->enumerate(enumerator, NULL, &profile))
+		{
+			if (profile->locked)
+			{
+				ref_get(&profile->refs);
+				sorted[count++] = profile;
+			}
+		}
+		enumerator->destroy(enumerator);
+	}
+	pthread_mutex_unlock(&profiles_lock);
+
+	fprintf(out, "Lock profiler %s, %d active lock name%s%s\n",
+			lock_profiler_enabled ? "enabled" : "disabled", count,
+			count == 1 ? "" : "s", count ? ":" : "");
+	if (count)
+	{
+		qsort(sorted, count, sizeof(*sorted), profile_cmp);
+		for (i = 0; i < count; i++)
+		{
+			print_profile(out, sorted[i]);
+			lock_profile_put(sorted[i]);
+		}
+	}
+	free(sorted);
+}
+
+/*
+ * Described in header
+ */
+void lock_profiler_init()
+{
+	lock_profiler_enable(lib->settings->get_bool(lib->settings,
+						"libstrongswan.lock_profiler", lock_profiler_enabled));
+}
+
+/*
+ * Described in header
+ */
+void lock_profiler_deinit()
+{
+	enumerator_t *enumerator;
+	lock_profile_t *profile;
+
+	pthread_mutex_lock(&profiles_lock);
+	if (profiles)
+	{
+		enumerator = profiles->create_enumerator(profiles);
+		while (enumerator->enumerate(enumerator, NULL, &profile))
+		{
+			lock_profile_put(profile);
+		}
+		enumerator->destroy(enumerator);
+		profiles->destroy(profiles);
+		profiles = NULL;
+	}
+	pthread_mutex_unlock(&profiles_lock);
+}
@@ -3,6 +3,8 @@
  * Copyright (C) 2008 Martin Willi
  * Hochschule fuer Technik Rapperswil
  *
+ * Copyright (C) 2013 revosec AG
+ *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms of the GNU General Public License as published by the
  * Free Software Foundation; either version 2 of the License, or (at your
@@ -14,89 +16,136 @@
  * for more details.
  */
 
+/**
+ * @defgroup lock_profiler lock_profiler
+ * @{ @ingroup threading
+ */
+
 #ifndef THREADING_LOCK_PROFILER_H_
 #define THREADING_LOCK_PROFILER_H_
 
-#ifdef LOCK_PROFILER
+#include <stdio.h>
+
+#include <utils/utils.h>
 
-#include <time.h>
+typedef struct lock_profile_t lock_profile_t;
 
 /**
- * Do not report mutexes with an overall waiting time smaller than this (in us)
+ * Number of buckets in the wait time histogram.
+ *
+ * Bucket 0 counts waits shorter than 1us, bucket i waits shorter than 2^i us,
+ * the last bucket collects all longer waits.
  */
-#define PROFILE_WAIT_TRESHHOLD 10000
+#define LOCK_PROFILE_BUCKETS 20
 
 /**
- * Do not report mutexes with an overall lock count smaller than this
+ * Runtime lock contention profiler.
+ *
+ * Locks created with a name (see mutex_create_named() and friends) share a
+ * profile with all other locks of the same name, e.g. all segments of the
+ * IKE_SA manager. While profiling is enabled, every acquisition of such a
+ * lock gets counted. Only contended acquisitions, where a try-lock fails,
+ * get timed and recorded in a wait time histogram. For exclusive locks the
+ * time the lock is held gets recorded, too. For condvars the time spent
+ * waiting for a signal gets recorded.
+ *
+ * Unnamed locks are never profiled and the overhead for named locks while
+ * profiling is disabled is a single branch.
  */
-#define PROFILE_LOCK_TRESHHOLD 1000
 
-#include <utils/backtrace.h>
+/**
+ * TRUE if profiling is currently enabled, use lock_profiler_enable() to change
+ */
+extern bool lock_profiler_enabled;
 
-typedef struct lock_profile_t lock_profile_t;
+/**
+ * Get a reference to the shared profile of locks with the given name.
+ *
+ * @param name			name of the lock, NULL for none
+ * @return				profile reference, NULL if name is NULL
+ */
+lock_profile_t *lock_profile_get(const char *name);
 
-struct lock_profile_t {
-	/**
-	 * how long threads have waited for the lock in this mutex so far
-	 */
-	timeval_t waited;
+/**
+ * Release a profile reference obtained with lock_profile_get().
+ *
+ * @param profile		profile, may be NULL
+ */
+void lock_profile_put(lock_profile_t *profile);
 
-	/**
-	 * How many times the lock has been invoked
-	 */
-	u_int locked;
+/**
+ * Get a monotonic timestamp to time a contended lock operation.
+ *
+ * @return				timestamp in ns
+ */
+u_int64_t lock_profile_time();
+
+/**
+ * Record an acquisition of a lock.
+ *
+ * @param profile		profile of the lock
+ * @param start			lock_profile_time() before blocking, 0 if uncontended
+ * @return				timestamp of the acquisition, for lock_profile_unlocked()
+ */
+u_int64_t lock_profile_locked(lock_profile_t *profile, u_int64_t start);
 
-	/**
-	 * backtrace where mutex has been created
-	 */
-	backtrace_t *backtrace;
-};
+/**
+ * Record the release of an exclusively held lock.
+ *
+ * @param profile		profile of the lock
+ * @param locked		timestamp returned by lock_profile_locked()
+ */
+void lock_profile_unlocked(lock_profile_t *profile, u_int64_t locked);
 
 /**
- * Print and cleanup mutex profiler
+ * Record the time spent waiting on a condvar.
+ *
+ * @param profile		profile of the condvar
+ * @param start			lock_profile_time() before starting to wait
  */
-static inline void profiler_cleanup(lock_profile_t *profile)
-{
-	if (profile->waited.tv_sec > 0 ||
-		profile->waited.tv_usec > PROFILE_WAIT_TRESHHOLD ||
-		profile->locked > PROFILE_LOCK_TRESHHOLD)
-	{
-		fprintf(stderr, "%d.%03ds / %d times in lock created at:",
-			profile->waited.tv_sec, profile->waited.tv_usec, profile->locked);
-		profile->backtrace->log(profile->backtrace, stderr, TRUE);
-	}
-	profile->backtrace->destroy(profile->backtrace);
-}
+void lock_profile_waited(lock_profile_t *profile, u_int64_t start);
 
 /**
- * Initialize mutex profiler
+ * Check if a lock with the given profile is currently profiled.
+ *
+ * @param profile		profile of the lock, NULL if unnamed
+ * @return				TRUE if lock operations should be recorded
  */
-static inline void profiler_init(lock_profile_t *profile)
+static inline bool lock_profile_active(lock_profile_t *profile)
 {
-	profile->backtrace = backtrace_create(2);
-	timerclear(&profile->waited);
-	profile->locked = 0;
+	return profile && lock_profiler_enabled;
 }
 
-#define profiler_start(profile) { \
-	struct timeval _start, _end, _diff; \
-	(profile)->locked++; \
-	time_monotonic(&_start);
-
-#define profiler_end(profile) \
-	time_monotonic(&_end); \
-	timersub(&_end, &_start, &_diff); \
-	timeradd(&(profile)->waited, &_diff, &(profile)->waited); }
+/**
+ * Enable or disable profiling of named locks.
+ *
+ * @param enable		TRUE to enable profiling
+ */
+void lock_profiler_enable(bool enable);
 
-#else /* !LOCK_PROFILER */
+/**
+ * Reset all collected statistics.
+ */
+void lock_profiler_reset();
 
-#define lock_profile_t struct {}
-#define profiler_cleanup(...) {}
-#define profiler_init(...) {}
-#define profiler_start(...) {}
-#define profiler_end(...) {}
+/**
+ * Print collected statistics, sorted by total wait time.
+ *
+ * @param out			stream to print to
+ */
+void lock_profiler_print(FILE *out);
 
-#endif /* LOCK_PROFILER */
+/**
+ * Initialize the lock profiler, enables it if configured.
+ */
+void lock_profiler_init();
 
-#endif /* THREADING_LOCK_PROFILER_H_ */
+/**
+ * Deinitialize the lock profiler.
+ *
+ * Profiles stay valid until the last lock using them gets destroyed, but
+ * are not reported anymore.
+ */
+void lock_profiler_deinit();
 
+#endif /** THREADING_LOCK_PROFILER_H_ @}*/
@@ -52,9 +52,14 @@ struct private_mutex_t {
 	bool recursive;
 
 	/**
-	 * profiling info, if enabled
+	 * profile, if named
 	 */
-	lock_profile_t profile;
+	lock_profile_t *profile;
+
+	/**
+	 * time the lock was acquired, if profiled
+	 */
+	u_int64_t acquired;
 };
 
 /**
@@ -93,21 +98,49 @@ struct private_condvar_t {
 	 */
 	pthread_cond_t condvar;
 
+	/**
+	 * profile, if named
+	 */
+	lock_profile_t *profile;
 };
 
 
 METHOD(mutex_t, lock, void,
 	private_mutex_t *this)
 {
+	u_int64_t start = 0;
 	int err;
 
-	profiler_start(&this->profile);
+	if (lock_profile_active(this->profile))
+	{
+		if (pthread_mutex_trylock(&this->mutex) == 0)
+		{
+			this->acquired = lock_profile_locked(this->profile, 0);
+			return;
+		}
+		start = lock_profile_time();
+	}
 	err = pthread_mutex_lock(&this->mutex);
 	if (err)
 	{
 		DBG1(DBG_LIB, "!!! MUTEX LOCK ERROR: %s !!!", strerror(err));
 	}
-	profiler_end(&this->profile);
+	if (start)
+	{
+		this->acquired = lock_profile_locked(this->profile, start);
+	}
+}
+
+/**
+ * Record the hold time of a profiled mutex we are about to release
+ */
+static inline void release_profile(private_mutex_t *this)
+{
+	if (this->acquired)
+	{
+		lock_profile_unlocked(this->profile, this->acquired);
+		this->acquired = 0;
+	}
 }
 
 METHOD(mutex_t, unlock, void,
@@ -115,6 +148,7 @@ METHOD(mutex_t, unlock, void,
 {
 	int err;
 
+	release_profile(this);
 	err = pthread_mutex_unlock(&this->mutex);
 	if (err)
 	{
@@ -152,7 +186,7 @@ METHOD(mutex_t, unlock_r, void,
 METHOD(mutex_t, mutex_destroy, void,
 	private_mutex_t *this)
 {
-	profiler_cleanup(&this->profile);
+	lock_profile_put(this->profile);
 	pthread_mutex_destroy(&this->mutex);
 	free(this);
 }
@@ -160,7 +194,7 @@ METHOD(mutex_t, mutex_destroy, void,
 METHOD(mutex_t, mutex_destroy_r, void,
 	private_r_mutex_t *this)
 {
-	profiler_cleanup(&this->generic.profile);
+	lock_profile_put(this->generic.profile);
 	pthread_mutex_destroy(&this->generic.mutex);
 	free(this);
 }
@@ -169,6 +203,14 @@ METHOD(mutex_t, mutex_destroy_r, void,
  * see header file
  */
 mutex_t *mutex_create(mutex_type_t type)
+{
+	return mutex_create_named(type, NULL);
+}
+
+/*
+ * see header file
+ */
+mutex_t *mutex_create_named(mutex_type_t type, const char *name)
 {
 	switch (type)
 	{
@@ -184,11 +226,11 @@ mutex_t *mutex_create(mutex_type_t type)
 						.destroy = _mutex_destroy_r,
 					},
 					.recursive = TRUE,
+					.profile = lock_profile_get(name),
 				},
 			);
 
 			pthread_mutex_init(&this->generic.mutex, NULL);
-			profiler_init(&this->generic.profile);
 
 			return &this->generic.public;
 		}
@@ -203,10 +245,10 @@ mutex_t *mutex_create(mutex_type_t type)
 					.unlock = _unlock,
 					.destroy = _mutex_destroy,
 				},
+				.profile = lock_profile_get(name),
 			);
 
 			pthread_mutex_init(&this->mutex, NULL);
-			profiler_init(&this->profile);
 
 			return &this->public;
 		}
@@ -214,9 +256,42 @@ mutex_t *mutex_create(mutex_type_t type)
 }
 
 
+/**
+ * Start waiting on a condvar, returns the start time if profiled
+ */
+static inline u_int64_t wait_start(private_condvar_t *this,
+								   private_mutex_t *mutex)
+{
+	release_profile(mutex);
+	if (lock_profile_active(this->profile))
+	{
+		return lock_profile_time();
+	}
+	return 0;
+}
+
+/**
+ * Woken up after waiting on a condvar, with the mutex held again
+ */
+static inline void wait_end(private_condvar_t *this, private_mutex_t *mutex,
+							u_int64_t start)
+{
+	if (start)
+	{
+		lock_profile_waited(this->profile, start);
+	}
+	if (lock_profile_active(mutex->profile))
+	{
+		mutex->acquired = lock_profile_time();
+	}
+}
+
 METHOD(condvar_t, wait_, void,
 	private_condvar_t *this, private_mutex_t *mutex)
 {
+	u_int64_t start;
+
+	start = wait_start(this, mutex);
 	if (mutex->recursive)
 	{
 		private_r_mutex_t* recursive = (private_r_mutex_t*)mutex;
@@ -234,6 +309,7 @@ METHOD(condvar_t, wait_, void,
 	{
 		pthread_cond_wait(&this->condvar, &mutex->mutex);
 	}
+	wait_end(this, mutex, start);
 }
 
 /* use the monotonic clock based version of this function if available */
@@ -245,11 +321,13 @@ METHOD(condvar_t, timed_wait_abs, bool,
 	private_condvar_t *this, private_mutex_t *mutex, timeval_t time)
 {
 	struct timespec ts;
+	u_int64_t start;
 	bool timed_out;
 
 	ts.tv_sec = time.tv_sec;
 	ts.tv_nsec = time.tv_usec * 1000;
 
+	start = wait_start(this, mutex);
 	if (mutex->recursive)
 	{
 		private_r_mutex_t* recursive = (private_r_mutex_t*)mutex;
@@ -267,6 +345,7 @@ METHOD(condvar_t, timed_wait_abs, bool,
 		timed_out = pthread_cond_timedwait(&this->condvar, &mutex->mutex,
 										   &ts) == ETIMEDOUT;
 	}
+	wait_end(this, mutex, start);
 	return timed_out;
 }
 
@@ -302,6 +381,7 @@ METHOD(condvar_t, condvar_destroy, void,
 	private_condvar_t *this)
 {
 	pthread_cond_destroy(&this->condvar);
+	lock_profile_put(this->profile);
 	free(this);
 }
 
@@ -309,6 +389,14 @@ METHOD(condvar_t, condvar_destroy, void,
  * see header file
  */
 condvar_t *condvar_create(condvar_type_t type)
+{
+	return condvar_create_named(type, NULL);
+}
+
+/*
+ * see header file
+ */
+condvar_t *condvar_create_named(condvar_type_t type, const char *name)
 {
 	switch (type)
 	{
@@ -325,7 +413,8 @@ condvar_t *condvar_create(condvar_type_t type)
 					.signal = _signal_,
 					.broadcast = _broadcast,
 					.destroy = _condvar_destroy,
-				}
+				},
+				.profile = lock_profile_get(name),
 			);
 
 #ifdef HAVE_PTHREAD_CONDATTR_INIT
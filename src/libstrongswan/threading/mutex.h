@@ -64,5 +64,14 @@ struct mutex_t {
  */
 mutex_t *mutex_create(mutex_type_t type);
 
+/**
+ * Create a named mutex instance, profiled by the lock profiler.
+ *
+ * @param type		type of mutex to create
+ * @param name		name shared by all mutexes of this kind, NULL for none
+ * @return			unlocked mutex instance
+ */
+mutex_t *mutex_create_named(mutex_type_t type, const char *name);
+
 #endif /** THREADING_MUTEX_H_ @} */
 
@@ -89,9 +89,14 @@ struct private_rwlock_t {
 #endif /* HAVE_PTHREAD_RWLOCK_INIT */
 
 	/**
-	 * profiling info, if enabled
+	 * profile, if named
 	 */
-	lock_profile_t profile;
+	lock_profile_t *profile;
+
+	/**
+	 * time the write lock was acquired, if profiled
+	 */
+	u_int64_t acquired;
 };
 
 /**
@@ -121,35 +126,67 @@ struct private_rwlock_condvar_t {
 METHOD(rwlock_t, read_lock, void,
 	private_rwlock_t *this)
 {
+	u_int64_t start = 0;
 	int err;
 
-	profiler_start(&this->profile);
+	if (lock_profile_active(this->profile))
+	{
+		if (pthread_rwlock_tryrdlock(&this->rwlock) == 0)
+		{
+			lock_profile_locked(this->profile, 0);
+			return;
+		}
+		start = lock_profile_time();
+	}
 	err = pthread_rwlock_rdlock(&this->rwlock);
 	if (err != 0)
 	{
 		DBG1(DBG_LIB, "!!! RWLOCK READ LOCK ERROR: %s !!!", strerror(err));
 	}
-	profiler_end(&this->profile);
+	if (start)
+	{
+		lock_profile_locked(this->profile, start);
+	}
 }
 
 METHOD(rwlock_t, write_lock, void,
 	private_rwlock_t *this)
 {
+	u_int64_t start = 0;
 	int err;
 
-	profiler_start(&this->profile);
+	if (lock_profile_active(this->profile))
+	{
+		if (pthread_rwlock_trywrlock(&this->rwlock) == 0)
+		{
+			this->acquired = lock_profile_locked(this->profile, 0);
+			return;
+		}
+		start = lock_profile_time();
+	}
 	err = pthread_rwlock_wrlock(&this->rwlock);
 	if (err != 0)
 	{
 		DBG1(DBG_LIB, "!!! RWLOCK WRITE LOCK ERROR: %s !!!", strerror(err));
 	}
-	profiler_end(&this->profile);
+	if (start)
+	{
+		this->acquired = lock_profile_locked(this->profile, start);
+	}
 }
 
 METHOD(rwlock_t, try_write_lock, bool,
 	private_rwlock_t *this)
 {
-	return pthread_rwlock_trywrlock(&this->rwlock) == 0;
+	if (pthread_rwlock_trywrlock(&this->rwlock) == 0)
+	{
+		if (lock_profile_active(this->profile))
+		{
+			this->acquired = lock_profile_locked(this->profile, 0);
+		}
+		return TRUE;
+	}
+	return FALSE;
 }
 
 METHOD(rwlock_t, unlock, void,
@@ -157,6 +194,11 @@ METHOD(rwlock_t, unlock, void,
 {
 	int err;
 
+	if (this->acquired)
+	{	/* only set by writers, which hold the lock exclusively */
+		lock_profile_unlocked(this->profile, this->acquired);
+		this->acquired = 0;
+	}
 	err = pthread_rwlock_unlock(&this->rwlock);
 	if (err != 0)
 	{
@@ -168,7 +210,7 @@ METHOD(rwlock_t, destroy, void,
 	private_rwlock_t *this)
 {
 	pthread_rwlock_destroy(&this->rwlock);
-	profiler_cleanup(&this->profile);
+	lock_profile_put(this->profile);
 	free(this);
 }
 
@@ -176,6 +218,14 @@ METHOD(rwlock_t, destroy, void,
  * see header file
  */
 rwlock_t *rwlock_create(rwlock_type_t type)
+{
+	return rwlock_create_named(type, NULL);
+}
+
+/*
+ * see header file
+ */
+rwlock_t *rwlock_create_named(rwlock_type_t type, const char *name)
 {
 	switch (type)
 	{
@@ -191,11 +241,11 @@ rwlock_t *rwlock_create(rwlock_type_t type)
 					.try_write_lock = _try_write_lock,
 					.unlock = _unlock,
 					.destroy = _destroy,
-				}
+				},
+				.profile = lock_profile_get(name),
 			);
 
 			pthread_rwlock_init(&this->rwlock, NULL);
-			profiler_init(&this->profile);
 
 			return &this->public;
 		}
@@ -260,11 +310,11 @@ static void initialize_is_reader()
 METHOD(rwlock_t, read_lock, void,
 	private_rwlock_t *this)
 {
+	u_int64_t start = 0;
 	uintptr_t reading;
 	bool old;
 
 	reading = (uintptr_t)pthread_getspecific(is_reader);
-	profiler_start(&this->profile);
 	this->mutex->lock(this->mutex);
 	if (!this->writer && reading > 0)
 	{
@@ -276,12 +326,19 @@ METHOD(rwlock_t, read_lock, void,
 		old = thread_cancelability(FALSE);
 		while (this->writer || this->waiting_writers)
 		{
+			if (!start && lock_profile_active(this->profile))
+			{
+				start = lock_profile_time();
+			}
 			this->readers->wait(this->readers, this->mutex);
 		}
 		thread_cancelability(old);
 	}
 	this->reader_count++;
-	profiler_end(&this->profile);
+	if (lock_profile_active(this->profile))
+	{
+		lock_profile_locked(this->profile, start);
+	}
 	this->mutex->unlock(this->mutex);
 	pthread_setspecific(is_reader, (void*)(reading + 1));
 }
@@ -289,20 +346,27 @@ METHOD(rwlock_t, read_lock, void,
 METHOD(rwlock_t, write_lock, void,
 	private_rwlock_t *this)
 {
+	u_int64_t start = 0;
 	bool old;
 
-	profiler_start(&this->profile);
 	this->mutex->lock(this->mutex);
 	this->waiting_writers++;
 	old = thread_cancelability(FALSE);
 	while (this->writer || this->reader_count)
 	{
+		if (!start && lock_profile_active(this->profile))
+		{
+			start = lock_profile_time();
+		}
 		this->writers->wait(this->writers, this->mutex);
 	}
 	thread_cancelability(old);
 	this->waiting_writers--;
 	this->writer = TRUE;
-	profiler_end(&this->profile);
+	if (lock_profile_active(this->profile))
+	{
+		this->acquired = lock_profile_locked(this->profile, start);
+	}
 	this->mutex->unlock(this->mutex);
 }
 
@@ -314,6 +378,10 @@ METHOD(rwlock_t, try_write_lock, bool,
 	if (!this->writer && !this->reader_count)
 	{
 		res = this->writer = TRUE;
+		if (lock_profile_active(this->profile))
+		{
+			this->acquired = lock_profile_locked(this->profile, 0);
+		}
 	}
 	this->mutex->unlock(this->mutex);
 	return res;
@@ -326,6 +394,11 @@ METHOD(rwlock_t, unlock, void,
 	if (this->writer)
 	{
 		this->writer = FALSE;
+		if (this->acquired)
+		{
+			lock_profile_unlocked(this->profile, this->acquired);
+			this->acquired = 0;
+		}
 	}
 	else
 	{
@@ -355,7 +428,7 @@ METHOD(rwlock_t, destroy, void,
 	this->mutex->destroy(this->mutex);
 	this->writers->destroy(this->writers);
 	this->readers->destroy(this->readers);
-	profiler_cleanup(&this->profile);
+	lock_profile_put(this->profile);
 	free(this);
 }
 
@@ -363,6 +436,14 @@ METHOD(rwlock_t, destroy, void,
  * see header file
  */
 rwlock_t *rwlock_create(rwlock_type_t type)
+{
+	return rwlock_create_named(type, NULL);
+}
+
+/*
+ * see header file
+ */
+rwlock_t *rwlock_create_named(rwlock_type_t type, const char *name)
 {
 	pthread_once(&is_reader_initialized,  initialize_is_reader);
 
@@ -384,10 +465,9 @@ rwlock_t *rwlock_create(rwlock_type_t type)
 				.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 				.writers = condvar_create(CONDVAR_TYPE_DEFAULT),
 				.readers = condvar_create(CONDVAR_TYPE_DEFAULT),
+				.profile = lock_profile_get(name),
 			);
 
-			profiler_init(&this->profile);
-
 			return &this->public;
 		}
 	}
@@ -76,5 +76,14 @@ struct rwlock_t {
  */
 rwlock_t *rwlock_create(rwlock_type_t type);
 
+/**
+ * Create a named read-write lock instance, profiled by the lock profiler.
+ *
+ * @param type		type of rwlock to create
+ * @param name		name shared by all rwlocks of this kind, NULL for none
+ * @return			unlocked rwlock instance
+ */
+rwlock_t *rwlock_create_named(rwlock_type_t type, const char *name);
+
 #endif /** THREADING_RWLOCK_H_ @} */
 
@@ -42,9 +42,14 @@ struct private_spinlock_t {
 	pthread_spinlock_t spinlock;
 
 	/**
-	 * profiling info, if enabled (the mutex below does profile itself)
+	 * profile, if named (the mutex below does profile itself)
 	 */
-	lock_profile_t profile;
+	lock_profile_t *profile;
+
+	/**
+	 * time the lock was acquired, if profiled
+	 */
+	u_int64_t acquired;
 
 #else /* HAVE_PTHREAD_SPIN_INIT */
 
@@ -60,15 +65,27 @@ METHOD(spinlock_t, lock, void,
 	private_spinlock_t *this)
 {
 #ifdef HAVE_PTHREAD_SPIN_INIT
+	u_int64_t start = 0;
 	int err;
 
-	profiler_start(&this->profile);
+	if (lock_profile_active(this->profile))
+	{
+		if (pthread_spin_trylock(&this->spinlock) == 0)
+		{
+			this->acquired = lock_profile_locked(this->profile, 0);
+			return;
+		}
+		start = lock_profile_time();
+	}
 	err = pthread_spin_lock(&this->spinlock);
 	if (err)
 	{
 		DBG1(DBG_LIB, "!!! SPIN LOCK LOCK ERROR: %s !!!", strerror(err));
 	}
-	profiler_end(&this->profile);
+	if (start)
+	{
+		this->acquired = lock_profile_locked(this->profile, start);
+	}
 #else
 	this->mutex->lock(this->mutex);
 #endif
@@ -80,6 +97,11 @@ METHOD(spinlock_t, unlock, void,
 #ifdef HAVE_PTHREAD_SPIN_INIT
 	int err;
 
+	if (this->acquired)
+	{
+		lock_profile_unlocked(this->profile, this->acquired);
+		this->acquired = 0;
+	}
 	err = pthread_spin_unlock(&this->spinlock);
 	if (err)
 	{
@@ -94,7 +116,7 @@ METHOD(spinlock_t, destroy, void,
 	private_spinlock_t *this)
 {
 #ifdef HAVE_PTHREAD_SPIN_INIT
-	profiler_cleanup(&this->profile);
+	lock_profile_put(this->profile);
 	pthread_spin_destroy(&this->spinlock);
 #else
 	this->mutex->destroy(this->mutex);
@@ -106,6 +128,14 @@ METHOD(spinlock_t, destroy, void,
  * Described in header
  */
 spinlock_t *spinlock_create()
+{
+	return spinlock_create_named(NULL);
+}
+
+/*
+ * Described in header
+ */
+spinlock_t *spinlock_create_named(const char *name)
 {
 	private_spinlock_t *this;
 
@@ -119,9 +149,9 @@ spinlock_t *spinlock_create()
 
 #ifdef HAVE_PTHREAD_SPIN_INIT
 	pthread_spin_init(&this->spinlock, PTHREAD_PROCESS_PRIVATE);
-	profiler_init(&this->profile);
+	this->profile = lock_profile_get(name);
 #else
-	this->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	this->mutex = mutex_create_named(MUTEX_TYPE_DEFAULT, name);
 #endif
 
 	return &this->public;
@@ -54,5 +54,13 @@ struct spinlock_t {
  */
 spinlock_t *spinlock_create();
 
+/**
+ * Create a named spin lock instance, profiled by the lock profiler.
+ *
+ * @param name		name shared by all spin locks of this kind, NULL for none
+ * @return			unlocked instance
+ */
+spinlock_t *spinlock_create_named(const char *name);
+
 #endif /** THREADING_SPINLOCK_H_ @} */
 
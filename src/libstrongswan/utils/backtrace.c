@@ -600,29 +600,62 @@ static backtrace_t get_methods()
 }
 
 /**
- * See header
+ * Capture the frames of the current stack, including the caller
  */
-backtrace_t *backtrace_create(int skip)
+static inline int get_frames(void **frames, int count)
 {
-	private_backtrace_t *this;
-	void *frames[50];
-	int frame_count = 0;
-
 #ifdef HAVE_LIBUNWIND_H
-	frame_count = backtrace_unwind(frames, countof(frames));
+	return backtrace_unwind(frames, count);
 #elif defined(HAVE_BACKTRACE)
-	frame_count = backtrace(frames, countof(frames));
-#endif /* HAVE_BACKTRACE */
+	return backtrace(frames, count);
+#else /* !HAVE_BACKTRACE && !HAVE_LIBUNWIND_H */
+	return 0;
+#endif /* HAVE_BACKTRACE/HAVE_LIBUNWIND_H */
+}
+
+/**
+ * See header
+ */
+int backtrace_capture(void **frames, int count, int skip)
+{
+	void *all[64];
+	int frame_count;
+
+	frame_count = get_frames(all, min(count + skip, countof(all)));
 	frame_count = max(frame_count - skip, 0);
-	this = malloc(sizeof(private_backtrace_t) + frame_count * sizeof(void*));
-	memcpy(this->frames, frames + skip, frame_count * sizeof(void*));
-	this->frame_count = frame_count;
+	memcpy(frames, all + skip, frame_count * sizeof(void*));
+	return frame_count;
+}
+
+/**
+ * See header
+ */
+backtrace_t *backtrace_create_from_frames(void **frames, int count)
+{
+	private_backtrace_t *this;
+
+	this = malloc(sizeof(private_backtrace_t) + count * sizeof(void*));
+	memcpy(this->frames, frames, count * sizeof(void*));
+	this->frame_count = count;
 
 	this->public = get_methods();
 
 	return &this->public;
 }
 
+/**
+ * See header
+ */
+backtrace_t *backtrace_create(int skip)
+{
+	void *frames[50];
+	int frame_count;
+
+	frame_count = get_frames(frames, countof(frames));
+	frame_count = max(frame_count - skip, 0);
+	return backtrace_create_from_frames(frames + skip, frame_count);
+}
+
 /**
  * See header
  */
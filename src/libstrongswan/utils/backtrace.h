@@ -88,6 +88,28 @@ struct backtrace_t {
  */
 backtrace_t *backtrace_create(int skip);
 
+/**
+ * Create a backtrace from previously captured stack frames.
+ *
+ * @param frames	stack frame addresses, as returned by backtrace_capture()
+ * @param count		number of frames
+ * @return			backtrace
+ */
+backtrace_t *backtrace_create_from_frames(void **frames, int count);
+
+/**
+ * Capture the frames of the current stack into a buffer.
+ *
+ * Other than backtrace_create() this does not allocate any memory, which
+ * makes it usable from within memory allocation hooks.
+ *
+ * @param frames	buffer receiving stack frame addresses
+ * @param count		maximum number of frames to capture
+ * @param skip		how many of the innerst frames to skip
+ * @return			number of captured frames
+ */
+int backtrace_capture(void **frames, int count, int skip);
+
 /**
  * Create a backtrace, dump it and clean it up.
  *
@@ -0,0 +1,641 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <dlfcn.h>
+
+#include "heap_profiler.h"
+
+#include <library.h>
+#include <utils/backtrace.h>
+#include <threading/thread_value.h>
+#include <threading/spinlock.h>
+
+#ifndef HAVE_GCC_ATOMIC_OPERATIONS
+#error the heap profiler requires GCC atomic operations
+#endif
+
+/**
+ * Maximum number of frames recorded for a call site
+ */
+#define MAX_FRAMES 16
+
+/**
+ * Number of call sites we can track, must be a power of two
+ */
+#define MAX_SITES 4096
+
+/**
+ * Number of sampled allocations we can track concurrently
+ */
+#define MAX_SAMPLES 65536
+
+/**
+ * Number of hash buckets for sampled allocations, must be a power of two
+ */
+#define SAMPLE_BUCKETS 16384
+
+/**
+ * Number of counters in the filter for sampled addresses, a power of two
+ */
+#define FILTER_SIZE (1 << 18)
+
+typedef struct private_heap_profiler_t private_heap_profiler_t;
+
+/**
+ * Private data of heap_profiler
+ */
+struct private_heap_profiler_t {
+
+	/**
+	 * Public functions
+	 */
+	heap_profiler_t public;
+};
+
+/**
+ * Statistics of a call site, identified by its backtrace.
+ *
+ * Call sites are stored in an open addressing hash table. A slot is claimed
+ * by atomically setting its hash, and gets usable as soon as ready is set
+ * after writing the frames. Call sites are never removed, so no locking is
+ * required to find or update them.
+ */
+typedef struct {
+	/** hash of the frames, 0 if slot unused */
+	u_int hash;
+	/** TRUE as soon as the frames are written */
+	bool ready;
+	/** number of frames */
+	int frame_count;
+	/** backtrace of the call site */
+	void *frames[MAX_FRAMES];
+	/** estimated number of allocations */
+	int64_t allocs;
+	/** estimated number of bytes allocated */
+	int64_t bytes;
+	/** estimated number of allocations not yet freed */
+	int64_t live_allocs;
+	/** estimated number of bytes not yet freed */
+	int64_t live_bytes;
+} site_t;
+
+/**
+ * A sampled allocation
+ */
+typedef struct {
+	/** allocated memory */
+	void *ptr;
+	/** call site that allocated it */
+	site_t *site;
+	/** estimated number of allocations this sample represents */
+	int64_t allocs;
+	/** estimated number of bytes this sample represents */
+	int64_t bytes;
+	/** index + 1 of next sample in bucket or free list, 0 for none */
+	u_int next;
+} sample_t;
+
+/**
+ * Is the heap profiler hooked and active?
+ */
+static bool enabled = FALSE;
+
+/**
+ * Average number of bytes allocated between two samples
+ */
+static u_int interval = HEAP_PROFILER_INTERVAL;
+
+/**
+ * Bytes left until a thread takes the next sample, as uintptr_t
+ */
+static thread_value_t *thread_left;
+
+/**
+ * Hash table of call sites
+ */
+static site_t sites[MAX_SITES];
+
+/**
+ * Sampled allocations, linked in buckets or in the free list
+ */
+static sample_t samples[MAX_SAMPLES];
+
+/**
+ * Hash buckets of sampled allocations, index + 1 into samples
+ */
+static u_int buckets[SAMPLE_BUCKETS];
+
+/**
+ * Free list of samples, index + 1 into samples
+ */
+static u_int free_samples;
+
+/**
+ * Number of samples used so far, free ones are either in the free list or
+ * above this index
+ */
+static u_int used_samples;
+
+/**
+ * Number of sampled allocations per filter slot. Frees check this filter
+ * without locking, only if it is set the sample buckets get searched.
+ */
+static u_int16_t filter[FILTER_SIZE];
+
+/**
+ * Lock for buckets, free list and filter
+ */
+static spinlock_t *lock;
+
+/**
+ * Number of samples we were unable to record
+ */
+static u_int dropped;
+
+/**
+ * dlsym() might do a malloc(), but we can't do one before we get the malloc()
+ * function pointer. Use this minimalistic malloc implementation instead.
+ */
+static void* malloc_for_dlsym(size_t size)
+{
+	static char buf[1024] = {};
+	static size_t used = 0;
+	char *ptr;
+
+	/* roundup to a multiple of 32 */
+	size = (size - 1) / 32 * 32 + 32;
+
+	if (used + size > sizeof(buf))
+	{
+		return NULL;
+	}
+	ptr = buf + used;
+	used += size;
+	return ptr;
+}
+
+/**
+ * Call original malloc()
+ */
+static void* real_malloc(size_t size)
+{
+	static void* (*fn)(size_t size);
+	static int recursive = 0;
+
+	if (!fn)
+	{
+		/* as in leak detective, we expect the first allocation to happen
+		 * before we go multi-threaded */
+		if (recursive)
+		{
+			return malloc_for_dlsym(size);
+		}
+		recursive++;
+		fn = dlsym(RTLD_NEXT, "malloc");
+		recursive--;
+	}
+	return fn(size);
+}
+
+/**
+ * Call original free()
+ */
+static void real_free(void *ptr)
+{
+	static void (*fn)(void *ptr);
+
+	if (!fn)
+	{
+		fn = dlsym(RTLD_NEXT, "free");
+	}
+	return fn(ptr);
+}
+
+/**
+ * Call original realloc()
+ */
+static void* real_realloc(void *ptr, size_t size)
+{
+	static void* (*fn)(void *ptr, size_t size);
+
+	if (!fn)
+	{
+		fn = dlsym(RTLD_NEXT, "realloc");
+	}
+	return fn(ptr, size);
+}
+
+/**
+ * Get the number of bytes to allocate until the next sample is taken,
+ * randomized to avoid aliasing with periodic allocation patterns
+ */
+static u_int next_interval()
+{
+	static u_int32_t state = 2463534242U;
+	u_int32_t x;
+
+	/* xorshift, concurrent updates just add to the randomness */
+	x = state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	state = x;
+
+	return interval / 2 + x % interval + 1;
+}
+
+/**
+ * Hash a backtrace
+ */
+static u_int hash_frames(void **frames, int count)
+{
+	u_int hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		hash = (hash ^ (uintptr_t)frames[i]) * 16777619U;
+	}
+	return hash ? hash : 1;
+}
+
+/**
+ * Find or create the call site for a backtrace, lock-free
+ */
+static site_t* get_site(void **frames, int count)
+{
+	site_t *site;
+	u_int hash, i;
+
+	hash = hash_frames(frames, count);
+	for (i = 0; i < MAX_SITES; i++)
+	{
+		site = &sites[(hash + i) & (MAX_SITES - 1)];
+		if (!site->hash &&
+			__sync_bool_compare_and_swap(&site->hash, 0, hash))
+		{
+			memcpy(site->frames, frames, count * sizeof(void*));
+			site->frame_count = count;
+			__sync_synchronize();
+			site->ready = TRUE;
+			return site;
+		}
+		if (site->hash == hash)
+		{
+			while (!*(volatile bool*)&site->ready)
+			{
+				/* claimed concurrently, frames get written right now */
+			}
+			if (site->frame_count == count &&
+				memeq(site->frames, frames, count * sizeof(void*)))
+			{
+				return site;
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Get the filter slot, and bucket, of an address
+ */
+static inline u_int hash_ptr(void *ptr)
+{
+	uintptr_t val = (uintptr_t)ptr;
+
+	return (val >> 4) ^ (val >> 22);
+}
+
+/**
+ * Register a sampled allocation
+ */
+static bool add_sample(void *ptr, site_t *site, int64_t allocs, int64_t bytes)
+{
+	sample_t *sample;
+	u_int hash, index;
+
+	hash = hash_ptr(ptr);
+	lock->lock(lock);
+	if (filter[hash & (FILTER_SIZE - 1)] == (u_int16_t)~0)
+	{
+		lock->unlock(lock);
+		return FALSE;
+	}
+	if (free_samples)
+	{
+		index = free_samples;
+		free_samples = samples[index - 1].next;
+	}
+	else if (used_samples < MAX_SAMPLES)
+	{
+		index = ++used_samples;
+	}
+	else
+	{
+		lock->unlock(lock);
+		return FALSE;
+	}
+	sample = &samples[index - 1];
+	*sample = (sample_t) {
+		.ptr = ptr,
+		.site = site,
+		.allocs = allocs,
+		.bytes = bytes,
+		.next = buckets[hash & (SAMPLE_BUCKETS - 1)],
+	};
+	buckets[hash & (SAMPLE_BUCKETS - 1)] = index;
+	filter[hash & (FILTER_SIZE - 1)]++;
+	lock->unlock(lock);
+	return TRUE;
+}
+
+/**
+ * Record a sample for an allocation
+ */
+static void __attribute__((noinline)) record(void *ptr, size_t size)
+{
+	void *frames[MAX_FRAMES];
+	site_t *site;
+	int64_t allocs, bytes;
+	int count;
+
+	/* skip backtrace_capture(), record() and the hook */
+	count = backtrace_capture(frames, countof(frames), 3);
+	site = get_site(frames, count);
+	/* an allocation of size s is sampled with a probability of s/interval,
+	 * unless it is larger than the interval */
+	bytes = max(size, interval);
+	allocs = bytes / max(size, 1);
+	if (!site || !add_sample(ptr, site, allocs, bytes))
+	{
+		__sync_add_and_fetch(&dropped, 1);
+		return;
+	}
+	__sync_add_and_fetch(&site->allocs, allocs);
+	__sync_add_and_fetch(&site->bytes, bytes);
+	__sync_add_and_fetch(&site->live_allocs, allocs);
+	__sync_add_and_fetch(&site->live_bytes, bytes);
+}
+
+/**
+ * Account an allocation, sample it if the thread allocated enough bytes
+ */
+static inline __attribute__((always_inline)) void allocated(void *ptr,
+																size_t size)
+{
+	uintptr_t left;
+
+	left = (uintptr_t)thread_left->get(thread_left);
+	if (!left)
+	{	/* first allocation of this thread */
+		left = next_interval();
+	}
+	if (left > size)
+	{
+		thread_left->set(thread_left, (void*)(left - size));
+		return;
+	}
+	thread_left->set(thread_left, (void*)(uintptr_t)next_interval());
+	record(ptr, size);
+}
+
+/**
+ * Remove the sample of an allocation, if any
+ */
+static inline void released(void *ptr)
+{
+	sample_t *sample = NULL;
+	u_int hash, *index;
+
+	hash = hash_ptr(ptr);
+	if (!filter[hash & (FILTER_SIZE - 1)])
+	{
+		return;
+	}
+	lock->lock(lock);
+	index = &buckets[hash & (SAMPLE_BUCKETS - 1)];
+	while (*index)
+	{
+		if (samples[*index - 1].ptr == ptr)
+		{
+			sample = &samples[*index - 1];
+			*index = sample->next;
+			sample->next = free_samples;
+			free_samples = sample - samples + 1;
+			filter[hash & (FILTER_SIZE - 1)]--;
+			break;
+		}
+		index = &samples[*index - 1].next;
+	}
+	if (sample)
+	{
+		__sync_sub_and_fetch(&sample->site->live_allocs, sample->allocs);
+		__sync_sub_and_fetch(&sample->site->live_bytes, sample->bytes);
+	}
+	lock->unlock(lock);
+}
+
+/**
+ * Hooked malloc() function
+ */
+void *malloc(size_t bytes)
+{
+	void *ptr;
+
+	ptr = real_malloc(bytes);
+	if (ptr && enabled)
+	{
+		allocated(ptr, bytes);
+	}
+	return ptr;
+}
+
+/**
+ * Hooked calloc() function, based on real_malloc() as dlsym() uses calloc()
+ */
+void *calloc(size_t nmemb, size_t size)
+{
+	void *ptr;
+
+	if (size && nmemb > SIZE_MAX / size)
+	{
+		return NULL;
+	}
+	size *= nmemb;
+	/* don't call malloc(), the compiler might turn it into calloc() */
+	ptr = real_malloc(size);
+	if (ptr)
+	{
+		memset(ptr, 0, size);
+		if (enabled)
+		{
+			allocated(ptr, size);
+		}
+	}
+	return ptr;
+}
+
+/**
+ * Hooked free() function
+ */
+void free(void *ptr)
+{
+	if (ptr && enabled)
+	{
+		released(ptr);
+	}
+	real_free(ptr);
+}
+
+/**
+ * Hooked realloc() function
+ */
+void *realloc(void *old, size_t bytes)
+{
+	void *ptr;
+
+	if (old && enabled)
+	{	/* the sample is dropped even if realloc() fails, which is rare */
+		released(old);
+	}
+	ptr = real_realloc(old, bytes);
+	if (ptr && enabled)
+	{
+		allocated(ptr, bytes);
+	}
+	return ptr;
+}
+
+/**
+ * Snapshot of call site statistics to print
+ */
+typedef struct {
+	/** call site */
+	site_t *site;
+	/** copied statistics */
+	int64_t allocs, bytes, live_allocs, live_bytes;
+} entry_t;
+
+/**
+ * Sort entries by live bytes, descending
+ */
+static int entry_cmp(const void *a, const void *b)
+{
+	const entry_t *ea = a, *eb = b;
+
+	if (ea->live_bytes == eb->live_bytes)
+	{
+		return 0;
+	}
+	return ea->live_bytes < eb->live_bytes ? 1 : -1;
+}
+
+METHOD(heap_profiler_t, print, void,
+	private_heap_profiler_t *this, FILE *out, bool detailed)
+{
+	backtrace_t *backtrace;
+	entry_t *entries;
+	int64_t live_allocs = 0, live_bytes = 0;
+	int i, count = 0;
+
+	entries = malloc(sizeof(entry_t) * MAX_SITES);
+	for (i = 0; i < MAX_SITES; i++)
+	{
+		if (sites[i].ready && sites[i].live_bytes > 0)
+		{
+			entries[count++] = (entry_t) {
+				.site = &sites[i],
+				.allocs = sites[i].allocs,
+				.bytes = sites[i].bytes,
+				.live_allocs = sites[i].live_allocs,
+				.live_bytes = sites[i].live_bytes,
+			};
+		}
+	}
+	qsort(entries, count, sizeof(entry_t), entry_cmp);
+
+	fprintf(out, "Heap profile, sampling every %u bytes:\n", interval);
+	for (i = 0; i < count; i++)
+	{
+		fprintf(out, "%" PRId64 " bytes in %" PRId64 " allocations live, "
+				"%" PRId64 " bytes in %" PRId64 " allocations total:\n",
+				entries[i].live_bytes, entries[i].live_allocs,
+				entries[i].bytes, entries[i].allocs);
+		backtrace = backtrace_create_from_frames(entries[i].site->frames,
+												 entries[i].site->frame_count);
+		backtrace->log(backtrace, out, detailed);
+		backtrace->destroy(backtrace);
+		live_allocs += entries[i].live_allocs;
+		live_bytes += entries[i].live_bytes;
+	}
+	fprintf(out, "Estimated heap usage: %" PRId64 " bytes in %" PRId64
+			" allocations from %d call sites, %u samples dropped\n",
+			live_bytes, live_allocs, count, dropped);
+	free(entries);
+}
+
+METHOD(heap_profiler_t, set_interval, void,
+	private_heap_profiler_t *this, u_int bytes)
+{
+	interval = max(bytes, 1);
+}
+
+METHOD(heap_profiler_t, destroy, void,
+	private_heap_profiler_t *this)
+{
+	enabled = FALSE;
+	memset(sites, 0, sizeof(sites));
+	memset(buckets, 0, sizeof(buckets));
+	memset(filter, 0, sizeof(filter));
+	free_samples = used_samples = dropped = 0;
+	lock->destroy(lock);
+	thread_left->destroy(thread_left);
+	free(this);
+}
+
+/*
+ * see header file
+ */
+heap_profiler_t *heap_profiler_create()
+{
+	private_heap_profiler_t *this;
+	void *frames[1];
+
+	INIT(this,
+		.public = {
+			.print = _print,
+			.set_interval = _set_interval,
+			.destroy = _destroy,
+		},
+	);
+
+	lock = spinlock_create();
+	thread_left = thread_value_create(NULL);
+
+	if (getenv("HEAP_PROFILER_DISABLE") == NULL)
+	{
+		/* resolve the hooked functions and make sure backtrace() is loaded
+		 * before it gets used from within a hook */
+		real_free(real_realloc(real_malloc(8), 16));
+		backtrace_capture(frames, countof(frames), 0);
+		enabled = TRUE;
+	}
+	return &this->public;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup heap_profiler heap_profiler
+ * @{ @ingroup utils
+ */
+
+#ifndef HEAP_PROFILER_H_
+#define HEAP_PROFILER_H_
+
+typedef struct heap_profiler_t heap_profiler_t;
+
+#include <library.h>
+
+/**
+ * Default number of bytes allocated between two samples
+ */
+#define HEAP_PROFILER_INTERVAL (512 * 1024)
+
+/**
+ * Sampling heap profiler using malloc hooks.
+ *
+ * Other than leak detective, the heap profiler does not track every
+ * allocation. Instead, it records the backtrace of an allocation about every
+ * interval bytes allocated by a thread, and extrapolates the number of
+ * allocations and bytes allocated by each call site from these samples.
+ * Allocations not sampled cost a thread-local counter update, frees of them
+ * a single lookup in a filter table. This makes it cheap enough to run on
+ * production systems.
+ */
+struct heap_profiler_t {
+
+	/**
+	 * Print a heap profile of the call sites with live allocations.
+	 *
+	 * Call sites are sorted by the estimated number of live bytes they
+	 * allocated.
+	 *
+	 * @param out			stream to print profile to
+	 * @param detailed		TRUE to resolve line/filename of call sites (slow)
+	 */
+	void (*print)(heap_profiler_t *this, FILE *out, bool detailed);
+
+	/**
+	 * Change the average number of bytes allocated between two samples.
+	 *
+	 * Estimates of allocations sampled with a different interval are not
+	 * affected.
+	 *
+	 * @param interval		sampling interval in bytes
+	 */
+	void (*set_interval)(heap_profiler_t *this, u_int interval);
+
+	/**
+	 * Destroy a heap_profiler instance.
+	 */
+	void (*destroy)(heap_profiler_t *this);
+};
+
+/**
+ * Create a heap_profiler instance.
+ */
+heap_profiler_t *heap_profiler_create();
+
+#endif /** HEAP_PROFILER_H_ @}*/
@@ -21,6 +21,7 @@
 #include <arpa/inet.h>
 #include <string.h>
 #include <stdio.h>
+#include <ctype.h>
 
 #include "identification.h"
 
@@ -691,6 +692,65 @@ METHOD(identification_t, equals_strcasecmp,  bool,
 	return FALSE;
 }
 
+/**
+ * Hash a chunk case-insensitively, including the given hash
+ */
+static u_int hash_lower(chunk_t data, u_int hash)
+{
+	u_char buf[64];
+	int i, len;
+
+	while (data.len)
+	{
+		len = min(data.len, sizeof(buf));
+		for (i = 0; i < len; i++)
+		{
+			buf[i] = tolower(data.ptr[i]);
+		}
+		hash = chunk_hash_inc(chunk_create(buf, len), hash);
+		data = chunk_skip(data, len);
+	}
+	return hash;
+}
+
+METHOD(identification_t, hash_binary, u_int,
+	private_identification_t *this, u_int inc)
+{
+	inc = chunk_hash_inc(chunk_from_thing(this->type), inc);
+	if (this->type == ID_ANY)
+	{
+		return inc;
+	}
+	return chunk_hash_inc(this->encoded, inc);
+}
+
+METHOD(identification_t, hash_dn, u_int,
+	private_identification_t *this, u_int inc)
+{
+	enumerator_t *enumerator;
+	chunk_t oid, data;
+	u_char type;
+
+	/* equal DNs might use different string types and some RDNs compare
+	 * case-insensitive, so hash the OIDs and lowercase RDN values only */
+	inc = chunk_hash_inc(chunk_from_thing(this->type), inc);
+	enumerator = create_rdn_enumerator(this->encoded);
+	while (enumerator->enumerate(enumerator, &oid, &type, &data))
+	{
+		inc = chunk_hash_inc(oid, inc);
+		inc = hash_lower(data, inc);
+	}
+	enumerator->destroy(enumerator);
+	return inc;
+}
+
+METHOD(identification_t, hash_strcasecmp, u_int,
+	private_identification_t *this, u_int inc)
+{
+	inc = chunk_hash_inc(chunk_from_thing(this->type), inc);
+	return hash_lower(this->encoded, inc);
+}
+
 METHOD(identification_t, matches_binary, id_match_t,
 	private_identification_t *this, identification_t *other)
 {
@@ -892,6 +952,7 @@ static private_identification_t *identification_create(id_type_t type)
 		case ID_ANY:
 			this->public.matches = _matches_any;
 			this->public.equals = _equals_binary;
+			this->public.hash = _hash_binary;
 			this->public.contains_wildcards = return_true;
 			break;
 		case ID_FQDN:
@@ -899,15 +960,18 @@ static private_identification_t *identification_create(id_type_t type)
 		case ID_USER_ID:
 			this->public.matches = _matches_string;
 			this->public.equals = _equals_strcasecmp;
+			this->public.hash = _hash_strcasecmp;
 			this->public.contains_wildcards = _contains_wildcards_memchr;
 			break;
 		case ID_DER_ASN1_DN:
 			this->public.equals = _equals_dn;
+			this->public.hash = _hash_dn;
 			this->public.matches = _matches_dn;
 			this->public.contains_wildcards = _contains_wildcards_dn;
 			break;
 		default:
 			this->public.equals = _equals_binary;
+			this->public.hash = _hash_binary;
 			this->public.matches = _matches_binary;
 			this->public.contains_wildcards = return_false;
 			break;
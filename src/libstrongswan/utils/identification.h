@@ -226,6 +226,17 @@ struct identification_t {
 	 */
 	bool (*equals) (identification_t *this, identification_t *other);
 
+	/**
+	 * Get a hash value for this identification_t object.
+	 *
+	 * The hash is compatible with equals(), identities that are equal get the
+	 * same hash, even if they differ in case or DN string types.
+	 *
+	 * @param inc		previous hash value to include
+	 * @return			hash value
+	 */
+	u_int (*hash) (identification_t *this, u_int inc);
+
 	/**
 	 * Check if an ID matches a wildcard ID.
 	 *
@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "metrics.h"
+
+#include <inttypes.h>
+
+#include <threading/mutex.h>
+#include <threading/thread_value.h>
+#include <collections/linked_list.h>
+
+ENUM(metric_type_names, METRIC_COUNTER, METRIC_HISTOGRAM,
+	"counter",
+	"gauge",
+	"histogram",
+);
+
+/**
+ * Upper bounds of histogram buckets, in us
+ */
+static const u_int64_t bounds[] = {
+	10, 25, 50, 100, 250, 500,
+	1000, 2500, 5000, 10000, 25000, 50000,
+	100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000,
+};
+
+/**
+ * Number of histogram buckets, including the one for larger values
+ */
+#define BUCKETS (countof(bounds) + 1)
+
+typedef struct private_metrics_t private_metrics_t;
+typedef struct private_metric_t private_metric_t;
+typedef struct shard_t shard_t;
+typedef struct local_t local_t;
+
+/**
+ * Values of a metric recorded by a single thread
+ */
+struct shard_t {
+
+	/**
+	 * Value of a counter or gauge, sum of a histogram
+	 */
+	int64_t value;
+
+	/**
+	 * Number of samples in each histogram bucket (not cumulative)
+	 */
+	u_int64_t buckets[];
+};
+
+/**
+ * Thread local shards of all metrics, indexed by metric identifier
+ */
+struct local_t {
+
+	/**
+	 * Shards, NULL for metrics not updated by this thread yet
+	 */
+	shard_t **shards;
+
+	/**
+	 * Number of allocated entries in shards
+	 */
+	u_int count;
+
+	/**
+	 * Registry this belongs to
+	 */
+	private_metrics_t *metrics;
+};
+
+/**
+ * Private data of a metrics_t object.
+ */
+struct private_metrics_t {
+
+	/**
+	 * Public metrics_t interface.
+	 */
+	metrics_t public;
+
+	/**
+	 * Registered metrics, families grouped together, as private_metric_t
+	 */
+	linked_list_t *metrics;
+
+	/**
+	 * Thread local shards, as local_t
+	 */
+	thread_value_t *local;
+
+	/**
+	 * All local_t of running threads
+	 */
+	linked_list_t *locals;
+
+	/**
+	 * Identifier of the next metric, not reused to avoid stale shards
+	 */
+	u_int next_id;
+
+	/**
+	 * Lock for metrics, locals, next_id and the shards of metrics
+	 */
+	mutex_t *mutex;
+};
+
+/**
+ * Private data of a metric_t object.
+ */
+struct private_metric_t {
+
+	/**
+	 * Public metric_t interface.
+	 */
+	metric_t public;
+
+	/**
+	 * Registry
+	 */
+	private_metrics_t *metrics;
+
+	/**
+	 * Type of this metric
+	 */
+	metric_type_t type;
+
+	/**
+	 * Name, without prefix
+	 */
+	char *name;
+
+	/**
+	 * Labels, NULL if none
+	 */
+	char *labels;
+
+	/**
+	 * Description
+	 */
+	char *help;
+
+	/**
+	 * Index of the shards of this metric in local_t
+	 */
+	u_int id;
+
+	/**
+	 * Shards of all threads that updated this metric, as shard_t
+	 */
+	linked_list_t *shards;
+
+	/**
+	 * Callback of a polled gauge
+	 */
+	metric_gauge_cb_t cb;
+
+	/**
+	 * Data to pass to cb
+	 */
+	void *data;
+};
+
+/**
+ * Release the local shard index of a terminating thread, its shards are
+ * owned by the metrics and stay accounted
+ */
+static void local_destroy(local_t *local)
+{
+	private_metrics_t *this = local->metrics;
+
+	this->mutex->lock(this->mutex);
+	this->locals->remove(this->locals, local, NULL);
+	this->mutex->unlock(this->mutex);
+	free(local->shards);
+	free(local);
+}
+
+/**
+ * Allocate the shard of the calling thread for a metric
+ */
+static shard_t *create_shard(private_metric_t *metric, local_t *local)
+{
+	private_metrics_t *this = metric->metrics;
+	shard_t *shard;
+	u_int count;
+
+	this->mutex->lock(this->mutex);
+	if (!local)
+	{
+		INIT(local,
+			.metrics = this,
+		);
+		this->local->set(this->local, local);
+		this->locals->insert_last(this->locals, local);
+	}
+	if (metric->id >= local->count)
+	{
+		count = max(this->next_id, metric->id + 1);
+		local->shards = realloc(local->shards, count * sizeof(shard_t*));
+		memset(local->shards + local->count, 0,
+			   (count - local->count) * sizeof(shard_t*));
+		local->count = count;
+	}
+	if (metric->type == METRIC_HISTOGRAM)
+	{
+		shard = calloc(1, sizeof(shard_t) + BUCKETS * sizeof(u_int64_t));
+	}
+	else
+	{
+		shard = calloc(1, sizeof(shard_t));
+	}
+	local->shards[metric->id] = shard;
+	metric->shards->insert_last(metric->shards, shard);
+	this->mutex->unlock(this->mutex);
+	return shard;
+}
+
+/**
+ * Get the shard of the calling thread for a metric
+ */
+static inline shard_t *get_shard(private_metric_t *this)
+{
+	local_t *local;
+
+	local = this->metrics->local->get(this->metrics->local);
+	if (local && this->id < local->count && local->shards[this->id])
+	{
+		return local->shards[this->id];
+	}
+	return create_shard(this, local);
+}
+
+METHOD(metric_t, add, void,
+	private_metric_t *this, int64_t value)
+{
+	get_shard(this)->value += value;
+}
+
+METHOD(metric_t, observe, void,
+	private_metric_t *this, u_int64_t usec)
+{
+	shard_t *shard;
+	int i;
+
+	shard = get_shard(this);
+	for (i = 0; i < countof(bounds) && usec > bounds[i]; i++)
+	{
+		/* find bucket */
+	}
+	shard->buckets[i]++;
+	shard->value += usec;
+}
+
+METHOD(metric_t, observe_since, void,
+	private_metric_t *this, timeval_t *start)
+{
+	timeval_t now;
+
+	time_monotonic(&now);
+	timersub(&now, start, &now);
+	observe(this, now.tv_sec * 1000000 + now.tv_usec);
+}
+
+METHOD(metric_t, metric_destroy, void,
+	private_metric_t *this)
+{
+	this->metrics->mutex->lock(this->metrics->mutex);
+	this->metrics->metrics->remove(this->metrics->metrics, this, NULL);
+	this->metrics->mutex->unlock(this->metrics->mutex);
+	this->shards->destroy_function(this->shards, free);
+	free(this->name);
+	free(this->labels);
+	free(this->help);
+	free(this);
+}
+
+/**
+ * Register a metric after the other members of its family
+ */
+static void register_metric(private_metrics_t *this, private_metric_t *metric)
+{
+	enumerator_t *enumerator;
+	private_metric_t *current;
+	bool family = FALSE, inserted = FALSE;
+
+	this->mutex->lock(this->mutex);
+	metric->id = this->next_id++;
+	enumerator = this->metrics->create_enumerator(this->metrics);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (streq(current->name, metric->name))
+		{
+			family = TRUE;
+		}
+		else if (family)
+		{
+			this->metrics->insert_before(this->metrics, enumerator, metric);
+			inserted = TRUE;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (!inserted)
+	{
+		this->metrics->insert_last(this->metrics, metric);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+/**
+ * Create a metric of the given type
+ */
+static private_metric_t *create_metric(private_metrics_t *this,
+									   metric_type_t type, char *name,
+									   char *labels, char *help)
+{
+	private_metric_t *metric;
+
+	INIT(metric,
+		.public = {
+			.add = _add,
+			.observe = _observe,
+			.observe_since = _observe_since,
+			.destroy = _metric_destroy,
+		},
+		.metrics = this,
+		.type = type,
+		.name = strdup(name),
+		.labels = strdupnull(labels),
+		.help = strdup(help),
+		.shards = linked_list_create(),
+	);
+	return metric;
+}
+
+METHOD(metrics_t, create, metric_t*,
+	private_metrics_t *this, metric_type_t type, char *name, char *labels,
+	char *help)
+{
+	private_metric_t *metric;
+
+	metric = create_metric(this, type, name, labels, help);
+	register_metric(this, metric);
+	return &metric->public;
+}
+
+METHOD(metrics_t, create_gauge, metric_t*,
+	private_metrics_t *this, char *name, char *labels, char *help,
+	metric_gauge_cb_t cb, void *data)
+{
+	private_metric_t *metric;
+
+	metric = create_metric(this, METRIC_GAUGE, name, labels, help);
+	metric->cb = cb;
+	metric->data = data;
+	register_metric(this, metric);
+	return &metric->public;
+}
+
+/**
+ * Print the labels of a sample, with an optional additional label
+ */
+static void print_labels(FILE *out, char *labels, char *extra)
+{
+	if (labels && extra)
+	{
+		fprintf(out, "{%s,%s}", labels, extra);
+	}
+	else if (labels || extra)
+	{
+		fprintf(out, "{%s}", labels ?: extra);
+	}
+}
+
+/**
+ * Print the samples of a histogram
+ */
+static void print_histogram(private_metric_t *metric, FILE *out)
+{
+	enumerator_t *enumerator;
+	shard_t *shard;
+	u_int64_t buckets[BUCKETS] = {}, count = 0;
+	int64_t sum = 0;
+	char le[32];
+	int i;
+
+	enumerator = metric->shards->create_enumerator(metric->shards);
+	while (enumerator->enumerate(enumerator, &shard))
+	{
+		for (i = 0; i < BUCKETS; i++)
+		{
+			buckets[i] += shard->buckets[i];
+		}
+		sum += shard->value;
+	}
+	enumerator->destroy(enumerator);
+
+	for (i = 0; i < BUCKETS; i++)
+	{
+		count += buckets[i];
+		if (i < countof(bounds))
+		{
+			snprintf(le, sizeof(le), "le=\"%g\"", bounds[i] / 1000000.0);
+		}
+		else
+		{
+			snprintf(le, sizeof(le), "le=\"+Inf\"");
+		}
+		fprintf(out, "strongswan_%s_bucket", metric->name);
+		print_labels(out, metric->labels, le);
+		fprintf(out, " %" PRIu64 "\n", count);
+	}
+	fprintf(out, "strongswan_%s_sum", metric->name);
+	print_labels(out, metric->labels, NULL);
+	fprintf(out, " %.6f\n", sum / 1000000.0);
+	fprintf(out, "strongswan_%s_count", metric->name);
+	print_labels(out, metric->labels, NULL);
+	fprintf(out, " %" PRIu64 "\n", count);
+}
+
+/**
+ * Print the sample of a counter or gauge
+ */
+static void print_value(private_metric_t *metric, FILE *out)
+{
+	enumerator_t *enumerator;
+	shard_t *shard;
+	int64_t value = 0;
+
+	if (metric->cb)
+	{
+		value = metric->cb(metric->data);
+	}
+	enumerator = metric->shards->create_enumerator(metric->shards);
+	while (enumerator->enumerate(enumerator, &shard))
+	{
+		value += shard->value;
+	}
+	enumerator->destroy(enumerator);
+
+	fprintf(out, "strongswan_%s", metric->name);
+	print_labels(out, metric->labels, NULL);
+	fprintf(out, " %" PRId64 "\n", value);
+}
+
+METHOD(metrics_t, print, void,
+	private_metrics_t *this, FILE *out)
+{
+	enumerator_t *enumerator;
+	private_metric_t *metric;
+	char *family = NULL;
+
+	this->mutex->lock(this->mutex);
+	enumerator = this->metrics->create_enumerator(this->metrics);
+	while (enumerator->enumerate(enumerator, &metric))
+	{
+		if (!family || !streq(family, metric->name))
+		{
+			family = metric->name;
+			fprintf(out, "# HELP strongswan_%s %s\n", metric->name,
+					metric->help);
+			fprintf(out, "# TYPE strongswan_%s %N\n", metric->name,
+					metric_type_names, metric->type);
+		}
+		if (metric->type == METRIC_HISTOGRAM)
+		{
+			print_histogram(metric, out);
+		}
+		else
+		{
+			print_value(metric, out);
+		}
+	}
+	enumerator->destroy(enumerator);
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(metrics_t, destroy, void,
+	private_metrics_t *this)
+{
+	private_metric_t *metric;
+	local_t *local;
+
+	this->local->destroy(this->local);
+	while (this->locals->remove_first(this->locals, (void**)&local) == SUCCESS)
+	{
+		free(local->shards);
+		free(local);
+	}
+	this->locals->destroy(this->locals);
+	while (this->metrics->remove_first(this->metrics,
+									   (void**)&metric) == SUCCESS)
+	{
+		metric_destroy(metric);
+	}
+	this->metrics->destroy(this->metrics);
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/*
+ * See header
+ */
+metrics_t *metrics_create()
+{
+	private_metrics_t *this;
+
+	INIT(this,
+		.public = {
+			.create = _create,
+			.create_gauge = _create_gauge,
+			.print = _print,
+			.destroy = _destroy,
+		},
+		.metrics = linked_list_create(),
+		.locals = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+	);
+	this->local = thread_value_create((thread_cleanup_t)local_destroy);
+
+	return &this->public;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2013 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup metrics metrics
+ * @{ @ingroup utils
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdio.h>
+
+#include <utils/utils.h>
+#include <utils/enum.h>
+
+typedef struct metrics_t metrics_t;
+typedef struct metric_t metric_t;
+typedef enum metric_type_t metric_type_t;
+
+/**
+ * Type of a metric
+ */
+enum metric_type_t {
+	/** monotonically increasing value */
+	METRIC_COUNTER,
+	/** value that goes up and down */
+	METRIC_GAUGE,
+	/** distribution of durations */
+	METRIC_HISTOGRAM,
+};
+
+/**
+ * enum names for metric_type_t, as used in the text format.
+ */
+extern enum_name_t *metric_type_names;
+
+/**
+ * Callback function to get the current value of a polled gauge.
+ *
+ * @param data			user data passed to metrics_t.create_gauge()
+ * @return				current value of the gauge
+ */
+typedef int64_t (*metric_gauge_cb_t)(void *data);
+
+/**
+ * A registered metric, updated by the component owning it.
+ *
+ * Updates are recorded in thread local storage without locking or atomic
+ * operations. Only the first update from a thread allocates its storage.
+ */
+struct metric_t {
+
+	/**
+	 * Add a value to a counter or gauge.
+	 *
+	 * @param value		value to add, negative values for gauges only
+	 */
+	void (*add)(metric_t *this, int64_t value);
+
+	/**
+	 * Record a duration in a histogram.
+	 *
+	 * @param usec		duration in microseconds
+	 */
+	void (*observe)(metric_t *this, u_int64_t usec);
+
+	/**
+	 * Record the time passed since a monotonic timestamp in a histogram.
+	 *
+	 * @param start		timestamp taken with time_monotonic()
+	 */
+	void (*observe_since)(metric_t *this, timeval_t *start);
+
+	/**
+	 * Unregister and destroy a metric.
+	 */
+	void (*destroy)(metric_t *this);
+};
+
+/**
+ * Registry of named counters, gauges and histograms.
+ *
+ * Components register metrics on creation and update them during operation.
+ * The values summed over all threads are printed in the Prometheus text
+ * exposition format, each name prefixed with "strongswan_". Metrics with the
+ * same name but different labels form a family, sharing help and type.
+ *
+ * Histograms use fixed buckets from 10us to 10s and print their bounds, sum
+ * and samples in seconds.
+ */
+struct metrics_t {
+
+	/**
+	 * Register a counter, gauge or histogram.
+	 *
+	 * @param type		type of the metric
+	 * @param name		name of the metric, without prefix
+	 * @param labels	labels, as in 'a="x",b="y"', NULL for none
+	 * @param help		description of the metric
+	 * @return			metric, to destroy() when done
+	 */
+	metric_t* (*create)(metrics_t *this, metric_type_t type, char *name,
+						char *labels, char *help);
+
+	/**
+	 * Register a gauge that gets polled when printed.
+	 *
+	 * @param name		name of the metric, without prefix
+	 * @param labels	labels, as in 'a="x",b="y"', NULL for none
+	 * @param help		description of the metric
+	 * @param cb		callback returning the current value
+	 * @param data		data to pass to cb
+	 * @return			metric, to destroy() when done
+	 */
+	metric_t* (*create_gauge)(metrics_t *this, char *name, char *labels,
+							  char *help, metric_gauge_cb_t cb, void *data);
+
+	/**
+	 * Print all registered metrics in the text exposition format.
+	 *
+	 * @param out		stream to print to
+	 */
+	void (*print)(metrics_t *this, FILE *out);
+
+	/**
+	 * Destroy a metrics_t instance, after all metrics have been destroyed.
+	 */
+	void (*destroy)(metrics_t *this);
+};
+
+/**
+ * Create a metrics_t instance.
+ *
+ * @return				metrics registry
+ */
+metrics_t *metrics_create();
+
+#endif /** METRICS_H_ @}*/
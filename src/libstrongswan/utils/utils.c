@@ -31,7 +31,7 @@
 #include "utils/debug.h"
 #include "utils/chunk.h"
 
-ENUM(status_names, SUCCESS, NEED_MORE,
+ENUM(status_names, SUCCESS, SUSPENDED,
 	"SUCCESS",
 	"FAILED",
 	"OUT_OF_RES",
@@ -44,6 +44,7 @@ ENUM(status_names, SUCCESS, NEED_MORE,
 	"INVALID_STATE",
 	"DESTROY_ME",
 	"NEED_MORE",
+	"SUSPENDED",
 );
 
 /**
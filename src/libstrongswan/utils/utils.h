@@ -332,6 +332,11 @@ enum status_t {
 	 * Another call to the method is required.
 	 */
 	NEED_MORE,
+
+	/**
+	 * Operation suspended, the method gets called again to continue.
+	 */
+	SUSPENDED,
 };
 
 /**
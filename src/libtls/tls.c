@@ -284,7 +284,7 @@ METHOD(tls_t, build, status_t,
 	private_tls_t *this, void *buf, size_t *buflen, size_t *msglen)
 {
 	tls_content_type_t type;
-	tls_record_t record;
+	bio_writer_t *writer;
 	status_t status;
 	chunk_t data;
 	size_t len;
@@ -292,31 +292,36 @@ METHOD(tls_t, build, status_t,
 	len = *buflen;
 	if (this->output.len == 0)
 	{
-		/* query upper layers for new records, as many as we can get */
+		/* query upper layers for new records, as many as we can get, and
+		 * bundle them in a single output buffer */
+		writer = bio_writer_create(TLS_MAX_FRAGMENT_LEN);
 		while (TRUE)
 		{
 			status = this->protection->build(this->protection, &type, &data);
-			switch (status)
+			if (status != NEED_MORE)
 			{
-				case NEED_MORE:
-					record.type = type;
-					htoun16(&record.version, this->version);
-					htoun16(&record.length, data.len);
-					this->output = chunk_cat("mcm", this->output,
-											 chunk_from_thing(record), data);
-					DBG2(DBG_TLS, "sending TLS %N record (%d bytes)",
-						 tls_content_type_names, type, data.len);
-					continue;
-				case INVALID_STATE:
-					if (this->output.len == 0)
-					{
-						return INVALID_STATE;
-					}
-					break;
-				default:
-					return status;
+				break;
 			}
-			break;
+			writer->write_uint8(writer, type);
+			writer->write_uint16(writer, this->version);
+			writer->write_data16(writer, data);
+			DBG2(DBG_TLS, "sending TLS %N record (%d bytes)",
+				 tls_content_type_names, type, data.len);
+			free(data.ptr);
+		}
+		this->output = writer->extract_buf(writer);
+		writer->destroy(writer);
+		if (this->output.len == 0)
+		{
+			chunk_free(&this->output);
+		}
+		if (status != INVALID_STATE)
+		{
+			return status;
+		}
+		if (this->output.len == 0)
+		{
+			return INVALID_STATE;
 		}
 		if (msglen)
 		{
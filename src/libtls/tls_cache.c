@@ -16,39 +16,90 @@
 #include "tls_cache.h"
 
 #include <utils/debug.h>
-#include <collections/linked_list.h>
 #include <collections/hashtable.h>
 #include <threading/rwlock.h>
 
+/**
+ * Maximum number of segments, a power of two
+ */
+#define MAX_SEGMENTS 16
+
+/**
+ * Default number of sessions in the shared caches
+ */
+#define DEFAULT_SESSION_CACHE_SIZE 1024
+
+/**
+ * Default lifetime of sessions in the shared caches, in seconds
+ */
+#define DEFAULT_SESSION_LIFETIME 3600
+
 typedef struct private_tls_cache_t private_tls_cache_t;
+typedef struct entry_t entry_t;
 
 /**
- * Private data of an tls_cache_t object.
+ * A segment of the cache, holding the sessions hashing into it
  */
-struct private_tls_cache_t {
+typedef struct {
 
 	/**
-	 * Public tls_cache_t interface.
+	 * Mapping session => entry_t, fast lookup by session
 	 */
-	tls_cache_t public;
+	hashtable_t *table;
 
 	/**
-	 * Mapping session => entry_t, fast lookup by session
+	 * Most recently used entry
 	 */
-	hashtable_t *table;
+	entry_t *first;
 
 	/**
-	 * List containing all entries
+	 * Least recently used entry
 	 */
-	linked_list_t *list;
+	entry_t *last;
 
 	/**
-	 * Lock to list and table
+	 * Number of entries
+	 */
+	u_int count;
+
+	/**
+	 * Lock to entries, table and statistics
 	 */
 	rwlock_t *lock;
 
 	/**
-	 * Session limit
+	 * Number of successful lookups
+	 */
+	u_int hits;
+
+	/**
+	 * Number of failed lookups
+	 */
+	u_int misses;
+} segment_t;
+
+/**
+ * Private data of an tls_cache_t object.
+ */
+struct private_tls_cache_t {
+
+	/**
+	 * Public tls_cache_t interface.
+	 */
+	tls_cache_t public;
+
+	/**
+	 * Cache segments
+	 */
+	segment_t *segments;
+
+	/**
+	 * Number of segments
+	 */
+	u_int count;
+
+	/**
+	 * Session limit per segment
 	 */
 	u_int max_sessions;
 
@@ -61,7 +112,7 @@ struct private_tls_cache_t {
 /**
  * Hashtable entry
  */
-typedef struct {
+struct entry_t {
 	/** session identifier */
 	chunk_t session;
 	/** master secret */
@@ -72,7 +123,11 @@ typedef struct {
 	identification_t *id;
 	/** time of add */
 	time_t t;
-} entry_t;
+	/** more recently used entry */
+	entry_t *prev;
+	/** less recently used entry */
+	entry_t *next;
+};
 
 /**
  * Destroy an entry
@@ -101,11 +156,88 @@ static bool equals(chunk_t *a, chunk_t *b)
 	return chunk_equals(*a, *b);
 }
 
+/**
+ * Get the segment a session belongs to
+ */
+static segment_t *get_segment(private_tls_cache_t *this, chunk_t session)
+{
+	/* the hashtable uses the lower bits of the same hash, use upper bits */
+	return &this->segments[(chunk_hash(session) >> 16) & (this->count - 1)];
+}
+
+/**
+ * Unlink an entry from the LRU order of a segment
+ */
+static void unlink_entry(segment_t *segment, entry_t *entry)
+{
+	if (entry->prev)
+	{
+		entry->prev->next = entry->next;
+	}
+	else
+	{
+		segment->first = entry->next;
+	}
+	if (entry->next)
+	{
+		entry->next->prev = entry->prev;
+	}
+	else
+	{
+		segment->last = entry->prev;
+	}
+	entry->prev = entry->next = NULL;
+	segment->count--;
+}
+
+/**
+ * Link an entry as most recently used one of a segment
+ */
+static void link_entry(segment_t *segment, entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = segment->first;
+	if (segment->first)
+	{
+		segment->first->prev = entry;
+	}
+	else
+	{
+		segment->last = entry;
+	}
+	segment->first = entry;
+	segment->count++;
+}
+
+/**
+ * Remove an entry from a segment and destroy it
+ */
+static void remove_entry(segment_t *segment, entry_t *entry)
+{
+	unlink_entry(segment, entry);
+	segment->table->remove(segment->table, &entry->session);
+	entry_destroy(entry);
+}
+
+/**
+ * Remove expired sessions from the end of a segment, requires a write lock
+ */
+static void purge(private_tls_cache_t *this, segment_t *segment, time_t now)
+{
+	while (segment->last && segment->last->t + this->max_age < now)
+	{
+		DBG2(DBG_TLS, "TLS session %#B expired", &segment->last->session);
+		remove_entry(segment, segment->last);
+	}
+}
+
 METHOD(tls_cache_t, create_, void,
 	private_tls_cache_t *this, chunk_t session, identification_t *id,
 	chunk_t master, tls_cipher_suite_t suite)
 {
-	entry_t *entry;
+	segment_t *segment;
+	entry_t *entry, *old;
+	u_int count;
 
 	INIT(entry,
 		.session = chunk_clone(session),
@@ -115,21 +247,28 @@ METHOD(tls_cache_t, create_, void,
 		.t = time_monotonic(NULL),
 	);
 
-	this->lock->write_lock(this->lock);
-	this->list->insert_first(this->list, entry);
-	this->table->put(this->table, &entry->session, entry);
-	if (this->list->get_count(this->list) > this->max_sessions &&
-		this->list->remove_last(this->list, (void**)&entry) == SUCCESS)
+	segment = get_segment(this, session);
+	segment->lock->write_lock(segment->lock);
+	purge(this, segment, entry->t);
+	old = segment->table->put(segment->table, &entry->session, entry);
+	if (old)
+	{
+		unlink_entry(segment, old);
+		entry_destroy(old);
+	}
+	link_entry(segment, entry);
+	if (segment->count > this->max_sessions)
 	{
+		old = segment->last;
 		DBG2(DBG_TLS, "session limit of %u reached, deleting %#B",
-			 this->max_sessions, &entry->session);
-		this->table->remove(this->table, &entry->session);
-		entry_destroy(entry);
+			 this->max_sessions * this->count, &old->session);
+		remove_entry(segment, old);
 	}
-	this->lock->unlock(this->lock);
+	count = segment->count;
+	segment->lock->unlock(segment->lock);
 
-	DBG2(DBG_TLS, "created TLS session %#B, %d sessions",
-		 &session, this->list->get_count(this->list));
+	DBG2(DBG_TLS, "created TLS session %#B, %u sessions in segment",
+		 &session, count);
 }
 
 METHOD(tls_cache_t, lookup, tls_cipher_suite_t,
@@ -137,31 +276,45 @@ METHOD(tls_cache_t, lookup, tls_cipher_suite_t,
 	chunk_t* master)
 {
 	tls_cipher_suite_t suite = 0;
+	segment_t *segment;
 	entry_t *entry;
 	time_t now;
-	u_int age;
+	u_int age = 0;
 
 	now = time_monotonic(NULL);
 
-	this->lock->write_lock(this->lock);
-	entry = this->table->get(this->table, &session);
+	segment = get_segment(this, session);
+	segment->lock->write_lock(segment->lock);
+	entry = segment->table->get(segment->table, &session);
 	if (entry)
 	{
 		age = now - entry->t;
 		if (age <= this->max_age)
 		{
-			if (!id || !entry->id || id->equals(id, entry->id))
+			if (!id || (entry->id && id->equals(id, entry->id)))
 			{
 				*master = chunk_clone(entry->master);
 				suite = entry->suite;
+				/* move to front, evicting least recently used sessions */
+				unlink_entry(segment, entry);
+				link_entry(segment, entry);
 			}
 		}
 		else
 		{
 			DBG2(DBG_TLS, "TLS session %#B expired: %u seconds", &session, age);
+			remove_entry(segment, entry);
 		}
 	}
-	this->lock->unlock(this->lock);
+	if (suite)
+	{
+		segment->hits++;
+	}
+	else
+	{
+		segment->misses++;
+	}
+	segment->lock->unlock(segment->lock);
 
 	if (suite)
 	{
@@ -174,40 +327,69 @@ METHOD(tls_cache_t, check, chunk_t,
 	private_tls_cache_t *this, identification_t *id)
 {
 	chunk_t session = chunk_empty;
-	enumerator_t *enumerator;
+	segment_t *segment;
 	entry_t *entry;
 	time_t now;
+	u_int i;
 
 	now = time_monotonic(NULL);
-	this->lock->read_lock(this->lock);
-	enumerator = this->list->create_enumerator(this->list);
-	while (enumerator->enumerate(enumerator, &entry))
+	for (i = 0; i < this->count && !session.len; i++)
 	{
-		if (entry->t + this->max_age >= now &&
-			entry->id && id->equals(id, entry->id))
+		segment = &this->segments[i];
+		segment->lock->read_lock(segment->lock);
+		for (entry = segment->first; entry; entry = entry->next)
 		{
-			session = chunk_clone(entry->session);
-			break;
+			if (entry->t + this->max_age >= now &&
+				entry->id && id->equals(id, entry->id))
+			{
+				session = chunk_clone(entry->session);
+				break;
+			}
 		}
+		segment->lock->unlock(segment->lock);
 	}
-	enumerator->destroy(enumerator);
-	this->lock->unlock(this->lock);
-
 	return session;
 }
 
+METHOD(tls_cache_t, get_stats, u_int,
+	private_tls_cache_t *this, u_int *hits, u_int *misses)
+{
+	segment_t *segment;
+	u_int i, count = 0;
+
+	*hits = *misses = 0;
+	for (i = 0; i < this->count; i++)
+	{
+		segment = &this->segments[i];
+		segment->lock->read_lock(segment->lock);
+		count += segment->count;
+		*hits += segment->hits;
+		*misses += segment->misses;
+		segment->lock->unlock(segment->lock);
+	}
+	return count;
+}
+
 METHOD(tls_cache_t, destroy, void,
 	private_tls_cache_t *this)
 {
+	segment_t *segment;
 	entry_t *entry;
+	u_int i;
 
-	while (this->list->remove_last(this->list, (void**)&entry) == SUCCESS)
+	for (i = 0; i < this->count; i++)
 	{
-		entry_destroy(entry);
+		segment = &this->segments[i];
+		while (segment->first)
+		{
+			entry = segment->first;
+			segment->first = entry->next;
+			entry_destroy(entry);
+		}
+		segment->table->destroy(segment->table);
+		segment->lock->destroy(segment->lock);
 	}
-	this->list->destroy(this->list);
-	this->table->destroy(this->table);
-	this->lock->destroy(this->lock);
+	free(this->segments);
 	free(this);
 }
 
@@ -217,21 +399,102 @@ METHOD(tls_cache_t, destroy, void,
 tls_cache_t *tls_cache_create(u_int max_sessions, u_int max_age)
 {
 	private_tls_cache_t *this;
+	u_int i;
 
 	INIT(this,
 		.public = {
 			.create = _create_,
 			.lookup = _lookup,
 			.check = _check,
+			.get_stats = _get_stats,
 			.destroy = _destroy,
 		},
-		.table = hashtable_create((hashtable_hash_t)hash,
-								  (hashtable_equals_t)equals, 8),
-		.list = linked_list_create(),
-		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
-		.max_sessions = max_sessions,
+		.count = MAX_SEGMENTS,
 		.max_age = max_age,
 	);
 
+	/* use fewer segments for small caches, the limit applies per segment */
+	while (this->count > 1 && this->count > max_sessions)
+	{
+		this->count /= 2;
+	}
+	this->max_sessions = max(max_sessions / this->count, 1);
+	this->segments = calloc(this->count, sizeof(segment_t));
+	for (i = 0; i < this->count; i++)
+	{
+		this->segments[i].table = hashtable_create((hashtable_hash_t)hash,
+											(hashtable_equals_t)equals, 8);
+		this->segments[i].lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
+	}
+
 	return &this->public;
 }
+
+/**
+ * Session caches shared by all TLS stacks of a role, created on first use
+ */
+static tls_cache_t *shared_server = NULL, *shared_peer = NULL;
+
+/**
+ * Reference count for users of the shared caches
+ */
+static refcount_t shared_ref = 0;
+
+/**
+ * Log session resumption statistics of a shared cache
+ */
+static void log_stats(tls_cache_t *cache, char *role)
+{
+	u_int count, hits, misses;
+
+	count = cache->get_stats(cache, &hits, &misses);
+	DBG1(DBG_TLS, "TLS %s session cache: %u sessions, %u resumed, "
+		 "%u not resumed", role, count, hits, misses);
+}
+
+/**
+ * See header
+ */
+void tls_cache_shared_init()
+{
+	u_int sessions, lifetime;
+
+	if (shared_ref == 0)
+	{
+		sessions = lib->settings->get_int(lib->settings,
+							"libtls.session_cache_size",
+							DEFAULT_SESSION_CACHE_SIZE);
+		lifetime = lib->settings->get_time(lib->settings,
+							"libtls.session_lifetime",
+							DEFAULT_SESSION_LIFETIME);
+		if (sessions)
+		{
+			shared_server = tls_cache_create(sessions, lifetime);
+			shared_peer = tls_cache_create(sessions, lifetime);
+		}
+	}
+	ref_get(&shared_ref);
+}
+
+/**
+ * See header
+ */
+void tls_cache_shared_deinit()
+{
+	if (ref_put(&shared_ref) && shared_server)
+	{
+		log_stats(shared_server, "server");
+		log_stats(shared_peer, "peer");
+		shared_server->destroy(shared_server);
+		shared_peer->destroy(shared_peer);
+		shared_server = shared_peer = NULL;
+	}
+}
+
+/**
+ * See header
+ */
+tls_cache_t *tls_cache_get_shared(bool is_server)
+{
+	return is_server ? shared_server : shared_peer;
+}
@@ -27,6 +27,11 @@ typedef struct tls_cache_t tls_cache_t;
 
 /**
  * TLS session cache facility.
+ *
+ * The cache is split into segments, each protected by its own lock, so it
+ * may be shared by many TLS stacks running concurrently. Sessions expire
+ * after a maximum age, and the least recently used sessions get evicted if
+ * the size limit is reached.
  */
 struct tls_cache_t {
 
@@ -44,8 +49,10 @@ struct tls_cache_t {
 	/**
 	 * Look up a TLS session entry.
 	 *
+	 * If an identity is given, only sessions bound to that identity match.
+	 *
 	 * @param session		session ID to find
-	 * @param id			identity the session is bound to
+	 * @param id			identity the session is bound to, NULL for any
 	 * @param master		gets allocated master secret, if session found
 	 * @return				TLS suite of session, 0 if none found
 	 */
@@ -60,6 +67,15 @@ struct tls_cache_t {
 	 */
 	chunk_t (*check)(tls_cache_t *this, identification_t *id);
 
+	/**
+	 * Get session resumption statistics.
+	 *
+	 * @param hits			number of sessions found by lookup()
+	 * @param misses		number of lookups failed, including expired sessions
+	 * @return				number of sessions currently cached
+	 */
+	u_int (*get_stats)(tls_cache_t *this, u_int *hits, u_int *misses);
+
 	/**
 	 * Destroy a tls_cache_t.
 	 */
@@ -75,4 +91,28 @@ struct tls_cache_t {
  */
 tls_cache_t *tls_cache_create(u_int max_sessions, u_int max_age);
 
+/**
+ * Create the session caches shared by all TLS stacks, one for each role.
+ *
+ * Calls are reference counted and must not happen concurrently, e.g. during
+ * plugin loading. Each call requires a call to tls_cache_shared_deinit().
+ * The caches get configured by libtls.session_cache_size and
+ * libtls.session_lifetime.
+ */
+void tls_cache_shared_init();
+
+/**
+ * Release a reference to the shared session caches, destroying them with the
+ * last reference.
+ */
+void tls_cache_shared_deinit();
+
+/**
+ * Get the session cache shared by all TLS stacks of a role.
+ *
+ * @param is_server			TRUE for the server role, FALSE for the peer role
+ * @return					shared cache, NULL if not initialized or disabled
+ */
+tls_cache_t *tls_cache_get_shared(bool is_server);
+
 #endif /** TLS_CACHE_H_ @}*/
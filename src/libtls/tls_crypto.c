@@ -17,6 +17,11 @@
 
 #include <utils/debug.h>
 
+/**
+ * Length of the implicit nonce part of AEAD suites (RFC 5288 salt)
+ */
+#define TLS_AEAD_SALT_LEN 4
+
 ENUM_BEGIN(tls_cipher_suite_names, TLS_NULL_WITH_NULL_NULL,
 								   TLS_DH_anon_WITH_3DES_EDE_CBC_SHA,
 	"TLS_NULL_WITH_NULL_NULL",
@@ -374,6 +379,16 @@ struct private_tls_crypto_t {
 	 */
 	tls_cache_t *cache;
 
+	/**
+	 * Session identifier to cache, once the handshake completed
+	 */
+	chunk_t session;
+
+	/**
+	 * Master secret of the session to cache
+	 */
+	chunk_t master;
+
 	/**
 	 * All handshake data concatentated
 	 */
@@ -404,6 +419,16 @@ struct private_tls_crypto_t {
 	 */
 	crypter_t *crypter_out;
 
+	/**
+	 * AEAD transform for inbound traffic, replaces signer/crypter
+	 */
+	aead_t *aead_in;
+
+	/**
+	 * AEAD transform for outbound traffic, replaces signer/crypter
+	 */
+	aead_t *aead_out;
+
 	/**
 	 * IV for input decryption, if < TLSv1.2
 	 */
@@ -440,6 +465,16 @@ typedef struct {
  * Mapping suites to a set of algorithms
  */
 static suite_algs_t suite_algs[] = {
+	{ TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+		KEY_ECDSA, ECP_256_BIT,
+		HASH_SHA256, PRF_HMAC_SHA2_256,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 16
+	},
+	{ TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+		KEY_ECDSA, ECP_384_BIT,
+		HASH_SHA384, PRF_HMAC_SHA2_384,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 32
+	},
 	{ TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA,
 		KEY_ECDSA, ECP_256_BIT,
 		HASH_SHA256, PRF_HMAC_SHA2_256,
@@ -460,6 +495,16 @@ static suite_algs_t suite_algs[] = {
 		HASH_SHA384, PRF_HMAC_SHA2_384,
 		AUTH_HMAC_SHA2_384_384, ENCR_AES_CBC, 32
 	},
+	{ TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+		KEY_RSA, ECP_256_BIT,
+		HASH_SHA256, PRF_HMAC_SHA2_256,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 16
+	},
+	{ TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+		KEY_RSA, ECP_384_BIT,
+		HASH_SHA384, PRF_HMAC_SHA2_384,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 32
+	},
 	{ TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA,
 		KEY_RSA, ECP_256_BIT,
 		HASH_SHA256, PRF_HMAC_SHA2_256,
@@ -480,6 +525,16 @@ static suite_algs_t suite_algs[] = {
 		HASH_SHA384, PRF_HMAC_SHA2_384,
 		AUTH_HMAC_SHA2_384_384, ENCR_AES_CBC, 32
 	},
+	{ TLS_DHE_RSA_WITH_AES_128_GCM_SHA256,
+		KEY_RSA, MODP_3072_BIT,
+		HASH_SHA256, PRF_HMAC_SHA2_256,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 16
+	},
+	{ TLS_DHE_RSA_WITH_AES_256_GCM_SHA384,
+		KEY_RSA, MODP_4096_BIT,
+		HASH_SHA384, PRF_HMAC_SHA2_384,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 32
+	},
 	{ TLS_DHE_RSA_WITH_AES_128_CBC_SHA,
 		KEY_RSA, MODP_2048_BIT,
 		HASH_SHA256,PRF_HMAC_SHA2_256,
@@ -525,6 +580,16 @@ static suite_algs_t suite_algs[] = {
 		HASH_SHA256, PRF_HMAC_SHA2_256,
 		AUTH_HMAC_SHA1_160, ENCR_3DES, 0
 	},
+	{ TLS_RSA_WITH_AES_128_GCM_SHA256,
+		KEY_RSA, MODP_NONE,
+		HASH_SHA256, PRF_HMAC_SHA2_256,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 16
+	},
+	{ TLS_RSA_WITH_AES_256_GCM_SHA384,
+		KEY_RSA, MODP_NONE,
+		HASH_SHA384, PRF_HMAC_SHA2_384,
+		AUTH_UNDEFINED, ENCR_AES_GCM_ICV16, 32
+	},
 	{ TLS_RSA_WITH_AES_128_CBC_SHA,
 		KEY_RSA, MODP_NONE,
 		HASH_SHA256, PRF_HMAC_SHA2_256,
@@ -641,12 +706,25 @@ static void filter_suite(private_tls_crypto_t *this,
 
 	for (i = 0; i < *count; i++)
 	{
+		if (create_enumerator == lib->crypto->create_crypter_enumerator &&
+			encryption_algorithm_is_aead(suites[i].encr))
+		{	/* filtering crypters, but suite uses an AEAD, keep it */
+			suites[remaining++] = suites[i];
+			continue;
+		}
+		if (create_enumerator == lib->crypto->create_aead_enumerator &&
+			!encryption_algorithm_is_aead(suites[i].encr))
+		{	/* filtering AEADs, but suite uses a crypter, keep it */
+			suites[remaining++] = suites[i];
+			continue;
+		}
 		enumerator = create_enumerator(lib->crypto);
 		while (enumerator->enumerate(enumerator, current_alg, &plugin_name))
 		{
 			if ((suites[i].encr == ENCR_NULL ||
 				 !current.encr || current.encr == suites[i].encr) &&
-				(!current.mac  || current.mac  == suites[i].mac) &&
+				(suites[i].mac == AUTH_UNDEFINED ||
+				 !current.mac  || current.mac  == suites[i].mac) &&
 				(!current.prf  || current.prf  == suites[i].prf) &&
 				(!current.hash || current.hash == suites[i].hash) &&
 				(suites[i].dh == MODP_NONE ||
@@ -787,6 +865,20 @@ static void filter_cipher_config_suites(private_tls_crypto_t *this,
 					suites[remaining++] = suites[i];
 					break;
 				}
+				if (strcaseeq(token, "aes128gcm") &&
+					suites[i].encr == ENCR_AES_GCM_ICV16 &&
+					suites[i].encr_size == 16)
+				{
+					suites[remaining++] = suites[i];
+					break;
+				}
+				if (strcaseeq(token, "aes256gcm") &&
+					suites[i].encr == ENCR_AES_GCM_ICV16 &&
+					suites[i].encr_size == 32)
+				{
+					suites[remaining++] = suites[i];
+					break;
+				}
 				if (strcaseeq(token, "camellia128") &&
 					suites[i].encr == ENCR_CAMELLIA_CBC &&
 					suites[i].encr_size == 16)
@@ -835,6 +927,11 @@ static void filter_mac_config_suites(private_tls_crypto_t *this,
 	{
 		for (i = 0; i < *count; i++)
 		{
+			if (suites[i].mac == AUTH_UNDEFINED)
+			{	/* AEAD suites use no separate MAC */
+				suites[remaining++] = suites[i];
+				continue;
+			}
 			enumerator = enumerator_create_token(config, ",", " ");
 			while (enumerator->enumerate(enumerator, &token))
 			{
@@ -930,6 +1027,8 @@ static void build_cipher_suite_list(private_tls_crypto_t *this,
 	/* filter suite list by each algorithm */
 	filter_suite(this, suites, &count, offsetof(suite_algs_t, encr),
 				 lib->crypto->create_crypter_enumerator);
+	filter_suite(this, suites, &count, offsetof(suite_algs_t, encr),
+				 lib->crypto->create_aead_enumerator);
 	filter_suite(this, suites, &count, offsetof(suite_algs_t, mac),
 				 lib->crypto->create_signer_enumerator);
 	filter_suite(this, suites, &count, offsetof(suite_algs_t, prf),
@@ -986,6 +1085,29 @@ static bool create_ciphers(private_tls_crypto_t *this, suite_algs_t *algs)
 
 	DESTROY_IF(this->signer_in);
 	DESTROY_IF(this->signer_out);
+	DESTROY_IF(this->crypter_in);
+	DESTROY_IF(this->crypter_out);
+	DESTROY_IF(this->aead_in);
+	DESTROY_IF(this->aead_out);
+	this->signer_in = this->signer_out = NULL;
+	this->crypter_in = this->crypter_out = NULL;
+	this->aead_in = this->aead_out = NULL;
+
+	if (encryption_algorithm_is_aead(algs->encr))
+	{
+		this->aead_in = lib->crypto->create_aead(lib->crypto,
+												algs->encr, algs->encr_size);
+		this->aead_out = lib->crypto->create_aead(lib->crypto,
+												algs->encr, algs->encr_size);
+		if (!this->aead_in || !this->aead_out)
+		{
+			DBG1(DBG_TLS, "selected TLS AEAD %N not supported",
+				 encryption_algorithm_names, algs->encr);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
 	this->signer_in = lib->crypto->create_signer(lib->crypto, algs->mac);
 	this->signer_out = lib->crypto->create_signer(lib->crypto, algs->mac);
 	if (!this->signer_in || !this->signer_out)
@@ -995,13 +1117,7 @@ static bool create_ciphers(private_tls_crypto_t *this, suite_algs_t *algs)
 		return FALSE;
 	}
 
-	DESTROY_IF(this->crypter_in);
-	DESTROY_IF(this->crypter_out);
-	if (algs->encr == ENCR_NULL)
-	{
-		this->crypter_in = this->crypter_out = NULL;
-	}
-	else
+	if (algs->encr != ENCR_NULL)
 	{
 		this->crypter_in = lib->crypto->create_crypter(lib->crypto,
 												algs->encr, algs->encr_size);
@@ -1031,6 +1147,11 @@ METHOD(tls_crypto_t, select_cipher_suite, tls_cipher_suite_t,
 			if (this->suites[i] == suites[j])
 			{
 				algs = find_suite(this->suites[i]);
+				if (algs && encryption_algorithm_is_aead(algs->encr) &&
+					this->tls->get_version(this->tls) < TLS_1_2)
+				{	/* AEAD suites are defined for TLSv1.2 only */
+					continue;
+				}
 				if (algs)
 				{
 					if (key == KEY_ANY || key == algs->key)
@@ -1476,8 +1597,8 @@ METHOD(tls_crypto_t, calculate_finished, bool,
  * Derive master secret from premaster, optionally save session
  */
 static bool derive_master(private_tls_crypto_t *this, chunk_t premaster,
-						  chunk_t session, identification_t *id,
-						  chunk_t client_random, chunk_t server_random)
+						  chunk_t session, chunk_t client_random,
+						  chunk_t server_random)
 {
 	char master[48];
 	chunk_t seed;
@@ -1494,14 +1615,45 @@ static bool derive_master(private_tls_crypto_t *this, chunk_t premaster,
 	}
 
 	if (this->cache && session.len)
-	{
-		this->cache->create(this->cache, session, id, chunk_from_thing(master),
-							this->suite);
+	{	/* cached once the handshake completed, see cache_session() */
+		chunk_clear(&this->master);
+		free(this->session.ptr);
+		this->master = chunk_clone(chunk_from_thing(master));
+		this->session = chunk_clone(session);
 	}
 	memwipe(master, sizeof(master));
 	return TRUE;
 }
 
+/**
+ * Set AEAD keys from a key block, with the implicit nonce parts appended
+ */
+static bool expand_aead_keys(private_tls_crypto_t *this, chunk_t block,
+							 int eks)
+{
+	chunk_t client_key, server_key, client_salt, server_salt;
+
+	client_key = chunk_create(block.ptr, eks);
+	block = chunk_skip(block, eks);
+	server_key = chunk_create(block.ptr, eks);
+	block = chunk_skip(block, eks);
+	client_salt = chunk_create(block.ptr, TLS_AEAD_SALT_LEN);
+	block = chunk_skip(block, TLS_AEAD_SALT_LEN);
+	server_salt = chunk_create(block.ptr, TLS_AEAD_SALT_LEN);
+
+	if (this->tls->is_server(this->tls))
+	{
+		return this->aead_in->set_key(this->aead_in,
+							chunk_cata("cc", client_key, client_salt)) &&
+			   this->aead_out->set_key(this->aead_out,
+							chunk_cata("cc", server_key, server_salt));
+	}
+	return this->aead_out->set_key(this->aead_out,
+							chunk_cata("cc", client_key, client_salt)) &&
+		   this->aead_in->set_key(this->aead_in,
+							chunk_cata("cc", server_key, server_salt));
+}
+
 /**
  * Expand key material from master secret
  */
@@ -1509,10 +1661,18 @@ static bool expand_keys(private_tls_crypto_t *this,
 						chunk_t client_random, chunk_t server_random)
 {
 	chunk_t seed, block, client_write, server_write;
-	int mks, eks = 0, ivs = 0;
+	int mks = 0, eks = 0, ivs = 0;
 
 	/* derive key block for key expansion */
-	mks = this->signer_out->get_key_size(this->signer_out);
+	if (this->aead_out)
+	{	/* the implicit nonce part is derived as IV, used as AEAD salt */
+		eks = this->aead_out->get_key_size(this->aead_out) - TLS_AEAD_SALT_LEN;
+		ivs = TLS_AEAD_SALT_LEN;
+	}
+	else
+	{
+		mks = this->signer_out->get_key_size(this->signer_out);
+	}
 	if (this->crypter_out)
 	{
 		eks = this->crypter_out->get_key_size(this->crypter_out);
@@ -1534,20 +1694,23 @@ static bool expand_keys(private_tls_crypto_t *this,
 	block = chunk_skip(block, mks);
 	server_write = chunk_create(block.ptr, mks);
 	block = chunk_skip(block, mks);
-	if (this->tls->is_server(this->tls))
+	if (this->signer_out && this->signer_in)
 	{
-		if (!this->signer_in->set_key(this->signer_in, client_write) ||
-			!this->signer_out->set_key(this->signer_out, server_write))
+		if (this->tls->is_server(this->tls))
 		{
-			return FALSE;
+			if (!this->signer_in->set_key(this->signer_in, client_write) ||
+				!this->signer_out->set_key(this->signer_out, server_write))
+			{
+				return FALSE;
+			}
 		}
-	}
-	else
-	{
-		if (!this->signer_out->set_key(this->signer_out, client_write) ||
-			!this->signer_in->set_key(this->signer_in, server_write))
+		else
 		{
-			return FALSE;
+			if (!this->signer_out->set_key(this->signer_out, client_write) ||
+				!this->signer_in->set_key(this->signer_in, server_write))
+			{
+				return FALSE;
+			}
 		}
 	}
 
@@ -1595,6 +1758,15 @@ static bool expand_keys(private_tls_crypto_t *this,
 		}
 	}
 
+	/* AEAD keys, followed by the implicit nonce parts */
+	if (this->aead_out && this->aead_in)
+	{
+		if (!expand_aead_keys(this, block, eks))
+		{
+			return FALSE;
+		}
+	}
+
 	/* EAP-MSK */
 	if (this->msk_label)
 	{
@@ -1611,13 +1783,25 @@ static bool expand_keys(private_tls_crypto_t *this,
 
 METHOD(tls_crypto_t, derive_secrets, bool,
 	private_tls_crypto_t *this, chunk_t premaster, chunk_t session,
-	identification_t *id, chunk_t client_random, chunk_t server_random)
+	chunk_t client_random, chunk_t server_random)
 {
-	return derive_master(this, premaster, session, id,
+	return derive_master(this, premaster, session,
 						 client_random, server_random) &&
 		   expand_keys(this, client_random, server_random);
 }
 
+METHOD(tls_crypto_t, cache_session, void,
+	private_tls_crypto_t *this, identification_t *id)
+{
+	if (this->cache && this->session.len)
+	{
+		this->cache->create(this->cache, this->session, id, this->master,
+							this->suite);
+	}
+	chunk_free(&this->session);
+	chunk_clear(&this->master);
+}
+
 METHOD(tls_crypto_t, resume_session, tls_cipher_suite_t,
 	private_tls_crypto_t *this, chunk_t session, identification_t *id,
 	chunk_t client_random, chunk_t server_random)
@@ -1663,12 +1847,14 @@ METHOD(tls_crypto_t, change_cipher, void,
 		if (inbound)
 		{
 			this->protection->set_cipher(this->protection, TRUE,
-							this->signer_in, this->crypter_in, this->iv_in);
+							this->signer_in, this->crypter_in, this->aead_in,
+							this->iv_in);
 		}
 		else
 		{
 			this->protection->set_cipher(this->protection, FALSE,
-							this->signer_out, this->crypter_out, this->iv_out);
+							this->signer_out, this->crypter_out, this->aead_out,
+							this->iv_out);
 		}
 	}
 }
@@ -1686,9 +1872,13 @@ METHOD(tls_crypto_t, destroy, void,
 	DESTROY_IF(this->signer_out);
 	DESTROY_IF(this->crypter_in);
 	DESTROY_IF(this->crypter_out);
+	DESTROY_IF(this->aead_in);
+	DESTROY_IF(this->aead_out);
 	free(this->iv_in.ptr);
 	free(this->iv_out.ptr);
 	free(this->handshake.ptr);
+	free(this->session.ptr);
+	chunk_clear(&this->master);
 	free(this->msk.ptr);
 	DESTROY_IF(this->prf);
 	free(this->suites);
@@ -1720,6 +1910,7 @@ tls_crypto_t *tls_crypto_create(tls_t *tls, tls_cache_t *cache)
 			.verify_handshake = _verify_handshake,
 			.calculate_finished = _calculate_finished,
 			.derive_secrets = _derive_secrets,
+			.cache_session = _cache_session,
 			.resume_session = _resume_session,
 			.get_session = _get_session,
 			.change_cipher = _change_cipher,
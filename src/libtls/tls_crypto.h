@@ -512,14 +512,23 @@ struct tls_crypto_t {
 	 *
 	 * @param premaster		premaster secret
 	 * @param session		session identifier to cache master secret
-	 * @param id			identity the session is bound to
 	 * @param client_random	random data from client hello
 	 * @param server_random	random data from server hello
 	 * @return				TRUE if secrets derived successfully
 	 */
 	bool (*derive_secrets)(tls_crypto_t *this, chunk_t premaster,
-						   chunk_t session, identification_t *id,
-						   chunk_t client_random, chunk_t server_random);
+						   chunk_t session, chunk_t client_random,
+						   chunk_t server_random);
+
+	/**
+	 * Store the session of derive_secrets() in the session cache.
+	 *
+	 * This must get called only after the handshake has been completed, as
+	 * resuming the session skips authentication of the bound identity.
+	 *
+	 * @param id			authenticated identity to bind the session to
+	 */
+	void (*cache_session)(tls_crypto_t *this, identification_t *id);
 
 	/**
 	 * Try to resume a TLS session, derive key material.
@@ -87,6 +87,11 @@ struct private_tls_fragmentation_t {
 	 */
 	chunk_t output;
 
+	/**
+	 * Position in output buffer
+	 */
+	size_t outpos;
+
 	/**
 	 * Type of data in output buffer
 	 */
@@ -310,7 +315,7 @@ static status_t build_handshake(private_tls_fragmentation_t *this)
 	tls_handshake_type_t type;
 	status_t status;
 
-	msg = bio_writer_create(64);
+	msg = bio_writer_create(TLS_MAX_FRAGMENT_LEN);
 	while (TRUE)
 	{
 		hs = bio_writer_create(64);
@@ -354,7 +359,7 @@ static status_t build_application(private_tls_fragmentation_t *this)
 	bio_writer_t *msg;
 	status_t status;
 
-	msg = bio_writer_create(64);
+	msg = bio_writer_create(TLS_MAX_FRAGMENT_LEN);
 	while (TRUE)
 	{
 		status = this->application->build(this->application, msg);
@@ -364,7 +369,11 @@ static status_t build_application(private_tls_fragmentation_t *this)
 				continue;
 			case INVALID_STATE:
 				this->output_type = TLS_APPLICATION_DATA;
-				this->output = chunk_clone(msg->get_buf(msg));
+				this->output = msg->extract_buf(msg);
+				if (!this->output.len)
+				{
+					chunk_free(&this->output);
+				}
 				break;
 			case SUCCESS:
 				this->application_finished = TRUE;
@@ -384,6 +393,7 @@ METHOD(tls_fragmentation_t, build, status_t,
 	private_tls_fragmentation_t *this, tls_content_type_t *type, chunk_t *data)
 {
 	status_t status = INVALID_STATE;
+	size_t len;
 
 	switch (this->state)
 	{
@@ -432,14 +442,20 @@ METHOD(tls_fragmentation_t, build, status_t,
 	if (this->output.len)
 	{
 		*type = this->output_type;
-		if (this->output.len <= TLS_MAX_FRAGMENT_LEN)
-		{
+		len = min(this->output.len - this->outpos, TLS_MAX_FRAGMENT_LEN);
+		if (len == this->output.len)
+		{	/* fits in a single record, pass on the buffer */
 			*data = this->output;
 			this->output = chunk_empty;
 			return NEED_MORE;
 		}
-		*data = chunk_create(this->output.ptr, TLS_MAX_FRAGMENT_LEN);
-		this->output = chunk_clone(chunk_skip(this->output, TLS_MAX_FRAGMENT_LEN));
+		*data = chunk_clone(chunk_create(this->output.ptr + this->outpos, len));
+		this->outpos += len;
+		if (this->outpos == this->output.len)
+		{
+			chunk_free(&this->output);
+			this->outpos = 0;
+		}
 		return NEED_MORE;
 	}
 	return status;
@@ -629,6 +629,7 @@ static status_t process_finished(private_tls_peer_t *this, bio_reader_t *reader)
 	}
 	this->state = STATE_FINISHED_RECEIVED;
 	this->crypto->append_handshake(this->crypto, TLS_FINISHED, received);
+	this->crypto->cache_session(this->crypto, this->server);
 
 	return NEED_MORE;
 }
@@ -920,7 +921,7 @@ static status_t send_key_exchange_encrypt(private_tls_peer_t *this,
 	htoun16(premaster, TLS_1_2);
 
 	if (!this->crypto->derive_secrets(this->crypto, chunk_from_thing(premaster),
-									  this->session, this->server,
+									  this->session,
 									  chunk_from_thing(this->client_random),
 									  chunk_from_thing(this->server_random)))
 	{
@@ -969,7 +970,7 @@ static status_t send_key_exchange_dhe(private_tls_peer_t *this,
 		return NEED_MORE;
 	}
 	if (!this->crypto->derive_secrets(this->crypto, premaster,
-									  this->session, this->server,
+									  this->session,
 									  chunk_from_thing(this->client_random),
 									  chunk_from_thing(this->server_random)))
 	{
@@ -79,6 +79,16 @@ struct private_tls_protection_t {
 	 */
 	crypter_t *crypter_out;
 
+	/**
+	 * AEAD transform for inbound traffic, replaces signer/crypter
+	 */
+	aead_t *aead_in;
+
+	/**
+	 * AEAD transform for outbound traffic, replaces signer/crypter
+	 */
+	aead_t *aead_out;
+
 	/**
 	 * Current IV for input decryption
 	 */
@@ -90,29 +100,179 @@ struct private_tls_protection_t {
 	chunk_t iv_out;
 };
 
+/**
+ * Record header as authenticated by MACs and AEADs
+ */
+typedef struct __attribute__((__packed__)) {
+	u_int32_t seq_high;
+	u_int32_t seq_low;
+	u_int8_t type;
+	u_int16_t version;
+	u_int16_t length;
+} sigheader_t;
+
+/**
+ * Fill in a record header to authenticate
+ */
+static void build_sigheader(sigheader_t *header, u_int32_t seq, u_int8_t type,
+							u_int16_t version, u_int16_t length)
+{
+	/* we only support 32 bit sequence numbers, but TLS uses 64 bit */
+	header->seq_high = 0;
+	htoun32(&header->seq_low, seq);
+	header->type = type;
+	htoun16(&header->version, version);
+	htoun16(&header->length, length);
+}
+
 /**
  * Create the header and feed it into a signer for MAC verification
  */
 static bool sigheader(signer_t *signer, u_int32_t seq, u_int8_t type,
 					  u_int16_t version, u_int16_t length)
 {
-	/* we only support 32 bit sequence numbers, but TLS uses 64 bit */
-	struct __attribute__((__packed__)) {
-		u_int32_t seq_high;
-		u_int32_t seq_low;
-		u_int8_t type;
-		u_int16_t version;
-		u_int16_t length;
-	} header = {
-		.type = type,
-	};
-	htoun32(&header.seq_low, seq);
-	htoun16(&header.version, version);
-	htoun16(&header.length, length);
+	sigheader_t header;
 
+	build_sigheader(&header, seq, type, version, length);
 	return signer->get_signature(signer, chunk_from_thing(header), NULL);
 }
 
+/**
+ * Decrypt and verify an AEAD protected record in place
+ */
+static bool decrypt_aead(private_tls_protection_t *this,
+						 tls_content_type_t type, chunk_t *data)
+{
+	sigheader_t header;
+	chunk_t iv;
+	size_t icv;
+
+	iv.len = this->aead_in->get_iv_size(this->aead_in);
+	icv = this->aead_in->get_icv_size(this->aead_in);
+	if (data->len < iv.len + icv)
+	{
+		DBG1(DBG_TLS, "encrypted TLS record length invalid");
+		return FALSE;
+	}
+	/* the explicit nonce part is prepended to the record */
+	iv.ptr = data->ptr;
+	*data = chunk_skip(*data, iv.len);
+
+	build_sigheader(&header, this->seq_in, type, this->version,
+					data->len - icv);
+	if (!this->aead_in->decrypt(this->aead_in, *data,
+								chunk_from_thing(header), iv, NULL))
+	{
+		DBG1(DBG_TLS, "TLS record decryption failed");
+		return FALSE;
+	}
+	data->len -= icv;
+	return TRUE;
+}
+
+/**
+ * Build an AEAD protected record, encrypted in its final buffer
+ */
+static bool encrypt_aead(private_tls_protection_t *this,
+						 tls_content_type_t type, chunk_t *data)
+{
+	sigheader_t header;
+	chunk_t record, iv, plain;
+	size_t icv;
+
+	iv.len = this->aead_out->get_iv_size(this->aead_out);
+	icv = this->aead_out->get_icv_size(this->aead_out);
+
+	record = chunk_alloc(iv.len + data->len + icv);
+	/* the sequence number is unique for a key, use it as explicit nonce */
+	iv.ptr = record.ptr;
+	memset(iv.ptr, 0, iv.len);
+	htoun32(iv.ptr + iv.len - sizeof(u_int32_t), this->seq_out);
+	plain = chunk_create(record.ptr + iv.len, data->len);
+	memcpy(plain.ptr, data->ptr, data->len);
+	build_sigheader(&header, this->seq_out, type, this->version, plain.len);
+	chunk_free(data);
+
+	/* the ICV gets appended to the plain data */
+	if (!this->aead_out->encrypt(this->aead_out, plain,
+								 chunk_from_thing(header), iv, NULL))
+	{
+		chunk_free(&record);
+		return FALSE;
+	}
+	*data = record;
+	return TRUE;
+}
+
+/**
+ * Build a MAC protected, optionally CBC encrypted record in a single buffer
+ */
+static bool encrypt_cbc(private_tls_protection_t *this,
+						tls_content_type_t type, chunk_t *data)
+{
+	chunk_t record, iv = chunk_empty;
+	u_int8_t bs, padding_length = 0;
+	size_t mac, padding = 0, len = data->len;
+	u_char *pos;
+
+	mac = this->signer_out->get_block_size(this->signer_out);
+	if (this->crypter_out)
+	{
+		bs = this->crypter_out->get_block_size(this->crypter_out);
+		padding_length = bs - ((len + mac + 1) % bs);
+		padding = padding_length + 1;
+		if (!this->iv_out.len)
+		{	/* TLSv1.1 uses random IVs, prepended to record */
+			iv.len = this->crypter_out->get_iv_size(this->crypter_out);
+		}
+	}
+
+	record = chunk_alloc(iv.len + len + mac + padding);
+	pos = record.ptr + iv.len;
+	memcpy(pos, data->ptr, len);
+	chunk_free(data);
+
+	if (!sigheader(this->signer_out, this->seq_out, type, this->version, len) ||
+		!this->signer_out->get_signature(this->signer_out,
+										 chunk_create(pos, len), pos + len))
+	{
+		chunk_free(&record);
+		return FALSE;
+	}
+	if (this->crypter_out)
+	{
+		memset(pos + len + mac, padding_length, padding);
+		if (iv.len)
+		{
+			iv.ptr = record.ptr;
+			if (!this->rng || !this->rng->get_bytes(this->rng, iv.len, iv.ptr))
+			{
+				DBG1(DBG_TLS, "failed to generate TLS IV");
+				chunk_free(&record);
+				return FALSE;
+			}
+		}
+		else
+		{	/* < TLSv1.1 uses IV from key derivation/last block */
+			iv = this->iv_out;
+		}
+		/* encrypt inline */
+		if (!this->crypter_out->encrypt(this->crypter_out,
+							chunk_skip(record, iv.len), iv, NULL))
+		{
+			chunk_free(&record);
+			return FALSE;
+		}
+		if (this->iv_out.len)
+		{	/* next record IV is last ciphertext block of this record */
+			memcpy(this->iv_out.ptr, record.ptr + record.len -
+				   this->iv_out.len, this->iv_out.len);
+		}
+	}
+	*data = record;
+	return TRUE;
+}
+
 METHOD(tls_protection_t, process, status_t,
 	private_tls_protection_t *this, tls_content_type_t type, chunk_t data)
 {
@@ -121,7 +281,15 @@ METHOD(tls_protection_t, process, status_t,
 		return NEED_MORE;
 	}
 
-	if (this->crypter_in)
+	if (this->aead_in)
+	{
+		if (!decrypt_aead(this, type, &data))
+		{
+			this->alert->add(this->alert, TLS_FATAL, TLS_BAD_RECORD_MAC);
+			return NEED_MORE;
+		}
+	}
+	else if (this->crypter_in)
 	{
 		chunk_t iv, next_iv = chunk_empty;
 		u_int8_t bs, padding_length;
@@ -136,7 +304,8 @@ METHOD(tls_protection_t, process, status_t,
 				return NEED_MORE;
 			}
 			iv = this->iv_in;
-			next_iv = chunk_clone(chunk_create(data.ptr + data.len - bs, bs));
+			next_iv = chunk_alloca(bs);
+			memcpy(next_iv.ptr, data.ptr + data.len - bs, bs);
 		}
 		else
 		{	/* TLSv1.1 uses random IVs, prepended to record */
@@ -152,7 +321,6 @@ METHOD(tls_protection_t, process, status_t,
 		}
 		if (!this->crypter_in->decrypt(this->crypter_in, data, iv, NULL))
 		{
-			free(next_iv.ptr);
 			this->alert->add(this->alert, TLS_FATAL, TLS_BAD_RECORD_MAC);
 			return NEED_MORE;
 		}
@@ -160,7 +328,6 @@ METHOD(tls_protection_t, process, status_t,
 		if (next_iv.len)
 		{	/* next record IV is last ciphertext block of this record */
 			memcpy(this->iv_in.ptr, next_iv.ptr, next_iv.len);
-			free(next_iv.ptr);
 		}
 
 		padding_length = data.ptr[data.len - 1];
@@ -220,71 +387,18 @@ METHOD(tls_protection_t, build, status_t,
 
 	if (status == NEED_MORE)
 	{
-		if (this->signer_out)
+		if (this->aead_out)
 		{
-			chunk_t mac;
-
-			if (!sigheader(this->signer_out, this->seq_out, *type,
-						   this->version, data->len) ||
-				!this->signer_out->allocate_signature(this->signer_out,
-						   *data, &mac))
+			if (!encrypt_aead(this, *type, data))
 			{
 				return FAILED;
 			}
-			if (this->crypter_out)
+		}
+		else if (this->signer_out)
+		{
+			if (!encrypt_cbc(this, *type, data))
 			{
-				chunk_t padding, iv;
-				u_int8_t bs, padding_length;
-
-				bs = this->crypter_out->get_block_size(this->crypter_out);
-				padding_length = bs - ((data->len + mac.len + 1) % bs);
-
-				padding = chunk_alloca(padding_length);
-				memset(padding.ptr, padding_length, padding.len);
-
-				if (this->iv_out.len)
-				{	/* < TLSv1.1 uses IV from key derivation/last block */
-					iv = this->iv_out;
-				}
-				else
-				{	/* TLSv1.1 uses random IVs, prepended to record */
-					iv.len = this->crypter_out->get_iv_size(this->crypter_out);
-					if (!this->rng ||
-						!this->rng->allocate_bytes(this->rng, iv.len, &iv))
-					{
-						DBG1(DBG_TLS, "failed to generate TLS IV");
-						free(data->ptr);
-						return FAILED;
-					}
-				}
-
-				*data = chunk_cat("mmcc", *data, mac, padding,
-								  chunk_from_thing(padding_length));
-				/* encrypt inline */
-				if (!this->crypter_out->encrypt(this->crypter_out, *data,
-												iv, NULL))
-				{
-					if (!this->iv_out.len)
-					{
-						free(iv.ptr);
-					}
-					free(data->ptr);
-					return FAILED;
-				}
-
-				if (this->iv_out.len)
-				{	/* next record IV is last ciphertext block of this record */
-					memcpy(this->iv_out.ptr, data->ptr + data->len -
-						   this->iv_out.len, this->iv_out.len);
-				}
-				else
-				{	/* prepend IV */
-					*data = chunk_cat("mm", iv, *data);
-				}
-			}
-			else
-			{	/* NULL encryption */
-				*data = chunk_cat("mm", *data, mac);
+				return FAILED;
 			}
 		}
 		this->seq_out++;
@@ -294,20 +408,22 @@ METHOD(tls_protection_t, build, status_t,
 
 METHOD(tls_protection_t, set_cipher, void,
 	private_tls_protection_t *this, bool inbound, signer_t *signer,
-	crypter_t *crypter, chunk_t iv)
+	crypter_t *crypter, aead_t *aead, chunk_t iv)
 {
 	if (inbound)
 	{
 		this->signer_in = signer;
 		this->crypter_in = crypter;
+		this->aead_in = aead;
 		this->iv_in = iv;
 	}
 	else
 	{
 		this->signer_out = signer;
 		this->crypter_out = crypter;
+		this->aead_out = aead;
 		this->iv_out = iv;
-		if (!iv.len)
+		if (!iv.len && crypter && !this->rng)
 		{	/* generate IVs if none given */
 			this->rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK);
 		}
@@ -64,13 +64,16 @@ struct tls_protection_t {
 	/**
 	 * Set a new cipher, including encryption and integrity algorithms.
 	 *
+	 * AEAD suites pass an aead_t and no signer/crypter.
+	 *
 	 * @param inbound	TRUE to use cipher for inbound data, FALSE for outbound
 	 * @param signer	new signer to use, gets owned by protection layer
 	 * @param crypter	new crypter to use, gets owned by protection layer
+	 * @param aead		new AEAD to use, gets owned by protection layer
 	 * @param iv		initial IV for crypter, gets owned by protection layer
 	 */
 	void (*set_cipher)(tls_protection_t *this, bool inbound, signer_t *signer,
-					   crypter_t *crypter, chunk_t iv);
+					   crypter_t *crypter, aead_t *aead, chunk_t iv);
 
 	/**
 	 * Set the TLS version negotiated, used for MAC calculation.
@@ -450,7 +450,7 @@ static status_t process_key_exchange_encrypted(private_tls_server_t *this,
 	}
 
 	if (!this->crypto->derive_secrets(this->crypto, chunk_from_thing(premaster),
-									  this->session, this->peer,
+									  this->session,
 									  chunk_from_thing(this->client_random),
 									  chunk_from_thing(this->server_random)))
 	{
@@ -503,7 +503,7 @@ static status_t process_key_exchange_dhe(private_tls_server_t *this,
 	}
 
 	if (!this->crypto->derive_secrets(this->crypto, premaster,
-									  this->session, this->peer,
+									  this->session,
 									  chunk_from_thing(this->client_random),
 									  chunk_from_thing(this->server_random)))
 	{
@@ -609,6 +609,7 @@ static status_t process_finished(private_tls_server_t *this,
 	}
 
 	this->crypto->append_handshake(this->crypto, TLS_FINISHED, received);
+	this->crypto->cache_session(this->crypto, this->peer);
 	this->state = STATE_FINISHED_RECEIVED;
 	return NEED_MORE;
 }
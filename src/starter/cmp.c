@@ -64,3 +64,45 @@ bool starter_cmp_ca(starter_ca_t *c1, starter_ca_t *c2)
 
 	return cmp_args(KW_CA_NAME, KW_CA_LAST, (char *)c1, (char *)c2);
 }
+
+void starter_cmp_config(starter_config_t *old, starter_config_t *new)
+{
+	starter_conn_t *conn, *conn2;
+	starter_ca_t *ca, *ca2;
+
+	/* only sections with the same name can be equal, look them up by name */
+	for (conn = old->conn_first; conn; conn = conn->next)
+	{
+		if (conn->state == STATE_ADDED)
+		{
+			conn2 = new->conns->get(new->conns, conn->name);
+			for (; conn2; conn2 = conn2->same_name)
+			{
+				if (conn2->state == STATE_TO_ADD && starter_cmp_conn(conn, conn2))
+				{
+					conn->state = STATE_REPLACED;
+					conn2->state = STATE_ADDED;
+					conn2->id = conn->id;
+					break;
+				}
+			}
+		}
+	}
+
+	for (ca = old->ca_first; ca; ca = ca->next)
+	{
+		if (ca->state == STATE_ADDED)
+		{
+			ca2 = new->cas->get(new->cas, ca->name);
+			for (; ca2; ca2 = ca2->same_name)
+			{
+				if (ca2->state == STATE_TO_ADD && starter_cmp_ca(ca, ca2))
+				{
+					ca->state = STATE_REPLACED;
+					ca2->state = STATE_ADDED;
+					break;
+				}
+			}
+		}
+	}
+}
@@ -18,5 +18,11 @@
 bool starter_cmp_conn(starter_conn_t *c1, starter_conn_t *c2);
 bool starter_cmp_ca(starter_ca_t *c1, starter_ca_t *c2);
 
+/**
+ * Mark conn and ca sections of a new config that are unchanged from the
+ * old config as added, and the old ones as replaced.
+ */
+void starter_cmp_config(starter_config_t *old, starter_config_t *new);
+
 #endif
 
@@ -677,23 +677,19 @@ static void load_also_conns(starter_conn_t *conn, also_t *also,
 static kw_list_t* find_also_conn(const char* name, starter_conn_t *conn,
 								 starter_config_t *cfg)
 {
-	starter_conn_t *c = cfg->conn_first;
+	starter_conn_t *c = cfg->conns->get(cfg->conns, (char*)name);
 
-	while (c != NULL)
+	if (c != NULL)
 	{
-		if (streq(name, c->name))
+		if (conn->visit == c->visit)
 		{
-			if (conn->visit == c->visit)
-			{
-				DBG1(DBG_APP, "# detected also loop");
-				cfg->err++;
-				return NULL;
-			}
-			c->visit = conn->visit;
-			load_also_conns(conn, c->also, cfg);
-			return c->kw;
+			DBG1(DBG_APP, "# detected also loop");
+			cfg->err++;
+			return NULL;
 		}
-		c = c->next;
+		c->visit = conn->visit;
+		load_also_conns(conn, c->also, cfg);
+		return c->kw;
 	}
 
 	DBG1(DBG_APP, "# also '%s' not found", name);
@@ -732,23 +728,19 @@ static void load_also_cas(starter_ca_t *ca, also_t *also, starter_config_t *cfg)
 static kw_list_t* find_also_ca(const char* name, starter_ca_t *ca,
 							   starter_config_t *cfg)
 {
-	starter_ca_t *c = cfg->ca_first;
+	starter_ca_t *c = cfg->cas->get(cfg->cas, (char*)name);
 
-	while (c != NULL)
+	if (c != NULL)
 	{
-		if (streq(name, c->name))
+		if (ca->visit == c->visit)
 		{
-			if (ca->visit == c->visit)
-			{
-				DBG1(DBG_APP, "# detected also loop");
-				cfg->err++;
-				return NULL;
-			}
-			c->visit = ca->visit;
-			load_also_cas(ca, c->also, cfg);
-			return c->kw;
+			DBG1(DBG_APP, "# detected also loop");
+			cfg->err++;
+			return NULL;
 		}
-		c = c->next;
+		c->visit = ca->visit;
+		load_also_cas(ca, c->also, cfg);
+		return c->kw;
 	}
 
 	DBG1(DBG_APP, "# also '%s' not found", name);
@@ -756,6 +748,44 @@ static kw_list_t* find_also_ca(const char* name, starter_ca_t *ca,
 	return NULL;
 }
 
+/*
+ * add a conn to the index of conns by name
+ */
+static void index_conn(starter_config_t *cfg, starter_conn_t *conn)
+{
+	starter_conn_t *c = cfg->conns->get(cfg->conns, conn->name);
+
+	if (c == NULL)
+	{
+		cfg->conns->put(cfg->conns, conn->name, conn);
+		return;
+	}
+	while (c->same_name != NULL)
+	{
+		c = c->same_name;
+	}
+	c->same_name = conn;
+}
+
+/*
+ * add a ca to the index of cas by name
+ */
+static void index_ca(starter_config_t *cfg, starter_ca_t *ca)
+{
+	starter_ca_t *c = cfg->cas->get(cfg->cas, ca->name);
+
+	if (c == NULL)
+	{
+		cfg->cas->put(cfg->cas, ca->name, ca);
+		return;
+	}
+	while (c->same_name != NULL)
+	{
+		c = c->same_name;
+	}
+	c->same_name = ca;
+}
+
 /*
  * free the memory used by also_t objects
  */
@@ -802,6 +832,9 @@ void confread_free(starter_config_t *cfg)
 
 	free_args(KW_SETUP_FIRST, KW_SETUP_LAST, (char *)cfg);
 
+	cfg->conns->destroy(cfg->conns);
+	cfg->cas->destroy(cfg->cas);
+
 	confread_free_conn(&cfg->conn_default);
 
 	while (conn != NULL)
@@ -852,6 +885,9 @@ starter_config_t* confread_load(const char *file)
 	/* set default values */
 	default_values(cfg);
 
+	cfg->cas = hashtable_create(hashtable_hash_str, hashtable_equals_str, 32);
+	cfg->conns = hashtable_create(hashtable_hash_str, hashtable_equals_str, 32);
+
 	/* load config setup section */
 	load_setup(cfg, cfgp);
 
@@ -904,6 +940,7 @@ starter_config_t* confread_load(const char *file)
 			cfg->ca_last = ca;
 			if (!cfg->ca_first)
 				cfg->ca_first = ca;
+			index_ca(cfg, ca);
 		}
 	}
 
@@ -971,6 +1008,7 @@ starter_config_t* confread_load(const char *file)
 			cfg->conn_last = conn;
 			if (!cfg->conn_first)
 				cfg->conn_first = conn;
+			index_conn(cfg, conn);
 		}
 	}
 
@@ -17,6 +17,7 @@
 #define _IPSEC_CONFREAD_H_
 
 #include <kernel/kernel_ipsec.h>
+#include <collections/hashtable.h>
 
 #include "ipsec-parser.h"
 
@@ -186,6 +187,9 @@ struct starter_conn {
 		char            *me_mediated_by;
 		char            *me_peerid;
 
+		/* next conn with the same name, if any */
+		starter_conn_t *same_name;
+
 		starter_conn_t *next;
 };
 
@@ -209,6 +213,9 @@ struct starter_ca {
 
 		bool            strict;
 
+		/* next ca with the same name, if any */
+		starter_ca_t    *same_name;
+
 		starter_ca_t    *next;
 };
 
@@ -242,6 +249,12 @@ struct starter_config {
 
 		/* connections list (without %default) */
 		starter_conn_t *conn_first, *conn_last;
+
+		/* ca sections by name, first of those with the same name */
+		hashtable_t *cas;
+
+		/* conn sections by name, first of those with the same name */
+		hashtable_t *conns;
 };
 
 extern starter_config_t *confread_load(const char *file);
@@ -404,8 +404,8 @@ int main (int argc, char **argv)
 {
 	starter_config_t *cfg = NULL;
 	starter_config_t *new_cfg;
-	starter_conn_t *conn, *conn2;
-	starter_ca_t *ca, *ca2;
+	starter_conn_t *conn;
+	starter_ca_t *ca;
 
 	struct sigaction action;
 	struct stat stb;
@@ -681,6 +681,7 @@ int main (int argc, char **argv)
 		{
 			if (starter_charon_pid())
 			{
+				starter_stroke_bulk_begin();
 				for (conn = cfg->conn_first; conn; conn = conn->next)
 				{
 					if (conn->state == STATE_ADDED)
@@ -707,6 +708,7 @@ int main (int argc, char **argv)
 						ca->state = STATE_TO_ADD;
 					}
 				}
+				starter_stroke_bulk_end();
 			}
 			_action_ &= ~FLAG_ACTION_RELOAD;
 		}
@@ -723,24 +725,10 @@ int main (int argc, char **argv)
 			{
 				/* Switch to new config. New conn will be loaded below */
 
-				/* Look for new connections that are already loaded */
-				for (conn = cfg->conn_first; conn; conn = conn->next)
-				{
-					if (conn->state == STATE_ADDED)
-					{
-						for (conn2 = new_cfg->conn_first; conn2; conn2 = conn2->next)
-						{
-							if (conn2->state == STATE_TO_ADD && starter_cmp_conn(conn, conn2))
-							{
-								conn->state = STATE_REPLACED;
-								conn2->state = STATE_ADDED;
-								conn2->id = conn->id;
-								break;
-							}
-						}
-					}
-				}
+				/* Look for new conn and ca sections that are already loaded */
+				starter_cmp_config(cfg, new_cfg);
 
+				starter_stroke_bulk_begin();
 				/* Remove conn sections that have become unused */
 				for (conn = cfg->conn_first; conn; conn = conn->next)
 				{
@@ -757,23 +745,6 @@ int main (int argc, char **argv)
 					}
 				}
 
-				/* Look for new ca sections that are already loaded */
-				for (ca = cfg->ca_first; ca; ca = ca->next)
-				{
-					if (ca->state == STATE_ADDED)
-					{
-						for (ca2 = new_cfg->ca_first; ca2; ca2 = ca2->next)
-						{
-							if (ca2->state == STATE_TO_ADD && starter_cmp_ca(ca, ca2))
-							{
-								ca->state = STATE_REPLACED;
-								ca2->state = STATE_ADDED;
-								break;
-							}
-						}
-					}
-				}
-
 				/* Remove ca sections that have become unused */
 				for (ca = cfg->ca_first; ca; ca = ca->next)
 				{
@@ -785,6 +756,7 @@ int main (int argc, char **argv)
 						}
 					}
 				}
+				starter_stroke_bulk_end();
 				confread_free(cfg);
 				cfg = new_cfg;
 			}
@@ -839,6 +811,7 @@ int main (int argc, char **argv)
 		 */
 		if (starter_charon_pid())
 		{
+			starter_stroke_bulk_begin();
 			for (ca = cfg->ca_first; ca; ca = ca->next)
 			{
 				if (ca->state == STATE_TO_ADD)
@@ -882,6 +855,7 @@ int main (int argc, char **argv)
 					}
 				}
 			}
+			starter_stroke_bulk_end();
 		}
 
 		/*
@@ -54,7 +54,47 @@ static char* push_string(stroke_msg_t *msg, char *string)
 	}
 }
 
-static int send_stroke_msg (stroke_msg_t *msg)
+/**
+ * Buffer for stroke messages queued for a bulk
+ */
+typedef struct {
+	char *ptr;
+	size_t len;
+	size_t size;
+} bulk_buffer_t;
+
+/**
+ * Stroke messages queued while in bulk mode
+ */
+static struct {
+	/** TRUE if messages get queued */
+	bool active;
+	/** number of queued messages */
+	int count;
+	/** queued messages changing the configuration */
+	bulk_buffer_t config;
+	/** queued route/initiate messages, sent after all config changes */
+	bulk_buffer_t actions;
+} bulk;
+
+/**
+ * Append data to a bulk buffer
+ */
+static void bulk_append(bulk_buffer_t *buf, void *data, size_t len)
+{
+	if (buf->len + len > buf->size)
+	{
+		buf->size = max(buf->size * 2, buf->len + len);
+		buf->ptr = realloc(buf->ptr, buf->size);
+	}
+	memcpy(buf->ptr + buf->len, data, len);
+	buf->len += len;
+}
+
+/**
+ * Send data to charon and log its reply
+ */
+static int send_stroke_data(void *data, size_t len)
 {
 	struct sockaddr_un ctl_addr;
 	int byte_count;
@@ -63,9 +103,6 @@ static int send_stroke_msg (stroke_msg_t *msg)
 	ctl_addr.sun_family = AF_UNIX;
 	strcpy(ctl_addr.sun_path, CHARON_CTL_FILE);
 
-	/* starter is not called from commandline, and therefore absolutely silent */
-	msg->output_verbosity = -1;
-
 	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
 
 	if (sock < 0)
@@ -81,11 +118,21 @@ static int send_stroke_msg (stroke_msg_t *msg)
 	}
 
 	/* send message */
-	if (write(sock, msg, msg->length) != msg->length)
+	while (len)
 	{
-		DBG1(DBG_APP, "write(charon_ctl) failed: %s", strerror(errno));
-		close(sock);
-		return -1;
+		byte_count = write(sock, data, len);
+		if (byte_count <= 0)
+		{
+			if (byte_count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			DBG1(DBG_APP, "write(charon_ctl) failed: %s", strerror(errno));
+			close(sock);
+			return -1;
+		}
+		data += byte_count;
+		len -= byte_count;
 	}
 	while ((byte_count = read(sock, buffer, sizeof(buffer)-1)) > 0)
 	{
@@ -101,6 +148,69 @@ static int send_stroke_msg (stroke_msg_t *msg)
 	return 0;
 }
 
+static int send_stroke_msg (stroke_msg_t *msg)
+{
+	/* starter is not called from commandline, and therefore absolutely silent */
+	msg->output_verbosity = -1;
+
+	if (bulk.active)
+	{
+		switch (msg->type)
+		{
+			case STR_ROUTE:
+			case STR_INITIATE:
+				bulk_append(&bulk.actions, msg, msg->length);
+				break;
+			default:
+				bulk_append(&bulk.config, msg, msg->length);
+				break;
+		}
+		bulk.count++;
+		return 0;
+	}
+	return send_stroke_data(msg, msg->length);
+}
+
+/**
+ * see header
+ */
+void starter_stroke_bulk_begin(void)
+{
+	bulk.active = TRUE;
+}
+
+/**
+ * see header
+ */
+int starter_stroke_bulk_end(void)
+{
+	bulk_buffer_t data = {
+		.ptr = NULL,
+	};
+	stroke_msg_t msg;
+	int ret = 0;
+
+	if (bulk.count)
+	{
+		memset(&msg, 0, offsetof(stroke_msg_t, buffer));
+		msg.type = STR_BULK;
+		msg.length = offsetof(stroke_msg_t, buffer);
+		msg.output_verbosity = -1;
+		msg.bulk.count = bulk.count;
+
+		/* send the header and all queued messages over a single connection */
+		bulk_append(&data, &msg, msg.length);
+		bulk_append(&data, bulk.config.ptr, bulk.config.len);
+		bulk_append(&data, bulk.actions.ptr, bulk.actions.len);
+		ret = send_stroke_data(data.ptr, data.len);
+		free(data.ptr);
+	}
+	free(bulk.config.ptr);
+	free(bulk.actions.ptr);
+	memset(&bulk, 0, sizeof(bulk));
+	return ret;
+}
+
 static char* connection_name(starter_conn_t *conn)
 {
 	 /* if connection name is '%auto', create a new name like conn_xxxxx */
@@ -27,4 +27,17 @@ int starter_stroke_add_ca(starter_ca_t *ca);
 int starter_stroke_del_ca(starter_ca_t *ca);
 int starter_stroke_configure(starter_config_t *cfg);
 
+/**
+ * Queue all following stroke messages until starter_stroke_bulk_end().
+ */
+void starter_stroke_bulk_begin(void);
+
+/**
+ * Send all queued stroke messages in a single bulk to charon, route and
+ * initiate messages after all configuration changes.
+ *
+ * @return		0 if sent successfully
+ */
+int starter_stroke_bulk_end(void);
+
 #endif /* _STARTER_STROKE_H_ */
@@ -236,7 +236,8 @@ static int unroute_connection(char *name)
 	return send_stroke_msg(&msg);
 }
 
-static int show_status(stroke_keyword_t kw, char *connection)
+static int show_status(stroke_keyword_t kw, char *connection, char *peer,
+					   char *state, int offset, int limit)
 {
 	stroke_msg_t msg;
 
@@ -254,6 +255,10 @@ static int show_status(stroke_keyword_t kw, char *connection)
 	}
 	msg.length = offsetof(stroke_msg_t, buffer);
 	msg.status.name = push_string(&msg, connection);
+	msg.status.peer = push_string(&msg, peer);
+	msg.status.state = push_string(&msg, state);
+	msg.status.offset = offset;
+	msg.status.limit = limit;
 	return send_stroke_msg(&msg);
 }
 
@@ -382,6 +387,17 @@ static int counters(int reset, char *name)
 	return send_stroke_msg(&msg);
 }
 
+static int locks(lock_flag_t flags)
+{
+	stroke_msg_t msg;
+
+	msg.type = STR_LOCKS;
+	msg.length = offsetof(stroke_msg_t, buffer);
+	msg.locks.flags = flags;
+
+	return send_stroke_msg(&msg);
+}
+
 static int set_loglevel(char *type, u_int level)
 {
 	stroke_msg_t msg;
@@ -434,11 +450,16 @@ static void exit_usage(char *error)
 	printf("    where: TYPE is any|dmn|mgr|ike|chd|job|cfg|knl|net|asn|enc|tnc|imc|imv|pts|tls|esp|lib\n");
 	printf("           LEVEL is -1|0|1|2|3|4\n");
 	printf("  Show connection status:\n");
-	printf("    stroke status\n");
+	printf("    stroke status [FILTER]\n");
 	printf("  Show extended status information:\n");
-	printf("    stroke statusall\n");
+	printf("    stroke statusall [FILTER]\n");
 	printf("  Show extended status information without blocking:\n");
-	printf("    stroke statusall-nb\n");
+	printf("    stroke statusall-nb [FILTER]\n");
+	printf("    where: FILTER is [NAME] [peer=ADDR|ID] [state=STATE] [offset=N] [limit=N]\n");
+	printf("           NAME is a connection name to show IKE_SAs and CHILD_SAs of\n");
+	printf("           ADDR|ID is an address or identity of the remote peer\n");
+	printf("           STATE is an IKE_SA state, e.g. ESTABLISHED or CONNECTING\n");
+	printf("           offset and limit page through the list of IKE_SAs\n");
 	printf("  Show list of authority and attribute certificates:\n");
 	printf("    stroke listcacerts|listocspcerts|listaacerts|listacerts\n");
 	printf("  Show list of end entity certificates, ca info records  and crls:\n");
@@ -472,6 +493,10 @@ static void exit_usage(char *error)
 	printf("           PASSWORD is the optional password, you'll be asked to enter it if not given\n");
 	printf("  Show IKE counters:\n");
 	printf("    stroke listcounters [connection-name]\n");
+	printf("  Show or reset lock contention statistics:\n");
+	printf("    stroke listlocks|resetlocks\n");
+	printf("  Enable or disable the lock contention profiler:\n");
+	printf("    stroke lockprofile on|off\n");
 	exit_error(error);
 }
 
@@ -573,8 +598,40 @@ int main(int argc, char *argv[])
 		case STROKE_STATUS:
 		case STROKE_STATUSALL:
 		case STROKE_STATUSALL_NOBLK:
-			res = show_status(token->kw, argc > 2 ? argv[2] : NULL);
+		{
+			char *name = NULL, *peer = NULL, *state = NULL;
+			int i, offset = 0, limit = 0;
+
+			for (i = 2; i < argc; i++)
+			{
+				if (strpfx(argv[i], "peer="))
+				{
+					peer = argv[i] + strlen("peer=");
+				}
+				else if (strpfx(argv[i], "state="))
+				{
+					state = argv[i] + strlen("state=");
+				}
+				else if (strpfx(argv[i], "offset="))
+				{
+					offset = atoi(argv[i] + strlen("offset="));
+				}
+				else if (strpfx(argv[i], "limit="))
+				{
+					limit = atoi(argv[i] + strlen("limit="));
+				}
+				else if (!name)
+				{
+					name = argv[i];
+				}
+				else
+				{
+					exit_usage("\"status\" accepts a single connection name");
+				}
+			}
+			res = show_status(token->kw, name, peer, state, offset, limit);
 			break;
+		}
 		case STROKE_LIST_PUBKEYS:
 		case STROKE_LIST_CERTS:
 		case STROKE_LIST_CACERTS:
@@ -633,6 +690,19 @@ int main(int argc, char *argv[])
 			res = counters(token->kw == STROKE_COUNTERS_RESET,
 						   argc > 2 ? argv[2] : NULL);
 			break;
+		case STROKE_LOCKS:
+			res = locks(LOCK_LIST);
+			break;
+		case STROKE_LOCKS_RESET:
+			res = locks(LOCK_RESET);
+			break;
+		case STROKE_LOCK_PROFILE:
+			if (argc != 3 || (!streq(argv[2], "on") && !streq(argv[2], "off")))
+			{
+				exit_usage("\"lockprofile\" needs either on or off");
+			}
+			res = locks(streq(argv[2], "on") ? LOCK_ENABLE : LOCK_DISABLE);
+			break;
 		default:
 			exit_usage(NULL);
 	}
@@ -54,7 +54,7 @@ struct stroke_token {
     stroke_keyword_t kw;
 };
 
-#define TOTAL_KEYWORDS 48
+#define TOTAL_KEYWORDS 51
 #define MIN_WORD_LENGTH 2
 #define MAX_WORD_LENGTH 15
 #define MIN_HASH_VALUE 3
@@ -130,6 +130,7 @@ static const struct stroke_token wordlist[] =
     {"down",            STROKE_DOWN},
     {"listall",         STROKE_LIST_ALL},
     {"listcrls",        STROKE_LIST_CRLS},
+    {"listlocks",       STROKE_LOCKS},
     {"up",              STROKE_UP},
     {"listaacerts",     STROKE_LIST_AACERTS},
     {"listcacerts",     STROKE_LIST_CACERTS},
@@ -168,20 +169,22 @@ static const struct stroke_token wordlist[] =
     {"listocspcerts",   STROKE_LIST_OCSPCERTS},
     {"memusage",        STROKE_MEMUSAGE},
     {"purgeike",        STROKE_PURGE_IKE},
+    {"lockprofile",     STROKE_LOCK_PROFILE},
     {"user-creds",      STROKE_USER_CREDS},
     {"down-nb",         STROKE_DOWN_NOBLK},
     {"purgecerts",      STROKE_PURGE_CERTS},
+    {"resetlocks",      STROKE_LOCKS_RESET},
     {"listgroups",      STROKE_LIST_GROUPS},
     {"resetcounters",   STROKE_COUNTERS_RESET}
   };
 
 static const short lookup[] =
   {
-    -1, -1, -1,  0,  1,  2, -1,  3, -1,  4, -1,  5,  6,  7,
-     8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21,
-    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35,
-    36, 37, 38, 39, 40, 41, 42, -1, 43, 44, -1, -1, 45, -1,
-    -1, 46, -1, 47
+    -1, -1, -1,  0,  1,  2, -1,  3, -1,  4,  5,  6,  7,  8,
+     9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22,
+    23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36,
+    37, 38, 39, 40, 41, 42, 43, 44, 45, 46, -1, -1, 47, -1,
+    48, 49, -1, 50
   };
 
 #ifdef __GNUC__
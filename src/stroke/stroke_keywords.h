@@ -64,6 +64,9 @@ typedef enum {
 	STROKE_USER_CREDS,
 	STROKE_COUNTERS,
 	STROKE_COUNTERS_RESET,
+	STROKE_LOCKS,
+	STROKE_LOCKS_RESET,
+	STROKE_LOCK_PROFILE,
 } stroke_keyword_t;
 
 #define STROKE_LIST_FIRST		STROKE_LIST_PUBKEYS
@@ -115,6 +115,22 @@ enum purge_flag_t {
 	PURGE_IKE =			0x0008,
 };
 
+typedef enum lock_flag_t lock_flag_t;
+
+/**
+ * Definition of the lock profiler actions
+ */
+enum lock_flag_t {
+	/** print lock profiler statistics */
+	LOCK_LIST =			0x0001,
+	/** reset lock profiler statistics */
+	LOCK_RESET =		0x0002,
+	/** enable lock profiling */
+	LOCK_ENABLE =		0x0004,
+	/** disable lock profiling */
+	LOCK_DISABLE =		0x0008,
+};
+
 typedef enum export_flag_t export_flag_t;
 
 /**
@@ -230,6 +246,10 @@ struct stroke_msg_t {
 		STR_USER_CREDS,
 		/* print/reset counters */
 		STR_COUNTERS,
+		/* control/print lock profiler */
+		STR_LOCKS,
+		/* bulk of messages following on the same connection */
+		STR_BULK,
 		/* more to come */
 	} type;
 
@@ -240,7 +260,16 @@ struct stroke_msg_t {
 		/* data for STR_INITIATE, STR_ROUTE, STR_UP, STR_DOWN, ... */
 		struct {
 			char *name;
-		} initiate, route, unroute, terminate, rekey, status, del_conn, del_ca;
+		} initiate, route, unroute, terminate, rekey, del_conn, del_ca;
+
+		/* data for STR_STATUS, STR_STATUS_ALL, STR_STATUS_ALL_NOBLK */
+		struct {
+			char *name;
+			char *peer;
+			char *state;
+			int offset;
+			int limit;
+		} status;
 
 		/* data for STR_TERMINATE_SRCIP */
 		struct {
@@ -369,6 +398,16 @@ struct stroke_msg_t {
 			int reset;
 			char *name;
 		} counters;
+
+		/* data for STR_LOCKS */
+		struct {
+			lock_flag_t flags;
+		} locks;
+
+		/* data for STR_BULK, followed by count messages, handled as a batch */
+		struct {
+			int count;
+		} bulk;
 	};
 	char buffer[STROKE_BUF_LEN];
 };
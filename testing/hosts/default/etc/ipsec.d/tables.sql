@@ -175,6 +175,12 @@ CREATE TABLE certificate_distribution_points (
   uri TEXT NOT NULL
 );
 
+DROP TABLE IF EXISTS config_generation;
+CREATE TABLE config_generation (
+  generation INTEGER NOT NULL DEFAULT 0
+);
+INSERT INTO config_generation (generation) VALUES (0);
+
 DROP TABLE IF EXISTS pools;
 CREATE TABLE pools (
   id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,